@@ -43,6 +43,10 @@
 #include "zmalloc.h"
 #include "config.h"
 
+/* Initial number of slots of the time events heap and id table. */
+// 时间事件最小堆和 id 索引表的初始大小
+#define AE_TIME_HEAP_INITIAL_SIZE 16
+
 /* Include the best multiplexing layer supported by this system.
  * The following should be ordered by performances, descending. */
 #ifdef HAVE_EVPORT
@@ -77,7 +81,14 @@ aeEventLoop *aeCreateEventLoop(int setsize) {
     eventLoop->lastTime = time(NULL);
 
     // 初始化时间事件结构
-    eventLoop->timeEventHead = NULL;
+    eventLoop->timeEventHeap = NULL;
+    eventLoop->timeEventHeapUsed = 0;
+    eventLoop->timeEventHeapSize = 0;
+    eventLoop->timeEventTable = NULL;
+    eventLoop->timeEventTableSize = 0;
+    eventLoop->timeEventCount = 0;
+    eventLoop->timeEventPending = NULL;
+    eventLoop->timeEventProcessing = 0;
     eventLoop->timeEventNextId = 0;
 
     eventLoop->stop = 0;
@@ -103,6 +114,26 @@ err:
  * 删除事件处理器
  */
 void aeDeleteEventLoop(aeEventLoop *eventLoop) {
+    aeTimeEvent *te;
+    int j;
+
+    // 释放所有时间事件，包括堆中的和待插入链表中的，
+    // 并调用它们的释放函数
+    for (j = 0; j < eventLoop->timeEventHeapUsed; j++) {
+        te = eventLoop->timeEventHeap[j];
+        if (te->finalizerProc)
+            te->finalizerProc(eventLoop, te->clientData);
+        zfree(te);
+    }
+    while((te = eventLoop->timeEventPending) != NULL) {
+        eventLoop->timeEventPending = te->next;
+        if (te->finalizerProc)
+            te->finalizerProc(eventLoop, te->clientData);
+        zfree(te);
+    }
+    zfree(eventLoop->timeEventHeap);
+    zfree(eventLoop->timeEventTable);
+
     aeApiFree(eventLoop);
     zfree(eventLoop->events);
     zfree(eventLoop->fired);
@@ -216,8 +247,190 @@ static void aeAddMillisecondsToNow(long long milliseconds, long *sec, long *ms)
     *ms = when_ms;
 }
 
+/* Returns non-zero if the time event 'a' should fire before 'b'.
+ *
+ * 如果事件 a 的到达时间早于事件 b ，那么返回非 0 值
+ */
+static int aeTimeEventBefore(aeTimeEvent *a, aeTimeEvent *b) {
+    return a->when_sec < b->when_sec ||
+           (a->when_sec == b->when_sec && a->when_ms < b->when_ms);
+}
+
+/*
+ * 将事件 te 放到堆数组的下标 j 处，并更新事件记录的下标
+ */
+static void aeTimeHeapSet(aeEventLoop *eventLoop, int j, aeTimeEvent *te) {
+    eventLoop->timeEventHeap[j] = te;
+    te->heapIndex = j;
+}
+
+/*
+ * 将下标为 i 的事件向堆顶方向移动，直到满足堆性质
+ *
+ * T = O(log N)
+ */
+static void aeTimeHeapSiftUp(aeEventLoop *eventLoop, int i) {
+    aeTimeEvent *te = eventLoop->timeEventHeap[i];
+
+    while (i > 0) {
+        int parent = (i-1)/2;
+        aeTimeEvent *p = eventLoop->timeEventHeap[parent];
+
+        if (!aeTimeEventBefore(te,p)) break;
+        aeTimeHeapSet(eventLoop,i,p);
+        i = parent;
+    }
+    aeTimeHeapSet(eventLoop,i,te);
+}
+
+/*
+ * 将下标为 i 的事件向堆底方向移动，直到满足堆性质
+ *
+ * T = O(log N)
+ */
+static void aeTimeHeapSiftDown(aeEventLoop *eventLoop, int i) {
+    aeTimeEvent *te = eventLoop->timeEventHeap[i];
+    int used = eventLoop->timeEventHeapUsed;
+
+    while (1) {
+        int child = i*2+1;
+
+        if (child >= used) break;
+        // 选出两个子节点中较早到达的那个
+        if (child+1 < used &&
+            aeTimeEventBefore(eventLoop->timeEventHeap[child+1],
+                              eventLoop->timeEventHeap[child]))
+            child++;
+        if (!aeTimeEventBefore(eventLoop->timeEventHeap[child],te)) break;
+        aeTimeHeapSet(eventLoop,i,eventLoop->timeEventHeap[child]);
+        i = child;
+    }
+    aeTimeHeapSet(eventLoop,i,te);
+}
+
+/*
+ * 将事件 te 插入到最小堆中，有需要的话对堆数组进行扩容
+ *
+ * T = O(log N)
+ */
+static int aeTimeHeapInsert(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    if (eventLoop->timeEventHeapUsed == eventLoop->timeEventHeapSize) {
+        int size = eventLoop->timeEventHeapSize ?
+                   eventLoop->timeEventHeapSize*2 : AE_TIME_HEAP_INITIAL_SIZE;
+        aeTimeEvent **heap;
+
+        heap = zrealloc(eventLoop->timeEventHeap,sizeof(aeTimeEvent*)*size);
+        if (heap == NULL) return AE_ERR;
+        eventLoop->timeEventHeap = heap;
+        eventLoop->timeEventHeapSize = size;
+    }
+    aeTimeHeapSet(eventLoop,eventLoop->timeEventHeapUsed++,te);
+    aeTimeHeapSiftUp(eventLoop,te->heapIndex);
+    return AE_OK;
+}
+
+/*
+ * 将事件 te 从最小堆中删除
+ *
+ * 做法是用堆的最后一个事件填补 te 的位置，
+ * 然后根据需要向上或者向下调整这个事件。
+ *
+ * T = O(log N)
+ */
+static void aeTimeHeapRemove(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    int i = te->heapIndex;
+    aeTimeEvent *last = eventLoop->timeEventHeap[--eventLoop->timeEventHeapUsed];
+
+    te->heapIndex = -1;
+    if (last == te) return;
+    aeTimeHeapSet(eventLoop,i,last);
+    if (i > 0 && aeTimeEventBefore(last,eventLoop->timeEventHeap[(i-1)/2]))
+        aeTimeHeapSiftUp(eventLoop,i);
+    else
+        aeTimeHeapSiftDown(eventLoop,i);
+}
+
+/*
+ * 将事件 te 添加到 id 索引表中
+ */
+static void aeTimeTableAdd(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    unsigned long idx = (unsigned long)te->id & (eventLoop->timeEventTableSize-1);
+
+    te->idNext = eventLoop->timeEventTable[idx];
+    eventLoop->timeEventTable[idx] = te;
+}
+
+/*
+ * 在索引表中的事件数量达到表大小时，将索引表的大小扩展为原来的两倍，
+ * 并将所有事件重新散列到新表中
+ *
+ * T = O(N) ，但均摊到每次插入上是 O(1)
+ */
+static int aeTimeTableExpandIfNeeded(aeEventLoop *eventLoop) {
+    aeTimeEvent **oldtable = eventLoop->timeEventTable;
+    unsigned long oldsize = eventLoop->timeEventTableSize, j;
+    unsigned long size;
+
+    if (eventLoop->timeEventCount < oldsize) return AE_OK;
+
+    size = oldsize ? oldsize*2 : AE_TIME_HEAP_INITIAL_SIZE;
+    eventLoop->timeEventTable = zcalloc(sizeof(aeTimeEvent*)*size);
+    if (eventLoop->timeEventTable == NULL) {
+        eventLoop->timeEventTable = oldtable;
+        return AE_ERR;
+    }
+    eventLoop->timeEventTableSize = size;
+
+    for (j = 0; j < oldsize; j++) {
+        aeTimeEvent *te = oldtable[j], *next;
+
+        while(te) {
+            next = te->idNext;
+            aeTimeTableAdd(eventLoop,te);
+            te = next;
+        }
+    }
+    zfree(oldtable);
+    return AE_OK;
+}
+
+/*
+ * 从 id 索引表中查找并删除 id 对应的事件
+ *
+ * 找到时返回该事件，找不到时返回 NULL
+ *
+ * T = O(1)
+ */
+static aeTimeEvent *aeTimeTableUnlink(aeEventLoop *eventLoop, long long id) {
+    aeTimeEvent *te, *prev = NULL;
+    unsigned long idx;
+
+    if (eventLoop->timeEventTableSize == 0) return NULL;
+
+    idx = (unsigned long)id & (eventLoop->timeEventTableSize-1);
+    te = eventLoop->timeEventTable[idx];
+    while(te) {
+        if (te->id == id) {
+            if (prev == NULL)
+                eventLoop->timeEventTable[idx] = te->idNext;
+            else
+                prev->idNext = te->idNext;
+            return te;
+        }
+        prev = te;
+        te = te->idNext;
+    }
+    return NULL;
+}
+
 /*
  * 创建时间事件
+ *
+ * 事件会被同时加入 id 索引表和最小堆中，
+ * 如果当前正在处理时间事件，那么新事件会先放到待插入链表里，
+ * 等处理结束之后才加入堆中，以免在同一轮处理中执行由事件处理器创建的事件。
+ *
+ * T = O(log N)
  */
 long long aeCreateTimeEvent(aeEventLoop *eventLoop, long long milliseconds,
         aeTimeProc *proc, void *clientData,
@@ -237,42 +450,63 @@ long long aeCreateTimeEvent(aeEventLoop *eventLoop, long long milliseconds,
     te->timeProc = proc;
     te->finalizerProc = finalizerProc;
     te->clientData = clientData;
-
-    // 将新事件放入表头
-    te->next = eventLoop->timeEventHead;
-    eventLoop->timeEventHead = te;
+    te->heapIndex = -1;
+    te->prev = te->next = NULL;
+
+    // 将新事件放入索引表
+    eventLoop->timeEventCount++;
+    if (aeTimeTableExpandIfNeeded(eventLoop) == AE_ERR) {
+        eventLoop->timeEventCount--;
+        zfree(te);
+        return AE_ERR;
+    }
+    aeTimeTableAdd(eventLoop,te);
+
+    // 将新事件放入最小堆，或者待插入链表
+    if (eventLoop->timeEventProcessing) {
+        te->next = eventLoop->timeEventPending;
+        if (te->next) te->next->prev = te;
+        eventLoop->timeEventPending = te;
+    } else if (aeTimeHeapInsert(eventLoop,te) == AE_ERR) {
+        aeTimeTableUnlink(eventLoop,id);
+        eventLoop->timeEventCount--;
+        zfree(te);
+        return AE_ERR;
+    }
 
     return id;
 }
 
 /*
  * 删除给定 id 的时间事件
+ *
+ * T = O(log N)
  */
 int aeDeleteTimeEvent(aeEventLoop *eventLoop, long long id)
 {
-    aeTimeEvent *te, *prev = NULL;
-
-    te = eventLoop->timeEventHead;
-    while(te) {
-        if (te->id == id) {
+    aeTimeEvent *te = aeTimeTableUnlink(eventLoop,id);
 
-            if (prev == NULL)
-                eventLoop->timeEventHead = te->next;
-            else
-                prev->next = te->next;
+    if (te == NULL) return AE_ERR; /* NO event with the specified ID found */
 
-            if (te->finalizerProc)
-                te->finalizerProc(eventLoop, te->clientData);
+    if (te->heapIndex != -1) {
+        // 从最小堆中删除
+        aeTimeHeapRemove(eventLoop,te);
+    } else {
+        // 从待插入链表中删除
+        if (te->prev)
+            te->prev->next = te->next;
+        else
+            eventLoop->timeEventPending = te->next;
+        if (te->next) te->next->prev = te->prev;
+    }
+    eventLoop->timeEventCount--;
 
-            zfree(te);
+    if (te->finalizerProc)
+        te->finalizerProc(eventLoop, te->clientData);
 
-            return AE_OK;
-        }
-        prev = te;
-        te = te->next;
-    }
+    zfree(te);
 
-    return AE_ERR; /* NO event with the specified ID found */
+    return AE_OK;
 }
 
 /* Search the first timer to fire.
@@ -280,27 +514,15 @@ int aeDeleteTimeEvent(aeEventLoop *eventLoop, long long id)
  * put in sleep without to delay any event.
  * If there are no timers NULL is returned.
  *
- * Note that's O(N) since time events are unsorted.
- * Possible optimizations (not needed by Redis so far, but...):
- * 1) Insert the event in order, so that the nearest is just the head.
- *    Much better but still insertion or deletion of timers is O(N).
- * 2) Use a skiplist to have this operation as O(1) and insertion as O(log(N)).
+ * Time events are kept in a min-heap ordered by fire time, so the
+ * nearest timer is always the root of the heap.
  */
 // 寻找里目前时间最近的时间事件
-// 因为链表是乱序的，所以查找复杂度为 O（N）
+// 时间事件保存在最小堆中，堆顶就是最近的事件，所以复杂度为 O（1）
 static aeTimeEvent *aeSearchNearestTimer(aeEventLoop *eventLoop)
 {
-    aeTimeEvent *te = eventLoop->timeEventHead;
-    aeTimeEvent *nearest = NULL;
-
-    while(te) {
-        if (!nearest || te->when_sec < nearest->when_sec ||
-                (te->when_sec == nearest->when_sec &&
-                 te->when_ms < nearest->when_ms))
-            nearest = te;
-        te = te->next;
-    }
-    return nearest;
+    if (eventLoop->timeEventHeapUsed == 0) return NULL;
+    return eventLoop->timeEventHeap[0];
 }
 
 /* Process time events
@@ -310,8 +532,8 @@ static aeTimeEvent *aeSearchNearestTimer(aeEventLoop *eventLoop)
 static int processTimeEvents(aeEventLoop *eventLoop) {
     int processed = 0;
     aeTimeEvent *te;
-    long long maxId;
     time_t now = time(NULL);
+    int j;
 
     /* If the system clock is moved to the future, and then set back to the
      * right value, time events may be delayed in a random way. Often this
@@ -324,67 +546,62 @@ static int processTimeEvents(aeEventLoop *eventLoop) {
     // 通过重置事件的运行时间，
     // 防止因时间穿插（skew）而造成的事件处理混乱
     if (now < eventLoop->lastTime) {
-        te = eventLoop->timeEventHead;
-        while(te) {
-            te->when_sec = 0;
-            te = te->next;
-        }
+        for (j = 0; j < eventLoop->timeEventHeapUsed; j++)
+            eventLoop->timeEventHeap[j]->when_sec = 0;
+        // 所有事件的键都被修改了，重建整个堆
+        for (j = eventLoop->timeEventHeapUsed/2-1; j >= 0; j--)
+            aeTimeHeapSiftDown(eventLoop,j);
     }
     // 更新最后一次处理时间事件的时间
     eventLoop->lastTime = now;
 
-    te = eventLoop->timeEventHead;
-    maxId = eventLoop->timeEventNextId-1;
-    while(te) {
+    /* Events registered by the handlers themselves are parked in the
+     * pending list until we are done, so that we don't loop forever
+     * processing timers created by the timers we are processing. */
+    eventLoop->timeEventProcessing = 1;
+    while(eventLoop->timeEventHeapUsed) {
         long now_sec, now_ms;
         long long id;
+        int retval;
+
+        te = eventLoop->timeEventHeap[0];
 
-        // 跳过无效事件
-        if (te->id > maxId) {
-            te = te->next;
-            continue;
-        }
-        
         // 获取当前时间
         aeGetTime(&now_sec, &now_ms);
 
-        // 如果当前时间等于或等于事件的执行时间，那么执行这个事件
-        if (now_sec > te->when_sec ||
-            (now_sec == te->when_sec && now_ms >= te->when_ms))
-        {
-            int retval;
+        // 堆顶事件还没有到达，那么其他事件也没有到达
+        if (now_sec < te->when_sec ||
+            (now_sec == te->when_sec && now_ms < te->when_ms)) break;
 
-            id = te->id;
-            retval = te->timeProc(eventLoop, id, te->clientData);
-            processed++;
-            /* After an event is processed our time event list may
-             * no longer be the same, so we restart from head.
-             * Still we make sure to don't process events registered
-             * by event handlers itself in order to don't loop forever.
-             * To do so we saved the max ID we want to handle.
-             *
-             * FUTURE OPTIMIZATIONS:
-             * Note that this is NOT great algorithmically. Redis uses
-             * a single time event so it's not a problem but the right
-             * way to do this is to add the new elements on head, and
-             * to flag deleted elements in a special way for later
-             * deletion (putting references to the nodes to delete into
-             * another linked list). */
-
-            // 记录是否有需要循环执行这个事件时间
-            if (retval != AE_NOMORE) {
-                // 是的， retval 毫秒之后继续执行这个时间事件
-                aeAddMillisecondsToNow(retval,&te->when_sec,&te->when_ms);
-            } else {
-                // 不，将这个事件删除
-                aeDeleteTimeEvent(eventLoop, id);
-            }
+        // 执行事件
+        id = te->id;
+        retval = te->timeProc(eventLoop, id, te->clientData);
+        processed++;
 
-            // 因为执行事件之后，事件列表可能已经被改变了
-            // 因此需要将 te 放回表头，继续开始执行事件
-            te = eventLoop->timeEventHead;
+        // 记录是否有需要循环执行这个事件时间
+        if (retval != AE_NOMORE) {
+            // 是的， retval 毫秒之后继续执行这个时间事件
+            aeAddMillisecondsToNow(retval,&te->when_sec,&te->when_ms);
+            aeTimeHeapSiftDown(eventLoop,te->heapIndex);
         } else {
-            te = te->next;
+            // 不，将这个事件删除
+            aeDeleteTimeEvent(eventLoop, id);
+        }
+    }
+    eventLoop->timeEventProcessing = 0;
+
+    // 将处理期间创建的事件放入堆中
+    while((te = eventLoop->timeEventPending) != NULL) {
+        eventLoop->timeEventPending = te->next;
+        if (te->next) te->next->prev = NULL;
+        te->next = NULL;
+        if (aeTimeHeapInsert(eventLoop,te) == AE_ERR) {
+            // 无法放入堆中，只能删除这个事件
+            aeTimeTableUnlink(eventLoop,te->id);
+            eventLoop->timeEventCount--;
+            if (te->finalizerProc)
+                te->finalizerProc(eventLoop, te->clientData);
+            zfree(te);
         }
     }
     return processed;
@@ -565,3 +782,88 @@ char *aeGetApiName(void) {
 void aeSetBeforeSleepProc(aeEventLoop *eventLoop, aeBeforeSleepProc *beforesleep) {
     eventLoop->beforesleep = beforesleep;
 }
+
+#ifdef AE_BENCHMARK_MAIN
+/* Micro benchmark of the time events machinery. Compile with:
+ *
+ *   cd src && make && cc -O2 -DAE_BENCHMARK_MAIN ae.c zmalloc.o \
+ *       ../deps/jemalloc/lib/libjemalloc.a -DUSE_JEMALLOC \
+ *       -I../deps/jemalloc/include -ldl -pthread -o ae-benchmark
+ *
+ * and run it as ./ae-benchmark [timers] [seconds].
+ *
+ * 时间事件的微型基准测试
+ */
+#include <sys/time.h>
+
+static long long ustime(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+    return ((long long)tv.tv_sec)*1000000+tv.tv_usec;
+}
+
+static long long fired = 0;
+
+/* Timers re-arm themselves with a random period between 1 and 100 ms. */
+static int benchTimerProc(aeEventLoop *eventLoop, long long id, void *clientData) {
+    AE_NOTUSED(eventLoop);
+    AE_NOTUSED(id);
+    AE_NOTUSED(clientData);
+    fired++;
+    return 1+rand()%100;
+}
+
+int main(int argc, char **argv) {
+    int timers = argc > 1 ? atoi(argv[1]) : 10000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 1;
+    long long iterations = 0;
+    aeEventLoop *el = aeCreateEventLoop(64);
+    long long *ids = zmalloc(sizeof(long long)*timers);
+    long long start, elapsed;
+    int j;
+
+    srand(1234);
+
+    // 创建定时器
+    start = ustime();
+    for (j = 0; j < timers; j++)
+        ids[j] = aeCreateTimeEvent(el,1+rand()%100,benchTimerProc,NULL,NULL);
+    elapsed = ustime()-start;
+    printf("Create %d timers: %.3f usec per timer\n",
+        timers, (double)elapsed/timers);
+
+    // 模拟事件循环的一次迭代：查找最近的定时器，然后处理已到达的定时器
+    start = ustime();
+    do {
+        aeProcessEvents(el, AE_TIME_EVENTS|AE_DONT_WAIT);
+        iterations++;
+        elapsed = ustime()-start;
+    } while(elapsed < (long long)seconds*1000000);
+    printf("Event loop with %d timers: %.3f usec per iteration, "
+           "%.3f usec per fired timer (%lld fired)\n",
+        timers, (double)elapsed/iterations, (double)elapsed/fired, fired);
+
+    iterations = 1000000;
+    start = ustime();
+    for (j = 0; j < iterations; j++) {
+        aeTimeEvent *te = aeSearchNearestTimer(el);
+        if (te == NULL) break;
+    }
+    elapsed = ustime()-start;
+    printf("Search nearest timer with %d timers: %.3f usec per call\n",
+        timers, (double)elapsed/iterations);
+
+    // 按 id 删除所有定时器
+    start = ustime();
+    for (j = 0; j < timers; j++)
+        aeDeleteTimeEvent(el,ids[timers-1-j]);
+    elapsed = ustime()-start;
+    printf("Delete %d timers: %.3f usec per timer\n",
+        timers, (double)elapsed/timers);
+
+    zfree(ids);
+    aeDeleteEventLoop(el);
+    return 0;
+}
+#endif
@@ -110,7 +110,16 @@ typedef struct aeTimeEvent {
     // 多路复用库的私有数据
     void *clientData;
 
-    // 指向下个时间事件结构，形成链表
+    // 事件在最小堆数组中的下标，
+    // 为 -1 表示事件还在待插入链表中，尚未进入堆
+    int heapIndex;
+
+    // 指向 id 索引表中同一个桶的下个时间事件
+    struct aeTimeEvent *idNext;
+
+    // 指向待插入链表中的前一个和下一个时间事件，
+    // 双向链接使得删除待插入事件的复杂度为 O(1)
+    struct aeTimeEvent *prev;
     struct aeTimeEvent *next;
 
 } aeTimeEvent;
@@ -143,8 +152,22 @@ typedef struct aeEventLoop {
     aeFileEvent *events; /* Registered events */
     // 已就绪的文件事件
     aeFiredEvent *fired; /* Fired events */
-    // 时间事件
-    aeTimeEvent *timeEventHead;
+    // 时间事件最小堆，以 when_sec/when_ms 为键，堆顶就是最近要执行的事件
+    aeTimeEvent **timeEventHeap;
+    // 堆中的事件数量
+    int timeEventHeapUsed;
+    // 堆数组的容量
+    int timeEventHeapSize;
+    // 以 id 为键的时间事件索引表（链地址法），用于按 id 查找事件
+    aeTimeEvent **timeEventTable;
+    // 索引表的大小，总是 2 的幂
+    unsigned long timeEventTableSize;
+    // 已注册的时间事件总数（包括堆中的和待插入的）
+    unsigned long timeEventCount;
+    // 处理时间事件期间新创建的事件，在处理结束后才放入堆中
+    aeTimeEvent *timeEventPending;
+    // 是否正在处理时间事件
+    int timeEventProcessing;
     // 事件处理器的开关
     int stop;
     // 多路复用库的私有数据
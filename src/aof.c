@@ -66,7 +66,8 @@ void aofUpdateCurrentSize(void);
 
 typedef struct aofrwblock {
     unsigned long used, // 已使用字节
-                  free; // 剩余可用字节
+                  free, // 剩余可用字节
+                  sent; // 已经通过管道发送给子进程的字节
     char buf[AOF_RW_BUF_BLOCK_SIZE];
 } aofrwblock;
 
@@ -99,12 +100,70 @@ unsigned long aofRewriteBufferSize(void) {
     if (block == NULL) return 0;
 
     // 总缓存大小 = 每个块大小 * (块数量 - 1) + 最后一个块的大小
+    //            - 第一个块中已经发送给子进程的部分
     unsigned long size =
         (listLength(server.aof_rewrite_buf_blocks)-1) * AOF_RW_BUF_BLOCK_SIZE;
     size += block->used;
+    block = listNodeValue(listFirst(server.aof_rewrite_buf_blocks));
+    size -= block->sent;
     return size;
 }
 
+/* Event handler used to send data to the child process doing the AOF
+ * rewrite. We send pieces of our AOF differences buffer so that the final
+ * write when the child finishes the rewrite will be small.
+ *
+ * 将 AOF 重写缓存中的数据通过管道发送给正在重写的子进程，
+ * 这样子进程退出后，父进程需要写入的剩余数据会很少。 */
+void aofChildWriteDiffData(aeEventLoop *el, int fd, void *privdata, int mask) {
+    listNode *ln;
+    aofrwblock *block;
+    ssize_t nwritten;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(fd);
+    REDIS_NOTUSED(privdata);
+    REDIS_NOTUSED(mask);
+
+    while(1) {
+        ln = listFirst(server.aof_rewrite_buf_blocks);
+        block = ln ? ln->value : NULL;
+        if (server.aof_stop_sending_diff || !block) {
+            aeDeleteFileEvent(server.el,server.aof_pipe_write_data_to_child,
+                              AE_WRITABLE);
+            return;
+        }
+        if (block->sent < block->used) {
+            nwritten = write(server.aof_pipe_write_data_to_child,
+                             block->buf+block->sent,block->used-block->sent);
+            if (nwritten <= 0) {
+                /* The pipe is full: wait for the next writable event.
+                 * On real errors just stop sending, the parent will flush
+                 * what is left by itself at the end of the rewrite. */
+                if (nwritten == -1 && errno != EAGAIN) {
+                    server.aof_stop_sending_diff = 1;
+                    aeDeleteFileEvent(server.el,
+                        server.aof_pipe_write_data_to_child,AE_WRITABLE);
+                }
+                return;
+            }
+            block->sent += nwritten;
+        }
+        if (block->sent == block->used) {
+            // 整个块都已发送：尾块原地复用，其他块直接释放
+            if (ln == listLast(server.aof_rewrite_buf_blocks)) {
+                /* Everything was sent: reuse the last block and wait for
+                 * aofRewriteBufferAppend() to install the handler again. */
+                block->used = block->sent = 0;
+                block->free = AOF_RW_BUF_BLOCK_SIZE;
+                aeDeleteFileEvent(server.el,
+                    server.aof_pipe_write_data_to_child,AE_WRITABLE);
+                return;
+            }
+            listDelNode(server.aof_rewrite_buf_blocks,ln);
+        }
+    }
+}
+
 /* Append data to the AOF rewrite buffer, allocating new blocks if needed. 
  *
  * 将数组 s 追加到 AOF 缓存的末尾。
@@ -138,6 +197,7 @@ void aofRewriteBufferAppend(unsigned char *s, unsigned long len) {
             block = zmalloc(sizeof(*block));
             block->free = AOF_RW_BUF_BLOCK_SIZE;
             block->used = 0;
+            block->sent = 0;
             listAddNodeTail(server.aof_rewrite_buf_blocks,block);
 
             /* Log every time we cross more 10 or 100 blocks, respectively
@@ -151,6 +211,17 @@ void aofRewriteBufferAppend(unsigned char *s, unsigned long len) {
             }
         }
     }
+
+    /* Install a file event to send data to the rewrite child if there is
+     * not one already. */
+    // 如果还没有安装写事件，那么安装它，以便把新数据发送给子进程
+    if (server.aof_pipe_write_data_to_child != -1 &&
+        !server.aof_stop_sending_diff &&
+        aeGetFileEvents(server.el,server.aof_pipe_write_data_to_child) == 0)
+    {
+        aeCreateFileEvent(server.el, server.aof_pipe_write_data_to_child,
+            AE_WRITABLE, aofChildWriteDiffData, NULL);
+    }
 }
 
 /* Write the buffer (possibly composed of multiple blocks) into the specified
@@ -176,9 +247,10 @@ ssize_t aofRewriteBufferWrite(int fd) {
         aofrwblock *block = listNodeValue(ln);
         ssize_t nwritten;
 
-        if (block->used) {
-            nwritten = write(fd,block->buf,block->used);
-            if (nwritten != block->used) {
+        if (block->used > block->sent) {
+            nwritten = write(fd,block->buf+block->sent,
+                             block->used-block->sent);
+            if (nwritten != (ssize_t)(block->used-block->sent)) {
                 if (nwritten == 0) errno = EIO;
                 return -1;
             }
@@ -202,6 +274,231 @@ void aof_background_fsync(int fd) {
     bioCreateBackgroundJob(REDIS_BIO_AOF_FSYNC,(void*)(long)fd,NULL,NULL);
 }
 
+/* ----------------------------------------------------------------------------
+ * Threaded AOF writes
+ *
+ * When aof-write-thread is enabled, flushAppendOnlyFile() does not call
+ * write(2) itself: server.aof_buf is handed as a batch to the
+ * REDIS_BIO_AOF_WRITE thread, that writes it and performs the fsync the
+ * policy asks for, while a second buffer accumulates the next writes.
+ * At most one batch is in flight: everything accumulated while the thread
+ * is busy is written as a single batch as soon as it finishes, so with
+ * "appendfsync always" a single fsync commits the writes of many clients.
+ *
+ * 启用 aof-write-thread 时，AOF 缓存作为一个批次交给后台线程写入并 fsync ，
+ * 主线程则继续在另一个缓存里累积新的写命令。
+ * 任何时候最多只有一个批次正在写入，
+ * 线程忙碌期间累积的所有命令会在它完成之后作为一个批次写入（组提交）。
+ *
+ * With "appendfsync always" the replies of the clients that wrote are held
+ * until the batch containing their writes is on disk, see
+ * aofHoldClientReply().
+ * ------------------------------------------------------------------------- */
+
+typedef struct aofWriteJob {
+    int fd;             /* AOF file descriptor. */
+    sds buf;            /* Batch to write. */
+    int fsync;          /* Call fsync after the write. */
+    long long seq;      /* Sequence number of the batch. */
+    ssize_t nwritten;   /* Return value of write(2). */
+    int write_errno;    /* errno set by write(2) if it failed. */
+} aofWriteJob;
+
+/* Log a failed or short write of 'len' bytes to the AOF and exit: the best
+ * thing to do for now is aborting instead of giving the illusion that
+ * everything is working as expected. */
+static void aofExitOnWriteError(int fd, ssize_t nwritten, size_t len) {
+    if (nwritten == -1) {
+        redisLog(REDIS_WARNING,"Exiting on error writing to the append-only file: %s",strerror(errno));
+    } else {
+        redisLog(REDIS_WARNING,"Exiting on short write while writing to "
+                               "the append-only file: %s (nwritten=%ld, "
+                               "expected=%ld)",
+                               strerror(errno),
+                               (long)nwritten,
+                               (long)len);
+
+        if (ftruncate(fd, server.aof_current_size) == -1) {
+            redisLog(REDIS_WARNING, "Could not remove short write "
+                     "from the append-only file.  Redis may refuse "
+                     "to load the AOF the next time it starts.  "
+                     "ftruncate: %s", strerror(errno));
+        }
+    }
+    exit(1);
+}
+
+/* Called by the REDIS_BIO_AOF_WRITE thread: write the batch, fsync it if
+ * needed and pass it back to the main thread. */
+/*
+ * 在后台线程中执行：写入批次，有需要的话执行 fsync ，然后通知主线程。
+ */
+void aofWriteBatchFromBioThread(void *ptr) {
+    aofWriteJob *job = ptr;
+
+    job->nwritten = write(job->fd,job->buf,sdslen(job->buf));
+    if (job->nwritten == -1)
+        job->write_errno = errno;
+    else if (job->nwritten == (ssize_t)sdslen(job->buf) && job->fsync)
+        aof_fsync(job->fd);
+
+    /* A pointer is smaller than PIPE_BUF, so the write is atomic. */
+    if (write(server.aof_write_done_pipe[1],&job,sizeof(job)) != sizeof(job))
+        redisLog(REDIS_WARNING,"Can't notify the AOF write completion: %s",
+            strerror(errno));
+}
+
+/* Send the held replies of the clients waiting for AOF batches up to 'seq'
+ * (included). */
+static void aofReleaseWaitingClients(long long seq) {
+    listIter li;
+    listNode *ln;
+
+    listRewind(server.clients_waiting_aof,&li);
+    while((ln = listNext(&li))) {
+        redisClient *c = listNodeValue(ln);
+
+        if (c->aof_wait_seq > seq) continue;
+        aofUnlinkWaitingClient(c);
+        scheduleClientReplyWrite(c);
+    }
+}
+
+/* Handle a batch written by the thread. */
+static void aofWriteBatchDone(aofWriteJob *job) {
+    size_t len = sdslen(job->buf);
+
+    server.aof_write_in_progress = 0;
+    if (job->nwritten != (ssize_t)len) {
+        errno = job->write_errno;
+        aofExitOnWriteError(job->fd,job->nwritten,len);
+    }
+    server.aof_current_size += job->nwritten;
+    aofReleaseWaitingClients(job->seq);
+
+    /* Keep the buffer for the next batch when it is small enough, like
+     * flushAppendOnlyFile() does with the single buffer. */
+    if (server.aof_buf_spare == NULL && len+sdsavail(job->buf) < 4000) {
+        sdsclear(job->buf);
+        server.aof_buf_spare = job->buf;
+    } else {
+        sdsfree(job->buf);
+    }
+    zfree(job);
+}
+
+/* Readable handler of the notification pipe. */
+static void aofWriteDoneHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    aofWriteJob *job;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(privdata);
+    REDIS_NOTUSED(mask);
+
+    if (read(fd,&job,sizeof(job)) != sizeof(job)) return;
+    aofWriteBatchDone(job);
+
+    /* Everything accumulated while the thread was busy is the next batch. */
+    // 组提交：线程忙碌期间累积的所有命令作为下一个批次写入
+    flushAppendOnlyFile(0);
+}
+
+/* Block until the batch being written by the thread is done. */
+static void aofWaitWriteThread(void) {
+    aofWriteJob *job;
+    long long latency;
+
+    latencyStartMonitor(latency);
+    bioWaitPendingJobsLE(REDIS_BIO_AOF_WRITE,0);
+    latencyEndMonitor(latency);
+    latencyAddSampleIfNeeded("aof-write-thread-wait",latency);
+    /* The thread notified the main thread before completing the job. */
+    if (read(server.aof_write_done_pipe[0],&job,sizeof(job)) == sizeof(job))
+        aofWriteBatchDone(job);
+}
+
+/* Hand server.aof_buf to the thread as a new batch. */
+static void aofStartWriteBatch(void) {
+    aofWriteJob *job = zmalloc(sizeof(*job));
+
+    job->fd = server.aof_fd;
+    job->buf = server.aof_buf;
+    job->seq = server.aof_batch_seq++;
+    job->nwritten = 0;
+    job->write_errno = 0;
+
+    /* Don't fsync if no-appendfsync-on-rewrite is set to yes and there are
+     * children doing I/O in the background. */
+    job->fsync = 0;
+    if (!(server.aof_no_fsync_on_rewrite &&
+        (server.aof_child_pid != -1 || server.rdb_child_pid != -1)))
+    {
+        if (server.aof_fsync == AOF_FSYNC_ALWAYS ||
+            (server.aof_fsync == AOF_FSYNC_EVERYSEC &&
+             server.unixtime > server.aof_last_fsync))
+        {
+            job->fsync = 1;
+            server.aof_last_fsync = server.unixtime;
+        }
+    }
+
+    // 切换到另一个缓存，继续累积新的写命令
+    server.aof_buf = server.aof_buf_spare ? server.aof_buf_spare : sdsempty();
+    server.aof_buf_spare = NULL;
+    server.aof_write_in_progress = 1;
+    bioCreateBackgroundJob(REDIS_BIO_AOF_WRITE,job,NULL,NULL);
+}
+
+/* Hold the replies of the client that just performed a write until the AOF
+ * batch containing it is on disk. This only happens with threaded writes
+ * and "appendfsync always": otherwise the write is already performed by
+ * flushAppendOnlyFile() before the event loop sends the replies. */
+/*
+ * 在包含客户端写命令的 AOF 批次写入磁盘之前，暂缓发送客户端的回复。
+ */
+void aofHoldClientReply(redisClient *c) {
+    if (!server.aof_write_thread ||
+        server.aof_fsync != AOF_FSYNC_ALWAYS ||
+        server.aof_state != REDIS_AOF_ON) return;
+    if (c->fd <= 0 || c->flags & (REDIS_MASTER|REDIS_SLAVE|REDIS_LUA_CLIENT))
+        return;
+
+    if (!(c->flags & REDIS_AOF_WAIT)) {
+        c->flags |= REDIS_AOF_WAIT;
+        listAddNodeTail(server.clients_waiting_aof,c);
+        c->aof_wait_node = listLast(server.clients_waiting_aof);
+        aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+    }
+    c->aof_wait_seq = server.aof_batch_seq;
+}
+
+/* Remove a client from the waiting list, in O(1) thanks to the list node
+ * stored by aofHoldClientReply(). */
+// 将客户端从等待 AOF 写入的客户端链表中删除
+void aofUnlinkWaitingClient(redisClient *c) {
+    redisAssert(c->flags & REDIS_AOF_WAIT);
+    listDelNode(server.clients_waiting_aof,c->aof_wait_node);
+    c->aof_wait_node = NULL;
+    c->flags &= ~REDIS_AOF_WAIT;
+}
+
+/* Initialize the state used by threaded AOF writes. */
+void aofInitWriteThread(void) {
+    server.aof_write_in_progress = 0;
+    server.aof_batch_seq = 0;
+    server.aof_buf_spare = NULL;
+    server.clients_waiting_aof = listCreate();
+    if (pipe(server.aof_write_done_pipe) == -1 ||
+        anetNonBlock(NULL,server.aof_write_done_pipe[0]) != ANET_OK ||
+        aeCreateFileEvent(server.el,server.aof_write_done_pipe[0],
+            AE_READABLE,aofWriteDoneHandler,NULL) == AE_ERR)
+    {
+        redisLog(REDIS_WARNING,
+            "Can't create the AOF write notification pipe: %s",
+            strerror(errno));
+        exit(1);
+    }
+}
+
 /* Called when the user switches from "appendonly yes" to "appendonly no"
  * at runtime using the CONFIG command. */
 /*
@@ -234,6 +531,7 @@ void stopAppendOnly(void) {
         /* reset the buffer accumulating changes while the child saves */
         // 释放缓存
         aofRewriteBufferReset();
+        aofClosePipes();
         // 移除临时文件
         aofRemoveTempFile(server.aof_child_pid);
         // 关闭服务器 flag
@@ -305,9 +603,30 @@ int startAppendOnly(void) {
 void flushAppendOnlyFile(int force) {
     ssize_t nwritten;
     int sync_in_progress = 0;
+    long long latency;
+
+    /* With threaded writes new data is written when the batch in flight is
+     * done. A forced flush waits for it and writes the rest synchronously. */
+    // 线程正在写入批次：除非强制冲洗，否则等它完成之后再写入
+    if (server.aof_write_in_progress) {
+        if (!force) return;
+        aofWaitWriteThread();
+    }
 
     // 没有缓存等待写入，直接返回
-    if (sdslen(server.aof_buf) == 0) return;
+    if (sdslen(server.aof_buf) == 0) {
+        /* The buffer may be discarded, for instance when an AOF rewrite
+         * terminates: nothing is left to wait for. */
+        if (listLength(server.clients_waiting_aof))
+            aofReleaseWaitingClients(server.aof_batch_seq);
+        return;
+    }
+
+    // 交给后台线程写入
+    if (server.aof_write_thread && !force) {
+        aofStartWriteBatch();
+        return;
+    }
 
     // 返回后台正在等待执行的 fsync 数量
     if (server.aof_fsync == AOF_FSYNC_EVERYSEC)
@@ -356,34 +675,22 @@ void flushAppendOnlyFile(int force) {
      * there is much to do about the whole server stopping for power problems
      * or alike */
     // 将 AOF 缓存写入到文件，如果一切幸运的话，写入会原子性地完成
+    latencyStartMonitor(latency);
     nwritten = write(server.aof_fd,server.aof_buf,sdslen(server.aof_buf));
+    latencyEndMonitor(latency);
+    latencyAddSampleIfNeeded("aof-write",latency);
     // 写入出错，停止 Redis 并报告错误
-    if (nwritten != (signed)sdslen(server.aof_buf)) {
-        /* Ooops, we are in troubles. The best thing to do for now is
-         * aborting instead of giving the illusion that everything is
-         * working as expected. */
-        if (nwritten == -1) {
-            redisLog(REDIS_WARNING,"Exiting on error writing to the append-only file: %s",strerror(errno));
-        } else {
-            redisLog(REDIS_WARNING,"Exiting on short write while writing to "
-                                   "the append-only file: %s (nwritten=%ld, "
-                                   "expected=%ld)",
-                                   strerror(errno),
-                                   (long)nwritten,
-                                   (long)sdslen(server.aof_buf));
-
-            if (ftruncate(server.aof_fd, server.aof_current_size) == -1) {
-                redisLog(REDIS_WARNING, "Could not remove short write "
-                         "from the append-only file.  Redis may refuse "
-                         "to load the AOF the next time it starts.  "
-                         "ftruncate: %s", strerror(errno));
-            }
-        }
-        exit(1);
-    }
+    if (nwritten != (signed)sdslen(server.aof_buf))
+        aofExitOnWriteError(server.aof_fd,nwritten,sdslen(server.aof_buf));
     // 更新 AOF 文件的当前大小
     server.aof_current_size += nwritten;
 
+    /* Replies held while threaded writes were enabled can be sent: the
+     * fsync below is performed before returning to the event loop. */
+    if (listLength(server.clients_waiting_aof))
+        aofReleaseWaitingClients(server.aof_batch_seq);
+    server.aof_batch_seq++;
+
     /* Re-use AOF buffer when it is small enough. The maximum comes from the
      * arena size of 4k minus some overhead (but is otherwise arbitrary). */
     // 如果 aof 缓存不是太大，那么重用它，否则，清空 aof 缓存
@@ -410,7 +717,10 @@ void flushAppendOnlyFile(int force) {
     if (server.aof_fsync == AOF_FSYNC_ALWAYS) {
         /* aof_fsync is defined as fdatasync() for Linux in order to avoid
          * flushing metadata. */
+        latencyStartMonitor(latency);
         aof_fsync(server.aof_fd); /* Let's try to get this data on the disk */
+        latencyEndMonitor(latency);
+        latencyAddSampleIfNeeded("aof-fsync-always",latency);
         // 更新对 AOF 文件最后一次进行 fsync 的时间
         server.aof_last_fsync = server.unixtime;
 
@@ -603,6 +913,7 @@ struct redisClient *createFakeClient(void) {
     c->querybuf_peak = 0;
     c->argc = 0;
     c->argv = NULL;
+    c->argv_len = 0;
     c->bufpos = 0;
     c->flags = 0;
     /* We set the fake client as a slave waiting for the synchronization
@@ -665,6 +976,28 @@ int loadAppendOnlyFile(char *filename) {
     // 定义于 rdb.c ，更新服务器的载入状态
     startLoading(fp);
 
+    /* Check if this AOF file has an RDB preamble. In that case we need to
+     * load the RDB payload first and then continue loading the AOF tail. */
+    // 文件以 "REDIS" 开头，说明它带有 RDB 格式的前缀
+    char sig[5]; /* "REDIS" */
+    if (fread(sig,1,5,fp) != 5 || memcmp(sig,"REDIS",5) != 0) {
+        /* No RDB preamble, seek back at 0 offset. */
+        if (fseek(fp,0,SEEK_SET) == -1) goto readerr;
+    } else {
+        /* RDB preamble. Pass loading the RDB functions. */
+        rio rdb;
+
+        redisLog(REDIS_NOTICE,"Reading RDB preamble from AOF file...");
+        if (fseek(fp,0,SEEK_SET) == -1) goto readerr;
+        rioInitWithFile(&rdb,fp);
+        if (rdbLoadRio(&rdb) != REDIS_OK) {
+            redisLog(REDIS_WARNING,"Error reading the RDB preamble of the AOF file, AOF loading aborted");
+            goto readerr;
+        } else {
+            redisLog(REDIS_NOTICE,"Reading the remaining AOF tail...");
+        }
+    }
+
     while(1) {
         int argc, j;
         unsigned long len;
@@ -769,7 +1102,7 @@ int rioWriteBulkObject(rio *r, robj *obj) {
      * in a child process when this function is called). */
     if (obj->encoding == REDIS_ENCODING_INT) {
         return rioWriteBulkLongLong(r,(long)obj->ptr);
-    } else if (obj->encoding == REDIS_ENCODING_RAW) {
+    } else if (sdsEncodedObject(obj)) {
         return rioWriteBulkString(r,obj->ptr,sdslen(obj->ptr));
     } else {
         redisPanic("Unknown string encoding");
@@ -786,52 +1119,40 @@ int rioWriteBulkObject(rio *r, robj *obj) {
 int rewriteListObject(rio *r, robj *key, robj *o) {
     long long count = 0, items = listTypeLength(o);
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        unsigned char *zl = o->ptr;
-        unsigned char *p = ziplistIndex(zl,0);
-        unsigned char *vstr;
-        unsigned int vlen;
-        long long vlong;
+    if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklist *list = o->ptr;
+        quicklistIter *li = quicklistGetIterator(list, AL_START_HEAD);
+        quicklistEntry entry;
 
-        while(ziplistGet(p,&vstr,&vlen,&vlong)) {
+        while (quicklistNext(li,&entry)) {
             if (count == 0) {
                 int cmd_items = (items > REDIS_AOF_REWRITE_ITEMS_PER_CMD) ?
                     REDIS_AOF_REWRITE_ITEMS_PER_CMD : items;
 
-                if (rioWriteBulkCount(r,'*',2+cmd_items) == 0) return 0;
-                if (rioWriteBulkString(r,"RPUSH",5) == 0) return 0;
-                if (rioWriteBulkObject(r,key) == 0) return 0;
-            }
-            if (vstr) {
-                if (rioWriteBulkString(r,(char*)vstr,vlen) == 0) return 0;
-            } else {
-                if (rioWriteBulkLongLong(r,vlong) == 0) return 0;
+                if (rioWriteBulkCount(r,'*',2+cmd_items) == 0 ||
+                    rioWriteBulkString(r,"RPUSH",5) == 0 ||
+                    rioWriteBulkObject(r,key) == 0)
+                {
+                    quicklistReleaseIterator(li);
+                    return 0;
+                }
             }
-            p = ziplistNext(zl,p);
-            if (++count == REDIS_AOF_REWRITE_ITEMS_PER_CMD) count = 0;
-            items--;
-        }
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        list *list = o->ptr;
-        listNode *ln;
-        listIter li;
-
-        listRewind(list,&li);
-        while((ln = listNext(&li))) {
-            robj *eleobj = listNodeValue(ln);
-
-            if (count == 0) {
-                int cmd_items = (items > REDIS_AOF_REWRITE_ITEMS_PER_CMD) ?
-                    REDIS_AOF_REWRITE_ITEMS_PER_CMD : items;
 
-                if (rioWriteBulkCount(r,'*',2+cmd_items) == 0) return 0;
-                if (rioWriteBulkString(r,"RPUSH",5) == 0) return 0;
-                if (rioWriteBulkObject(r,key) == 0) return 0;
+            if (entry.value) {
+                if (rioWriteBulkString(r,(char*)entry.value,entry.sz) == 0) {
+                    quicklistReleaseIterator(li);
+                    return 0;
+                }
+            } else {
+                if (rioWriteBulkLongLong(r,entry.longval) == 0) {
+                    quicklistReleaseIterator(li);
+                    return 0;
+                }
             }
-            if (rioWriteBulkObject(r,eleobj) == 0) return 0;
             if (++count == REDIS_AOF_REWRITE_ITEMS_PER_CMD) count = 0;
             items--;
         }
+        quicklistReleaseIterator(li);
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -1039,43 +1360,98 @@ int rewriteHashObject(rio *r, robj *key, robj *o) {
     return 1;
 }
 
-/* Write a sequence of commands able to fully rebuild the dataset into
- * "filename". Used both by REWRITEAOF and BGREWRITEAOF.
+/* This function is called by the child rewriting the AOF file to read
+ * the difference accumulated from the parent into a buffer, that is
+ * concatenated at the end of the rewrite.
  *
- * 写一串足以还原数据集的命令到给定文件里。
- * 被 REWRITEAOF 和 BGREWRITEAOF 所使用。
+ * 在重写 AOF 的子进程中调用，读取父进程发来的差异数据，
+ * 并将它们保存到 server.aof_child_diff ，重写结束时追加到文件末尾。
  *
- * In order to minimize the number of commands needed in the rewritten
- * log Redis uses variadic commands when possible, such as RPUSH, SADD
- * and ZADD. However at max REDIS_AOF_REWRITE_ITEMS_PER_CMD items per time
- * are inserted using a single command. 
+ * 返回本次读取的字节数。
+ */
+ssize_t aofReadDiffFromParent(void) {
+    char buf[65536]; /* Default pipe buffer size on most Linux systems. */
+    ssize_t nread, total = 0;
+
+    if (server.aof_pipe_read_data_from_parent == -1) return 0;
+
+    while ((nread =
+            read(server.aof_pipe_read_data_from_parent,buf,sizeof(buf))) > 0) {
+        server.aof_child_diff = sdscatlen(server.aof_child_diff,buf,nread);
+        total += nread;
+    }
+    return total;
+}
+
+/* Called by the rewrite child once the dataset is written: keep reading
+ * the diff while the parent sends it, then ask the parent to stop and
+ * append everything received to 'aof'.
  *
- * 为了减少重建数据集所需命令的数量，
- * 在可能时，Redis 会使用可变参数命令，比如 RPUSH 、 SADD 和 ZADD 。
- * 不过这些命令每次最多添加的元素不会超过 REDIS_AOF_REWRITE_ITEMS_PER_CMD 。
+ * 子进程写完数据集之后调用：继续读取父进程发来的差异数据，
+ * 然后通知父进程停止发送，并将所有差异数据写入到 aof 。
+ */
+static int rewriteAppendOnlyFileDiff(rio *aof) {
+    int nodata = 0;
+    long long start = mstime();
+    char byte;
+
+    /* Read again a few times to get more data from the parent.
+     * We can't read forever (the server may receive data from clients
+     * faster than it is able to send data to the child), so we try to read
+     * some more data in a loop as soon as there is a good chance more data
+     * will come. If it looks like we are wasting time, we abort (this
+     * happens after 20 ms without new data). */
+    // 最多等待 1 秒，连续 20 毫秒没有新数据就停止等待
+    while(mstime()-start < 1000 && nodata < 20) {
+        if (aeWait(server.aof_pipe_read_data_from_parent, AE_READABLE, 1) <= 0)
+        {
+            nodata++;
+            continue;
+        }
+        nodata = 0; /* Start counting from zero, we stop on N *contiguous*
+                       timeouts. */
+        aofReadDiffFromParent();
+    }
+
+    /* Ask the master to stop sending diffs. */
+    // 通知父进程停止发送差异数据，并等待父进程确认
+    if (write(server.aof_pipe_write_ack_to_parent,"!",1) != 1) return REDIS_ERR;
+    if (anetNonBlock(NULL,server.aof_pipe_read_ack_from_parent) != ANET_OK)
+        return REDIS_ERR;
+    /* We read the ACK from the server using a 5 seconds timeout. Normally
+     * it should reply ASAP, but just in case we lose its reply, we are sure
+     * the child will eventually get terminated. */
+    if (syncRead(server.aof_pipe_read_ack_from_parent,&byte,1,5000) != 1 ||
+        byte != '!') return REDIS_ERR;
+    redisLog(REDIS_NOTICE,"Parent agreed to stop sending diffs. Finalizing AOF...");
+
+    /* Read the final diff if any. */
+    aofReadDiffFromParent();
+
+    /* Write the received diff to the file. */
+    redisLog(REDIS_NOTICE,
+        "Concatenating %.2f MB of AOF diff received from parent.",
+        (double) sdslen(server.aof_child_diff) / (1024*1024));
+    if (sdslen(server.aof_child_diff) &&
+        rioWrite(aof,server.aof_child_diff,sdslen(server.aof_child_diff)) == 0)
+        return REDIS_ERR;
+    return REDIS_OK;
+}
+
+/* Write a sequence of commands able to fully rebuild the dataset into the
+ * rio stream 'aof'. Returns REDIS_ERR on write error, REDIS_OK otherwise.
  *
- * 重写失败返回 REDIS_ERR ，成功返回 REDIS_OK 。
+ * 将足以还原数据集的命令写入到 aof 中。
+ *
+ * 写入出错返回 REDIS_ERR ，成功返回 REDIS_OK 。
  */
-int rewriteAppendOnlyFile(char *filename) {
+int rewriteAppendOnlyFileRio(rio *aof) {
     dictIterator *di = NULL;
     dictEntry *de;
-    rio aof;
-    FILE *fp;
-    char tmpfile[256];
     int j;
     long long now = mstime();
+    long long processed = 0;
 
-    /* Note that we have to use a different temp name here compared to the
-     * one used by rewriteAppendOnlyFileBackground() function. */
-    snprintf(tmpfile,256,"temp-rewriteaof-%d.aof", (int) getpid());
-    fp = fopen(tmpfile,"w");
-    if (!fp) {
-        redisLog(REDIS_WARNING, "Opening the temp file for AOF rewrite in rewriteAppendOnlyFile(): %s", strerror(errno));
-        return REDIS_ERR;
-    }
-
-    // 初始化文件流
-    rioInitWithFile(&aof,fp);
     // 遍历所有数据库
     for (j = 0; j < server.dbnum; j++) {
         char selectcmd[] = "*2\r\n$6\r\nSELECT\r\n";
@@ -1083,15 +1459,12 @@ int rewriteAppendOnlyFile(char *filename) {
         dict *d = db->dict;
         if (dictSize(d) == 0) continue;
         di = dictGetSafeIterator(d);
-        if (!di) {
-            fclose(fp);
-            return REDIS_ERR;
-        }
+        if (!di) return REDIS_ERR;
 
         /* SELECT the new DB */
         // 切换到合适的数据库上
-        if (rioWrite(&aof,selectcmd,sizeof(selectcmd)-1) == 0) goto werr;
-        if (rioWriteBulkLongLong(&aof,j) == 0) goto werr;
+        if (rioWrite(aof,selectcmd,sizeof(selectcmd)-1) == 0) goto werr;
+        if (rioWriteBulkLongLong(aof,j) == 0) goto werr;
 
         /* Iterate this DB writing every entry */
         // 遍历数据库的所有 key-value 对
@@ -1111,18 +1484,18 @@ int rewriteAppendOnlyFile(char *filename) {
             if (o->type == REDIS_STRING) {
                 /* Emit a SET command */
                 char cmd[]="*3\r\n$3\r\nSET\r\n";
-                if (rioWrite(&aof,cmd,sizeof(cmd)-1) == 0) goto werr;
+                if (rioWrite(aof,cmd,sizeof(cmd)-1) == 0) goto werr;
                 /* Key and value */
-                if (rioWriteBulkObject(&aof,&key) == 0) goto werr;
-                if (rioWriteBulkObject(&aof,o) == 0) goto werr;
+                if (rioWriteBulkObject(aof,&key) == 0) goto werr;
+                if (rioWriteBulkObject(aof,o) == 0) goto werr;
             } else if (o->type == REDIS_LIST) {
-                if (rewriteListObject(&aof,&key,o) == 0) goto werr;
+                if (rewriteListObject(aof,&key,o) == 0) goto werr;
             } else if (o->type == REDIS_SET) {
-                if (rewriteSetObject(&aof,&key,o) == 0) goto werr;
+                if (rewriteSetObject(aof,&key,o) == 0) goto werr;
             } else if (o->type == REDIS_ZSET) {
-                if (rewriteSortedSetObject(&aof,&key,o) == 0) goto werr;
+                if (rewriteSortedSetObject(aof,&key,o) == 0) goto werr;
             } else if (o->type == REDIS_HASH) {
-                if (rewriteHashObject(&aof,&key,o) == 0) goto werr;
+                if (rewriteHashObject(aof,&key,o) == 0) goto werr;
             } else {
                 redisPanic("Unknown object type");
             }
@@ -1133,21 +1506,90 @@ int rewriteAppendOnlyFile(char *filename) {
                 /* If this key is already expired skip it */
                 // 不重写已过期的 key
                 if (expiretime < now) continue;
-                if (rioWrite(&aof,cmd,sizeof(cmd)-1) == 0) goto werr;
-                if (rioWriteBulkObject(&aof,&key) == 0) goto werr;
-                if (rioWriteBulkLongLong(&aof,expiretime) == 0) goto werr;
+                if (rioWrite(aof,cmd,sizeof(cmd)-1) == 0) goto werr;
+                if (rioWriteBulkObject(aof,&key) == 0) goto werr;
+                if (rioWriteBulkLongLong(aof,expiretime) == 0) goto werr;
             }
+            /* Read some diff from the parent from time to time. */
+            // 每处理一批键，就读取一次父进程发来的差异数据
+            if (++processed % 1024 == 0) aofReadDiffFromParent();
         }
         dictReleaseIterator(di);
     }
+    return REDIS_OK;
+
+werr:
+    if (di) dictReleaseIterator(di);
+    return REDIS_ERR;
+}
+
+/* Write a sequence of commands able to fully rebuild the dataset into
+ * "filename". Used both by REWRITEAOF and BGREWRITEAOF.
+ *
+ * 写一串足以还原数据集的命令到给定文件里。
+ * 被 REWRITEAOF 和 BGREWRITEAOF 所使用。
+ *
+ * In order to minimize the number of commands needed in the rewritten
+ * log Redis uses variadic commands when possible, such as RPUSH, SADD
+ * and ZADD. However at max REDIS_AOF_REWRITE_ITEMS_PER_CMD items per time
+ * are inserted using a single command. 
+ *
+ * When aof-use-rdb-preamble is enabled the dataset is written in the RDB
+ * format instead, and loadAppendOnlyFile() loads it with the RDB loader.
+ *
+ * 为了减少重建数据集所需命令的数量，
+ * 在可能时，Redis 会使用可变参数命令，比如 RPUSH 、 SADD 和 ZADD 。
+ * 不过这些命令每次最多添加的元素不会超过 REDIS_AOF_REWRITE_ITEMS_PER_CMD 。
+ *
+ * 重写失败返回 REDIS_ERR ，成功返回 REDIS_OK 。
+ */
+int rewriteAppendOnlyFile(char *filename) {
+    rio aof;
+    FILE *fp;
+    char tmpfile[256];
+
+    /* Note that we have to use a different temp name here compared to the
+     * one used by rewriteAppendOnlyFileBackground() function. */
+    snprintf(tmpfile,256,"temp-rewriteaof-%d.aof", (int) getpid());
+    fp = fopen(tmpfile,"w");
+    if (!fp) {
+        redisLog(REDIS_WARNING, "Opening the temp file for AOF rewrite in rewriteAppendOnlyFile(): %s", strerror(errno));
+        return REDIS_ERR;
+    }
+
+    // 初始化文件流
+    rioInitWithFile(&aof,fp);
+    if (server.aof_use_rdb_preamble) {
+        // 以 RDB 格式写入数据集，载入时比逐条执行命令快得多
+        if (rdbSaveRio(&aof,REDIS_RDB_SAVE_AOF_PREAMBLE) == REDIS_ERR)
+            goto werr;
+    } else {
+        if (rewriteAppendOnlyFileRio(&aof) == REDIS_ERR) goto werr;
+    }
+
+    /* Do an initial slow fsync here while the parent is still sending
+     * data, in order to make the next final fsync faster. */
+    if (fflush(fp) == EOF) goto werr;
+    if (aof_fsync(fileno(fp)) == -1) goto werr;
+
+    /* When running in a rewrite child, collect what the parent is still
+     * sending and append it, so the parent has little left to write once
+     * we exit. */
+    // 在子进程中，读取并写入父进程仍在发送的差异数据
+    if (server.aof_pipe_read_data_from_parent != -1) {
+        if (rewriteAppendOnlyFileDiff(&aof) == REDIS_ERR) goto werr;
+    }
 
     /* Make sure data will not remain on the OS's output buffers */
-    // 重新文件流
-    fflush(fp);
+    // 冲洗文件流
+    if (fflush(fp) == EOF) goto werr;
     // sync
-    aof_fsync(fileno(fp));
+    if (aof_fsync(fileno(fp)) == -1) goto werr;
     // 关闭
-    fclose(fp);
+    if (fclose(fp) == EOF) {
+        fp = NULL;
+        goto werr;
+    }
 
     /* Use RENAME to make sure the DB file is changed atomically only
      * if the generate DB file is ok. */
@@ -1161,13 +1603,108 @@ int rewriteAppendOnlyFile(char *filename) {
     return REDIS_OK;
 
 werr:
-    fclose(fp);
-    unlink(tmpfile);
     redisLog(REDIS_WARNING,"Write error writing append only file on disk: %s", strerror(errno));
-    if (di) dictReleaseIterator(di);
+    if (fp) fclose(fp);
+    unlink(tmpfile);
     return REDIS_ERR;
 }
 
+/* ----------------------------------------------------------------------------
+ * AOF rewrite pipes for IPC
+ *
+ * 父子进程之间用于传送 AOF 差异数据的管道
+ * -------------------------------------------------------------------------- */
+
+/* This event handler is called when the AOF rewriting child sends us a
+ * single '!' char to signal we should stop sending buffer diffs. The
+ * parent sends a '!' as well to acknowledge. */
+/*
+ * 子进程通过发送 '!' 要求父进程停止发送差异数据，
+ * 父进程同样回复一个 '!' 作为确认。
+ */
+void aofChildPipeReadable(aeEventLoop *el, int fd, void *privdata, int mask) {
+    char byte;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(privdata);
+    REDIS_NOTUSED(mask);
+
+    if (read(fd,&byte,1) == 1 && byte == '!') {
+        redisLog(REDIS_NOTICE,"AOF rewrite child asks to stop sending diffs.");
+        server.aof_stop_sending_diff = 1;
+        if (write(server.aof_pipe_write_ack_to_child,"!",1) != 1) {
+            /* If we can't send the ack, inform the user, but don't try again
+             * since in the other side the children will use a timeout if the
+             * kernel can't buffer our write, or, the children was
+             * terminated. */
+            redisLog(REDIS_WARNING,"Can't send ACK to AOF child: %s",
+                strerror(errno));
+        }
+    }
+    /* Remove the handler since this can be called only one time during a
+     * rewrite. */
+    aeDeleteFileEvent(server.el,server.aof_pipe_read_ack_from_child,AE_READABLE);
+}
+
+/* Create the pipes used for parent - child process IPC during rewrite.
+ * We have a data pipe used to send AOF incremental diffs to the child,
+ * and two other pipes used by the children to signal it finished with
+ * the rewrite so no more data should be written, and another for the
+ * parent to acknowledge it understood this new condition. */
+/*
+ * 创建重写期间父子进程通讯所需的三个管道：
+ * 一个数据管道，用于将 AOF 差异数据发送给子进程；
+ * 两个确认管道，用于子进程通知父进程停止发送，以及父进程的确认。
+ */
+int aofCreatePipes(void) {
+    int fds[6] = {-1, -1, -1, -1, -1, -1};
+    int j;
+
+    if (pipe(fds) == -1) goto error; /* parent -> children data. */
+    if (pipe(fds+2) == -1) goto error; /* children -> parent ack. */
+    if (pipe(fds+4) == -1) goto error; /* children -> parent ack. */
+    /* Parent -> children data is non blocking. */
+    if (anetNonBlock(NULL,fds[0]) != ANET_OK) goto error;
+    if (anetNonBlock(NULL,fds[1]) != ANET_OK) goto error;
+    if (aeCreateFileEvent(server.el, fds[2], AE_READABLE, aofChildPipeReadable, NULL) == AE_ERR) goto error;
+
+    server.aof_pipe_write_data_to_child = fds[1];
+    server.aof_pipe_read_data_from_parent = fds[0];
+    server.aof_pipe_write_ack_to_parent = fds[3];
+    server.aof_pipe_read_ack_from_child = fds[2];
+    server.aof_pipe_write_ack_to_child = fds[5];
+    server.aof_pipe_read_ack_from_parent = fds[4];
+    server.aof_stop_sending_diff = 0;
+    return REDIS_OK;
+
+error:
+    redisLog(REDIS_WARNING,"Error opening /setting AOF rewrite IPC pipes: %s",
+        strerror(errno));
+    for (j = 0; j < 6; j++) if(fds[j] != -1) close(fds[j]);
+    return REDIS_ERR;
+}
+
+/*
+ * 关闭重写期间使用的所有管道
+ */
+void aofClosePipes(void) {
+    if (server.aof_pipe_write_data_to_child == -1) return;
+
+    aeDeleteFileEvent(server.el,server.aof_pipe_read_ack_from_child,AE_READABLE);
+    aeDeleteFileEvent(server.el,server.aof_pipe_write_data_to_child,AE_WRITABLE);
+    close(server.aof_pipe_write_data_to_child);
+    close(server.aof_pipe_read_data_from_parent);
+    close(server.aof_pipe_write_ack_to_parent);
+    close(server.aof_pipe_read_ack_from_child);
+    close(server.aof_pipe_write_ack_to_child);
+    close(server.aof_pipe_read_ack_from_parent);
+    server.aof_pipe_write_data_to_child = -1;
+    server.aof_pipe_read_data_from_parent = -1;
+    server.aof_pipe_write_ack_to_parent = -1;
+    server.aof_pipe_read_ack_from_child = -1;
+    server.aof_pipe_write_ack_to_child = -1;
+    server.aof_pipe_read_ack_from_parent = -1;
+}
+
 /* This is how rewriting of the append only file in background works:
  * 
  * 以下是后台重写 AOF 文件的工作步骤：
@@ -1202,6 +1739,9 @@ int rewriteAppendOnlyFileBackground(void) {
     // 后台重写正在执行
     if (server.aof_child_pid != -1) return REDIS_ERR;
 
+    // 创建与子进程通讯的管道
+    if (aofCreatePipes() != REDIS_OK) return REDIS_ERR;
+
     // 开始时间
     start = ustime();
     if ((childpid = fork()) == 0) {
@@ -1211,6 +1751,7 @@ int rewriteAppendOnlyFileBackground(void) {
         // 关闭网络连接
         if (server.ipfd > 0) close(server.ipfd);
         if (server.sofd > 0) close(server.sofd);
+        server.aof_child_diff = sdsempty();
 
         // 创建临时文件
         snprintf(tmpfile,256,"temp-rewriteaof-bg-%d.aof", (int) getpid());
@@ -1231,12 +1772,14 @@ int rewriteAppendOnlyFileBackground(void) {
     } else {
         /* Parent */
         server.stat_fork_time = ustime()-start;
+        latencyAddSampleIfNeeded("fork",server.stat_fork_time/1000);
 
         // 如果创建子进程失败，直接返回
         if (childpid == -1) {
             redisLog(REDIS_WARNING,
                 "Can't rewrite append only file in background: fork: %s",
                 strerror(errno));
+            aofClosePipes();
             return REDIS_ERR;
         }
 
@@ -1311,6 +1854,8 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
         int newfd, oldfd;
         char tmpfile[256];
         long long now = ustime();
+        long long diff_start;
+        ssize_t diff_bytes;
 
         redisLog(REDIS_NOTICE,
             "Background AOF rewrite terminated with success");
@@ -1326,16 +1871,22 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
             goto cleanup;
         }
 
-        // 将重写 AOF 文件时新请求的缓存写入到临时文件
-        if (aofRewriteBufferWrite(newfd) == -1) {
+        // 将子进程没有接收到的剩余差异数据写入到临时文件，
+        // 这次写入会阻塞服务器，所以记录它的大小和耗时
+        diff_start = ustime();
+        if ((diff_bytes = aofRewriteBufferWrite(newfd)) == -1) {
             redisLog(REDIS_WARNING,
                 "Error trying to flush the parent diff to the rewritten AOF: %s", strerror(errno));
             close(newfd);
             goto cleanup;
         }
+        server.aof_rewrite_diff_bytes_last = diff_bytes;
+        server.aof_rewrite_diff_time_last = ustime()-diff_start;
 
         redisLog(REDIS_NOTICE,
-            "Parent diff successfully flushed to the rewritten AOF (%lu bytes)", aofRewriteBufferSize());
+            "Residual parent diff successfully flushed to the rewritten AOF (%.2f MB, %lld usec)",
+            (double) diff_bytes / (1024*1024),
+            server.aof_rewrite_diff_time_last);
 
         /* The only remaining thing to do is to rename the temporary file to
          * the configured file and switch the file descriptor used to do AOF
@@ -1395,7 +1946,10 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
              * to this new file, so we can close it. */
             close(newfd);
         } else {
-            /* AOF enabled, replace the old fd with the new one. */
+            /* AOF enabled, replace the old fd with the new one. The batch
+             * the AOF thread may be writing targets the old fd, that is
+             * going to be closed: wait for it. */
+            if (server.aof_write_in_progress) aofWaitWriteThread();
             oldfd = server.aof_fd;
             server.aof_fd = newfd;
 
@@ -1440,6 +1994,7 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
     }
 
 cleanup:
+    aofClosePipes();
     aofRewriteBufferReset();
     aofRemoveTempFile(server.aof_child_pid);
     server.aof_child_pid = -1;
@@ -72,6 +72,8 @@
 static pthread_t bio_threads[REDIS_BIO_NUM_OPS];
 static pthread_mutex_t bio_mutex[REDIS_BIO_NUM_OPS];
 static pthread_cond_t bio_condvar[REDIS_BIO_NUM_OPS];
+// 每完成一个任务就广播一次，用于等待任务完成
+static pthread_cond_t bio_step_cond[REDIS_BIO_NUM_OPS];
 // 存放工作的队列
 static list *bio_jobs[REDIS_BIO_NUM_OPS];
 /* The following array is used to hold the number of pending jobs for every
@@ -99,10 +101,6 @@ struct bio_job {
 
 void *bioProcessBackgroundJobs(void *arg);
 
-/* Make sure we have enough stack to perform all the things we do in the
- * main thread. */
-#define REDIS_THREAD_STACK_SIZE (1024*1024*4)
-
 /* Initialize the background system, spawning the thread. */
 // 初始化后台任务系统，生成线程
 void bioInit(void) {
@@ -116,6 +114,7 @@ void bioInit(void) {
     for (j = 0; j < REDIS_BIO_NUM_OPS; j++) {
         pthread_mutex_init(&bio_mutex[j],NULL);
         pthread_cond_init(&bio_condvar[j],NULL);
+        pthread_cond_init(&bio_step_cond[j],NULL);
         bio_jobs[j] = listCreate();
         bio_pending[j] = 0;
     }
@@ -201,6 +200,17 @@ void *bioProcessBackgroundJobs(void *arg) {
             close((long)job->arg1);
         } else if (type == REDIS_BIO_AOF_FSYNC) {
             aof_fsync((long)job->arg1);
+        } else if (type == REDIS_BIO_AOF_WRITE) {
+            aofWriteBatchFromBioThread(job->arg1);
+        } else if (type == REDIS_BIO_LAZY_FREE) {
+            /* What we free depends on the arguments that are set:
+             * arg1 -> an object to release.
+             * arg2 & arg3 -> the main and expires dicts of a flushed DB. */
+            // 释放单个对象，或者释放整个数据库的两个字典
+            if (job->arg1)
+                lazyfreeFreeObjectFromBioThread(job->arg1);
+            else if (job->arg2 && job->arg3)
+                lazyfreeFreeDatabaseFromBioThread(job->arg2,job->arg3);
         } else {
             redisPanic("Wrong job type in bioProcessBackgroundJobs().");
         }
@@ -212,6 +222,8 @@ void *bioProcessBackgroundJobs(void *arg) {
         // 将任务从队列中删除，并减少任务计数器
         listDelNode(bio_jobs[type],ln);
         bio_pending[type]--;
+        // 唤醒等待任务完成的线程
+        pthread_cond_broadcast(&bio_step_cond[type]);
     }
 }
 
@@ -227,6 +239,18 @@ unsigned long long bioPendingJobsOfType(int type) {
     return val;
 }
 
+/* Block until the number of pending jobs of the specified type is less
+ * than or equal to 'num'. */
+/*
+ * 阻塞，直到给定类型的待执行任务数量小于等于 num
+ */
+void bioWaitPendingJobsLE(int type, unsigned long long num) {
+    pthread_mutex_lock(&bio_mutex[type]);
+    while (bio_pending[type] > num)
+        pthread_cond_wait(&bio_step_cond[type],&bio_mutex[type]);
+    pthread_mutex_unlock(&bio_mutex[type]);
+}
+
 /* Kill the running bio threads in an unclean way. This function should be
  * used only when it's critical to stop the threads for some reason.
  * Currently Redis does this only on crash (for instance on SIGSEGV) in order
@@ -0,0 +1,558 @@
+/* Bit array kernels used by BITCOUNT, BITOP and BITPOS.
+ *
+ * Every kernel has a generic C implementation working a machine word at a
+ * time. On x86 CPUs the faster kernels supported by the running CPU are
+ * selected the first time a kernel is called:
+ *
+ * - POPCNT (SSE4.2 generation): BITCOUNT uses the popcnt instruction on
+ *   64 bit words.
+ * - AVX2: BITCOUNT counts 32 bytes at a time using vpshufb nibble lookups
+ *   (Mula's algorithm), BITOP and BITPOS work on 32 byte vectors.
+ *
+ * 位数组内核：每个内核都有一个通用的 C 实现，
+ * 在 x86 CPU 上，第一次调用时根据 CPU 支持的指令选择 POPCNT 或者 AVX2 实现。
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "bitkernel.h"
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+/* -----------------------------------------------------------------------------
+ * Generic kernels.
+ * -------------------------------------------------------------------------- */
+
+/* Count number of bits set in the binary array pointed by 's' and long
+ * 'count' bytes. The implementation of this function is required to
+ * work with a input string length up to 512 MB. */
+static long popcountGeneric(const void *s, long count) {
+    long bits = 0;
+    unsigned char *p;
+    const uint32_t *p4 = s;
+    static const unsigned char bitsinbyte[256] = {0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,4,5,5,6,5,6,6,7,5,6,6,7,6,7,7,8};
+
+    /* Count bits 16 bytes at a time */
+    while(count>=16) {
+        uint32_t aux1, aux2, aux3, aux4;
+
+        aux1 = *p4++;
+        aux2 = *p4++;
+        aux3 = *p4++;
+        aux4 = *p4++;
+        count -= 16;
+
+        aux1 = aux1 - ((aux1 >> 1) & 0x55555555);
+        aux1 = (aux1 & 0x33333333) + ((aux1 >> 2) & 0x33333333);
+        aux2 = aux2 - ((aux2 >> 1) & 0x55555555);
+        aux2 = (aux2 & 0x33333333) + ((aux2 >> 2) & 0x33333333);
+        aux3 = aux3 - ((aux3 >> 1) & 0x55555555);
+        aux3 = (aux3 & 0x33333333) + ((aux3 >> 2) & 0x33333333);
+        aux4 = aux4 - ((aux4 >> 1) & 0x55555555);
+        aux4 = (aux4 & 0x33333333) + ((aux4 >> 2) & 0x33333333);
+        bits += ((((aux1 + (aux1 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) +
+                ((((aux2 + (aux2 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) +
+                ((((aux3 + (aux3 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) +
+                ((((aux4 + (aux4 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+    }
+    /* Count the remaining bytes */
+    p = (unsigned char*)p4;
+    while(count--) bits += bitsinbyte[*p++];
+    return bits;
+}
+
+/* Compute the bit operation 'op' of the first 'len' bytes of the 'numkeys'
+ * strings in 'src', storing the result in 'dst'. BITOP_NOT only uses
+ * src[0]. */
+static void bitopGeneric(int op, unsigned char *dst, unsigned char **src,
+                         long numkeys, long len)
+{
+    unsigned long *lres = (unsigned long*) dst;
+    long j = 0, i;
+
+    /* Note: sds pointer is always aligned to 8 byte boundary. */
+    memcpy(dst,src[0],len);
+
+    /* Different branches per different operations for speed (sorry). */
+    if (op == BITOP_AND) {
+        while(len-j >= (long)sizeof(unsigned long)*4) {
+            for (i = 1; i < numkeys; i++) {
+                unsigned long *lp = (unsigned long*) (src[i]+j);
+                lres[0] &= lp[0];
+                lres[1] &= lp[1];
+                lres[2] &= lp[2];
+                lres[3] &= lp[3];
+            }
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+        }
+    } else if (op == BITOP_OR) {
+        while(len-j >= (long)sizeof(unsigned long)*4) {
+            for (i = 1; i < numkeys; i++) {
+                unsigned long *lp = (unsigned long*) (src[i]+j);
+                lres[0] |= lp[0];
+                lres[1] |= lp[1];
+                lres[2] |= lp[2];
+                lres[3] |= lp[3];
+            }
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+        }
+    } else if (op == BITOP_XOR) {
+        while(len-j >= (long)sizeof(unsigned long)*4) {
+            for (i = 1; i < numkeys; i++) {
+                unsigned long *lp = (unsigned long*) (src[i]+j);
+                lres[0] ^= lp[0];
+                lres[1] ^= lp[1];
+                lres[2] ^= lp[2];
+                lres[3] ^= lp[3];
+            }
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+        }
+    } else if (op == BITOP_NOT) {
+        while(len-j >= (long)sizeof(unsigned long)*4) {
+            lres[0] = ~lres[0];
+            lres[1] = ~lres[1];
+            lres[2] = ~lres[2];
+            lres[3] = ~lres[3];
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+        }
+    }
+
+    /* j is set to the next byte to process by the previous loop. */
+    for (; j < len; j++) {
+        unsigned char output = src[0][j];
+
+        if (op == BITOP_NOT) output = ~output;
+        for (i = 1; i < numkeys; i++) {
+            switch(op) {
+            case BITOP_AND: output &= src[i][j]; break;
+            case BITOP_OR:  output |= src[i][j]; break;
+            case BITOP_XOR: output ^= src[i][j]; break;
+            }
+        }
+        dst[j] = output;
+    }
+}
+
+/* Return the index of the first byte of 's' (long 'count' bytes) that is
+ * not equal to 'skip', or 'count' if all the bytes are equal to 'skip'. */
+static long skipBytesGeneric(const void *s, long count, unsigned char skip) {
+    const unsigned char *p = s;
+    unsigned long skipword;
+    long j = 0;
+
+    memset(&skipword,skip,sizeof(skipword));
+
+    /* Process bytes until the pointer is word aligned, then a word at a
+     * time, and the remaining bytes at the end. */
+    while (j < count && ((uintptr_t)(p+j) & (sizeof(unsigned long)-1))) {
+        if (p[j] != skip) return j;
+        j++;
+    }
+    while (count-j >= (long)sizeof(unsigned long) &&
+           *(const unsigned long*)(p+j) == skipword)
+        j += sizeof(unsigned long);
+    while (j < count && p[j] == skip) j++;
+    return j;
+}
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+/* -----------------------------------------------------------------------------
+ * x86 kernels. The functions are compiled for the instruction set they need
+ * via the target attribute, and only called if the CPU supports it.
+ * -------------------------------------------------------------------------- */
+
+/* BITCOUNT using the popcnt instruction on 64 bit words. Four counters
+ * avoid serializing the popcnt instructions. */
+__attribute__((target("popcnt")))
+static long popcountPopcnt(const void *s, long count) {
+    const unsigned char *p = s;
+    uint64_t w[4], c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+
+    while (count >= 32) {
+        memcpy(w,p,32);
+        c0 += __builtin_popcountll(w[0]);
+        c1 += __builtin_popcountll(w[1]);
+        c2 += __builtin_popcountll(w[2]);
+        c3 += __builtin_popcountll(w[3]);
+        p += 32;
+        count -= 32;
+    }
+    while (count >= 8) {
+        memcpy(w,p,8);
+        c0 += __builtin_popcountll(w[0]);
+        p += 8;
+        count -= 8;
+    }
+    while (count--) c1 += __builtin_popcount(*p++);
+    return c0+c1+c2+c3;
+}
+
+/* BITCOUNT using AVX2: the two nibbles of every byte are counted with a
+ * vpshufb table lookup, and the per byte counters are summed into 64 bit
+ * counters with vpsadbw every 31 iterations, before they can overflow
+ * (31*8 < 256). */
+__attribute__((target("avx2,popcnt")))
+static long popcountAvx2(const void *s, long count) {
+    const unsigned char *p = s;
+    const __m256i lookup = _mm256_setr_epi8(
+        0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+        0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i lowmask = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    uint64_t sums[4];
+    long bits;
+
+    while (count >= 32) {
+        __m256i acc = _mm256_setzero_si256();
+        int iter = 0;
+
+        while (count >= 32 && iter < 31) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)p);
+            __m256i lo = _mm256_and_si256(v,lowmask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v,4),lowmask);
+
+            acc = _mm256_add_epi8(acc,_mm256_shuffle_epi8(lookup,lo));
+            acc = _mm256_add_epi8(acc,_mm256_shuffle_epi8(lookup,hi));
+            p += 32;
+            count -= 32;
+            iter++;
+        }
+        total = _mm256_add_epi64(total,
+                    _mm256_sad_epu8(acc,_mm256_setzero_si256()));
+    }
+    _mm256_storeu_si256((__m256i*)sums,total);
+    bits = sums[0]+sums[1]+sums[2]+sums[3];
+    return bits+popcountPopcnt(p,count);
+}
+
+/* BITOP using AVX2: the strings are processed in blocks of 128 bytes, so
+ * that the result of the block stays in registers while all the keys are
+ * combined into it. */
+__attribute__((target("avx2")))
+static void bitopAvx2(int op, unsigned char *dst, unsigned char **src,
+                      long numkeys, long len)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+    long j = 0, i;
+
+#define BITOP_LOAD(s,k) _mm256_loadu_si256((const __m256i*)((s)+j+(k)*32))
+#define BITOP_AVX2_LOOP(vecop) do { \
+    while (len-j >= 128) { \
+        __m256i a = BITOP_LOAD(src[0],0), b = BITOP_LOAD(src[0],1); \
+        __m256i c = BITOP_LOAD(src[0],2), d = BITOP_LOAD(src[0],3); \
+        for (i = 1; i < numkeys; i++) { \
+            a = vecop(a,BITOP_LOAD(src[i],0)); \
+            b = vecop(b,BITOP_LOAD(src[i],1)); \
+            c = vecop(c,BITOP_LOAD(src[i],2)); \
+            d = vecop(d,BITOP_LOAD(src[i],3)); \
+        } \
+        _mm256_storeu_si256((__m256i*)(dst+j),a); \
+        _mm256_storeu_si256((__m256i*)(dst+j+32),b); \
+        _mm256_storeu_si256((__m256i*)(dst+j+64),c); \
+        _mm256_storeu_si256((__m256i*)(dst+j+96),d); \
+        j += 128; \
+    } \
+    while (len-j >= 32) { \
+        __m256i a = BITOP_LOAD(src[0],0); \
+        for (i = 1; i < numkeys; i++) a = vecop(a,BITOP_LOAD(src[i],0)); \
+        _mm256_storeu_si256((__m256i*)(dst+j),a); \
+        j += 32; \
+    } \
+} while(0)
+
+    switch(op) {
+    case BITOP_AND: BITOP_AVX2_LOOP(_mm256_and_si256); break;
+    case BITOP_OR:  BITOP_AVX2_LOOP(_mm256_or_si256); break;
+    case BITOP_XOR: BITOP_AVX2_LOOP(_mm256_xor_si256); break;
+    case BITOP_NOT:
+        numkeys = 1; /* Only src[0] is used: the loop just loads it. */
+        while (len-j >= 32) {
+            _mm256_storeu_si256((__m256i*)(dst+j),
+                _mm256_xor_si256(BITOP_LOAD(src[0],0),ones));
+            j += 32;
+        }
+        break;
+    }
+#undef BITOP_AVX2_LOOP
+#undef BITOP_LOAD
+
+    /* The remaining bytes, less than 32. */
+    for (; j < len; j++) {
+        unsigned char output = src[0][j];
+
+        if (op == BITOP_NOT) output = ~output;
+        for (i = 1; i < numkeys; i++) {
+            switch(op) {
+            case BITOP_AND: output &= src[i][j]; break;
+            case BITOP_OR:  output |= src[i][j]; break;
+            case BITOP_XOR: output ^= src[i][j]; break;
+            }
+        }
+        dst[j] = output;
+    }
+}
+
+/* Skip bytes equal to 'skip' comparing 32 bytes at a time. */
+__attribute__((target("avx2")))
+static long skipBytesAvx2(const void *s, long count, unsigned char skip) {
+    const unsigned char *p = s;
+    const __m256i skipvec = _mm256_set1_epi8((char)skip);
+    long j = 0;
+
+    while (count-j >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p+j));
+        unsigned int eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v,skipvec));
+
+        if (eq != 0xffffffff) return j+__builtin_ctz(~eq);
+        j += 32;
+    }
+    while (j < count && p[j] == skip) j++;
+    return j;
+}
+#endif /* HAVE_X86_SIMD_DISPATCH */
+
+/* -----------------------------------------------------------------------------
+ * Runtime dispatch.
+ * -------------------------------------------------------------------------- */
+
+static long (*popcountImpl)(const void *s, long count) = NULL;
+static void (*bitopImpl)(int op, unsigned char *dst, unsigned char **src,
+                         long numkeys, long len) = NULL;
+static long (*skipBytesImpl)(const void *s, long count, unsigned char skip);
+static char *implName = "generic";
+
+/* Select the best kernels supported by the CPU. */
+/*
+ * 根据 CPU 支持的指令选择内核
+ */
+static void bitkernelSelect(void) {
+    popcountImpl = popcountGeneric;
+    bitopImpl = bitopGeneric;
+    skipBytesImpl = skipBytesGeneric;
+    implName = "generic";
+
+#ifdef HAVE_X86_SIMD_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        popcountImpl = popcountAvx2;
+        bitopImpl = bitopAvx2;
+        skipBytesImpl = skipBytesAvx2;
+        implName = "avx2";
+    } else if (__builtin_cpu_supports("popcnt")) {
+        popcountImpl = popcountPopcnt;
+        implName = "popcnt";
+    }
+#endif
+}
+
+/* Count the number of bits set in the 'count' bytes starting at 's'. */
+long bitkernelPopcount(const void *s, long count) {
+    if (popcountImpl == NULL) bitkernelSelect();
+    return popcountImpl(s,count);
+}
+
+/* Store in 'dst' the bit operation 'op' of the first 'len' bytes of the
+ * 'numkeys' strings in 'src'. All the strings must be at least 'len'
+ * bytes long. */
+void bitkernelOp(int op, unsigned char *dst, unsigned char **src,
+                 long numkeys, long len)
+{
+    if (bitopImpl == NULL) bitkernelSelect();
+    bitopImpl(op,dst,src,numkeys,len);
+}
+
+/* Return the index of the first byte not equal to 'skip' in the 'count'
+ * bytes starting at 's', or 'count' if there is no such byte. */
+long bitkernelSkipBytes(const void *s, long count, unsigned char skip) {
+    if (skipBytesImpl == NULL) bitkernelSelect();
+    return skipBytesImpl(s,count,skip);
+}
+
+/* Return the name of the selected kernels: "avx2", "popcnt" or "generic". */
+char *bitkernelImplementation(void) {
+    if (popcountImpl == NULL) bitkernelSelect();
+    return implName;
+}
+
+#ifdef BITKERNEL_TEST_MAIN
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <time.h>
+
+/* Check the selected kernels against the generic ones on random buffers
+ * of random lengths and alignments, then measure the throughput of every
+ * kernel available on this CPU over 64 MB bitmaps:
+ *
+ * gcc -O2 -DBITKERNEL_TEST_MAIN -o bitkernel-test bitkernel.c
+ * ./bitkernel-test [seed] */
+
+#define BENCH_LEN (64*1024*1024)
+#define BENCH_KEYS 4
+
+typedef struct {
+    char *name;
+    long (*popcount)(const void *s, long count);
+    void (*bitop)(int op, unsigned char *dst, unsigned char **src,
+                  long numkeys, long len);
+    long (*skip)(const void *s, long count, unsigned char skip);
+} kernelSet;
+
+static long long ustime(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+    return ((long long)tv.tv_sec)*1000000+tv.tv_usec;
+}
+
+static void fillRandom(unsigned char *p, long len) {
+    long j;
+
+    for (j = 0; j < len; j++) p[j] = rand();
+}
+
+static void testCorrectness(void) {
+    unsigned char *src[20], *dst1, *dst2;
+    long iter, len, off, j, numkeys, expected;
+    int op;
+
+    for (j = 0; j < 20; j++) src[j] = malloc(4096+64);
+    dst1 = malloc(4096);
+    dst2 = malloc(4096);
+    for (iter = 0; iter < 20000; iter++) {
+        len = rand() % ((iter & 7) ? 300 : 4096);
+        off = rand() % 64;
+        numkeys = 1 + rand() % 20;
+        op = rand() % 4;
+        for (j = 0; j < numkeys; j++) fillRandom(src[j],len+off);
+
+        /* BITCOUNT at any offset. */
+        assert(bitkernelPopcount(src[0]+off,len) ==
+               popcountGeneric(src[0]+off,len));
+
+        /* BITOP with any number of keys. */
+        bitkernelOp(op,dst1,src,numkeys,len);
+        bitopGeneric(op,dst2,src,numkeys,len);
+        assert(memcmp(dst1,dst2,len) == 0);
+
+        /* BITPOS skipping a random prefix of zero / one bytes. */
+        expected = len ? rand() % (len+1) : 0;
+        memset(src[1]+off,iter&1 ? 0xff : 0,expected);
+        assert(bitkernelSkipBytes(src[1]+off,len,iter&1 ? 0xff : 0) ==
+               skipBytesGeneric(src[1]+off,len,iter&1 ? 0xff : 0));
+    }
+    for (j = 0; j < 20; j++) free(src[j]);
+    free(dst1);
+    free(dst2);
+}
+
+static void benchmark(kernelSet *k, unsigned char **src, unsigned char *dst) {
+    static char *opnames[] = {"and","or","xor","not"};
+    long long start, elapsed;
+    long bits, pos;
+    int op, skip;
+
+    start = ustime();
+    bits = k->popcount(src[0],BENCH_LEN);
+    elapsed = ustime()-start;
+    printf("%-8s bitcount  %8.0f MB/s (%ld bits)\n", k->name,
+        (double)BENCH_LEN/(elapsed ? elapsed : 1), bits);
+
+    for (op = 0; op < 4; op++) {
+        long numkeys = (op == BITOP_NOT) ? 1 : BENCH_KEYS;
+
+        start = ustime();
+        k->bitop(op,dst,src,numkeys,BENCH_LEN);
+        elapsed = ustime()-start;
+        printf("%-8s bitop %-3s %8.0f MB/s (%ld keys)\n", k->name,
+            opnames[op], (double)BENCH_LEN*numkeys/(elapsed ? elapsed : 1),
+            numkeys);
+    }
+
+    /* BITPOS scanning the whole bitmap: all the bytes but the last one
+     * are equal to the skipped value. */
+    for (skip = 0; skip <= 0xff; skip += 0xff) {
+        memset(dst,skip,BENCH_LEN);
+        dst[BENCH_LEN-1] ^= 1;
+        start = ustime();
+        pos = k->skip(dst,BENCH_LEN,skip);
+        elapsed = ustime()-start;
+        assert(pos == BENCH_LEN-1);
+        printf("%-8s bitpos %d  %8.0f MB/s\n", k->name, skip ? 0 : 1,
+            (double)BENCH_LEN/(elapsed ? elapsed : 1));
+    }
+}
+
+int main(int argc, char **argv) {
+    kernelSet kernels[] = {
+        {"generic",popcountGeneric,bitopGeneric,skipBytesGeneric},
+#ifdef HAVE_X86_SIMD_DISPATCH
+        {"popcnt",popcountPopcnt,bitopGeneric,skipBytesGeneric},
+        {"avx2",popcountAvx2,bitopAvx2,skipBytesAvx2},
+#endif
+        {NULL,NULL,NULL,NULL}
+    };
+    unsigned char *src[BENCH_KEYS], *dst;
+    int seed = argc > 1 ? atoi(argv[1]) : (int)time(NULL);
+    int j;
+
+    printf("Seed: %d, selected kernels: %s\n", seed,
+        bitkernelImplementation());
+    srand(seed);
+    testCorrectness();
+    printf("Correctness tests passed.\n");
+
+    for (j = 0; j < BENCH_KEYS; j++) {
+        src[j] = malloc(BENCH_LEN);
+        fillRandom(src[j],BENCH_LEN);
+    }
+    dst = calloc(1,BENCH_LEN);
+    for (j = 0; kernels[j].name; j++) {
+        if (strcmp(kernels[j].name,bitkernelImplementation()) &&
+            strcmp(kernels[j].name,"generic") &&
+            (strcmp(kernels[j].name,"popcnt") ||
+             strcmp(bitkernelImplementation(),"avx2")))
+            continue; /* Not supported by this CPU. */
+        benchmark(kernels+j,src,dst);
+    }
+    for (j = 0; j < BENCH_KEYS; j++) free(src[j]);
+    free(dst);
+    return 0;
+}
+#endif
@@ -1497,12 +1497,20 @@ void clusterCommand(redisClient *c) {
 void createDumpPayload(rio *payload, robj *o) {
     unsigned char buf[2];
     uint64_t crc;
+    int codec = server.rdb_compression_codec;
 
     /* Serialize the object in a RDB-like format. It consist of an object type
-     * byte followed by the serialized object. This is understood by RESTORE. */
+     * byte followed by the serialized object. This is understood by RESTORE.
+     *
+     * Strings are always compressed with LZF, whatever the codec used for
+     * RDB files, so that instances without LZ4 support can RESTORE the
+     * payload. */
+    // DUMP 和 MIGRATE 的数据总是使用 LZF 压缩，以便旧版本的实例也可以 RESTORE
     rioInitWithBuffer(payload,sdsempty());
+    server.rdb_compression_codec = REDIS_RDB_CODEC_LZF;
     redisAssert(rdbSaveObjectType(payload,o));
     redisAssert(rdbSaveObject(payload,o));
+    server.rdb_compression_codec = codec;
 
     /* Write the footer, this is how it looks like:
      * ----------------+---------------------+---------------+
@@ -1523,8 +1531,8 @@ void createDumpPayload(rio *payload, robj *o) {
     payload->io.buffer.ptr = sdscatlen(payload->io.buffer.ptr,&crc,8);
 }
 
-/* Verify that the RDB version of the dump payload matches the one of this Redis
- * instance and that the checksum is ok.
+/* Verify that the RDB version of the dump payload is not newer than the one
+ * of this Redis instance and that the checksum is ok.
  * If the DUMP payload looks valid REDIS_OK is returned, otherwise REDIS_ERR
  * is returned. */
 int verifyDumpPayload(unsigned char *p, size_t len) {
@@ -1538,7 +1546,7 @@ int verifyDumpPayload(unsigned char *p, size_t len) {
 
     /* Verify RDB version */
     rdbver = (footer[1] << 8) | footer[0];
-    if (rdbver != REDIS_RDB_VERSION) return REDIS_ERR;
+    if (rdbver > REDIS_RDB_VERSION) return REDIS_ERR;
 
     /* Verify CRC64 */
     crc = crc64(0,p,len-8);
@@ -1799,7 +1807,7 @@ try_again:
     }
     redisAssertWithInfo(c,NULL,rioWriteBulkCount(&cmd,'*',replace ? 5 : 4));
     redisAssertWithInfo(c,NULL,rioWriteBulkString(&cmd,"RESTORE",7));
-    redisAssertWithInfo(c,NULL,c->argv[3]->encoding == REDIS_ENCODING_RAW);
+    redisAssertWithInfo(c,NULL,sdsEncodedObject(c->argv[3]));
     redisAssertWithInfo(c,NULL,rioWriteBulkString(&cmd,c->argv[3]->ptr,sdslen(c->argv[3]->ptr)));
     redisAssertWithInfo(c,NULL,rioWriteBulkLongLong(&cmd,ttl));
 
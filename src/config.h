@@ -164,5 +164,14 @@
 #endif
 #endif
 
+/* Test for x86 kernels selected at runtime (target attribute, intrinsics
+ * and __builtin_cpu_supports), used by bitkernel.c. */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__clang__) && __clang_major__ >= 4) || \
+     (!defined(__clang__) && defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HAVE_X86_SIMD_DISPATCH 1
+#endif
+
 
 #endif
@@ -58,8 +58,13 @@ robj *lookupKey(redisDb *db, robj *key) {
          * Don't do it if we have a saving child, as this will trigger
          * a copy on write madness. */
         // 如果条件允许，那么更新 lru 时间
-        if (server.rdb_child_pid == -1 && server.aof_child_pid == -1)
-            val->lru = server.lruclock;
+        if (server.rdb_child_pid == -1 && server.aof_child_pid == -1) {
+            // LFU 策略下更新访问频率计数器，否则更新 LRU 时间
+            if (REDIS_MAXMEMORY_IS_LFU(server.maxmemory_policy))
+                updateObjectLFU(val);
+            else
+                val->lru = server.lruclock;
+        }
 
         return val;
     } else {
@@ -327,26 +332,76 @@ void signalFlushedDb(int dbid) {
  * Type agnostic commands operating on the key space
  *----------------------------------------------------------------------------*/
 
+/* Parse the optional ASYNC argument of FLUSHDB and FLUSHALL. On success
+ * REDIS_OK is returned and *async is set to 1 if the databases should be
+ * freed by a bio thread. On syntax error REDIS_ERR is returned and an error
+ * is sent to the client. */
+/*
+ * 解析 FLUSHDB 和 FLUSHALL 的可选参数 ASYNC
+ *
+ * 给定 ASYNC 时将 *async 设为 1 ，表示由后台线程释放数据库
+ */
+static int getFlushCommandAsync(redisClient *c, int *async) {
+    if (c->argc > 2) {
+        addReply(c,shared.syntaxerr);
+        return REDIS_ERR;
+    }
+    if (c->argc == 2) {
+        if (strcasecmp(c->argv[1]->ptr,"async")) {
+            addReply(c,shared.syntaxerr);
+            return REDIS_ERR;
+        }
+        /* Inside MULTI/EXEC the arguments of the queued commands may still
+         * reference objects stored into keys, that the bio thread would
+         * release while the main thread holds them: flush synchronously. */
+        // 事务中的命令参数可能引用了数据库中的对象，此时同步地清空数据库
+        *async = !(c->flags & REDIS_MULTI);
+    } else {
+        *async = 0;
+    }
+    return REDIS_OK;
+}
+
 /*
  * 清空客户端当前所使用的数据库
+ *
+ * FLUSHDB [ASYNC]
  */
 void flushdbCommand(redisClient *c) {
-    server.dirty += dictSize(c->db->dict);
+    int async;
+
+    if (getFlushCommandAsync(c,&async) == REDIS_ERR) return;
+
     signalFlushedDb(c->db->id);
-    dictEmpty(c->db->dict);
-    dictEmpty(c->db->expires);
+    if (async) {
+        server.dirty += emptyDbAsync(c->db);
+    } else {
+        server.dirty += dictSize(c->db->dict);
+        dictEmpty(c->db->dict);
+        dictEmpty(c->db->expires);
+    }
     addReply(c,shared.ok);
 }
 
 /*
  * 清空所有数据库
+ *
+ * FLUSHALL [ASYNC]
  */
 void flushallCommand(redisClient *c) {
+    int async, j;
+
+    if (getFlushCommandAsync(c,&async) == REDIS_ERR) return;
 
     signalFlushedDb(-1);
 
     // 清空所有数据库
-    server.dirty += emptyDb();
+    if (async) {
+        for (j = 0; j < server.dbnum; j++)
+            server.dirty += emptyDbAsync(&server.db[j]);
+    } else {
+        server.dirty += emptyDb();
+    }
 
     addReply(c,shared.ok);
 
@@ -368,12 +423,26 @@ void flushallCommand(redisClient *c) {
 
 /*
  * 从数据库中删除所有给定 key
+ *
+ * lazy 为真时，大的值对象由后台线程释放
  */
-void delCommand(redisClient *c) {
+void delGenericCommand(redisClient *c, int lazy) {
     int deleted = 0, j;
+    long long latency;
 
     for (j = 1; j < c->argc; j++) {
-        if (dbDelete(c->db,c->argv[j])) {
+        int removed;
+
+        /* Freeing a big value may block the server: sample the time
+         * spent here as the "del" event. Evictions and expires are
+         * sampled by their own events. */
+        // 释放大的值对象可能会阻塞服务器，将删除的耗时记录为 del 事件
+        latencyStartMonitor(latency);
+        removed = lazy ? dbAsyncDelete(c->db,c->argv[j]) :
+                         dbDelete(c->db,c->argv[j]);
+        latencyEndMonitor(latency);
+        latencyAddSampleIfNeeded("del",latency);
+        if (removed) {
             signalModifiedKey(c->db,c->argv[j]);
             server.dirty++;
             deleted++;
@@ -383,6 +452,17 @@ void delCommand(redisClient *c) {
     addReplyLongLong(c,deleted);
 }
 
+void delCommand(redisClient *c) {
+    delGenericCommand(c,0);
+}
+
+/* UNLINK is like DEL, but the values are freed by a bio thread when they
+ * are big enough for this to be worth it. */
+// UNLINK 和 DEL 一样，但大的值对象会交给后台线程释放
+void unlinkCommand(redisClient *c) {
+    delGenericCommand(c,1);
+}
+
 /*
  * 检查给定 key 是否存在
  */
@@ -477,6 +557,286 @@ void keysCommand(redisClient *c) {
     setDeferredMultiBulkLength(c,replylen,numkeys);
 }
 
+/* This callback is used by scanGenericCommand in order to collect elements
+ * returned by the dictionary iterator into a list.
+ *
+ * scanGenericCommand 所使用的回调函数，
+ * 将字典迭代器返回的元素收集到列表中。
+ */
+void scanCallback(void *privdata, const dictEntry *de) {
+    void **pd = (void**) privdata;
+    list *keys = pd[0];
+    robj *o = pd[1];
+    robj *key, *val = NULL;
+
+    if (o == NULL) {
+        // 数据库键空间，键为 sds
+        sds sdskey = dictGetKey(de);
+        key = createStringObject(sdskey, sdslen(sdskey));
+    } else if (o->type == REDIS_SET) {
+        // 集合，只有成员
+        key = dictGetKey(de);
+        incrRefCount(key);
+    } else if (o->type == REDIS_HASH) {
+        // 哈希，域和值
+        key = dictGetKey(de);
+        incrRefCount(key);
+        val = dictGetVal(de);
+        incrRefCount(val);
+    } else if (o->type == REDIS_ZSET) {
+        // 有序集合，成员和分值
+        key = dictGetKey(de);
+        incrRefCount(key);
+        val = createStringObjectFromLongDouble(*(double*)dictGetVal(de));
+    } else {
+        redisPanic("Type not handled in SCAN callback.");
+    }
+
+    listAddNodeTail(keys, key);
+    if (val) listAddNodeTail(keys, val);
+}
+
+/* Try to parse a SCAN cursor stored at object 'o':
+ * if the cursor is valid, store it as unsigned integer into *cursor and
+ * returns REDIS_OK. Otherwise return REDIS_ERR and send an error to the
+ * client.
+ *
+ * 解析保存在对象 o 中的 SCAN 游标，
+ * 游标有效时将它保存到 *cursor 并返回 REDIS_OK ，
+ * 否则向客户端发送错误并返回 REDIS_ERR 。
+ */
+int parseScanCursorOrReply(redisClient *c, robj *o, unsigned long *cursor) {
+    char *eptr;
+
+    /* Use strtoul() because we need an *unsigned* long, so
+     * getLongLongFromObject() does not cover the whole cursor space. */
+    // strtoul() 会接受并翻转负数，所以负号需要单独检查
+    errno = 0;
+    *cursor = strtoul(o->ptr, &eptr, 10);
+    if (isspace(((char*)o->ptr)[0]) || ((char*)o->ptr)[0] == '-' ||
+        eptr[0] != '\0' || errno == ERANGE)
+    {
+        addReplyError(c, "invalid cursor");
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+
+/* This command implements SCAN, HSCAN, SSCAN and ZSCAN commands.
+ * If object 'o' is passed, then it must be a Hash, Set or Zset object, otherwise
+ * if 'o' is NULL the command will operate on the dictionary associated with
+ * the current database.
+ *
+ * SCAN 、 HSCAN 、 SSCAN 和 ZSCAN 命令的实现。
+ * 如果给定了对象 o ，那么它必须是哈希、集合或者有序集合对象，
+ * 如果 o 为 NULL ，那么命令迭代当前数据库的键空间。
+ *
+ * When 'o' is not NULL the function assumes that the first argument in
+ * the client arguments vector is a key so it skips it before iterating
+ * in order to parse options.
+ *
+ * In the case of a Hash object the function returns both the field and value
+ * of every element on the Hash.
+ *
+ * 对于哈希对象，函数同时返回每个元素的域和值。
+ *
+ * Objects using the ziplist or intset encoding are small by definition,
+ * so they are returned in a single call with a zero cursor.
+ *
+ * 使用 ziplist 或 intset 编码的对象一定很小，
+ * 所以它们的全部元素会在一次调用中返回，返回的游标为 0 。
+ */
+void scanGenericCommand(redisClient *c, robj *o, unsigned long cursor) {
+    int rv;
+    int i, j;
+    char buf[32];
+    list *keys = listCreate();
+    listNode *node, *nextnode;
+    long count = 10;
+    sds pat = NULL;
+    int patlen = 0, use_pattern = 0;
+    dict *ht;
+
+    /* Object must be NULL (to iterate keys names), or the type of the object
+     * must be Set, Sorted Set, or Hash. */
+    redisAssert(o == NULL || o->type == REDIS_SET || o->type == REDIS_HASH ||
+                o->type == REDIS_ZSET);
+
+    /* Set i to the first option argument. The previous one is the cursor. */
+    // 跳过命令名、（可能存在的）键名和游标
+    i = (o == NULL) ? 2 : 3; /* Skip the key argument if needed. */
+
+    /* Step 1: Parse options. */
+    // 1) 解析 COUNT 和 MATCH 选项
+    while (i < c->argc) {
+        j = c->argc - i;
+        if (!strcasecmp(c->argv[i]->ptr, "count") && j >= 2) {
+            if (getLongFromObjectOrReply(c, c->argv[i+1], &count, NULL)
+                != REDIS_OK)
+            {
+                goto cleanup;
+            }
+
+            if (count < 1) {
+                addReply(c,shared.syntaxerr);
+                goto cleanup;
+            }
+
+            i += 2;
+        } else if (!strcasecmp(c->argv[i]->ptr, "match") && j >= 2) {
+            pat = c->argv[i+1]->ptr;
+            patlen = sdslen(pat);
+
+            /* The pattern always matches if it is exactly "*", so it is
+             * equivalent to disabling it. */
+            use_pattern = !(pat[0] == '*' && patlen == 1);
+
+            i += 2;
+        } else {
+            addReply(c,shared.syntaxerr);
+            goto cleanup;
+        }
+    }
+
+    /* Step 2: Iterate the collection.
+     *
+     * Note that if the object is encoded with a ziplist or intset, there is
+     * no cursor: all the elements are returned in one call. */
+
+    /* Handle the case of a hash table. */
+    // 2) 迭代集合
+    ht = NULL;
+    if (o == NULL) {
+        ht = c->db->dict;
+    } else if (o->type == REDIS_SET && o->encoding == REDIS_ENCODING_HT) {
+        ht = o->ptr;
+    } else if (o->type == REDIS_HASH && o->encoding == REDIS_ENCODING_HT) {
+        ht = o->ptr;
+        count *= 2; /* We return key / value for this type. */
+    } else if (o->type == REDIS_ZSET && o->encoding == REDIS_ENCODING_SKIPLIST) {
+        zset *zs = o->ptr;
+        ht = zs->dict;
+        count *= 2; /* We return key / value for this type. */
+    }
+
+    if (ht) {
+        void *privdata[2];
+
+        /* We pass two pointers to the callback: the list to which it will
+         * add new elements, and the object containing the dictionary so that
+         * it is possible to fetch more data in a type-dependent way. */
+        privdata[0] = keys;
+        privdata[1] = o;
+        // 每次访问一个桶，直到收集到 count 个元素或迭代完成
+        // 为了防止字典非常稀疏时迭代过久，访问的桶数量也有上限
+        long maxiterations = count*10;
+        do {
+            cursor = dictScan(ht, cursor, scanCallback, privdata);
+        } while (cursor && maxiterations-- && listLength(keys) < (unsigned long)count);
+    } else if (o->type == REDIS_SET) {
+        // intset 编码的集合
+        int pos = 0;
+        int64_t ll;
+
+        while(intsetGet(o->ptr,pos++,&ll))
+            listAddNodeTail(keys,createStringObjectFromLongLong(ll));
+        cursor = 0;
+    } else if (o->type == REDIS_HASH || o->type == REDIS_ZSET) {
+        // ziplist 编码的哈希和有序集合，元素和值（分值）交替保存
+        unsigned char *p = ziplistIndex(o->ptr,0);
+        unsigned char *vstr;
+        unsigned int vlen;
+        long long vll;
+
+        while(p) {
+            ziplistGet(p,&vstr,&vlen,&vll);
+            listAddNodeTail(keys,
+                (vstr != NULL) ? createStringObject((char*)vstr,vlen) :
+                                 createStringObjectFromLongLong(vll));
+            p = ziplistNext(o->ptr,p);
+        }
+        cursor = 0;
+    } else {
+        redisPanic("Not handled encoding in SCAN.");
+    }
+
+    /* Step 3: Filter elements. */
+    // 3) 过滤元素：不匹配模式的元素，以及已过期的键
+    node = listFirst(keys);
+    while (node) {
+        robj *kobj = listNodeValue(node);
+        nextnode = listNextNode(node);
+        int filter = 0;
+
+        /* Filter element if it does not match the pattern. */
+        if (!filter && use_pattern) {
+            if (sdsEncodedObject(kobj)) {
+                if (!stringmatchlen(pat, patlen, kobj->ptr, sdslen(kobj->ptr), 0))
+                    filter = 1;
+            } else {
+                char llbuf[32];
+                int len;
+
+                redisAssert(kobj->encoding == REDIS_ENCODING_INT);
+                len = ll2string(llbuf,sizeof(llbuf),(long)kobj->ptr);
+                if (!stringmatchlen(pat, patlen, llbuf, len, 0)) filter = 1;
+            }
+        }
+
+        /* Filter element if it is an expired key. */
+        if (!filter && o == NULL && expireIfNeeded(c->db, kobj)) filter = 1;
+
+        /* Remove the element and its associted value if needed. */
+        if (filter) {
+            decrRefCount(kobj);
+            listDelNode(keys, node);
+        }
+
+        /* If this is a hash or a sorted set, we have a flat list of
+         * key-value elements, so if this element was filtered, remove the
+         * value, or skip it if it was not filtered: we only match keys. */
+        if (o && (o->type == REDIS_ZSET || o->type == REDIS_HASH)) {
+            node = nextnode;
+            nextnode = listNextNode(node);
+            if (filter) {
+                kobj = listNodeValue(node);
+                decrRefCount(kobj);
+                listDelNode(keys, node);
+            }
+        }
+        node = nextnode;
+    }
+
+    /* Step 4: Reply to the client. */
+    // 4) 回复：新的游标，以及元素列表
+    addReplyMultiBulkLen(c, 2);
+    rv = snprintf(buf, sizeof(buf), "%lu", cursor);
+    redisAssert(rv < (int)sizeof(buf));
+    addReplyBulkCBuffer(c, buf, rv);
+
+    addReplyMultiBulkLen(c, listLength(keys));
+    while ((node = listFirst(keys)) != NULL) {
+        robj *kobj = listNodeValue(node);
+        addReplyBulk(c, kobj);
+        decrRefCount(kobj);
+        listDelNode(keys, node);
+    }
+
+cleanup:
+    listSetFreeMethod(keys,decrRefCount);
+    listRelease(keys);
+}
+
+/* The SCAN command completely relies on scanGenericCommand.
+ *
+ * SCAN 命令的实现
+ */
+void scanCommand(redisClient *c) {
+    unsigned long cursor;
+    if (parseScanCursorOrReply(c,c->argv[1],&cursor) == REDIS_ERR) return;
+    scanGenericCommand(c,NULL,cursor);
+}
+
 /*
  * DBSIZE 命令的实现
  *
@@ -748,8 +1108,7 @@ void propagateExpire(redisDb *db, robj *key) {
     if (server.aof_state != REDIS_AOF_OFF)
         feedAppendOnlyFile(server.delCommand,db->id,argv,2);
 
-    if (listLength(server.slaves))
-        replicationFeedSlaves(server.slaves,db->id,argv,2);
+    replicationFeedSlaves(server.slaves,db->id,argv,2);
 
     decrRefCount(argv[0]);
     decrRefCount(argv[1]);
@@ -901,6 +901,253 @@ dictEntry *dictGetRandomKey(dict *d)
     return he;
 }
 
+/* This function samples the dictionary to return a few keys from random
+ * locations. It stores at most 'count' entries into the array 'des' and
+ * returns the number of entries actually stored.
+ *
+ * It does not guarantee to return all the keys specified in 'count', nor
+ * that the returned elements are distinct, but it is much faster than
+ * calling dictGetRandomKey() 'count' times: a random bucket is picked and
+ * then the following buckets are visited in order, collecting every entry
+ * found, jumping to a new random bucket only when a long run of empty
+ * buckets is found. The returned entries are not well distributed, but
+ * this is fine when what is needed is a sample of the keyspace, like in
+ * the eviction algorithm.
+ *
+ * 从字典中随机取出至多 count 个节点，保存到数组 des 中，
+ * 返回实际取得的节点数量。
+ *
+ * 函数从一个随机的桶开始，顺序访问之后的桶并取出其中的所有节点，
+ * 只有在遇到连续的空桶时才跳到另一个随机位置，
+ * 因此比调用 count 次 dictGetRandomKey() 要快得多，
+ * 但取出的节点分布不够均匀，也可能有重复。
+ *
+ * T = O(count)
+ */
+unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count) {
+    unsigned int j;         /* Internal hash table id, 0 or 1. */
+    unsigned int tables;    /* 1 or 2 tables? */
+    unsigned int stored = 0, emptylen = 0;
+    unsigned long i, maxsizemask, maxsteps;
+
+    if (dictSize(d) < count) count = dictSize(d);
+    maxsteps = count*10;
+
+    /* Try to do an amount of rehashing work proportional to 'count'. */
+    // 执行和 count 成正比的渐进式 rehash
+    for (j = 0; j < count; j++) {
+        if (dictIsRehashing(d))
+            _dictRehashStep(d);
+        else
+            break;
+    }
+
+    tables = dictIsRehashing(d) ? 2 : 1;
+    maxsizemask = d->ht[0].sizemask;
+    if (tables > 1 && maxsizemask < d->ht[1].sizemask)
+        maxsizemask = d->ht[1].sizemask;
+
+    /* Pick a random point inside the larger table. */
+    // 从较大的那个哈希表中随机选择一个起点
+    i = random() & maxsizemask;
+    while(stored < count && maxsteps--) {
+        for (j = 0; j < tables; j++) {
+            dictEntry *he;
+
+            /* While rehashing, the buckets of ht[0] below rehashidx were
+             * already moved to ht[1], so they can be skipped. If we are
+             * also out of range for ht[1], both tables are empty up to
+             * rehashidx, so we jump there directly. */
+            // rehash 时 ht[0] 中 rehashidx 之前的桶都已经为空
+            if (tables == 2 && j == 0 && i < (unsigned long) d->rehashidx) {
+                if (i >= d->ht[1].size) i = d->rehashidx;
+                continue;
+            }
+            if (i >= d->ht[j].size) continue; /* Out of range for this table. */
+            he = d->ht[j].table[i];
+
+            /* Count contiguous empty buckets, and jump to another random
+             * location if they reach 'count' (with a minimum of 5). */
+            // 连续遇到太多空桶时，跳到另一个随机位置
+            if (he == NULL) {
+                emptylen++;
+                if (emptylen >= 5 && emptylen > count) {
+                    i = random() & maxsizemask;
+                    emptylen = 0;
+                }
+            } else {
+                emptylen = 0;
+                // 取出链表中的所有节点
+                while (he) {
+                    *des = he;
+                    des++;
+                    he = he->next;
+                    stored++;
+                    if (stored == count) return stored;
+                }
+            }
+        }
+        i = (i+1) & maxsizemask;
+    }
+    return stored;
+}
+
+/* Function to reverse bits. Algorithm from:
+ * http://graphics.stanford.edu/~seander/bithacks.html#ReverseParallel
+ *
+ * 翻转一个无符号长整数的所有二进制位
+ */
+static unsigned long rev(unsigned long v) {
+    unsigned long s = 8 * sizeof(v); // bit size; must be power of 2
+    unsigned long mask = ~0;
+    while ((s >>= 1) > 0) {
+        mask ^= (mask << s);
+        v = ((v >> s) & mask) | ((v << s) & ~mask);
+    }
+    return v;
+}
+
+/* dictScan() is used to iterate over the elements of a dictionary.
+ *
+ * 迭代给定字典中的元素。
+ *
+ * Iterating works in the following way:
+ *
+ * 1) Initially you call the function using a cursor (v) value of 0.
+ *    第一次调用时，游标 v 为 0 。
+ * 2) The function performs one step of the iteration, and returns the
+ *    new cursor value that you must use in the next call.
+ *    函数执行一步迭代，并返回下次调用时需要使用的新游标。
+ * 3) When the returned cursor is 0, the iteration is complete.
+ *    当返回的游标为 0 时，迭代完成。
+ *
+ * The function guarantees that all the elements that are present in the
+ * dictionary from the start to the end of the iteration are returned.
+ * However it is possible that some element is returned multiple times.
+ *
+ * 从迭代开始到结束一直存在于字典中的元素一定会被返回，
+ * 但某些元素可能会被返回多次。
+ *
+ * For every element returned, the callback 'fn' is called with 'privdata'
+ * as first argument and the dictionary entry 'de' as second argument.
+ *
+ * HOW IT WORKS.
+ *
+ * The cursor is a bucket index, but instead of being incremented normally
+ * its bits are reversed, incremented, and reversed again: the high order
+ * bits of the index are incremented first.
+ *
+ * 游标是一个桶的索引，但它不是按普通方式递增的，
+ * 而是将二进制位翻转之后加一，再翻转回来，也即是先递增高位。
+ *
+ * Since the table size is always a power of two, the buckets of a smaller
+ * table map to a contiguous group of buckets of a bigger table that share
+ * the same low order bits (the bucket index masked by the small table
+ * mask). Incrementing the high bits first means that when the table grows
+ * or shrinks between two calls the cursor never skips a group of buckets
+ * that was not already visited: at worst some bucket is visited again.
+ *
+ * 因为哈希表的大小总是 2 的幂，小表中的一个桶在大表中对应的是
+ * 低位相同的一组桶。先递增高位的游标保证哈希表在两次调用之间
+ * 扩展或收缩时，不会跳过尚未访问的桶，最多只会重复访问某些桶。
+ *
+ * While rehashing both tables are scanned: for the smaller table only the
+ * bucket pointed by the cursor is visited, then all the buckets of the
+ * bigger table that are expansions of that bucket.
+ *
+ * 在 rehash 进行期间，两个哈希表都会被扫描：
+ * 先访问小表中游标指向的桶，然后访问大表中由该桶扩展出来的所有桶。
+ *
+ * LIMITATIONS
+ *
+ * The iterator is stateless, so nothing needs to be released, but elements
+ * may be returned multiple times and the caller must deal with it.
+ *
+ * 这个迭代器是无状态的，不需要释放任何资源，
+ * 但调用者必须能处理元素被重复返回的情况。
+ *
+ * T = O(1) 摊销，每次调用访问 1 个（rehash 时为若干个）桶
+ */
+unsigned long dictScan(dict *d,
+                       unsigned long v,
+                       dictScanFunction *fn,
+                       void *privdata)
+{
+    dictht *t0, *t1;
+    const dictEntry *de;
+    unsigned long m0, m1;
+
+    // 空字典，迭代完成
+    if (dictSize(d) == 0) return 0;
+
+    if (!dictIsRehashing(d)) {
+        t0 = &(d->ht[0]);
+        m0 = t0->sizemask;
+
+        /* Emit entries at cursor */
+        // 返回游标指向的桶中的所有节点
+        de = t0->table[v & m0];
+        while (de) {
+            fn(privdata, de);
+            de = de->next;
+        }
+
+    } else {
+        t0 = &d->ht[0];
+        t1 = &d->ht[1];
+
+        /* Make sure t0 is the smaller and t1 is the bigger table */
+        // 让 t0 指向较小的表， t1 指向较大的表
+        if (t0->size > t1->size) {
+            t0 = &d->ht[1];
+            t1 = &d->ht[0];
+        }
+
+        m0 = t0->sizemask;
+        m1 = t1->sizemask;
+
+        /* Emit entries at cursor */
+        // 返回小表中游标指向的桶
+        de = t0->table[v & m0];
+        while (de) {
+            fn(privdata, de);
+            de = de->next;
+        }
+
+        /* Iterate over indices in larger table that are the expansion
+         * of the index pointed to by the cursor in the smaller table */
+        // 返回大表中由小表的这个桶扩展出来的所有桶
+        do {
+            /* Emit entries at cursor */
+            de = t1->table[v & m1];
+            while (de) {
+                fn(privdata, de);
+                de = de->next;
+            }
+
+            /* Increment bits not covered by the smaller mask */
+            // 递增小表掩码之外的那些位
+            v = (((v | m0) + 1) & ~m0) | (v & m0);
+
+            /* Continue while bits covered by mask difference is non-zero */
+        } while (v & (m0 ^ m1));
+    }
+
+    /* Set unmasked bits so incrementing the reversed cursor
+     * operates on the masked bits of the smaller table */
+    // 将掩码之外的位全部设为 1 ，
+    // 这样翻转之后的加一只会作用在小表掩码覆盖的位上
+    v |= ~m0;
+
+    /* Increment the reverse cursor */
+    // 翻转、加一、再翻转
+    v = rev(v);
+    v++;
+    v = rev(v);
+
+    return v;
+}
+
 /* ------------------------- private functions ------------------------------ */
 
 /* Expand the hash table if needed */
@@ -150,6 +150,8 @@ typedef struct dictIterator {
               *nextEntry;   // 当前哈希节点的后继节点
 } dictIterator;
 
+typedef void (dictScanFunction)(void *privdata, const dictEntry *de);
+
 // 所有哈希表的起始大小
 #define DICT_HT_INITIAL_SIZE     4
 
@@ -214,6 +216,8 @@ dictIterator *dictGetSafeIterator(dict *d);
 dictEntry *dictNext(dictIterator *iter);
 void dictReleaseIterator(dictIterator *iter);
 dictEntry *dictGetRandomKey(dict *d);
+unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count);
+unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, void *privdata);
 void dictPrintStats(dict *d);
 unsigned int dictGenHashFunction(const void *key, int len);
 unsigned int dictGenCaseHashFunction(const unsigned char *buf, int len);
@@ -0,0 +1,384 @@
+/* The latency monitor samples the internal operations that can block the
+ * server for a long time, like fork(), AOF writes and fsyncs, the active
+ * expire cycle, evictions, the release of big values and slow commands.
+ *
+ * 延迟监视器对可能长时间阻塞服务器的内部操作进行采样，
+ * 比如 fork() 、 AOF 的写入和 fsync 、主动过期、驱逐、大对象的释放以及慢命令。
+ *
+ * Every operation taking at least 'latency-monitor-threshold' milliseconds
+ * is recorded in the time series of its event, that remembers the latest
+ * LATENCY_TS_LEN spikes (one per second at most, the worst wins). The
+ * LATENCY command returns the time series and a human readable analysis.
+ *
+ * 耗时超过 latency-monitor-threshold 毫秒的操作会被记录到对应事件的时间序列中，
+ * 每个序列保存最近的 LATENCY_TS_LEN 个样本（每秒最多一个，保留最大的那个）。
+ * LATENCY 命令返回这些时间序列，以及可读的分析报告。
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "redis.h"
+
+/* Dictionary type for latency events: C string -> latencyTimeSeries. */
+static unsigned int dictStringHash(const void *key) {
+    return dictGenHashFunction(key, strlen(key));
+}
+
+static int dictStringKeyCompare(void *privdata, const void *key1,
+                                const void *key2)
+{
+    DICT_NOTUSED(privdata);
+    return strcmp(key1,key2) == 0;
+}
+
+dictType latencyTimeSeriesDictType = {
+    dictStringHash,             /* hash function */
+    NULL,                       /* key dup */
+    NULL,                       /* val dup */
+    dictStringKeyCompare,       /* key compare */
+    dictVanillaFree,            /* key destructor */
+    dictVanillaFree             /* val destructor */
+};
+
+/* ---------------------------- Latency API --------------------------------- */
+
+/* Latency monitor initialization. We just need to create the dictionary
+ * of time series, each time serie is created on demand in order to avoid
+ * having a fixed list to maintain. */
+/*
+ * 初始化延迟监视器
+ */
+void latencyMonitorInit(void) {
+    server.latency_events = dictCreate(&latencyTimeSeriesDictType,NULL);
+}
+
+/* Add the specified sample to the specified time series "event".
+ * This function is usually called via latencyAddSampleIfNeeded(), that
+ * is a macro that only adds the sample if the latency is higher than
+ * server.latency_monitor_threshold. */
+/*
+ * 将延迟样本添加到事件 event 的时间序列中
+ */
+void latencyAddSample(char *event, long long latency) {
+    latencyTimeSeries *ts = dictFetchValue(server.latency_events,event);
+    time_t now = time(NULL);
+    int prev;
+
+    /* Create the time series if it does not exist. */
+    if (ts == NULL) {
+        ts = zcalloc(sizeof(*ts));
+        dictAdd(server.latency_events,zstrdup(event),ts);
+    }
+
+    if (latency > UINT32_MAX) latency = UINT32_MAX;
+    if (latency > ts->max) ts->max = latency;
+
+    /* If the previous sample is in the same second, we update our old sample
+     * if this latency is > of the old one, or just return. */
+    // 同一秒内的样本只保留最大的一个
+    prev = (ts->idx + LATENCY_TS_LEN - 1) % LATENCY_TS_LEN;
+    if (ts->samples[prev].time == now) {
+        if (latency > ts->samples[prev].latency)
+            ts->samples[prev].latency = latency;
+        return;
+    }
+
+    ts->samples[ts->idx].time = now;
+    ts->samples[ts->idx].latency = latency;
+    ts->idx = (ts->idx+1) % LATENCY_TS_LEN;
+}
+
+/* Reset data for the specified event, or all the events data if 'event' is
+ * NULL.
+ *
+ * Note: this is O(N) even when event_to_reset is not NULL because makes
+ * the code simpler and we have a small fixed max number of events. */
+/*
+ * 重置事件 event 的数据，event 为 NULL 时重置所有事件
+ *
+ * 返回被重置的事件数量
+ */
+int latencyResetEvent(char *event_to_reset) {
+    dictIterator *di;
+    dictEntry *de;
+    int resets = 0;
+
+    di = dictGetSafeIterator(server.latency_events);
+    while((de = dictNext(di)) != NULL) {
+        char *event = dictGetKey(de);
+
+        if (event_to_reset == NULL || strcasecmp(event,event_to_reset) == 0) {
+            dictDelete(server.latency_events, event);
+            resets++;
+        }
+    }
+    dictReleaseIterator(di);
+    return resets;
+}
+
+/* ------------------------ Latency reporting (doctor) ---------------------- */
+
+/* Analyze the samples available for a given event and fill the latencyStats
+ * structure with the computed statistics. */
+/*
+ * 分析事件的样本，计算统计信息
+ */
+void analyzeLatencyForEvent(char *event, latencyStats *ls) {
+    latencyTimeSeries *ts = dictFetchValue(server.latency_events,event);
+    long long sum;
+    int j;
+
+    memset(ls,0,sizeof(*ls));
+    if (ts == NULL) return;
+    ls->all_time_high = ts->max;
+    ls->min = UINT32_MAX;
+
+    /* First pass, populate everything but the MAD. */
+    sum = 0;
+    for (j = 0; j < LATENCY_TS_LEN; j++) {
+        if (ts->samples[j].time == 0) continue;
+        ls->samples++;
+        if (ls->samples == 1) {
+            ls->min = ls->max = ts->samples[j].latency;
+        } else {
+            if (ls->min > ts->samples[j].latency)
+                ls->min = ts->samples[j].latency;
+            if (ls->max < ts->samples[j].latency)
+                ls->max = ts->samples[j].latency;
+        }
+        sum += ts->samples[j].latency;
+
+        /* Track the oldest event time in ls->period. */
+        if (ls->period == 0 || ts->samples[j].time < ls->period)
+            ls->period = ts->samples[j].time;
+    }
+
+    /* So far avg is actually the sum of the latencies, and period is
+     * the oldest event time. We need to make the first an average and
+     * the second a range of seconds. */
+    if (ls->samples) {
+        ls->avg = sum / ls->samples;
+        ls->period = time(NULL) - ls->period;
+        if (ls->period == 0) ls->period = 1;
+    }
+
+    /* Second pass, compute MAD. */
+    sum = 0;
+    for (j = 0; j < LATENCY_TS_LEN; j++) {
+        long long delta;
+
+        if (ts->samples[j].time == 0) continue;
+        delta = (long long)ls->avg - ts->samples[j].latency;
+        if (delta < 0) delta = -delta;
+        sum += delta;
+    }
+    if (ls->samples) ls->mad = sum / ls->samples;
+}
+
+/* Create a human readable report of latency events for this Redis instance,
+ * with advices about the events observed. */
+/*
+ * 创建可读的延迟报告，并根据观察到的事件给出建议
+ */
+sds createLatencyReport(void) {
+    sds report = sdsempty();
+    dictIterator *di;
+    dictEntry *de;
+    int eventnum = 0;
+    int advise_fork = 0, advise_aof = 0, advise_expire = 0;
+    int advise_eviction = 0, advise_del = 0, advise_command = 0;
+
+    if (dictSize(server.latency_events) == 0) {
+        if (server.latency_monitor_threshold == 0)
+            return sdscat(report,
+                "The latency monitor is disabled. Enable it with "
+                "CONFIG SET latency-monitor-threshold <milliseconds>.\n");
+        return sdscat(report,
+            "No latency spikes were observed so far (threshold is "
+            "latency-monitor-threshold milliseconds).\n");
+    }
+
+    report = sdscat(report,"Latency spikes observed, per event:\n\n");
+    di = dictGetIterator(server.latency_events);
+    while((de = dictNext(di)) != NULL) {
+        char *event = dictGetKey(de);
+        latencyStats ls;
+
+        analyzeLatencyForEvent(event,&ls);
+        eventnum++;
+        report = sdscatprintf(report,
+            "%d. %s: %u latency spikes (average %ums, mean deviation %ums, "
+            "period %.2f sec). Worst all time event %ums.\n",
+            eventnum, event, ls.samples, ls.avg, ls.mad,
+            (double)ls.period/ls.samples, ls.all_time_high);
+
+        if (!strcasecmp(event,"fork")) advise_fork = 1;
+        else if (!strncasecmp(event,"aof-",4)) advise_aof = 1;
+        else if (!strcasecmp(event,"expire-cycle")) advise_expire = 1;
+        else if (!strncasecmp(event,"eviction-",9)) advise_eviction = 1;
+        else if (!strcasecmp(event,"del")) advise_del = 1;
+        else if (!strcasecmp(event,"command")) advise_command = 1;
+    }
+    dictReleaseIterator(di);
+
+    report = sdscat(report,"\nAdvices:\n\n");
+    if (advise_fork) {
+        double mb = (double)zmalloc_used_memory()/(1024*1024);
+
+        report = sdscatprintf(report,
+            "- fork() is slow: the latest fork took %.2f ms with %.2f MB of "
+            "used memory. Copying the page tables grows with the dataset: "
+            "smaller instances fork faster, and some virtualized "
+            "environments are known to have a very slow fork().\n",
+            (double)server.stat_fork_time/1000, mb);
+    }
+    if (advise_aof) {
+        report = sdscat(report,
+            "- Writing or fsyncing the AOF blocks the server: the disk is "
+            "slow or busy. Consider 'appendfsync everysec' instead of "
+            "'always', 'aof-write-thread yes' so that the write and fsync "
+            "leave the main thread, and 'no-appendfsync-on-rewrite yes' to "
+            "avoid fsyncs while a child is saving.\n");
+    }
+    if (advise_expire) {
+        report = sdscat(report,
+            "- The active expire cycle is slow: many keys expire at the "
+            "same time, or big values expire. Add a random component to the "
+            "TTLs in order to spread the expires.\n");
+    }
+    if (advise_eviction) {
+        report = sdscat(report,
+            "- Evicting keys is slow: the dataset keeps growing above "
+            "maxmemory, or big values are evicted. Consider a higher "
+            "maxmemory or a lower write rate.\n");
+    }
+    if (advise_del) {
+        report = sdscat(report,
+            "- Releasing big values blocks the server. Use UNLINK instead "
+            "of DEL, so that big values are freed by a background "
+            "thread.\n");
+    }
+    if (advise_command) {
+        report = sdscat(report,
+            "- Some commands are slow. Check SLOWLOG GET and the p99/p999 "
+            "latencies of INFO commandstats to find them, and avoid O(N) "
+            "commands like KEYS, SORT or SMEMBERS on big values.\n");
+    }
+    return report;
+}
+
+/* ---------------------- Latency command implementation -------------------- */
+
+/* latencyCommand() helper to produce a time-delay reply for all the samples
+ * in memory for the specified time series. */
+static void latencyCommandReplyWithSamples(redisClient *c,
+                                           latencyTimeSeries *ts)
+{
+    void *replylen = addDeferredMultiBulkLength(c);
+    int samples = 0, j;
+
+    for (j = 0; j < LATENCY_TS_LEN; j++) {
+        int i = (ts->idx + j) % LATENCY_TS_LEN;
+
+        if (ts->samples[i].time == 0) continue;
+        addReplyMultiBulkLen(c,2);
+        addReplyLongLong(c,ts->samples[i].time);
+        addReplyLongLong(c,ts->samples[i].latency);
+        samples++;
+    }
+    setDeferredMultiBulkLength(c,replylen,samples);
+}
+
+/* latencyCommand() helper to produce the reply for the LATEST subcommand,
+ * listing the last latency sample for every event type registered so far. */
+static void latencyCommandReplyWithLatestEvents(redisClient *c) {
+    dictIterator *di;
+    dictEntry *de;
+
+    addReplyMultiBulkLen(c,dictSize(server.latency_events));
+    di = dictGetIterator(server.latency_events);
+    while((de = dictNext(di)) != NULL) {
+        char *event = dictGetKey(de);
+        latencyTimeSeries *ts = dictGetVal(de);
+        int last = (ts->idx + LATENCY_TS_LEN - 1) % LATENCY_TS_LEN;
+
+        addReplyMultiBulkLen(c,4);
+        addReplyBulkCString(c,event);
+        addReplyLongLong(c,ts->samples[last].time);
+        addReplyLongLong(c,ts->samples[last].latency);
+        addReplyLongLong(c,ts->max);
+    }
+    dictReleaseIterator(di);
+}
+
+/* LATENCY command implementations.
+ *
+ * LATENCY LATEST: return the latest latency for all the events classes.
+ * LATENCY HISTORY <event>: return time-latency samples for the event class.
+ * LATENCY RESET [event ...]: reset latency data of one or more event classes
+ *                            (default: reset all data for all event classes).
+ * LATENCY DOCTOR: returns a human readable analysis of the latency events.
+ */
+void latencyCommand(redisClient *c) {
+    latencyTimeSeries *ts;
+
+    if (!strcasecmp(c->argv[1]->ptr,"history") && c->argc == 3) {
+        /* LATENCY HISTORY <event> */
+        ts = dictFetchValue(server.latency_events,c->argv[2]->ptr);
+        if (ts == NULL) {
+            addReplyMultiBulkLen(c,0);
+        } else {
+            latencyCommandReplyWithSamples(c,ts);
+        }
+    } else if (!strcasecmp(c->argv[1]->ptr,"latest") && c->argc == 2) {
+        /* LATENCY LATEST */
+        latencyCommandReplyWithLatestEvents(c);
+    } else if (!strcasecmp(c->argv[1]->ptr,"doctor") && c->argc == 2) {
+        /* LATENCY DOCTOR */
+        sds report = createLatencyReport();
+
+        addReplyBulkCBuffer(c,report,sdslen(report));
+        sdsfree(report);
+    } else if (!strcasecmp(c->argv[1]->ptr,"reset") && c->argc >= 2) {
+        /* LATENCY RESET */
+        if (c->argc == 2) {
+            addReplyLongLong(c,latencyResetEvent(NULL));
+        } else {
+            int j, resets = 0;
+
+            for (j = 2; j < c->argc; j++)
+                resets += latencyResetEvent(c->argv[j]->ptr);
+            addReplyLongLong(c,resets);
+        }
+    } else {
+        addReplyError(c,
+            "Unknown LATENCY subcommand or wrong # of args. Try LATEST, HISTORY, RESET, DOCTOR.");
+    }
+}
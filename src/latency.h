@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LATENCY_H
+#define __LATENCY_H
+
+// 每个事件保存的样本数量
+#define LATENCY_TS_LEN 160 /* History length for every monitored event. */
+
+/* Representation of a latency sample: the sampling time and the latency
+ * observed in milliseconds. */
+/*
+ * 延迟样本
+ */
+typedef struct latencySample {
+    // 样本的 UNIX 时间（以秒为单位）
+    int32_t time;       /* We don't use time_t to force 4 bytes usage. */
+    // 延迟，以毫秒为单位
+    uint32_t latency;   /* Latency in milliseconds. */
+} latencySample;
+
+/* The latency time series for a given event. */
+/*
+ * 事件的延迟时间序列，以环形数组保存最近的 LATENCY_TS_LEN 个样本
+ */
+typedef struct latencyTimeSeries {
+    // 下一个样本的保存位置
+    int idx;            /* Index of the next sample to store. */
+    // 重置之后出现过的最大延迟
+    uint32_t max;       /* Max latency observed for this event. */
+    latencySample samples[LATENCY_TS_LEN]; /* Latest history. */
+} latencyTimeSeries;
+
+/* Statistics about the samples of an event, used by LATENCY DOCTOR. */
+/*
+ * 事件延迟的统计信息
+ */
+typedef struct latencyStats {
+    uint32_t all_time_high; /* Absolute max observed since latest reset. */
+    uint32_t avg;           /* Average of current samples. */
+    uint32_t min;           /* Min of current samples. */
+    uint32_t max;           /* Max of current samples. */
+    uint32_t mad;           /* Mean absolute deviation. */
+    uint32_t samples;       /* Number of non-zero samples. */
+    time_t period;          /* Seconds between the first sample and now. */
+} latencyStats;
+
+/* Exported API */
+void latencyMonitorInit(void);
+void latencyAddSample(char *event, long long latency);
+
+/* Exported commands */
+void latencyCommand(redisClient *c);
+
+/* Latency monitoring macros. The time is only taken when the monitor is
+ * enabled (latency-monitor-threshold greater than zero), so the macros are
+ * almost free otherwise.
+ *
+ * 只有在延迟监视器开启时才会获取时间 */
+
+/* Start monitoring an event. We just set the current time. */
+#define latencyStartMonitor(var) if (server.latency_monitor_threshold) { \
+    var = mstime(); \
+} else { \
+    var = 0; \
+}
+
+/* End monitoring an event, compute the difference with the current time
+ * to check the amount of time elapsed. */
+#define latencyEndMonitor(var) if (server.latency_monitor_threshold) { \
+    var = mstime() - var; \
+}
+
+/* Add the sample only if the elapsed time is >= to the configured threshold. */
+#define latencyAddSampleIfNeeded(event,var) \
+    if (server.latency_monitor_threshold && \
+        (var) >= server.latency_monitor_threshold) \
+          latencyAddSample((event),(var));
+
+#endif /* __LATENCY_H */
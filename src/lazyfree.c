@@ -0,0 +1,254 @@
+/* Lazy freeing of values and databases.
+ *
+ * 惰性删除：在主线程中把键从数据库中解除关联，
+ * 然后把释放值对象（或者整个数据库）的工作交给后台的 bio 线程执行。
+ *
+ * Deleting a key holding a big aggregate value, or flushing a whole DB,
+ * requires to free every single element of the value, blocking the server
+ * for a long time. The functions in this file unlink the key (or swap the
+ * database dictionaries with new empty ones) in the main thread, and queue
+ * a REDIS_BIO_LAZY_FREE job so that the memory is reclaimed by a bio thread.
+ *
+ * Small values are still freed synchronously, since queueing a job would
+ * cost more than freeing them. Reference counts are not atomic, so the bio
+ * thread must never release objects that the main thread can still reach:
+ * only values sharing no object with the rest of the server are handed to
+ * it, see lazyfreeObjectIsPrivate(). Shared objects like small integers
+ * are fine in flushed databases, as their reference count is never
+ * modified (see makeObjectShared()), and the reply lists and the slow log
+ * take copies of the objects instead of references.
+ *
+ * Lazy freeing relies on atomic builtins (HAVE_ATOMIC) for the counter of
+ * objects waiting to be freed: without them everything is freed
+ * synchronously as before.
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "redis.h"
+#include "bio.h"
+
+void SlotToKeyDel(robj *key);
+
+/* Number of objects queued for freeing and not yet released by the bio
+ * thread. Updated by both threads, so atomic builtins are used. */
+// 等待后台线程释放的对象数量
+static size_t lazyfree_objects = 0;
+
+/* Return the amount of work needed in order to free an object: the number
+ * of allocations for aggregate values using a non compact encoding (for
+ * lists, the number of quicklist nodes), and 1 for everything else, that
+ * is a single allocation (strings, ziplists, intsets). */
+/*
+ * 返回释放给定对象所需的工作量
+ *
+ * 对于非紧凑编码的聚合对象，返回其元素数量（列表返回 quicklist 的节点数量），
+ * 其他对象（字符串、ziplist 、intset）只需一次释放，返回 1
+ */
+size_t lazyfreeGetFreeEffort(robj *obj) {
+    if (obj->type == REDIS_LIST && obj->encoding == REDIS_ENCODING_QUICKLIST) {
+        return ((quicklist*)obj->ptr)->len;
+    } else if (obj->type == REDIS_SET && obj->encoding == REDIS_ENCODING_HT) {
+        return dictSize((dict*)obj->ptr);
+    } else if (obj->type == REDIS_ZSET &&
+               obj->encoding == REDIS_ENCODING_SKIPLIST)
+    {
+        return ((zset*)obj->ptr)->zsl->length;
+    } else if (obj->type == REDIS_HASH && obj->encoding == REDIS_ENCODING_HT) {
+        return dictSize((dict*)obj->ptr);
+    } else {
+        return 1;
+    }
+}
+
+/* Return 1 if no element of the value is referenced by anything else than
+ * the value itself, so that a bio thread can release it without racing
+ * with the main thread on the reference counts. Elements may be shared
+ * objects, be stored into other keys by SUNIONSTORE and similar commands,
+ * or be kept by the argv of a command still running, like a MULTI
+ * transaction. Values with a compact encoding contain no objects at all.
+ * Only the reference counts are read, so checking a value costs a fraction
+ * of releasing it. */
+/*
+ * 如果值对象的所有元素都只被值对象本身引用，那么返回 1 ，
+ * 此时后台线程可以安全地释放它。
+ *
+ * 元素可能是共享对象，可能被 SUNIONSTORE 等命令保存到了其他键中，
+ * 也可能被正在执行的命令（比如 MULTI 事务）的参数引用。
+ * 紧凑编码的值对象不包含任何对象。
+ */
+static int lazyfreeObjectIsPrivate(robj *obj) {
+    dictIterator *di;
+    dictEntry *de;
+    dict *d;
+    int private = 1, refcount = 1;
+
+    if ((obj->type == REDIS_SET || obj->type == REDIS_HASH) &&
+        obj->encoding == REDIS_ENCODING_HT)
+    {
+        d = obj->ptr;
+    } else if (obj->type == REDIS_ZSET &&
+               obj->encoding == REDIS_ENCODING_SKIPLIST)
+    {
+        d = ((zset*)obj->ptr)->dict;
+        // 有序集合的元素同时被字典和跳跃表引用
+        refcount = 2;
+    } else {
+        return 1;
+    }
+
+    di = dictGetIterator(d);
+    while(private && (de = dictNext(di)) != NULL) {
+        robj *ele = dictGetKey(de);
+
+        if (ele->refcount != refcount) private = 0;
+        // 哈希的值也是对象
+        if (obj->type == REDIS_HASH &&
+            ((robj*)dictGetVal(de))->refcount != 1) private = 0;
+    }
+    dictReleaseIterator(di);
+    return private;
+}
+
+/* Delete a key, value, and associated expiration entry if any, from the DB.
+ * If the value is composed of a few allocations, it is freed synchronously
+ * as dbDelete() would do, otherwise it is released by a bio thread. */
+/*
+ * 从数据库中删除 key 、值以及过期时间（如果有的话）
+ *
+ * 如果值对象的释放工作量超过 REDIS_LAZYFREE_THRESHOLD ，
+ * 那么值对象交给后台线程释放，否则和 dbDelete() 一样同步释放
+ */
+int dbAsyncDelete(redisDb *db, robj *key) {
+#ifdef HAVE_ATOMIC
+    dictEntry *de;
+
+    /* Deleting an entry from the expires dict will not free the sds of
+     * the key, because it is shared with the main dictionary. */
+    // 先删除过期时间
+    if (dictSize(db->expires) > 0) dictDelete(db->expires,key->ptr);
+
+    de = dictFind(db->dict,key->ptr);
+    if (de) {
+        robj *val = dictGetVal(de);
+        size_t free_effort = lazyfreeGetFreeEffort(val);
+
+        /* Values with other references (for example a value just stored
+         * by a command still holding it in argv), or containing objects
+         * referenced elsewhere, are freed by their last owner as usual. */
+        // 值对象足够大，并且它和它的元素都没有被其他地方引用，交给后台线程释放
+        if (free_effort > REDIS_LAZYFREE_THRESHOLD && val->refcount == 1 &&
+            lazyfreeObjectIsPrivate(val))
+        {
+            __sync_add_and_fetch(&lazyfree_objects,1);
+            bioCreateBackgroundJob(REDIS_BIO_LAZY_FREE,val,NULL,NULL);
+            // 字典的值析构函数会跳过 NULL 值
+            dictSetVal(db->dict,de,NULL);
+        }
+    }
+
+    // 删除 key （以及留在字典中的值）
+    if (dictDelete(db->dict,key->ptr) == DICT_OK) {
+        if (server.cluster_enabled) SlotToKeyDel(key);
+        return 1;
+    } else {
+        return 0;
+    }
+#else
+    return dbDelete(db,key);
+#endif
+}
+
+/* Empty a Redis DB asynchronously: the main and expires dictionaries are
+ * replaced by new empty ones, and the old ones are released by a bio
+ * thread. Returns the number of keys removed.
+ *
+ * The values are not checked one by one as dbAsyncDelete() does, that
+ * would take as long as releasing them: objects shared among values of
+ * the flushed databases are all released by the same bio thread, and the
+ * only objects shared with the rest of the server are shared objects.
+ * FLUSHDB and FLUSHALL never call it inside MULTI/EXEC, where the argv of
+ * the queued commands may reference values of the databases. */
+/*
+ * 异步地清空数据库
+ *
+ * 用新的空字典替换数据库的键空间和过期字典，旧字典交给后台线程释放
+ *
+ * 返回被删除 key 的数量
+ */
+long long emptyDbAsync(redisDb *db) {
+    long long removed = dictSize(db->dict);
+#ifdef HAVE_ATOMIC
+    dict *oldht1 = db->dict, *oldht2 = db->expires;
+
+    db->dict = dictCreate(&dbDictType,NULL);
+    db->expires = dictCreate(&keyptrDictType,NULL);
+    __sync_add_and_fetch(&lazyfree_objects,(size_t)removed);
+    bioCreateBackgroundJob(REDIS_BIO_LAZY_FREE,NULL,oldht1,oldht2);
+#else
+    dictEmpty(db->dict);
+    dictEmpty(db->expires);
+#endif
+    return removed;
+}
+
+/* Return the number of objects queued for freeing and not yet released. */
+// 返回等待后台线程释放的对象数量
+size_t lazyfreeGetPendingObjectsCount(void) {
+#ifdef HAVE_ATOMIC
+    return __sync_add_and_fetch(&lazyfree_objects,0);
+#else
+    return lazyfree_objects;
+#endif
+}
+
+/* Release an object from the bio thread. Called by bio.c. */
+// 在后台线程中释放对象，由 bio.c 调用
+void lazyfreeFreeObjectFromBioThread(robj *o) {
+    decrRefCount(o);
+#ifdef HAVE_ATOMIC
+    __sync_sub_and_fetch(&lazyfree_objects,1);
+#endif
+}
+
+/* Release the main and expires dictionaries of a flushed DB from the bio
+ * thread. Called by bio.c. */
+// 在后台线程中释放被清空数据库的两个字典，由 bio.c 调用
+void lazyfreeFreeDatabaseFromBioThread(dict *ht1, dict *ht2) {
+    size_t numkeys = dictSize(ht1);
+
+    dictRelease(ht1);
+    dictRelease(ht2);
+#ifdef HAVE_ATOMIC
+    __sync_sub_and_fetch(&lazyfree_objects,numkeys);
+#else
+    REDIS_NOTUSED(numkeys);
+#endif
+}
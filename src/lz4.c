@@ -0,0 +1,247 @@
+/* LZ4 block format compression.
+ *
+ * LZ4 块格式压缩算法的实现。
+ *
+ * A compressed block is a sequence of "sequences": every sequence starts
+ * with a token byte, whose high nibble is the number of literals and whose
+ * low nibble is the match length minus 4 (the minimum match). A nibble of
+ * 15 means the length continues in the following bytes, each adding up to
+ * 255. The literals follow, then the offset of the match as a 16 bit little
+ * endian integer, then the rest of the match length if any. The last
+ * sequence only has literals: as required by the format the last 5 bytes
+ * are always literals and no match starts in the last 12 bytes.
+ *
+ * The compressor is a greedy single pass matcher using a hash table of
+ * 4 bytes sequences, sized according to the input length so that the
+ * small strings found in a RDB file do not pay for clearing a big table.
+ *
+ * ----------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lz4.h"
+
+#define LZ4_MINMATCH 4
+#define LZ4_LASTLITERALS 5  /* The last 5 bytes are always literals. */
+#define LZ4_MFLIMIT 12      /* No match can start in the last 12 bytes. */
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_MAX_HASHLOG 13
+#define LZ4_SKIP_TRIGGER 6  /* Speed up the scan of incompressible data. */
+
+static inline uint32_t lz4Read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+static inline uint64_t lz4Read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+static inline unsigned int lz4Hash(uint32_t seq, int hashlog) {
+    return (seq * 2654435761U) >> (32 - hashlog);
+}
+
+/* Write the extra bytes of a length that does not fit into a nibble. */
+static inline unsigned char *lz4WriteLength(unsigned char *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char) len;
+    return op;
+}
+
+/* Read the extra bytes of a length, returns NULL on truncated input. */
+static inline const unsigned char *lz4ReadLength(const unsigned char *ip,
+    const unsigned char *iend, size_t *len)
+{
+    unsigned char b;
+
+    do {
+        if (ip >= iend) return NULL;
+        b = *ip++;
+        *len += b;
+    } while (b == 255);
+    return ip;
+}
+
+/* Emit a sequence made of the literals [anchor, anchor+litlen) followed by a
+ * match of 'mlen' bytes at distance 'offset' (mlen == 0 for the last
+ * sequence). Returns NULL if the output buffer is too small. */
+static unsigned char *lz4WriteSequence(unsigned char *op, unsigned char *oend,
+    const unsigned char *anchor, size_t litlen, size_t offset, size_t mlen)
+{
+    unsigned char *token;
+
+    /* Token + literals with their length + offset + match length. */
+    if ((size_t)(oend - op) < 1 + litlen + litlen/255 + 1 + 2 + mlen/255 + 1)
+        return NULL;
+
+    token = op++;
+    if (litlen >= 15) {
+        *token = 15 << 4;
+        op = lz4WriteLength(op,litlen - 15);
+    } else {
+        *token = (unsigned char) (litlen << 4);
+    }
+    memcpy(op,anchor,litlen);
+    op += litlen;
+    if (mlen == 0) return op;
+
+    *op++ = offset & 0xff;
+    *op++ = (offset >> 8) & 0xff;
+    mlen -= LZ4_MINMATCH;
+    if (mlen >= 15) {
+        *token |= 15;
+        op = lz4WriteLength(op,mlen - 15);
+    } else {
+        *token |= (unsigned char) mlen;
+    }
+    return op;
+}
+
+unsigned int lz4_compress(const void *in_data, unsigned int in_len,
+                          void *out_data, unsigned int out_len)
+{
+    const unsigned char *base = in_data, *ip = base, *anchor = base;
+    const unsigned char *iend = base + in_len;
+    const unsigned char *mflimit = iend - LZ4_MFLIMIT;
+    const unsigned char *matchlimit = iend - LZ4_LASTLITERALS;
+    unsigned char *op = out_data, *oend = op + out_len;
+    uint32_t htab[1 << LZ4_MAX_HASHLOG];
+    unsigned int misses;
+    int hashlog = 8;
+
+    /* Too short to contain a match: everything is a literal. */
+    if (in_len < LZ4_MFLIMIT + 1) goto last_literals;
+
+    /* Size the hash table according to the input. */
+    while (hashlog < LZ4_MAX_HASHLOG && (1U << (hashlog+2)) < in_len)
+        hashlog++;
+    memset(htab,0,sizeof(uint32_t) << hashlog);
+
+    ip++;
+    misses = 1 << LZ4_SKIP_TRIGGER;
+    while (ip < mflimit) {
+        const unsigned char *ref;
+        uint32_t seq = lz4Read32(ip);
+        unsigned int h = lz4Hash(seq,hashlog);
+        size_t mlen;
+
+        ref = base + htab[h];
+        htab[h] = ip - base;
+        if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || lz4Read32(ref) != seq) {
+            /* No match: after many consecutive misses the step grows,
+             * so incompressible data is skipped fast. */
+            ip += misses++ >> LZ4_SKIP_TRIGGER;
+            continue;
+        }
+
+        /* Extend the match backward over the pending literals. */
+        while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+
+        /* Extend the match forward, 8 bytes at a time while possible. */
+        mlen = LZ4_MINMATCH;
+        while (ip + mlen + 8 <= matchlimit &&
+               lz4Read64(ip + mlen) == lz4Read64(ref + mlen))
+            mlen += 8;
+        while (ip + mlen < matchlimit && ip[mlen] == ref[mlen]) mlen++;
+
+        op = lz4WriteSequence(op,oend,anchor,ip-anchor,ip-ref,mlen);
+        if (op == NULL) return 0;
+        ip += mlen;
+        anchor = ip;
+        misses = 1 << LZ4_SKIP_TRIGGER;
+
+        /* Index a position inside the match, it helps the next search. */
+        if (ip < mflimit) htab[lz4Hash(lz4Read32(ip-2),hashlog)] = ip-2-base;
+    }
+
+last_literals:
+    op = lz4WriteSequence(op,oend,anchor,iend-anchor,0,0);
+    if (op == NULL) return 0;
+    return op - (unsigned char*) out_data;
+}
+
+unsigned int lz4_decompress(const void *in_data, unsigned int in_len,
+                            void *out_data, unsigned int out_len)
+{
+    const unsigned char *ip = in_data, *iend = ip + in_len;
+    unsigned char *op = out_data, *oend = op + out_len;
+
+    while (ip < iend) {
+        unsigned char token = *ip++;
+        size_t litlen = token >> 4, mlen, offset;
+        const unsigned char *ref;
+
+        /* Literals. */
+        if (litlen == 15 && (ip = lz4ReadLength(ip,iend,&litlen)) == NULL)
+            return 0;
+        if (litlen > (size_t)(iend - ip) || litlen > (size_t)(oend - op))
+            return 0;
+        memcpy(op,ip,litlen);
+        op += litlen;
+        ip += litlen;
+
+        /* The last sequence has no match. */
+        if (ip == iend) break;
+
+        /* Match. */
+        if (iend - ip < 2) return 0;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (unsigned char*)out_data))
+            return 0;
+        mlen = token & 15;
+        if (mlen == 15 && (ip = lz4ReadLength(ip,iend,&mlen)) == NULL)
+            return 0;
+        mlen += LZ4_MINMATCH;
+        if (mlen > (size_t)(oend - op)) return 0;
+
+        ref = op - offset;
+        if (offset >= mlen) {
+            memcpy(op,ref,mlen);
+            op += mlen;
+        } else {
+            /* Overlapping match: repeats the last 'offset' bytes. */
+            while (mlen--) *op++ = *ref++;
+        }
+    }
+    return op - (unsigned char*) out_data;
+}
@@ -0,0 +1,59 @@
+/* LZ4 block format compression.
+ *
+ * LZ4 块格式压缩算法：压缩速度和 LZF 相当或更快，解压速度则快得多。
+ *
+ * A small, self contained implementation of the LZ4 block format, used as
+ * an alternative to LZF for the compression of strings in RDB files and for
+ * the streaming compression of whole RDB files. The output is a valid LZ4
+ * block that any LZ4 decoder can decompress. The API mirrors the one of
+ * lzf_compress() / lzf_decompress().
+ *
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LZ4_H
+#define __LZ4_H
+
+/* Compress 'in_len' bytes from 'in_data' into 'out_data', writing at most
+ * 'out_len' bytes. Returns the compressed length, or 0 if the output buffer
+ * is not large enough (as with LZF, calling it with out_len < in_len makes
+ * sure only data that actually shrinks is returned). */
+unsigned int lz4_compress(const void *in_data, unsigned int in_len,
+                          void *out_data, unsigned int out_len);
+
+/* Decompress a block of 'in_len' bytes produced by lz4_compress() into
+ * 'out_data', writing at most 'out_len' bytes. Returns the decompressed
+ * length, or 0 if the block is corrupted or the output does not fit. */
+unsigned int lz4_decompress(const void *in_data, unsigned int in_len,
+                            void *out_data, unsigned int out_len);
+
+/* Worst case size of the compressed output for 'len' input bytes. */
+#define LZ4_COMPRESS_BOUND(len) ((len) + ((len)/255) + 16)
+
+#endif
@@ -170,8 +170,7 @@ void execCommandReplicateMulti(redisClient *c) {
 
     if (server.aof_state != REDIS_AOF_OFF)
         feedAppendOnlyFile(server.multiCommand,c->db->id,&multistring,1);
-    if (listLength(server.slaves))
-        replicationFeedSlaves(server.slaves,c->db->id,&multistring,1);
+    replicationFeedSlaves(server.slaves,c->db->id,&multistring,1);
     decrRefCount(multistring);
 }
 
@@ -182,7 +181,7 @@ void execCommand(redisClient *c) {
     int j;
     // 用于保存执行命令、命令的参数和参数数量的副本
     robj **orig_argv;
-    int orig_argc;
+    int orig_argc, orig_argv_len;
     struct redisCommand *orig_cmd;
 
     // 只能在 MULTI 已启用的情况下执行
@@ -233,6 +232,7 @@ void execCommand(redisClient *c) {
 
     // 将三个原始参数备份起来
     orig_argv = c->argv;
+    orig_argv_len = c->argv_len;
     orig_argc = c->argc;
     orig_cmd = c->cmd;
     addReplyMultiBulkLen(c,c->mstate.count);
@@ -255,6 +255,7 @@ void execCommand(redisClient *c) {
     }
     // 还原三个原始命令
     c->argv = orig_argv;
+    c->argv_len = orig_argv_len;
     c->argc = orig_argc;
     c->cmd = orig_cmd;
 
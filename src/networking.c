@@ -31,6 +31,10 @@
 #include <sys/uio.h>
 
 static void setProtocolError(redisClient *c, int pos);
+static int clientCanUseIOThreads(redisClient *c);
+static void ioThreadsQueueClient(redisClient *c, int op);
+static void ioThreadsDequeueClient(redisClient *c, int op);
+static int inIOThread(void);
 
 /* To evaluate the output buffer size of a client we need to get size of
  * allocated objects, however we can't used zmalloc_size() directly on sds
@@ -45,6 +49,22 @@ void *dupClientReplyValue(void *o) {
     return o;
 }
 
+/* Release an object of a reply list. Full size reply blocks, tagged by
+ * createReplyBlock(), are put back into the pool of free blocks if there
+ * is room. The pool is not locked, so the I/O threads never touch it. */
+void freeClientReplyValue(void *o) {
+    robj *obj = o;
+
+    if (!inIOThread() && obj->replyblock && obj->refcount == 1 &&
+        listLength(server.reply_blocks) < REDIS_REPLY_BLOCK_POOL_SIZE)
+    {
+        sdsclear(obj->ptr);
+        listAddNodeTail(server.reply_blocks,obj);
+    } else {
+        decrRefCount(obj);
+    }
+}
+
 int listMatchObjects(void *a, void *b) {
     return equalStringObjects(a,b);
 }
@@ -88,12 +108,18 @@ redisClient *createClient(int fd) {
     // 命令及参数
     c->argc = 0;
     c->argv = NULL;
+    c->argv_len = 0;
     c->cmd = c->lastcmd = NULL;
 
     // 回复
     c->multibulklen = 0;
     c->bulklen = -1;
     c->sentlen = 0;
+    c->io_sent_nodes = 0;
+    c->pending_read_node = NULL;
+    c->pending_write_node = NULL;
+    c->aof_wait_seq = 0;
+    c->aof_wait_node = NULL;
 
     // 状态
     c->flags = 0;
@@ -109,6 +135,13 @@ redisClient *createClient(int fd) {
 
     // 附属监听端口
     c->slave_listening_port = 0;
+    c->slave_capa = REDIS_SLAVE_CAPA_NONE;
+
+    // 复制偏移量
+    c->reploff = 0;
+    c->read_reploff = 0;
+    c->psync_initoffset = 0;
+    c->replrunid[0] = '\0';
 
     // 回复
     c->reply = listCreate();
@@ -118,7 +151,7 @@ redisClient *createClient(int fd) {
     c->obuf_soft_limit_reached_time = 0;
 
     // 回复处理函数
-    listSetFreeMethod(c->reply,decrRefCount);
+    listSetFreeMethod(c->reply,freeClientReplyValue);
     listSetDupMethod(c->reply,dupClientReplyValue);
 
     // 阻塞 POP 相关
@@ -136,8 +169,8 @@ redisClient *createClient(int fd) {
     // pubsub
     c->pubsub_channels = dictCreate(&setDictType,NULL);
     c->pubsub_patterns = listCreate();
-    listSetFreeMethod(c->pubsub_patterns,decrRefCount);
-    listSetMatchMethod(c->pubsub_patterns,listMatchObjects);
+    // 链表和字典中的模式记录由 server.pubsub_patterns 负责释放
+    c->pubsub_patterns_dict = dictCreate(&setDictType,NULL);
 
     // 如果不是伪客户端，那么将客户端加入到服务器客户端列表中
     if (fd != -1) listAddNodeTail(server.clients,c);
@@ -177,27 +210,33 @@ redisClient *createClient(int fd) {
 int prepareClientToWrite(redisClient *c) {
     if (c->flags & REDIS_LUA_CLIENT) return REDIS_OK;
     if (c->fd <= 0) return REDIS_ERR; /* Fake client */
-    if (c->bufpos == 0 && listLength(c->reply) == 0 &&
-        (c->replstate == REDIS_REPL_NONE || c->replstate == REDIS_REPL_ONLINE) &&
-        aeCreateFileEvent(server.el, c->fd, AE_WRITABLE, sendReplyToClient, c) == AE_ERR)
-        return REDIS_ERR;
-    return REDIS_OK;
-}
 
-/* Create a duplicate of the last object in the reply list when
- * it is not exclusively owned by the reply list. */
-robj *dupLastObjectIfNeeded(list *reply) {
-    robj *new, *cur;
-    listNode *ln;
-    redisAssert(listLength(reply) > 0);
-    ln = listLast(reply);
-    cur = listNodeValue(ln);
-    if (cur->refcount > 1) {
-        new = dupStringObject(cur);
-        decrRefCount(cur);
-        listNodeValue(ln) = new;
+    /* The query of this client is being processed by the I/O threads:
+     * the main thread will schedule the write once they are done. */
+    // 客户端的读入还在排队中，由主线程在读入完成之后安排写入
+    if (c->flags & REDIS_PENDING_READ) return REDIS_OK;
+
+    /* The reply is held until the AOF thread wrote the client writes:
+     * the write is scheduled by scheduleClientReplyWrite(). */
+    // 回复需要等待 AOF 写入完成
+    if (c->flags & REDIS_AOF_WAIT) return REDIS_OK;
+
+    if (c->bufpos == 0 && listLength(c->reply) == 0 &&
+        (c->replstate == REDIS_REPL_NONE || c->replstate == REDIS_REPL_ONLINE))
+    {
+        /* With threaded I/O the write is performed by the I/O threads
+         * just before returning to the event loop. */
+        // 使用 I/O 线程时，将客户端放入待写入队列，
+        // 在进入事件循环之前由 I/O 线程写出回复
+        if (clientCanUseIOThreads(c)) {
+            ioThreadsQueueClient(c,REDIS_IO_THREADS_OP_WRITE);
+            return REDIS_OK;
+        }
+        if (aeCreateFileEvent(server.el, c->fd, AE_WRITABLE,
+                sendReplyToClient, c) == AE_ERR)
+            return REDIS_ERR;
     }
-    return listNodeValue(ln);
+    return REDIS_OK;
 }
 
 /* -----------------------------------------------------------------------------
@@ -233,47 +272,124 @@ int _addReplyToBuffer(redisClient *c, char *s, size_t len) {
     return REDIS_OK;
 }
 
-/*
- * 将回复对象所保存的值添加到回复列表 c->reply 末尾
- */
-void _addReplyObjectToList(redisClient *c, robj *o) {
-    robj *tail;
+/* Replies that don't fit the static buffer of the client are copied into
+ * reply blocks: string objects with a preallocated sds, chained in the
+ * c->reply list and filled in place, so that there is an allocation every
+ * block and not every reply. The first block is sized to the reply that
+ * needs it, and every next block doubles the previous one up to
+ * REDIS_REPLY_BLOCK_BYTES, so that a small reply just past the static
+ * buffer is not charged a whole block. Full size blocks are tagged with
+ * the replyblock flag of the object: once written they are put back into
+ * a small pool shared by all the clients, and reused by the next big
+ * replies. The pool belongs to the main thread: replies added by the I/O
+ * threads (protocol errors found while parsing) always allocate their
+ * blocks.
+ *
+ * Sds strings of at least REDIS_SHARED_REPLY_MIN_LEN bytes are not copied:
+ * the reply list takes them as they are, and the blocks go on after them.
+ * Objects are copied whatever their size, see _addReplyObjectToList(),
+ * with the exception of the ones sent by addReplyShared().
+ *
+ * 无法放入客户端静态缓存的回复会被复制到回复块中：
+ * 回复块是预先分配了 sds 空间的字符串对象，
+ * 它们按顺序保存在 c->reply 链表中，并被原地填充，
+ * 因此每个回复块只需要一次内存分配，而不是每个回复一次。
+ * 第一个回复块的大小由需要它的回复决定，之后每个回复块的大小翻倍，
+ * 直到 REDIS_REPLY_BLOCK_BYTES 为止。
+ * 完整大小的回复块带有 replyblock 标志，
+ * 它们在写出之后会被放回一个所有客户端共享的小型池中，供之后的回复重用。
+ * 这个池只由主线程使用，I/O 线程总是直接分配回复块。
+ *
+ * 长度不小于 REDIS_SHARED_REPLY_MIN_LEN 字节的 sds 不会被复制，
+ * 而是直接添加到回复链表中。
+ * 除了 addReplyShared() 发送的对象之外，对象无论大小总是会被复制。 */
+
+/* Return an empty reply block for 'len' more bytes, following a block of
+ * 'prev' bytes (0 if there is none). Full size blocks are taken from the
+ * pool if possible. */
+static robj *createReplyBlock(size_t len, size_t prev) {
+    size_t size = prev*2;
+    struct sdshdr *sh;
+    robj *o;
 
-    // 服务端已被关闭
-    if (c->flags & REDIS_CLOSE_AFTER_REPLY) return;
+    if (size < len) size = len;
+    if (size < REDIS_REPLY_BLOCK_MIN_BYTES) size = REDIS_REPLY_BLOCK_MIN_BYTES;
+    if (size > REDIS_REPLY_BLOCK_BYTES) size = REDIS_REPLY_BLOCK_BYTES;
 
-    // 空链表
-    if (listLength(c->reply) == 0) {
-        // 创建新表尾
-        incrRefCount(o);
-        listAddNodeTail(c->reply,o);
-        // 更新总字节数
-        c->reply_bytes += zmalloc_size_sds(o->ptr);
+    if (size == REDIS_REPLY_BLOCK_BYTES && !inIOThread()) {
+        listNode *ln = listFirst(server.reply_blocks);
 
-    // 非空链表
-    } else {
-        // 取出原有表尾
-        tail = listNodeValue(listLast(c->reply));
-
-        /* Append to this object when possible. */
-        // 如果最后一个节点所保存的回复，加上新回复，
-        // 内容总长度小于等于 REDIS_REPLY_CHUNK_BYTES 
-        // 那么将新回复追加到节点回复当中。
-        if (tail->ptr != NULL &&
-            sdslen(tail->ptr)+sdslen(o->ptr) <= REDIS_REPLY_CHUNK_BYTES)
+        if (ln != NULL) {
+            o = listNodeValue(ln);
+            listDelNode(server.reply_blocks,ln);
+            return o;
+        }
+    }
+
+    /* The block is not zeroed, unlike sdsnewlen(NULL,...) would do. */
+    sh = zmalloc(sizeof(struct sdshdr)+size+1);
+    sh->len = 0;
+    sh->free = size;
+    sh->buf[0] = '\0';
+    o = createObject(REDIS_STRING,sh->buf);
+    // 只有完整大小的回复块可以放回池中
+    if (size == REDIS_REPLY_BLOCK_BYTES) o->replyblock = 1;
+    return o;
+}
+
+/* Copy 'len' bytes at 's' to the end of the reply list, filling the free
+ * space of the last node and then new reply blocks. */
+/*
+ * 将 s 的 len 个字节复制到回复链表的末尾，
+ * 先填充最后一个节点的空闲空间，然后再使用新的回复块。
+ */
+static void _addReplyToBlocks(redisClient *c, const char *s, size_t len) {
+    robj *tail = NULL;
+
+    if (listLength(c->reply)) tail = listNodeValue(listLast(c->reply));
+    while(len) {
+        size_t avail;
+
+        /* EMBSTR objects can't be modified, and objects shared with
+         * something else (other clients, the keyspace) must not, so only
+         * RAW tails owned by the reply list are filled. */
+        // 只有回复链表独占的 RAW 表尾才能被填充
+        if (tail == NULL || tail->ptr == NULL ||
+            tail->encoding != REDIS_ENCODING_RAW || tail->refcount != 1 ||
+            sdsavail(tail->ptr) == 0)
         {
-            c->reply_bytes -= zmalloc_size_sds(tail->ptr);
-            tail = dupLastObjectIfNeeded(c->reply);
-            tail->ptr = sdscatlen(tail->ptr,o->ptr,sdslen(o->ptr));
-            c->reply_bytes += zmalloc_size_sds(tail->ptr);
-        
-        // 否则，为新回复单独创建一个节点
-        } else {
-            incrRefCount(o);
-            listAddNodeTail(c->reply,o);
-            c->reply_bytes += zmalloc_size_sds(o->ptr);
+            size_t prev = 0;
+
+            if (tail && tail->ptr && tail->encoding == REDIS_ENCODING_RAW)
+                prev = sdslen(tail->ptr)+sdsavail(tail->ptr);
+            tail = createReplyBlock(len,prev);
+            listAddNodeTail(c->reply,tail);
+            c->reply_bytes += getStringObjectSdsUsedMemory(tail);
         }
+
+        avail = sdsavail(tail->ptr);
+        if (avail > len) avail = len;
+        memcpy((char*)tail->ptr+sdslen(tail->ptr),s,avail);
+        sdsIncrLen(tail->ptr,avail);
+        s += avail;
+        len -= avail;
     }
+}
+
+/* The object is always copied, even when big: the reply list never takes
+ * references to objects that may be stored into keys, otherwise a bio
+ * thread releasing a value lazily would race with the main thread on their
+ * reference counts. */
+/*
+ * 将回复对象所保存的值复制到回复列表 c->reply 末尾
+ *
+ * 即使是大对象也会被复制，回复链表不会引用数据库中的对象
+ */
+void _addReplyObjectToList(redisClient *c, robj *o) {
+    // 服务端已被关闭
+    if (c->flags & REDIS_CLOSE_AFTER_REPLY) return;
+
+    _addReplyToBlocks(c,o->ptr,sdslen(o->ptr));
 
     // 如果突破了客户端的最大缓存限制，那么关闭客户端
     asyncCloseClientOnOutputBufferLimitReached(c);
@@ -285,33 +401,18 @@ void _addReplyObjectToList(redisClient *c, robj *o) {
  * 将 sds 添加到回复列表末尾
  */
 void _addReplySdsToList(redisClient *c, sds s) {
-    robj *tail;
-
     if (c->flags & REDIS_CLOSE_AFTER_REPLY) {
         sdsfree(s);
         return;
     }
 
     // 添加到列表
-    if (listLength(c->reply) == 0) {
+    if (sdslen(s) >= REDIS_SHARED_REPLY_MIN_LEN) {
         listAddNodeTail(c->reply,createObject(REDIS_STRING,s));
         c->reply_bytes += zmalloc_size_sds(s);
     } else {
-        tail = listNodeValue(listLast(c->reply));
-
-        /* Append to this object when possible. */
-        if (tail->ptr != NULL &&
-            sdslen(tail->ptr)+sdslen(s) <= REDIS_REPLY_CHUNK_BYTES)
-        {
-            c->reply_bytes -= zmalloc_size_sds(tail->ptr);
-            tail = dupLastObjectIfNeeded(c->reply);
-            tail->ptr = sdscatlen(tail->ptr,s,sdslen(s));
-            c->reply_bytes += zmalloc_size_sds(tail->ptr);
-            sdsfree(s);
-        } else {
-            listAddNodeTail(c->reply,createObject(REDIS_STRING,s));
-            c->reply_bytes += zmalloc_size_sds(s);
-        }
+        _addReplyToBlocks(c,s,sdslen(s));
+        sdsfree(s);
     }
 
     // 检查缓存大小限制
@@ -322,34 +423,10 @@ void _addReplySdsToList(redisClient *c, sds s) {
  * 将字符串添加到列表表尾
  */
 void _addReplyStringToList(redisClient *c, char *s, size_t len) {
-    robj *tail;
-
     if (c->flags & REDIS_CLOSE_AFTER_REPLY) return;
 
     // 添加到列表
-    if (listLength(c->reply) == 0) {
-        robj *o = createStringObject(s,len);
-
-        listAddNodeTail(c->reply,o);
-        c->reply_bytes += zmalloc_size_sds(o->ptr);
-    } else {
-        tail = listNodeValue(listLast(c->reply));
-
-        /* Append to this object when possible. */
-        if (tail->ptr != NULL &&
-            sdslen(tail->ptr)+len <= REDIS_REPLY_CHUNK_BYTES)
-        {
-            c->reply_bytes -= zmalloc_size_sds(tail->ptr);
-            tail = dupLastObjectIfNeeded(c->reply);
-            tail->ptr = sdscatlen(tail->ptr,s,len);
-            c->reply_bytes += zmalloc_size_sds(tail->ptr);
-        } else {
-            robj *o = createStringObject(s,len);
-
-            listAddNodeTail(c->reply,o);
-            c->reply_bytes += zmalloc_size_sds(o->ptr);
-        }
-    }
+    _addReplyToBlocks(c,s,len);
 
     // 检查缓存大小限制
     asyncCloseClientOnOutputBufferLimitReached(c);
@@ -376,7 +453,7 @@ void addReply(redisClient *c, robj *obj) {
      * If the encoding is RAW and there is room in the static buffer
      * we'll be able to send the object to the client without
      * messing with its page. */
-    if (obj->encoding == REDIS_ENCODING_RAW) {
+    if (sdsEncodedObject(obj)) {
         // 如果 c->reply 链表中没有节点，并且缓存空间足够，
         // 那么将内容追加到 c->buf 的后部
         if (_addReplyToBuffer(c,obj->ptr,sdslen(obj->ptr)) != REDIS_OK)
@@ -410,6 +487,40 @@ void addReply(redisClient *c, robj *obj) {
     }
 }
 
+/* Add a reply that is built once and sent to many clients, like the
+ * messages PUBLISH sends to the subscribers. Unless it is small, the object
+ * is never copied: the reply list of every client takes a reference to it,
+ * and the socket is written straight from the shared sds.
+ *
+ * Every client is charged for the whole object in its output buffer usage,
+ * as the object stays in memory until the slowest of them consumed it.
+ *
+ * 添加一个只创建一次、但发送给多个客户端的回复，比如 PUBLISH 发送给订阅者的消息。
+ *
+ * 除非回复很小，否则它的内容不会被复制：
+ * 每个客户端的回复链表只保存它的一个引用，写入套接字时直接使用共享的 sds 。
+ *
+ * 每个客户端的输出缓存用量都包含整个对象的大小，
+ * 因为对象会一直留在内存中，直到最慢的客户端也读取了它为止。 */
+void addReplyShared(redisClient *c, robj *obj) {
+    redisAssert(obj->encoding == REDIS_ENCODING_RAW);
+
+    if (sdslen(obj->ptr) < REDIS_SHARED_REPLY_MIN_LEN) {
+        addReply(c,obj);
+        return;
+    }
+    if (prepareClientToWrite(c) != REDIS_OK) return;
+    if (c->flags & REDIS_CLOSE_AFTER_REPLY) return;
+
+    /* The static buffer is always sent before the reply list, so the
+     * reference can be queued even if the buffer has room for the object. */
+    incrRefCount(obj);
+    listAddNodeTail(c->reply,obj);
+    c->reply_bytes += getStringObjectSdsUsedMemory(obj);
+
+    asyncCloseClientOnOutputBufferLimitReached(c);
+}
+
 /*
  * 添加 sds 回复
  *
@@ -532,25 +643,33 @@ void *addDeferredMultiBulkLength(redisClient *c) {
 void setDeferredMultiBulkLength(redisClient *c, void *node, long length) {
     listNode *ln = (listNode*)node;
     robj *len, *next;
+    char lenstr[128];
+    size_t lenlen;
 
     /* Abort when *node is NULL (see addDeferredMultiBulkLength). */
     if (node == NULL) return;
 
-    len = listNodeValue(ln);
-    len->ptr = sdscatprintf(sdsempty(),"*%ld\r\n",length);
-    c->reply_bytes += zmalloc_size_sds(len->ptr);
+    lenlen = snprintf(lenstr,sizeof(lenstr),"*%ld\r\n",length);
     if (ln->next != NULL) {
         next = listNodeValue(ln->next);
 
-        /* Only glue when the next node is non-NULL (an sds in this case) */
-        if (next->ptr != NULL) {
-            c->reply_bytes -= zmalloc_size_sds(len->ptr);
-            c->reply_bytes -= zmalloc_size_sds(next->ptr);
-            len->ptr = sdscatlen(len->ptr,next->ptr,sdslen(next->ptr));
-            c->reply_bytes += zmalloc_size_sds(len->ptr);
-            listDelNode(c->reply,ln->next);
+        /* Glue the length in place in front of the next node when it is a
+         * block (or any RAW object owned by the reply list) with enough
+         * free space, dropping the placeholder node. */
+        // 如果下一个节点有足够的空闲空间，那么将长度原地写入到它的前面
+        if (next->ptr != NULL && next->encoding == REDIS_ENCODING_RAW &&
+            next->refcount == 1 && sdsavail(next->ptr) >= lenlen)
+        {
+            memmove((char*)next->ptr+lenlen,next->ptr,sdslen(next->ptr));
+            memcpy(next->ptr,lenstr,lenlen);
+            sdsIncrLen(next->ptr,lenlen);
+            listDelNode(c->reply,ln);
+            return;
         }
     }
+    len = listNodeValue(ln);
+    len->ptr = sdsnewlen(lenstr,lenlen);
+    c->reply_bytes += zmalloc_size_sds(len->ptr);
     asyncCloseClientOnOutputBufferLimitReached(c);
 }
 
@@ -615,7 +734,7 @@ void addReplyMultiBulkLen(redisClient *c, long length) {
 void addReplyBulkLen(redisClient *c, robj *obj) {
     size_t len;
 
-    if (obj->encoding == REDIS_ENCODING_RAW) {
+    if (sdsEncodedObject(obj)) {
         len = sdslen(obj->ptr);
     } else {
         long n = (long)obj->ptr;
@@ -761,16 +880,35 @@ void acceptUnixHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
 /*
  * 释放客户端参数
  */
-static void freeClientArgv(redisClient *c) {
+void freeClientArgv(redisClient *c) {
     int j;
 
     for (j = 0; j < c->argc; j++)
         decrRefCount(c->argv[j]);
 
+    /* The argv array is reused by the next command, unless an unusually
+     * long command made it big. */
+    // argv 数组留给下一个命令使用，除非它太大
+    if (c->argv_len > REDIS_ARGV_POOL_MAX) {
+        zfree(c->argv);
+        c->argv = NULL;
+        c->argv_len = 0;
+    }
+
     c->argc = 0;
     c->cmd = NULL;
 }
 
+/* Reset the state of the protocol parser. Every path that abandons or
+ * completes the parsing of a command calls it.
+ *
+ * 重置协议分析器的状态。 */
+void resetClientParser(redisClient *c) {
+    c->reqtype = 0;
+    c->multibulklen = 0;
+    c->bulklen = -1;
+}
+
 /* Close all the slaves connections. This is useful in chained replication
  * when we resync with our own master and want to force all our slaves to
  * resync with us as well. */
@@ -790,6 +928,25 @@ void freeClient(redisClient *c) {
     /* If this is marked as current client unset it */
     if (server.current_client == c) server.current_client = NULL;
 
+    /* If it is our master that's beging disconnected we should make sure
+     * to cache the state to try a partial resynchronization later.
+     *
+     * Note that before doing this we make sure that the client is not in
+     * some unexpected state, by checking its flags. */
+    // 如果断开的是主节点，那么缓存它的状态，以便之后尝试部分重同步
+    if (server.master && c->flags & REDIS_MASTER) {
+        redisLog(REDIS_WARNING,"Connection with master lost.");
+        if (!(c->flags & (REDIS_CLOSE_AFTER_REPLY|
+                          REDIS_CLOSE_ASAP|
+                          REDIS_BLOCKED|
+                          REDIS_UNBLOCKED|
+                          REDIS_PRE_PSYNC)))
+        {
+            replicationCacheMaster(c);
+            return;
+        }
+    }
+
     /* Note that if the client we are freeing is blocked into a blocking
      * call, we have to set querybuf to NULL *before* to call
      * unblockClientWaitingData() to avoid processInputBuffer() will get
@@ -809,16 +966,23 @@ void freeClient(redisClient *c) {
     pubsubUnsubscribeAllPatterns(c,0);
     dictRelease(c->pubsub_channels);
     listRelease(c->pubsub_patterns);
-    /* Obvious cleanup */
-    aeDeleteFileEvent(server.el,c->fd,AE_READABLE);
-    aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+    dictRelease(c->pubsub_patterns_dict);
+    /* Obvious cleanup. A cached master has no socket. */
+    if (c->fd != -1) {
+        aeDeleteFileEvent(server.el,c->fd,AE_READABLE);
+        aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+        close(c->fd);
+    }
     listRelease(c->reply);
     freeClientArgv(c);
-    close(c->fd);
-    /* Remove from the list of clients */
-    ln = listSearchKey(server.clients,c);
-    redisAssert(ln != NULL);
-    listDelNode(server.clients,ln);
+    resetClientParser(c);
+    /* Remove from the list of clients. The cached master was already
+     * removed by replicationCacheMaster(). */
+    if (c != server.cached_master) {
+        ln = listSearchKey(server.clients,c);
+        redisAssert(ln != NULL);
+        listDelNode(server.clients,ln);
+    }
     /* When client was just unblocked because of a blocking operation,
      * remove it from the list with unblocked clients. */
     if (c->flags & REDIS_UNBLOCKED) {
@@ -836,20 +1000,14 @@ void freeClient(redisClient *c) {
         ln = listSearchKey(l,c);
         redisAssert(ln != NULL);
         listDelNode(l,ln);
+        // 记录最后一个附属节点断开的时间，用于释放复制积压缓冲区
+        if (!(c->flags & REDIS_MONITOR) && listLength(server.slaves) == 0)
+            server.repl_no_slaves_since = server.unixtime;
     }
 
     /* Case 2: we lost the connection with the master. */
-    if (c->flags & REDIS_MASTER) {
-        server.master = NULL;
-        server.repl_state = REDIS_REPL_CONNECT;
-        server.repl_down_since = server.unixtime;
-        /* We lost connection with our master, force our slaves to resync
-         * with us as well to load the new data set.
-         *
-         * If server.masterhost is NULL the user called SLAVEOF NO ONE so
-         * slave resync is not needed. */
-        if (server.masterhost != NULL) disconnectSlaves();
-    }
+    if (c->flags & REDIS_MASTER && c == server.master)
+        replicationHandleMasterDisconnection();
 
     /* If this client was scheduled for async freeing we need to remove it
      * from the queue. */
@@ -859,6 +1017,14 @@ void freeClient(redisClient *c) {
         listDelNode(server.clients_to_close,ln);
     }
 
+    /* Remove the client from the queues of the I/O threads. */
+    // 将客户端从 I/O 线程的读写队列中删除
+    ioThreadsDequeueClient(c,REDIS_IO_THREADS_OP_READ);
+    ioThreadsDequeueClient(c,REDIS_IO_THREADS_OP_WRITE);
+
+    /* Remove the client from the clients waiting for AOF writes. */
+    if (c->flags & REDIS_AOF_WAIT) aofUnlinkWaitingClient(c);
+
     /* Release memory */
     zfree(c->argv);
     freeClientMultiState(c);
@@ -886,60 +1052,115 @@ void freeClientsInAsyncFreeQueue(void) {
     }
 }
 
-/*
- * 将所有回复发送到客户端
- */
-void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
-    redisClient *c = privdata;
-    int nwritten = 0, totwritten = 0, objlen;
-    size_t objmem;
-    robj *o;
-    REDIS_NOTUSED(el);
-    REDIS_NOTUSED(mask);
-
-    while(c->bufpos > 0 || listLength(c->reply)) {
+/* Write c->buf and then the objects in the c->reply list to the client
+ * socket. The number of written bytes is stored in *totwritten, the return
+ * value is the result of the last writev(2) call, so -1 signals an error
+ * (with errno set accordingly).
+ *
+ * 将 c->buf 以及 c->reply 链表中的回复写入到客户端套接字。
+ *
+ * The buffer and up to REDIS_IOV_MAX nodes of the reply list are sent with
+ * a single writev(2) call, so a reply made of many chunks costs one system
+ * call every REDIS_MAX_WRITE_PER_EVENT bytes instead of one per chunk.
+ * c->sentlen is the number of bytes already sent of the first chunk, that
+ * is c->buf if it is not empty, or the first node of the reply list.
+ *
+ * 静态缓存和最多 REDIS_IOV_MAX 个回复链表节点会通过一次 writev(2) 调用写出，
+ * c->sentlen 记录第一个块（c->buf 不为空时为 c->buf ，否则为链表的第一个节点）
+ * 已经写出的字节数。
+ *
+ * When 'iothread' is true the function is running in an I/O thread:
+ * objects in the reply list are not released (they may be shared objects
+ * and refcounting is not thread safe), the number of fully written nodes
+ * is accumulated into c->io_sent_nodes instead, and the main thread will
+ * release them later.
+ *
+ * 如果 iothread 为真，那么函数正运行在 I/O 线程中：
+ * 已写出的链表节点不会被释放（节点可能是共享对象，而引用计数不是线程安全的），
+ * 而是记录到 c->io_sent_nodes ，之后由主线程释放。 */
+static int _writeToClient(redisClient *c, int iothread, int *totwritten) {
+    struct iovec iov[REDIS_IOV_MAX];
+    int nwritten = 0;
+    listNode *ln = listFirst(c->reply);
+
+    *totwritten = 0;
+    while(c->bufpos > 0 || ln) {
+        listNode *next = ln;
+        size_t offset = c->sentlen, iovlen = 0, left;
+        int iovcnt = 0;
+
+        /* Collect the chunks to send: what is left of the static buffer,
+         * then the nodes of the reply list. Empty nodes are skipped here
+         * and released below as already sent. */
+        // 收集需要写出的块：静态缓存中剩余的内容，以及回复链表中的节点
         if (c->bufpos > 0) {
-            if (c->flags & REDIS_MASTER) {
-                /* Don't reply to a master */
-                nwritten = c->bufpos - c->sentlen;
-            } else {
-                nwritten = write(fd,c->buf+c->sentlen,c->bufpos-c->sentlen);
-                if (nwritten <= 0) break;
+            iov[iovcnt].iov_base = c->buf+offset;
+            iov[iovcnt].iov_len = c->bufpos-offset;
+            iovlen += iov[iovcnt++].iov_len;
+            offset = 0;
+        }
+        while(next && iovcnt < REDIS_IOV_MAX &&
+              iovlen < REDIS_MAX_WRITE_PER_EVENT)
+        {
+            robj *o = listNodeValue(next);
+            size_t objlen = sdslen(o->ptr);
+
+            if (objlen > offset) {
+                iov[iovcnt].iov_base = ((char*)o->ptr)+offset;
+                iov[iovcnt].iov_len = objlen-offset;
+                iovlen += iov[iovcnt++].iov_len;
             }
-            c->sentlen += nwritten;
-            totwritten += nwritten;
+            offset = 0;
+            next = listNextNode(next);
+        }
+
+        if (iovcnt == 0) {
+            nwritten = 0;
+        } else if (c->flags & REDIS_MASTER) {
+            /* Don't reply to a master */
+            nwritten = iovlen;
+        } else {
+            nwritten = writev(c->fd,iov,iovcnt);
+            if (nwritten <= 0) break;
+        }
+        *totwritten += nwritten;
 
-            /* If the buffer was sent, set bufpos to zero to continue with
-             * the remainder of the reply. */
-            if (c->sentlen == c->bufpos) {
+        /* Consume the written bytes: the buffer first, then the nodes,
+         * leaving c->sentlen set to the partially written chunk if any. */
+        // 根据写出的字节数，更新缓存、链表和 c->sentlen
+        left = nwritten;
+        if (c->bufpos > 0) {
+            if (left < (size_t)(c->bufpos-c->sentlen)) {
+                c->sentlen += left;
+                left = 0;
+            } else {
+                /* If the buffer was sent, set bufpos to zero to continue
+                 * with the remainder of the reply. */
+                left -= c->bufpos-c->sentlen;
                 c->bufpos = 0;
                 c->sentlen = 0;
             }
-        } else {
-            o = listNodeValue(listFirst(c->reply));
-            objlen = sdslen(o->ptr);
-            objmem = zmalloc_size_sds(o->ptr);
+        }
+        while(c->bufpos == 0 && ln) {
+            robj *o = listNodeValue(ln);
+            size_t objlen = sdslen(o->ptr);
+            size_t objmem = getStringObjectSdsUsedMemory(o);
 
-            if (objlen == 0) {
-                listDelNode(c->reply,listFirst(c->reply));
-                continue;
+            if (left < objlen-c->sentlen) {
+                c->sentlen += left;
+                break;
             }
 
-            if (c->flags & REDIS_MASTER) {
-                /* Don't reply to a master */
-                nwritten = objlen - c->sentlen;
+            /* The object on head was fully sent: go to the next one */
+            left -= objlen-c->sentlen;
+            c->sentlen = 0;
+            if (iothread) {
+                c->io_sent_nodes++;
+                ln = listNextNode(ln);
             } else {
-                nwritten = write(fd, ((char*)o->ptr)+c->sentlen,objlen-c->sentlen);
-                if (nwritten <= 0) break;
-            }
-            c->sentlen += nwritten;
-            totwritten += nwritten;
-
-            /* If we fully sent the object on head go to the next one */
-            if (c->sentlen == objlen) {
-                listDelNode(c->reply,listFirst(c->reply));
-                c->sentlen = 0;
-                c->reply_bytes -= objmem;
+                listDelNode(c->reply,ln);
+                if (objlen) c->reply_bytes -= objmem;
+                ln = listFirst(c->reply);
             }
         }
         /* Note that we avoid to send more than REDIS_MAX_WRITE_PER_EVENT
@@ -953,10 +1174,29 @@ void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
         // 为了避免一个巨大的回复独占服务器
         // 如果写入字节数已经超过事件设定的最大每次可写字节数
         // 那么中断回复的发送
-        if (totwritten > REDIS_MAX_WRITE_PER_EVENT &&
+        if (*totwritten > REDIS_MAX_WRITE_PER_EVENT &&
             (server.maxmemory == 0 ||
              zmalloc_used_memory() < server.maxmemory)) break;
     }
+    return nwritten;
+}
+
+/* Returns true if all the pending output of the client was written. */
+static int clientHasNoPendingReplies(redisClient *c) {
+    return c->bufpos == 0 && listLength(c->reply) == c->io_sent_nodes;
+}
+
+/*
+ * 将所有回复发送到客户端
+ */
+void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
+    redisClient *c = privdata;
+    int nwritten, totwritten;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(fd);
+    REDIS_NOTUSED(mask);
+
+    nwritten = _writeToClient(c,0,&totwritten);
 
     // 写入出错
     if (nwritten == -1) {
@@ -993,10 +1233,7 @@ void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
 void resetClient(redisClient *c) {
     // 清空上一次执行的命令
     freeClientArgv(c);
-
-    c->reqtype = 0;
-    c->multibulklen = 0;
-    c->bulklen = -1;
+    resetClientParser(c);
 
     /* We clear the ASKING flag as well if we are not inside a MULTI. */
     if (!(c->flags & REDIS_MULTI)) c->flags &= (~REDIS_ASKING);
@@ -1025,8 +1262,11 @@ int processInlineBuffer(redisClient *c) {
     c->querybuf = sdsrange(c->querybuf,querylen+2,-1);
 
     /* Setup argv array on client structure */
-    if (c->argv) zfree(c->argv);
-    c->argv = zmalloc(sizeof(robj*)*argc);
+    if (c->argv_len < argc) {
+        zfree(c->argv);
+        c->argv = zmalloc(sizeof(robj*)*argc);
+        c->argv_len = argc;
+    }
 
     /* Create redis objects for all arguments. */
     for (c->argc = 0, j = 0; j < argc; j++) {
@@ -1095,9 +1335,13 @@ int processMultibulkBuffer(redisClient *c) {
 
         c->multibulklen = ll;
 
-        /* Setup argv array on client structure */
-        if (c->argv) zfree(c->argv);
-        c->argv = zmalloc(sizeof(robj*)*c->multibulklen);
+        /* Setup argv array on client structure, reusing the one of the
+         * previous command if it is large enough. */
+        if (c->argv_len < c->multibulklen) {
+            zfree(c->argv);
+            c->argv = zmalloc(sizeof(robj*)*c->multibulklen);
+            c->argv_len = c->multibulklen;
+        }
     }
 
     redisAssertWithInfo(c,NULL,c->multibulklen > 0);
@@ -1186,6 +1430,36 @@ int processMultibulkBuffer(redisClient *c) {
     return REDIS_ERR;
 }
 
+/* Parse the next command in the query buffer into c->argv.
+ *
+ * Returns REDIS_OK when a whole command was parsed (c->argc may be zero
+ * for an empty multi bulk request), REDIS_ERR if more data is needed or
+ * on protocol errors.
+ *
+ * 从查询缓存中分析出下一个命令，并保存到 c->argv 中。
+ *
+ * 分析出完整的命令时返回 REDIS_OK ，
+ * 需要更多数据或者协议出错时返回 REDIS_ERR 。 */
+static int parseClientCommand(redisClient *c) {
+    /* Determine request type when unknown. */
+    if (!c->reqtype) {
+        if (c->querybuf[0] == '*') {
+            c->reqtype = REDIS_REQ_MULTIBULK;
+        } else {
+            c->reqtype = REDIS_REQ_INLINE;
+        }
+    }
+
+    if (c->reqtype == REDIS_REQ_INLINE) {
+        return processInlineBuffer(c);
+    } else if (c->reqtype == REDIS_REQ_MULTIBULK) {
+        return processMultibulkBuffer(c);
+    } else {
+        redisPanic("Unknown request type");
+    }
+    return REDIS_ERR; /* Not reached */
+}
+
 void processInputBuffer(redisClient *c) {
     /* Keep processing while there is something in the input buffer */
     while(sdslen(c->querybuf)) {
@@ -1197,22 +1471,7 @@ void processInputBuffer(redisClient *c) {
          * this flag has been set (i.e. don't process more commands). */
         if (c->flags & REDIS_CLOSE_AFTER_REPLY) return;
 
-        /* Determine request type when unknown. */
-        if (!c->reqtype) {
-            if (c->querybuf[0] == '*') {
-                c->reqtype = REDIS_REQ_MULTIBULK;
-            } else {
-                c->reqtype = REDIS_REQ_INLINE;
-            }
-        }
-
-        if (c->reqtype == REDIS_REQ_INLINE) {
-            if (processInlineBuffer(c) != REDIS_OK) break;
-        } else if (c->reqtype == REDIS_REQ_MULTIBULK) {
-            if (processMultibulkBuffer(c) != REDIS_OK) break;
-        } else {
-            redisPanic("Unknown request type");
-        }
+        if (parseClientCommand(c) != REDIS_OK) break;
 
         /* Multibulk processing could see a <= 0 length. */
         if (c->argc == 0) {
@@ -1222,17 +1481,30 @@ void processInputBuffer(redisClient *c) {
             if (processCommand(c) == REDIS_OK)
                 resetClient(c);
         }
+
+        /* The replication offset of our master is advanced only by the
+         * commands that were actually processed, so that the unprocessed
+         * tail of the query buffer is requested again on PSYNC. */
+        // 更新主节点复制流中已执行的偏移量
+        if (c->flags & REDIS_MASTER)
+            c->reploff = c->read_reploff - sdslen(c->querybuf);
     }
 }
 
-void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
-    redisClient *c = (redisClient*) privdata;
+/* Read from the client socket into the query buffer.
+ *
+ * Returns the number of bytes read, 0 if there was nothing to read, or -1
+ * if the client should be closed (read error or connection closed).
+ * Since it may run in an I/O thread, it never frees the client itself.
+ *
+ * 从客户端套接字读入数据到查询缓存。
+ *
+ * 返回读入的字节数，没有数据可读时返回 0 ，
+ * 出错或者连接已关闭时返回 -1 ，由调用者负责释放客户端。 */
+static int readClientSocket(redisClient *c) {
     int nread, readlen;
     size_t qblen;
-    REDIS_NOTUSED(el);
-    REDIS_NOTUSED(mask);
 
-    server.current_client = c;
     readlen = REDIS_IOBUF_LEN;
     /* If this is a multi bulk request, and we are processing a bulk reply
      * that is large enough, try to maximize the probability that the query
@@ -1252,9 +1524,9 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
     qblen = sdslen(c->querybuf);
     if (c->querybuf_peak < qblen) c->querybuf_peak = qblen;
     c->querybuf = sdsMakeRoomFor(c->querybuf, readlen);
-    
+
     // 读入到 buf
-    nread = read(fd, c->querybuf+qblen, readlen);
+    nread = read(c->fd, c->querybuf+qblen, readlen);
 
     // 处理读错误值和 EOF （客户端已关闭）
     if (nread == -1) {
@@ -1262,13 +1534,11 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
             nread = 0;
         } else {
             redisLog(REDIS_VERBOSE, "Reading from client: %s",strerror(errno));
-            freeClient(c);
-            return;
+            return -1;
         }
     } else if (nread == 0) {
         redisLog(REDIS_VERBOSE, "Client closed connection");
-        freeClient(c);
-        return;
+        return -1;
     }
 
     // 根据读入情况更新客户端统计数据
@@ -1276,19 +1546,59 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
         sdsIncrLen(c->querybuf,nread);
         // 最后一次交互时间
         c->lastinteraction = server.unixtime;
-    } else {
-        server.current_client = NULL;
+        // 记录从主节点读入的复制流字节数
+        if (c->flags & REDIS_MASTER) c->read_reploff += nread;
+    }
+    return nread;
+}
+
+/* Returns true (and logs the event) if the query buffer of the client
+ * is over the configured limit, so that the caller can free it. */
+// 读入缓存不能超过限制，否则断开并清除客户端
+static int clientQueryBufferTooBig(redisClient *c) {
+    sds ci, bytes;
+
+    if (sdslen(c->querybuf) <= server.client_max_querybuf_len) return 0;
+
+    ci = getClientInfoString(c);
+    bytes = sdscatrepr(sdsempty(),c->querybuf,64);
+    redisLog(REDIS_WARNING,"Closing client that reached max query buffer length: %s (qbuf initial bytes: %s)", ci, bytes);
+    sdsfree(ci);
+    sdsfree(bytes);
+    return 1;
+}
+
+void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
+    redisClient *c = (redisClient*) privdata;
+    int nread;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(fd);
+    REDIS_NOTUSED(mask);
+
+    /* Already queued for the I/O threads. */
+    if (c->flags & REDIS_PENDING_READ) return;
+
+    /* With threaded I/O just queue the client: the read and the parsing
+     * of the query are performed by the I/O threads before returning to
+     * the event loop, see handleClientsWithPendingReads(). */
+    // 使用 I/O 线程时，只将客户端放入待读入队列
+    if (clientCanUseIOThreads(c)) {
+        ioThreadsQueueClient(c,REDIS_IO_THREADS_OP_READ);
         return;
     }
 
-    // 读入缓存不能超过限制，否则断开并清除客户端
-    if (sdslen(c->querybuf) > server.client_max_querybuf_len) {
-        sds ci = getClientInfoString(c), bytes = sdsempty();
+    server.current_client = c;
+
+    nread = readClientSocket(c);
+    if (nread == -1) {
+        freeClient(c);
+        return;
+    } else if (nread == 0) {
+        server.current_client = NULL;
+        return;
+    }
 
-        bytes = sdscatrepr(bytes,c->querybuf,64);
-        redisLog(REDIS_WARNING,"Closing client that reached max query buffer length: %s (qbuf initial bytes: %s)", ci, bytes);
-        sdsfree(ci);
-        sdsfree(bytes);
+    if (clientQueryBufferTooBig(c)) {
         freeClient(c);
         return;
     }
@@ -1458,6 +1768,7 @@ void rewriteClientCommandVector(redisClient *c, int argc, ...) {
     zfree(c->argv);
     /* Replace argv and argc with our new versions. */
     c->argv = argv;
+    c->argv_len = argc;
     c->argc = argc;
     c->cmd = lookupCommand(c->argv[0]->ptr);
     redisAssertWithInfo(c,NULL,c->cmd != NULL);
@@ -1583,6 +1894,9 @@ int checkClientOutputBufferLimits(redisClient *c) {
 void asyncCloseClientOnOutputBufferLimitReached(redisClient *c) {
     redisAssert(c->reply_bytes < ULONG_MAX-(1024*64));
     if (c->reply_bytes == 0 || c->flags & REDIS_CLOSE_ASAP) return;
+    /* The I/O threads can't touch the list of clients to close: the check
+     * is performed again the next time the main thread adds a reply. */
+    if (inIOThread()) return;
     if (checkClientOutputBufferLimits(c)) {
         sds client = getClientInfoString(c);
 
@@ -1612,3 +1926,369 @@ void flushSlavesOutputBuffers(void) {
         }
     }
 }
+
+/* -----------------------------------------------------------------------------
+ * Threaded I/O
+ *
+ * When io-threads is greater than 1, reads and writes of normal clients are
+ * not performed by the file event handlers: the clients are queued into
+ * server.clients_pending_read and server.clients_pending_write, and before
+ * returning to the event loop the main thread splits the queued clients
+ * among itself and the I/O threads. For reads the I/O threads also parse
+ * the first command of the query buffer, while commands are always executed
+ * by the main thread with call(). The main thread waits for all the I/O
+ * threads to finish before touching the clients again, so no client is ever
+ * accessed by two threads at the same time.
+ *
+ * I/O 线程
+ *
+ * 在 io-threads 大于 1 时，普通客户端的读写不再由文件事件处理器直接执行，
+ * 而是先放入待读入/待写入队列，在返回事件循环之前，
+ * 由主线程将这些客户端分配给自己和 I/O 线程执行。
+ * 读入时 I/O 线程还会分析查询缓存中的第一个命令，但命令总是由主线程执行。
+ * 主线程会等待所有 I/O 线程完成之后才继续处理这些客户端，
+ * 所以同一时间只会有一个线程访问某个客户端。
+ * -------------------------------------------------------------------------- */
+
+static pthread_t io_threads[REDIS_IO_THREADS_MAX_NUM];
+static pthread_mutex_t io_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 主线程通过这个条件变量通知 I/O 线程有新的任务
+static pthread_cond_t io_threads_job_cond = PTHREAD_COND_INITIALIZER;
+// I/O 线程通过这个条件变量通知主线程任务已完成
+static pthread_cond_t io_threads_done_cond = PTHREAD_COND_INITIALIZER;
+// 当前任务的客户端数组，第 j 个线程处理下标 i % threads == j 的客户端
+static redisClient **io_threads_clients = NULL;
+static unsigned long io_threads_clients_num = 0;
+static unsigned long io_threads_clients_size = 0;
+// 当前任务的类型：REDIS_IO_THREADS_OP_READ 或 REDIS_IO_THREADS_OP_WRITE
+static int io_threads_op;
+// 参与当前任务的线程数量（包括主线程）
+static int io_threads_active;
+// 还没有完成当前任务的 I/O 线程数量
+static int io_threads_pending;
+// 每次分派任务时增一，I/O 线程用它来发现新任务
+static unsigned long long io_threads_job_id = 0;
+// 主线程的 id
+static pthread_t io_threads_main_id;
+
+/* Return true if we are running in one of the I/O threads. */
+static int inIOThread(void) {
+    return server.io_threads_num > 1 &&
+           !pthread_equal(pthread_self(),io_threads_main_id);
+}
+
+/* Return true if the reads and writes of this client can be performed by
+ * the I/O threads. Masters and slaves are always served by the main thread,
+ * and so is everybody while loading or while a script timed out, as in
+ * these states the event loop is entered without calling beforeSleep(). */
+static int clientCanUseIOThreads(redisClient *c) {
+    return server.io_threads_num > 1 &&
+           !(c->flags & (REDIS_MASTER|REDIS_SLAVE)) &&
+           !server.loading && !server.lua_timedout;
+}
+
+/* Append the client to the queue of the I/O threads for the operation 'op'
+ * (REDIS_IO_THREADS_OP_READ or REDIS_IO_THREADS_OP_WRITE), unless it is
+ * already queued. The list node is stored in the client, so that it can be
+ * removed in O(1) by ioThreadsDequeueClient(). */
+/*
+ * 将客户端添加到 I/O 线程的读或写队列末尾，如果它已经在队列中，那么什么也不做。
+ *
+ * 链表节点被保存在客户端中，以便 ioThreadsDequeueClient() 以 O(1) 复杂度删除它
+ */
+static void ioThreadsQueueClient(redisClient *c, int op) {
+    if (op == REDIS_IO_THREADS_OP_READ) {
+        if (c->flags & REDIS_PENDING_READ) return;
+        c->flags |= REDIS_PENDING_READ;
+        listAddNodeTail(server.clients_pending_read,c);
+        c->pending_read_node = listLast(server.clients_pending_read);
+    } else {
+        if (c->flags & REDIS_PENDING_WRITE) return;
+        c->flags |= REDIS_PENDING_WRITE;
+        listAddNodeTail(server.clients_pending_write,c);
+        c->pending_write_node = listLast(server.clients_pending_write);
+    }
+}
+
+/* Remove the client from the queue of the I/O threads for the operation
+ * 'op', if it is queued. */
+// 将客户端从 I/O 线程的读或写队列中删除（如果它在队列中的话）
+static void ioThreadsDequeueClient(redisClient *c, int op) {
+    if (op == REDIS_IO_THREADS_OP_READ) {
+        if (!(c->flags & REDIS_PENDING_READ)) return;
+        listDelNode(server.clients_pending_read,c->pending_read_node);
+        c->pending_read_node = NULL;
+        c->flags &= ~REDIS_PENDING_READ;
+    } else {
+        if (!(c->flags & REDIS_PENDING_WRITE)) return;
+        listDelNode(server.clients_pending_write,c->pending_write_node);
+        c->pending_write_node = NULL;
+        c->flags &= ~REDIS_PENDING_WRITE;
+    }
+}
+
+/* Read and parse the query of a client. Called by the I/O threads. */
+static void ioThreadsReadClient(redisClient *c) {
+    int nread = readClientSocket(c);
+
+    if (nread == -1) {
+        c->flags |= REDIS_IO_CLOSE;
+        return;
+    }
+    if (nread == 0 || sdslen(c->querybuf) == 0) return;
+    // 查询缓存超过限制，由主线程关闭客户端
+    if (sdslen(c->querybuf) > server.client_max_querybuf_len) return;
+    if (c->flags & (REDIS_BLOCKED|REDIS_CLOSE_AFTER_REPLY)) return;
+
+    // 分析第一个命令，剩下的命令由主线程分析
+    if (parseClientCommand(c) == REDIS_OK)
+        c->flags |= REDIS_PENDING_COMMAND;
+}
+
+/* Write the pending output of a client. Called by the I/O threads. */
+static void ioThreadsWriteClient(redisClient *c) {
+    int nwritten, totwritten;
+
+    if (c->flags & REDIS_AOF_WAIT) return;
+
+    nwritten = _writeToClient(c,1,&totwritten);
+    if (nwritten == -1 && errno != EAGAIN) {
+        redisLog(REDIS_VERBOSE,
+            "Error writing to client: %s", strerror(errno));
+        c->flags |= REDIS_IO_CLOSE;
+        return;
+    }
+    if (totwritten > 0) c->lastinteraction = server.unixtime;
+}
+
+/* Process the share of the current job of the I/O thread with the given id
+ * (the main thread has id 0). */
+static void ioThreadsProcessJob(int id) {
+    unsigned long j;
+
+    for (j = id; j < io_threads_clients_num; j += io_threads_active) {
+        if (io_threads_op == REDIS_IO_THREADS_OP_READ)
+            ioThreadsReadClient(io_threads_clients[j]);
+        else
+            ioThreadsWriteClient(io_threads_clients[j]);
+    }
+}
+
+/* Main function of the I/O threads. */
+static void *ioThreadMain(void *arg) {
+    int id = (unsigned long) arg;
+    unsigned long long seen = 0;
+    sigset_t sigset;
+
+    /* Block SIGALRM so we are sure that only the main thread will
+     * receive the watchdog signal. */
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &sigset, NULL))
+        redisLog(REDIS_WARNING,
+            "Warning: can't mask SIGALRM in I/O thread: %s", strerror(errno));
+
+    pthread_mutex_lock(&io_threads_mutex);
+    while(1) {
+        /* The loop always starts with the lock hold. */
+        if (seen == io_threads_job_id) {
+            pthread_cond_wait(&io_threads_job_cond,&io_threads_mutex);
+            continue;
+        }
+        seen = io_threads_job_id;
+        // 这个线程不参与本次任务
+        if (id >= io_threads_active) continue;
+        pthread_mutex_unlock(&io_threads_mutex);
+
+        ioThreadsProcessJob(id);
+
+        pthread_mutex_lock(&io_threads_mutex);
+        if (--io_threads_pending == 0)
+            pthread_cond_signal(&io_threads_done_cond);
+    }
+    return NULL;
+}
+
+/* Spawn the I/O threads. Called at startup if io-threads > 1. */
+void initThreadedIO(void) {
+    pthread_attr_t attr;
+    size_t stacksize;
+    int j;
+
+    server.clients_pending_read = listCreate();
+    server.clients_pending_write = listCreate();
+    io_threads_main_id = pthread_self();
+    if (server.io_threads_num <= 1) return;
+
+    /* Set the stack size as by default it may be small in some system */
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr,&stacksize);
+    if (!stacksize) stacksize = 1; /* The world is full of Solaris Fixes */
+    while (stacksize < REDIS_THREAD_STACK_SIZE) stacksize *= 2;
+    pthread_attr_setstacksize(&attr, stacksize);
+
+    // 主线程本身就是 0 号 I/O 线程
+    for (j = 1; j < server.io_threads_num; j++) {
+        void *arg = (void*)(unsigned long) j;
+
+        if (pthread_create(&io_threads[j],&attr,ioThreadMain,arg) != 0) {
+            redisLog(REDIS_WARNING,"Fatal: Can't initialize I/O threads.");
+            exit(1);
+        }
+    }
+    redisLog(REDIS_NOTICE,"Threaded I/O enabled with %d threads",
+        server.io_threads_num);
+}
+
+/* Split the clients of the list among the main thread and the I/O threads,
+ * performing the operation 'op' on every client, and wait for completion.
+ * The list itself is left untouched. */
+static void ioThreadsRunJob(list *clients, int op) {
+    unsigned long numclients = listLength(clients);
+    int threads = server.io_threads_num;
+    listIter li;
+    listNode *ln;
+
+    if (numclients > io_threads_clients_size) {
+        io_threads_clients_size = numclients*2;
+        io_threads_clients = zrealloc(io_threads_clients,
+            sizeof(redisClient*)*io_threads_clients_size);
+    }
+    io_threads_clients_num = 0;
+    listRewind(clients,&li);
+    while((ln = listNext(&li)))
+        io_threads_clients[io_threads_clients_num++] = listNodeValue(ln);
+
+    /* Waking up the threads is not free: with just a few clients the
+     * main thread does all the work alone. */
+    // 客户端太少时，由主线程独自完成所有工作
+    if (numclients < (unsigned long)threads*REDIS_IO_THREADS_MIN_CLIENTS)
+        threads = 1;
+
+    pthread_mutex_lock(&io_threads_mutex);
+    io_threads_op = op;
+    io_threads_active = threads;
+    if (threads > 1) {
+        io_threads_pending = threads-1;
+        io_threads_job_id++;
+        pthread_cond_broadcast(&io_threads_job_cond);
+    }
+    pthread_mutex_unlock(&io_threads_mutex);
+
+    // 主线程处理自己的那份工作
+    ioThreadsProcessJob(0);
+
+    // 等待所有 I/O 线程完成
+    if (threads > 1) {
+        pthread_mutex_lock(&io_threads_mutex);
+        while(io_threads_pending)
+            pthread_cond_wait(&io_threads_done_cond,&io_threads_mutex);
+        pthread_mutex_unlock(&io_threads_mutex);
+    }
+}
+
+/* Called by beforeSleep(): read and parse the queries of the clients queued
+ * by readQueryFromClient() using the I/O threads, then execute the commands
+ * in the main thread. */
+void handleClientsWithPendingReads(void) {
+    redisClient *c;
+
+    if (listLength(server.clients_pending_read) == 0) return;
+    ioThreadsRunJob(server.clients_pending_read,REDIS_IO_THREADS_OP_READ);
+
+    /* Clients are removed from the head one at a time, since executing a
+     * command may free other clients of the list. */
+    while(listLength(server.clients_pending_read)) {
+        c = listNodeValue(listFirst(server.clients_pending_read));
+        ioThreadsDequeueClient(c,REDIS_IO_THREADS_OP_READ);
+        server.stat_io_reads_processed++;
+
+        if (c->flags & REDIS_IO_CLOSE || clientQueryBufferTooBig(c)) {
+            freeClient(c);
+            continue;
+        }
+
+        server.current_client = c;
+        // 执行 I/O 线程分析出的命令
+        if (c->flags & REDIS_PENDING_COMMAND) {
+            c->flags &= ~REDIS_PENDING_COMMAND;
+            if (c->argc == 0) {
+                resetClient(c);
+            } else {
+                if (processCommand(c) == REDIS_OK)
+                    resetClient(c);
+            }
+        }
+        // 处理查询缓存中剩下的命令
+        processInputBuffer(c);
+        server.current_client = NULL;
+
+        /* Replies added while the read was pending (for instance protocol
+         * errors emitted by the I/O thread) did not schedule a write. */
+        if ((c->bufpos || listLength(c->reply)) &&
+            !(c->flags & REDIS_AOF_WAIT) && clientCanUseIOThreads(c))
+        {
+            ioThreadsQueueClient(c,REDIS_IO_THREADS_OP_WRITE);
+        }
+    }
+}
+
+/* Schedule the write of the pending output of a client whose replies were
+ * held waiting for an AOF write, see aofHoldClientReply(). */
+/*
+ * 为回复被暂缓的客户端安排写入
+ */
+void scheduleClientReplyWrite(redisClient *c) {
+    if (c->bufpos == 0 && listLength(c->reply) == 0) return;
+
+    if (clientCanUseIOThreads(c)) {
+        ioThreadsQueueClient(c,REDIS_IO_THREADS_OP_WRITE);
+    } else if (aeCreateFileEvent(server.el,c->fd,AE_WRITABLE,
+               sendReplyToClient,c) == AE_ERR)
+    {
+        freeClientAsync(c);
+    }
+}
+
+/* Called by beforeSleep(), after the AOF buffer is flushed: write the
+ * output buffers of the queued clients using the I/O threads. Clients
+ * that still have pending output get a regular write handler. */
+void handleClientsWithPendingWrites(void) {
+    redisClient *c;
+
+    if (listLength(server.clients_pending_write) == 0) return;
+    ioThreadsRunJob(server.clients_pending_write,REDIS_IO_THREADS_OP_WRITE);
+
+    while(listLength(server.clients_pending_write)) {
+        c = listNodeValue(listFirst(server.clients_pending_write));
+        ioThreadsDequeueClient(c,REDIS_IO_THREADS_OP_WRITE);
+        server.stat_io_writes_processed++;
+
+        // 释放已被 I/O 线程写出的回复节点
+        while(c->io_sent_nodes) {
+            robj *o = listNodeValue(listFirst(c->reply));
+
+            if (sdslen(o->ptr)) c->reply_bytes -= getStringObjectSdsUsedMemory(o);
+            listDelNode(c->reply,listFirst(c->reply));
+            c->io_sent_nodes--;
+        }
+
+        /* Held after the write was queued: scheduled again later. */
+        if (c->flags & REDIS_AOF_WAIT) continue;
+
+        if (c->flags & REDIS_IO_CLOSE) {
+            freeClient(c);
+            continue;
+        }
+
+        if (clientHasNoPendingReplies(c)) {
+            c->sentlen = 0;
+            /* Close connection after entire reply has been sent. */
+            if (c->flags & REDIS_CLOSE_AFTER_REPLY) freeClient(c);
+        } else if (aeCreateFileEvent(server.el,c->fd,AE_WRITABLE,
+                   sendReplyToClient,c) == AE_ERR)
+        {
+            freeClientAsync(c);
+        }
+    }
+}
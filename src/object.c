@@ -43,22 +43,71 @@ robj *createObject(int type, void *ptr) {
     // 初始化对象域
     o->type = type;
     o->encoding = REDIS_ENCODING_RAW;   // 默认编码
+    o->replyblock = 0;
     o->ptr = ptr;
     o->refcount = 1;
 
-    /* Set the LRU to the current lruclock (minutes resolution). */
-    o->lru = server.lruclock;
+    /* Set the LRU to the current lruclock (seconds resolution), or the
+     * initial LFU counter if an LFU policy is used. */
+    o->lru = objectGetLRUOrLFU();
 
     return o;
 }
 
+/* Create a string object with encoding REDIS_ENCODING_RAW, that is a plain
+ * string object where o->ptr points to a proper sds string. */
 /*
- * 根据给定字符数组，创建一个 String 对象
+ * 创建一个 RAW 编码的 String 对象，对象的 ptr 指向一个独立分配的 sds
  */
-robj *createStringObject(char *ptr, size_t len) {
+robj *createRawStringObject(char *ptr, size_t len) {
     return createObject(REDIS_STRING,sdsnewlen(ptr,len));
 }
 
+/* Create a string object with encoding REDIS_ENCODING_EMBSTR, that is
+ * an object where the sds string is actually an unmodifiable string
+ * allocated in the same chunk as the object itself. */
+/*
+ * 创建一个 EMBSTR 编码的 String 对象，
+ * sds 头和字符串内容紧跟在对象之后，和对象分配在同一块内存中，
+ * 这个 sds 是只读的，不能被修改或者单独释放。
+ */
+robj *createEmbeddedStringObject(char *ptr, size_t len) {
+    robj *o = zmalloc(sizeof(robj)+sizeof(struct sdshdr)+len+1);
+    struct sdshdr *sh = (void*)(o+1);
+
+    o->type = REDIS_STRING;
+    o->encoding = REDIS_ENCODING_EMBSTR;
+    o->replyblock = 0;
+    o->ptr = sh+1;
+    o->refcount = 1;
+    o->lru = objectGetLRUOrLFU();
+
+    sh->len = len;
+    sh->free = 0;
+    if (ptr) {
+        memcpy(sh->buf,ptr,len);
+        sh->buf[len] = '\0';
+    } else {
+        memset(sh->buf,0,len+1);
+    }
+    return o;
+}
+
+/* Create a string object with EMBSTR encoding if it is not longer than
+ * REDIS_ENCODING_EMBSTR_SIZE_LIMIT, otherwise the RAW encoding is
+ * used. */
+/*
+ * 根据给定字符数组，创建一个 String 对象，
+ * 长度不超过 REDIS_ENCODING_EMBSTR_SIZE_LIMIT 的字符串使用 EMBSTR 编码，
+ * 其他字符串使用 RAW 编码。
+ */
+robj *createStringObject(char *ptr, size_t len) {
+    if (len <= REDIS_ENCODING_EMBSTR_SIZE_LIMIT)
+        return createEmbeddedStringObject(ptr,len);
+    else
+        return createRawStringObject(ptr,len);
+}
+
 /*
  * 根据给定数字值 value ，创建一个 String 对象
  */
@@ -66,7 +115,9 @@ robj *createStringObjectFromLongLong(long long value) {
 
     robj *o;
 
-    if (value >= 0 && value < REDIS_SHARED_INTEGERS) {
+    if (value >= 0 && value < REDIS_SHARED_INTEGERS &&
+        !server.rdb_load_unshared)
+    {
         // 如果条件允许，使用共享对象
         incrRefCount(shared.integers[value]);
         o = shared.integers[value];
@@ -114,41 +165,39 @@ robj *createStringObjectFromLongDouble(long double value) {
     return createStringObject(buf,len);
 }
 
+/* Duplicate a string object, with the guarantee that the returned object
+ * has the same encoding as the original one. */
 /*
- * 复制一个 String 对象的副本
+ * 复制一个 String 对象的副本，副本和原对象的编码相同
  */
 robj *dupStringObject(robj *o) {
-    redisAssertWithInfo(NULL,o,o->encoding == REDIS_ENCODING_RAW);
-    return createStringObject(o->ptr,sdslen(o->ptr));
+    robj *d;
+
+    switch(o->encoding) {
+    case REDIS_ENCODING_RAW:
+        return createRawStringObject(o->ptr,sdslen(o->ptr));
+    case REDIS_ENCODING_EMBSTR:
+        return createEmbeddedStringObject(o->ptr,sdslen(o->ptr));
+    case REDIS_ENCODING_INT:
+        d = createObject(REDIS_STRING,NULL);
+        d->encoding = REDIS_ENCODING_INT;
+        d->ptr = o->ptr;
+        return d;
+    default:
+        redisPanic("Wrong encoding.");
+        return NULL;
+    }
 }
 
 /*
- * 创建一个 list 对象
+ * 创建一个 list 对象，使用 quicklist 编码，
+ * 节点大小和压缩深度由服务器配置决定
  */
-robj *createListObject(void) {
-    // 使用双端链表(adlist)
-    list *l = listCreate();
-
-    // 创建对象
+robj *createQuicklistObject(void) {
+    quicklist *l = quicklistNew(server.list_max_ziplist_size,
+                                server.list_compress_depth);
     robj *o = createObject(REDIS_LIST,l);
-
-    // 因为列表里的值也是其他对象
-    // 所以要设置 decrRefCount 作为值的释放器
-    listSetFreeMethod(l,decrRefCount);
-
-    // 设置编码
-    o->encoding = REDIS_ENCODING_LINKEDLIST;
-
-    return o;
-}
-
-/*
- * 创建一个 ziplist 对象
- */
-robj *createZiplistObject(void) {
-    unsigned char *zl = ziplistNew();
-    robj *o = createObject(REDIS_LIST,zl);
-    o->encoding = REDIS_ENCODING_ZIPLIST;
+    o->encoding = REDIS_ENCODING_QUICKLIST;
     return o;
 }
 
@@ -224,13 +273,9 @@ void freeStringObject(robj *o) {
  */
 void freeListObject(robj *o) {
     switch (o->encoding) {
-    // 释放双端链表
-    case REDIS_ENCODING_LINKEDLIST:
-        listRelease((list*) o->ptr);
-        break;
-    // 释放 ziplist 
-    case REDIS_ENCODING_ZIPLIST:
-        zfree(o->ptr);
+    // 释放 quicklist
+    case REDIS_ENCODING_QUICKLIST:
+        quicklistRelease(o->ptr);
         break;
     default:
         redisPanic("Unknown list encoding type");
@@ -296,11 +341,33 @@ void freeHashObject(robj *o) {
     }
 }
 
+/* Set a special refcount in the object to make it "shared":
+ * incrRefCount and decrRefCount() will test for this special refcount
+ * and will not touch the object. This way it is free to access shared
+ * objects such as small integers from different threads without any
+ * mutex, for example from the bio thread releasing values lazily.
+ *
+ * A common pattern to create shared objects:
+ *
+ * robj *myobject = makeObjectShared(createObject(...));
+ */
+/*
+ * 将对象设置为共享对象
+ *
+ * 共享对象的引用计数永远不会被 incrRefCount() 和 decrRefCount() 修改，
+ * 所以其他线程（比如惰性删除的后台线程）也可以安全地访问它们
+ */
+robj *makeObjectShared(robj *o) {
+    redisAssert(o->refcount == 1);
+    o->refcount = REDIS_SHARED_REFCOUNT;
+    return o;
+}
+
 /*
  * 增加对象的引用计数
  */
 void incrRefCount(robj *o) {
-    o->refcount++;
+    if (o->refcount != REDIS_SHARED_REFCOUNT) o->refcount++;
 }
 
 /*
@@ -328,7 +395,7 @@ void decrRefCount(void *obj) {
         zfree(o);
     } else {
         // 否则，只降低引用数
-        o->refcount--;
+        if (o->refcount != REDIS_SHARED_REFCOUNT) o->refcount--;
     }
 }
 
@@ -386,9 +453,10 @@ int isObjectRepresentableAsLongLong(robj *o, long long *llval) {
 robj *tryObjectEncoding(robj *o) {
     long value;
     sds s = o->ptr;
+    size_t len;
 
-    // 对象已编码?
-    if (o->encoding != REDIS_ENCODING_RAW)
+    // 对象已编码为整数?
+    if (!sdsEncodedObject(o))
         return o; /* Already encoded */
 
     /* It's not safe to encode shared objects: shared objects can be shared
@@ -404,7 +472,21 @@ robj *tryObjectEncoding(robj *o) {
     /* Check if we can represent this string as a long integer */
     // 尝试将字符串值转换为 long 整数
     // 转换失败直接返回 o ，转换成功时继续执行
-    if (!string2l(s,sdslen(s),&value)) return o;
+    len = sdslen(s);
+    if (len > 21 || !string2l(s,len,&value)) {
+        /* Short strings are moved into an EMBSTR object, so that a
+         * single allocation holds both the object and the string. */
+        // 不能编码为整数的短字符串，转换为 EMBSTR 编码
+        if (len <= REDIS_ENCODING_EMBSTR_SIZE_LIMIT &&
+            o->encoding == REDIS_ENCODING_RAW)
+        {
+            robj *emb = createEmbeddedStringObject(s,len);
+
+            decrRefCount(o);
+            return emb;
+        }
+        return o;
+    }
 
     /* Ok, this object can be encoded...
      *
@@ -412,9 +494,12 @@ robj *tryObjectEncoding(robj *o) {
      *
      * Note that we also avoid using shared integers when maxmemory is used
      * because every object needs to have a private LRU field for the LRU
-     * algorithm to work well. */
+     * algorithm to work well, and while the RDB loading threads are running,
+     * as they must not touch the reference count of shared objects. */
     // 执行到这一行时， value 保存的已经是一个 long 整数了
-    if (server.maxmemory == 0 && value >= 0 && value < REDIS_SHARED_INTEGERS) {
+    if (server.maxmemory == 0 && !server.rdb_load_unshared &&
+        value >= 0 && value < REDIS_SHARED_INTEGERS)
+    {
         // 看看 value 是否属于可共享值的范围
         // 如果是的话就用共享对象代替这个对象 o
         decrRefCount(o);
@@ -424,8 +509,9 @@ robj *tryObjectEncoding(robj *o) {
         return shared.integers[value];
     } else {
         // value 不属于共享范围，将它保存到对象 o 中
+        // 释放旧值， EMBSTR 的内容和对象在同一块内存中，不需要释放
+        if (o->encoding == REDIS_ENCODING_RAW) sdsfree(o->ptr);
         o->encoding = REDIS_ENCODING_INT;   // 更新编码方式
-        sdsfree(o->ptr);        // 释放旧值
         o->ptr = (void*) value; // 设置新值
 
         return o;
@@ -444,7 +530,7 @@ robj *getDecodedObject(robj *o) {
     robj *dec;
 
     // 返回未编码对象
-    if (o->encoding == REDIS_ENCODING_RAW) {
+    if (sdsEncodedObject(o)) {
         incrRefCount(o);
         return o;
     }
@@ -478,14 +564,14 @@ int compareStringObjects(robj *a, robj *b) {
     int bothsds = 1;
 
     if (a == b) return 0;
-    if (a->encoding != REDIS_ENCODING_RAW) {
+    if (!sdsEncodedObject(a)) {
         ll2string(bufa,sizeof(bufa),(long) a->ptr);
         astr = bufa;
         bothsds = 0;
     } else {
         astr = a->ptr;
     }
-    if (b->encoding != REDIS_ENCODING_RAW) {
+    if (!sdsEncodedObject(b)) {
         ll2string(bufb,sizeof(bufb),(long) b->ptr);
         bstr = bufb;
         bothsds = 0;
@@ -500,7 +586,7 @@ int compareStringObjects(robj *a, robj *b) {
  * this function is faster then checking for (compareStringObject(a,b) == 0)
  * because it can perform some more optimization. */
 int equalStringObjects(robj *a, robj *b) {
-    if (a->encoding != REDIS_ENCODING_RAW && b->encoding != REDIS_ENCODING_RAW){
+    if (a->encoding == REDIS_ENCODING_INT && b->encoding == REDIS_ENCODING_INT){
         return a->ptr == b->ptr;
     } else {
         return compareStringObjects(a,b) == 0;
@@ -509,7 +595,7 @@ int equalStringObjects(robj *a, robj *b) {
 
 size_t stringObjectLen(robj *o) {
     redisAssertWithInfo(NULL,o,o->type == REDIS_STRING);
-    if (o->encoding == REDIS_ENCODING_RAW) {
+    if (sdsEncodedObject(o)) {
         return sdslen(o->ptr);
     } else {
         char buf[32];
@@ -518,6 +604,21 @@ size_t stringObjectLen(robj *o) {
     }
 }
 
+/* Return the memory used by the string of a string object, not counting
+ * the robj header. For EMBSTR objects this is the part of the object
+ * allocation after the robj. */
+/*
+ * 返回 String 对象的字符串部分所占用的内存，不包括对象结构本身
+ */
+size_t getStringObjectSdsUsedMemory(robj *o) {
+    redisAssertWithInfo(NULL,o,o->type == REDIS_STRING);
+    switch(o->encoding) {
+    case REDIS_ENCODING_RAW: return zmalloc_size_sds(o->ptr);
+    case REDIS_ENCODING_EMBSTR: return zmalloc_size(o)-sizeof(robj);
+    default: return 0; /* Just integer encoding for now. */
+    }
+}
+
 int getDoubleFromObject(robj *o, double *target) {
     double value;
     char *eptr;
@@ -526,7 +627,7 @@ int getDoubleFromObject(robj *o, double *target) {
         value = 0;
     } else {
         redisAssertWithInfo(NULL,o,o->type == REDIS_STRING);
-        if (o->encoding == REDIS_ENCODING_RAW) {
+        if (sdsEncodedObject(o)) {
             errno = 0;
             value = strtod(o->ptr, &eptr);
             if (isspace(((char*)o->ptr)[0]) || eptr[0] != '\0' ||
@@ -564,7 +665,7 @@ int getLongDoubleFromObject(robj *o, long double *target) {
         value = 0;
     } else {
         redisAssertWithInfo(NULL,o,o->type == REDIS_STRING);
-        if (o->encoding == REDIS_ENCODING_RAW) {
+        if (sdsEncodedObject(o)) {
             errno = 0;
             value = strtold(o->ptr, &eptr);
             if (isspace(((char*)o->ptr)[0]) || eptr[0] != '\0' ||
@@ -610,7 +711,7 @@ int getLongLongFromObject(
     } else {
         redisAssertWithInfo(NULL,o,o->type == REDIS_STRING);
         // 根据不同编码，取出值
-        if (o->encoding == REDIS_ENCODING_RAW) {
+        if (sdsEncodedObject(o)) {
             errno = 0;
             value = strtoll(o->ptr, &eptr, 10);
             if (isspace(((char*)o->ptr)[0]) || eptr[0] != '\0' ||
@@ -673,16 +774,18 @@ char *strEncoding(int encoding) {
     switch(encoding) {
     case REDIS_ENCODING_RAW: return "raw";
     case REDIS_ENCODING_INT: return "int";
+    case REDIS_ENCODING_EMBSTR: return "embstr";
     case REDIS_ENCODING_HT: return "hashtable";
     case REDIS_ENCODING_LINKEDLIST: return "linkedlist";
     case REDIS_ENCODING_ZIPLIST: return "ziplist";
     case REDIS_ENCODING_INTSET: return "intset";
     case REDIS_ENCODING_SKIPLIST: return "skiplist";
+    case REDIS_ENCODING_QUICKLIST: return "quicklist";
     default: return "unknown";
     }
 }
 
-/* Given an object returns the min number of seconds the object was never
+/* Given an object returns the min number of milliseconds the object was never
  * requested, using an approximated LRU algorithm. */
 unsigned long estimateObjectIdleTime(robj *o) {
     if (server.lruclock >= o->lru) {
@@ -693,6 +796,82 @@ unsigned long estimateObjectIdleTime(robj *o) {
     }
 }
 
+/* ----------------------- LFU access frequency counter ---------------------- */
+
+/* Return the current time in minutes, using the 14 bits available in the
+ * lru field next to the counter. */
+// 返回以分钟为单位的当前时间（14 位，会回绕）
+static unsigned long LFUGetTimeInMinutes(void) {
+    return (server.unixtime/60) & REDIS_LFU_TIME_MAX;
+}
+
+/* Return the minutes elapsed since the time 'ldt', taking the wrapping of
+ * the clock into account. */
+static unsigned long LFUTimeElapsed(unsigned long ldt) {
+    unsigned long now = LFUGetTimeInMinutes();
+
+    if (now >= ldt) return now-ldt;
+    return REDIS_LFU_TIME_MAX-ldt+now;
+}
+
+/* Logarithmically increment a counter. The greater the current counter
+ * value, the less likely it is to be incremented: with the default
+ * lfu-log-factor of 10 the counter saturates after about one million
+ * accesses. */
+/*
+ * 以对数的方式增加计数器
+ *
+ * 计数器的值越大，增加的概率越小
+ */
+static unsigned long LFULogIncr(unsigned long counter) {
+    double r, baseval, p;
+
+    if (counter == REDIS_LFU_COUNTER_MAX) return counter;
+    r = (double)rand()/RAND_MAX;
+    baseval = (double)counter - REDIS_LFU_INIT_VAL;
+    if (baseval < 0) baseval = 0;
+    p = 1.0/(baseval*server.lfu_log_factor+1);
+    if (r < p) counter++;
+    return counter;
+}
+
+/* Return the LFU counter of the object, decremented by one for every
+ * lfu-decay-time minutes elapsed since the last access. The object is not
+ * modified: this is also used to rank eviction candidates. */
+/*
+ * 返回对象的 LFU 计数器，
+ * 自上次访问以来每经过 lfu-decay-time 分钟，计数器减一
+ */
+unsigned long LFUDecrAndReturn(robj *o) {
+    unsigned long ldt = o->lru >> 8;
+    unsigned long counter = o->lru & REDIS_LFU_COUNTER_MAX;
+    unsigned long num_periods = server.lfu_decay_time ?
+        LFUTimeElapsed(ldt) / server.lfu_decay_time : 0;
+
+    if (num_periods)
+        counter = (num_periods > counter) ? 0 : counter - num_periods;
+    return counter;
+}
+
+/* Update the LFU counter of an object that was just accessed: apply the
+ * decay, then increment the counter and store the access time. */
+// 对象被访问时，更新它的 LFU 计数器和访问时间
+void updateObjectLFU(robj *o) {
+    unsigned long counter = LFUDecrAndReturn(o);
+
+    counter = LFULogIncr(counter);
+    o->lru = (LFUGetTimeInMinutes()<<8) | counter;
+}
+
+/* Return the initial value of the lru field of a new object, that is the
+ * current LRU clock, or the initial LFU counter and the current time when
+ * an LFU maxmemory policy is selected. */
+unsigned int objectGetLRUOrLFU(void) {
+    if (REDIS_MAXMEMORY_IS_LFU(server.maxmemory_policy))
+        return (LFUGetTimeInMinutes()<<8) | REDIS_LFU_INIT_VAL;
+    return server.lruclock;
+}
+
 /* This is an helper function for the DEBUG command. We need to lookup keys
  * without any modification of LRU or other parameters. */
 robj *objectCommandLookup(redisClient *c, robj *key) {
@@ -729,9 +908,22 @@ void objectCommand(redisClient *c) {
     } else if (!strcasecmp(c->argv[1]->ptr,"idletime") && c->argc == 3) {
         if ((o = objectCommandLookupOrReply(c,c->argv[2],shared.nullbulk))
                 == NULL) return;
-        addReplyLongLong(c,estimateObjectIdleTime(o));
+        if (REDIS_MAXMEMORY_IS_LFU(server.maxmemory_policy)) {
+            addReplyError(c,"An LFU maxmemory policy is selected, idle time not tracked. Please note that when switching between policies at runtime LRU and LFU data will take some time to adjust.");
+            return;
+        }
+        addReplyLongLong(c,estimateObjectIdleTime(o)/1000);
+    // 查看 LFU 访问频率计数器
+    } else if (!strcasecmp(c->argv[1]->ptr,"freq") && c->argc == 3) {
+        if ((o = objectCommandLookupOrReply(c,c->argv[2],shared.nullbulk))
+                == NULL) return;
+        if (!REDIS_MAXMEMORY_IS_LFU(server.maxmemory_policy)) {
+            addReplyError(c,"An LFU maxmemory policy is not selected, access frequency not tracked. Please note that when switching between policies at runtime LRU and LFU data will take some time to adjust.");
+            return;
+        }
+        addReplyLongLong(c,LFUDecrAndReturn(o));
     } else {
-        addReplyError(c,"Syntax error. Try OBJECT (refcount|encoding|idletime)");
+        addReplyError(c,"Syntax error. Try OBJECT (refcount|encoding|idletime|freq)");
     }
 }
 
@@ -57,6 +57,68 @@ int listMatchPubsubPattern(void *a, void *b) {
            (equalStringObjects(pa->pattern,pb->pattern));
 }
 
+/* Return the length of the literal prefix of a glob-style pattern, that is
+ * the number of bytes before the first special character. Every channel
+ * matched by the pattern starts with this prefix. */
+/*
+ * 返回模式的字面前缀的长度，也即是第一个特殊字符之前的字节数量。
+ *
+ * 所有被模式匹配的频道都以这个前缀开头。
+ *
+ * T = O(N)
+ */
+static size_t pubsubPatternPrefixLen(sds pattern) {
+    size_t j, len = sdslen(pattern);
+
+    for (j = 0; j < len; j++) {
+        char c = pattern[j];
+
+        if (c == '*' || c == '?' || c == '[' || c == '\\') break;
+    }
+    return j;
+}
+
+/* Add the pattern record to the bucket of its literal prefix in
+ * server.pubsub_prefixes, creating the bucket if needed. */
+/*
+ * 将模式添加到它的字面前缀所对应的桶中，桶不存在时创建它
+ *
+ * T = O(M) ，M 为前缀的长度
+ */
+static void pubsubIndexPattern(pubsubPattern *pat) {
+    sds p = pat->pattern->ptr;
+    size_t plen = pubsubPatternPrefixLen(p);
+    void *bucket;
+
+    if (!radixFind(server.pubsub_prefixes,(unsigned char*)p,plen,&bucket)) {
+        bucket = listCreate();
+        radixInsert(server.pubsub_prefixes,(unsigned char*)p,plen,bucket);
+    }
+    pat->bucket = bucket;
+    listAddNodeTail(pat->bucket,pat);
+    pat->bucketnode = listLast(pat->bucket);
+}
+
+/* Remove the pattern record from its bucket, and the bucket from the
+ * prefix index if it is now empty. */
+/*
+ * 将模式从它的前缀桶中删除，如果桶变成了空桶，那么从索引中删除这个桶
+ *
+ * T = O(M) ，M 为前缀的长度
+ */
+static void pubsubUnindexPattern(pubsubPattern *pat) {
+    listDelNode(pat->bucket,pat->bucketnode);
+    if (listLength(pat->bucket) == 0) {
+        sds p = pat->pattern->ptr;
+
+        radixRemove(server.pubsub_prefixes,(unsigned char*)p,
+                    pubsubPatternPrefixLen(p));
+        listRelease(pat->bucket);
+    }
+    pat->bucket = NULL;
+    pat->bucketnode = NULL;
+}
+
 /* Subscribe a client to a channel. Returns 1 if the operation succeeded, or
  * 0 if the client was already subscribed to that channel. */
 /*
@@ -168,28 +230,34 @@ int pubsubUnsubscribeChannel(redisClient *c, robj *channel, int notify) {
  *
  * 订阅成功返回 1 ，如果已经订阅返回 0 。
  *
- * T = O(N)
+ * T = O(1)
  */
 int pubsubSubscribePattern(redisClient *c, robj *pattern) {
     int retval = 0;
 
-    // 如果 pattern 未保存在 c->pubsub_patterns 链表，那么。。。
-    // O(N)
-    if (listSearchKey(c->pubsub_patterns,pattern) == NULL) {
+    // 如果 pattern 未保存在 c->pubsub_patterns_dict 字典，那么。。。
+    // O(1)
+    if (dictFind(c->pubsub_patterns_dict,pattern) == NULL) {
         retval = 1;
         pubsubPattern *pat;
 
-        // 将模式加入客户端链表, O(1)
-        listAddNodeTail(c->pubsub_patterns,pattern);
-
-        incrRefCount(pattern);
-
+        /* The same record is referenced by the client, by the global list
+         * and by the prefix index, so that unsubscribing is O(1). */
         // 将模式和客户端信息记录到服务器
+        // 客户端链表和字典、服务器链表和前缀索引共享同一个记录
         // O(1)
         pat = zmalloc(sizeof(*pat));
         pat->pattern = getDecodedObject(pattern);
         pat->client = c;
         listAddNodeTail(server.pubsub_patterns,pat);
+        pat->node = listLast(server.pubsub_patterns);
+        pubsubIndexPattern(pat);
+
+        // 将模式加入客户端链表和字典, O(1)
+        listAddNodeTail(c->pubsub_patterns,pat);
+        pat->clientnode = listLast(c->pubsub_patterns);
+        incrRefCount(pat->pattern);
+        dictAdd(c->pubsub_patterns_dict,pat->pattern,pat);
     }
 
     /* Notify the client */
@@ -208,25 +276,25 @@ int pubsubSubscribePattern(redisClient *c, robj *pattern) {
  *
  * 退订成功返回 1 ，如果因为客户端并没有订阅模式而造成退订失败，返回 0
  *
- * T = O(N)
+ * T = O(1)
  */
 int pubsubUnsubscribePattern(redisClient *c, robj *pattern, int notify) {
-    listNode *ln;
-    pubsubPattern pat;
+    dictEntry *de;
     int retval = 0;
 
     incrRefCount(pattern); /* Protect the object. May be the same we remove */
-    // 客户端订阅了这个 pattern ？ , O(N)
-    if ((ln = listSearchKey(c->pubsub_patterns,pattern)) != NULL) {
+    // 客户端订阅了这个 pattern ？ , O(1)
+    if ((de = dictFind(c->pubsub_patterns_dict,pattern)) != NULL) {
+        pubsubPattern *pat = dictGetVal(de);
+
         retval = 1;
-        // 从客户端中移除 pattern , O(1)
-        listDelNode(c->pubsub_patterns,ln);
-        pat.client = c;
-        pat.pattern = pattern;
-        // 从服务器中移除这个 pattern ,O(N)
-        ln = listSearchKey(server.pubsub_patterns,&pat);
-        // O(1)
-        listDelNode(server.pubsub_patterns,ln);
+        // 从客户端的链表和字典中移除 pattern , O(1)
+        listDelNode(c->pubsub_patterns,pat->clientnode);
+        dictDelete(c->pubsub_patterns_dict,pattern);
+        // 从前缀索引中移除 pattern , O(1)
+        pubsubUnindexPattern(pat);
+        // 从服务器中移除 pattern 并释放记录, O(1)
+        listDelNode(server.pubsub_patterns,pat->node);
     }
     /* Notify the client */
     if (notify) {
@@ -267,7 +335,7 @@ int pubsubUnsubscribeAllChannels(redisClient *c, int notify) {
 /*
  * 让客户端退订所有模式
  *
- * T = O(N^2)
+ * T = O(N)
  */
 int pubsubUnsubscribeAllPatterns(redisClient *c, int notify) {
     listNode *ln;
@@ -276,69 +344,148 @@ int pubsubUnsubscribeAllPatterns(redisClient *c, int notify) {
 
     listRewind(c->pubsub_patterns,&li);
     while ((ln = listNext(&li)) != NULL) {
-        robj *pattern = ln->value;
+        pubsubPattern *pat = ln->value;
+        robj *pattern = pat->pattern;
 
-        // O(N)
+        // O(1)
         count += pubsubUnsubscribePattern(c,pattern,notify);
     }
     return count;
 }
 
+/* Append the bulk reply of 'len' bytes at 's' to the sds 'dst'. */
+static sds pubsubCatBulk(sds dst, char *s, size_t len) {
+    char buf[32];
+    int blen;
+
+    buf[0] = '$';
+    blen = 1+ll2string(buf+1,sizeof(buf)-1,(long long)len);
+    dst = sdscatlen(dst,buf,blen);
+    dst = sdscatlen(dst,"\r\n",2);
+    dst = sdscatlen(dst,s,len);
+    return sdscatlen(dst,"\r\n",2);
+}
+
+/* Create the bulk replies of the channel and of the message, serialized
+ * once per PUBLISH and added by reference to the output of every receiver
+ * with addReplyShared(). */
+/*
+ * 创建频道和消息的 bulk 回复。
+ *
+ * 每次 PUBLISH 只序列化一次，并通过 addReplyShared() 以引用的方式
+ * 添加到所有接收者的回复中。
+ */
+static robj *pubsubCreatePayload(robj *channel, robj *message) {
+    robj *msg = getDecodedObject(message);
+    size_t chlen = sdslen(channel->ptr), msglen = sdslen(msg->ptr);
+    sds s = sdsMakeRoomFor(sdsempty(),chlen+msglen+64);
+
+    s = pubsubCatBulk(s,channel->ptr,chlen);
+    s = pubsubCatBulk(s,msg->ptr,msglen);
+    decrRefCount(msg);
+    return createObject(REDIS_STRING,s);
+}
+
+/* State shared by pubsubPublishMessage() and the prefix index walk. */
+typedef struct pubsubPublishState {
+    robj *channel;      /* Decoded channel name */
+    robj *payload;      /* Channel and message bulks, see above */
+    int receivers;
+} pubsubPublishState;
+
+/* Called for every bucket of patterns whose literal prefix is a prefix of
+ * the channel: only those patterns can match it. */
+/*
+ * 对每个字面前缀是频道前缀的桶调用，
+ * 只有这些桶里的模式才可能匹配频道。
+ */
+static void pubsubPublishToBucket(void *bucket, void *privdata) {
+    pubsubPublishState *st = privdata;
+    robj *channel = st->channel;
+    listNode *ln;
+    listIter li;
+
+    listRewind(bucket,&li);
+    while ((ln = listNext(&li)) != NULL) {
+        pubsubPattern *pat = ln->value;
+
+        if (stringmatchlen((char*)pat->pattern->ptr,
+                            sdslen(pat->pattern->ptr),
+                            (char*)channel->ptr,
+                            sdslen(channel->ptr),0)) {
+
+            addReply(pat->client,shared.mbulkhdr[4]);   // 信息头
+            addReply(pat->client,shared.pmessagebulk);  // 信息类型
+            addReplyBulk(pat->client,pat->pattern);     // 匹配的模式
+            addReplyShared(pat->client,st->payload);    // 频道和消息正文
+
+            st->receivers++;
+        }
+    }
+}
+
 /* Publish a message */
 int pubsubPublishMessage(robj *channel, robj *message) {
     int receivers = 0;
     struct dictEntry *de;
-    listNode *ln;
-    listIter li;
+    robj *payload;
+
+    de = dictFind(server.pubsub_channels,channel);
+    if (de == NULL && listLength(server.pubsub_patterns) == 0) return 0;
+
+    channel = getDecodedObject(channel);
+    payload = pubsubCreatePayload(channel,message);
 
     /* Send to clients listening for that channel */
     // 取出所有订阅给定频道的客户端, O(1)
-    de = dictFind(server.pubsub_channels,channel);
     if (de) {
         list *list = dictGetVal(de);
         listNode *ln;
         listIter li;
+        robj *reply;
+        sds s;
+
+        /* The whole "message" reply is the same for every subscriber. */
+        // 所有订阅者收到的 message 回复都是相同的，只创建一次
+        s = sdsMakeRoomFor(sdsempty(),sdslen(payload->ptr)+32);
+        s = sdscatsds(s,shared.mbulkhdr[3]->ptr);
+        s = sdscatsds(s,shared.messagebulk->ptr);
+        s = sdscatsds(s,payload->ptr);
+        reply = createObject(REDIS_STRING,s);
 
         // 将信息发送至至所有订阅者, O(N)
         listRewind(list,&li);
         while ((ln = listNext(&li)) != NULL) {
             redisClient *c = ln->value;
 
-            addReply(c,shared.mbulkhdr[3]); // 信息头
-            addReply(c,shared.messagebulk); // 信息类型
-            addReplyBulk(c,channel);        // 来源频道
-            addReplyBulk(c,message);        // 信息正文
+            addReplyShared(c,reply);
 
             receivers++;
         }
+        decrRefCount(reply);
     }
 
     /* Send to clients listening to matching channels */
     // 匹配的数量不为 0 
     if (listLength(server.pubsub_patterns)) {
-        // 遍历所有模式，并将信息发送给匹配的模式
-        listRewind(server.pubsub_patterns,&li);
-        channel = getDecodedObject(channel);
-        while ((ln = listNext(&li)) != NULL) {
-            pubsubPattern *pat = ln->value;
-
-            if (stringmatchlen((char*)pat->pattern->ptr,
-                                sdslen(pat->pattern->ptr),
-                                (char*)channel->ptr,
-                                sdslen(channel->ptr),0)) {
-
-                addReply(pat->client,shared.mbulkhdr[4]);   // 信息头
-                addReply(pat->client,shared.pmessagebulk);  // 信息类型
-                addReplyBulk(pat->client,pat->pattern);     // 匹配的模式
-                addReplyBulk(pat->client,channel);          // 被匹配的频道
-                addReplyBulk(pat->client,message);          // 消息正文
-
-                receivers++;
-            }
-        }
-        decrRefCount(channel);
+        pubsubPublishState st;
+
+        /* Only the patterns indexed under a prefix of the channel are
+         * tried, instead of every pattern of every client. */
+        // 只尝试那些字面前缀是频道前缀的模式，而不是遍历所有模式
+        // O(L + M) ，L 为频道的长度，M 为候选模式的数量
+        st.channel = channel;
+        st.payload = payload;
+        st.receivers = 0;
+        radixWalkPrefixes(server.pubsub_prefixes,
+                          (unsigned char*)channel->ptr,
+                          sdslen(channel->ptr),
+                          pubsubPublishToBucket,&st);
+        receivers += st.receivers;
     }
 
+    decrRefCount(payload);
+    decrRefCount(channel);
     return receivers;
 }
 
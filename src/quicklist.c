@@ -0,0 +1,1666 @@
+/* quicklist.c - A doubly linked list of ziplists
+ *
+ * 快速列表：由 ziplist 节点组成的双端链表。
+ *
+ * A quicklist keeps the O(1) push/pop at both ends of a linked list, while
+ * storing the elements themselves in small ziplists: every node holds a
+ * bounded ziplist, so the per-element overhead of a listNode, a robj and an
+ * sds disappears, and no single ziplist grows big enough to make the
+ * memmove() of an insertion expensive.
+ *
+ * The size of every ziplist is bounded by the 'fill' factor: a positive
+ * value is the max number of entries of a node, a negative value from -1 to
+ * -5 limits the ziplist to 4, 8, 16, 32 or 64 kbytes. Nodes in the middle
+ * of the list can also be LZF compressed: 'compress' is the number of nodes
+ * at each end of the list that are never compressed, so that push and pop
+ * never pay for the compression.
+ *
+ * 每个节点的 ziplist 大小由 fill 限制，
+ * 除了两端各 compress 个节点之外，中间的节点可以用 LZF 压缩。
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h> /* for memcpy */
+#include "quicklist.h"
+#include "zmalloc.h"
+#include "ziplist.h"
+#include "util.h" /* for ll2string */
+#include "lzf.h"
+
+/* Optimization levels for size-based filling: fill -1 to -5. */
+/*
+ * fill 为负数时，节点 ziplist 允许的最大字节数
+ */
+static const size_t optimization_level[] = {4096, 8192, 16384, 32768, 65536};
+
+/* Maximum size in bytes of any multi-element ziplist.
+ * Larger values will live in their own isolated ziplists. */
+/*
+ * fill 为正数时，节点 ziplist 的字节数仍然不能超过这个值，
+ * 更大的元素会被放在只包含它自己的节点里
+ */
+#define SIZE_SAFETY_LIMIT 8192
+
+/* Minimum ziplist size in bytes for attempting compression. */
+// 小于这个字节数的 ziplist 不尝试压缩
+#define MIN_COMPRESS_BYTES 48
+
+/* Minimum size reduction in bytes to store compressed quicklistNode data.
+ * This also prevents us from storing compression if the compression
+ * resulted in a larger size than the original data. */
+// 压缩至少要节省这么多字节，否则保存原始 ziplist
+#define MIN_COMPRESS_IMPROVE 8
+
+/* Size in bytes of an empty ziplist (header + end marker). */
+#define ZIPLIST_EMPTY_SIZE 11
+
+/* Max number of entries of a node, the width of quicklistNode->count. */
+#define COUNT_LIMIT 65535
+
+/* Bookkeeping of the size of a node after its ziplist changed. */
+#define quicklistNodeUpdateSz(node)                                            \
+    do {                                                                       \
+        (node)->sz = ziplistBlobLen((node)->zl);                               \
+    } while (0)
+
+/* Create a new quicklist.
+ * Free with quicklistRelease(). */
+/*
+ * 创建一个新的 quicklist ，使用默认的 fill 和不压缩
+ */
+quicklist *quicklistCreate(void) {
+    struct quicklist *quicklist;
+
+    quicklist = zmalloc(sizeof(*quicklist));
+    quicklist->head = quicklist->tail = NULL;
+    quicklist->len = 0;
+    quicklist->count = 0;
+    quicklist->compress = 0;
+    quicklist->fill = -2;
+    return quicklist;
+}
+
+#define COMPRESS_MAX (1 << 16)
+/*
+ * 设置两端不压缩的节点数量
+ */
+void quicklistSetCompressDepth(quicklist *quicklist, int compress) {
+    if (compress > COMPRESS_MAX) {
+        compress = COMPRESS_MAX;
+    } else if (compress < 0) {
+        compress = 0;
+    }
+    quicklist->compress = compress;
+}
+
+#define FILL_MAX (1 << 15)
+/*
+ * 设置节点的填充因子
+ */
+void quicklistSetFill(quicklist *quicklist, int fill) {
+    if (fill > FILL_MAX) {
+        fill = FILL_MAX;
+    } else if (fill < -5) {
+        fill = -5;
+    }
+    quicklist->fill = fill;
+}
+
+void quicklistSetOptions(quicklist *quicklist, int fill, int depth) {
+    quicklistSetFill(quicklist, fill);
+    quicklistSetCompressDepth(quicklist, depth);
+}
+
+/* Create a new quicklist with some default parameters. */
+quicklist *quicklistNew(int fill, int compress) {
+    quicklist *quicklist = quicklistCreate();
+    quicklistSetOptions(quicklist, fill, compress);
+    return quicklist;
+}
+
+/*
+ * 创建一个空节点
+ */
+static quicklistNode *quicklistCreateNode(void) {
+    quicklistNode *node;
+    node = zmalloc(sizeof(*node));
+    node->zl = NULL;
+    node->count = 0;
+    node->sz = 0;
+    node->next = node->prev = NULL;
+    node->encoding = QUICKLIST_NODE_ENCODING_RAW;
+    node->recompress = 0;
+    node->extra = 0;
+    return node;
+}
+
+/* Return cached quicklist count */
+/*
+ * 返回 quicklist 中的元素数量
+ *
+ * T = O(1)
+ */
+unsigned long quicklistCount(const quicklist *ql) { return ql->count; }
+
+/* Free entire quicklist. */
+/*
+ * 释放整个 quicklist
+ *
+ * T = O(N)
+ */
+void quicklistRelease(quicklist *quicklist) {
+    unsigned long len;
+    quicklistNode *current, *next;
+
+    current = quicklist->head;
+    len = quicklist->len;
+    while (len--) {
+        next = current->next;
+
+        zfree(current->zl);
+        quicklist->count -= current->count;
+
+        zfree(current);
+
+        quicklist->len--;
+        current = next;
+    }
+    zfree(quicklist);
+}
+
+/* Compress the ziplist in 'node' and update encoding details.
+ * Returns 1 if ziplist compressed successfully.
+ * Returns 0 if compression failed or if ziplist too small to compress. */
+/*
+ * 用 LZF 压缩节点的 ziplist
+ *
+ * 压缩成功返回 1 ，ziplist 太小或者压缩效果不好时返回 0 。
+ */
+static int __quicklistCompressNode(quicklistNode *node) {
+    quicklistLZF *lzf;
+
+    node->recompress = 0;
+
+    /* Don't bother compressing small values */
+    if (node->sz < MIN_COMPRESS_BYTES) return 0;
+
+    lzf = zmalloc(sizeof(*lzf) + node->sz);
+
+    /* Cancel if compression fails or doesn't compress small enough */
+    if (((lzf->sz = lzf_compress(node->zl, node->sz, lzf->compressed,
+                                 node->sz)) == 0) ||
+        lzf->sz + MIN_COMPRESS_IMPROVE >= node->sz) {
+        /* lzf_compress aborts/rejects compression if value not compressable. */
+        zfree(lzf);
+        return 0;
+    }
+    lzf = zrealloc(lzf, sizeof(*lzf) + lzf->sz);
+    zfree(node->zl);
+    node->zl = (unsigned char *)lzf;
+    node->encoding = QUICKLIST_NODE_ENCODING_LZF;
+    return 1;
+}
+
+/* Compress only uncompressed nodes. */
+#define quicklistCompressNode(_node)                                           \
+    do {                                                                       \
+        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_RAW) {     \
+            __quicklistCompressNode((_node));                                  \
+        }                                                                      \
+    } while (0)
+
+/* Uncompress the ziplist in 'node' and update encoding details.
+ * Returns 1 on successful decode, 0 on failure to decode. */
+/*
+ * 解压节点的 ziplist
+ */
+static int __quicklistDecompressNode(quicklistNode *node) {
+    void *decompressed = zmalloc(node->sz);
+    quicklistLZF *lzf = (quicklistLZF *)node->zl;
+    if (lzf_decompress(lzf->compressed, lzf->sz, decompressed, node->sz) == 0) {
+        /* Someone requested decompress, but we can't decompress.  Not good. */
+        zfree(decompressed);
+        return 0;
+    }
+    zfree(lzf);
+    node->zl = decompressed;
+    node->encoding = QUICKLIST_NODE_ENCODING_RAW;
+    return 1;
+}
+
+/* Decompress only compressed nodes. */
+#define quicklistDecompressNode(_node)                                         \
+    do {                                                                       \
+        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_LZF) {     \
+            __quicklistDecompressNode((_node));                                \
+            (_node)->recompress = 0;                                           \
+        }                                                                      \
+    } while (0)
+
+/* Force node to not be immediately re-compresable */
+/*
+ * 为了读写节点而临时解压它，用完之后需要调用 quicklistRecompressOnly()
+ */
+#define quicklistDecompressNodeForUse(_node)                                   \
+    do {                                                                       \
+        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_LZF) {     \
+            __quicklistDecompressNode((_node));                                \
+            (_node)->recompress = 1;                                           \
+        }                                                                      \
+    } while (0)
+
+/* Extract the raw LZF data from this quicklistNode.
+ * Pointer to LZF data is assigned to '*data'.
+ * Return value is the length of compressed LZF data. */
+/*
+ * 取出被压缩节点的 LZF 数据，用于直接保存到 RDB
+ */
+size_t quicklistGetLzf(const quicklistNode *node, void **data) {
+    quicklistLZF *lzf = (quicklistLZF *)node->zl;
+    *data = lzf->compressed;
+    return lzf->sz;
+}
+
+#define quicklistAllowsCompression(_ql) ((_ql)->compress != 0)
+
+/* Force 'quicklist' to meet compression guidelines set by compress depth.
+ * The only way to guarantee interior nodes get compressed is to iterate
+ * to our "interior" compress depth then compress the next node we find.
+ * If compress depth is larger than the entire list, we return immediately. */
+/*
+ * 保证两端各 compress 个节点没有被压缩，
+ * 并且压缩刚好位于这个深度之外的节点，以及给定的 node （如果它不在两端的话）。
+ *
+ * T = O(compress)
+ */
+static void __quicklistCompress(const quicklist *quicklist,
+                                quicklistNode *node) {
+    quicklistNode *forward, *reverse;
+    int depth = 0;
+    int in_depth = 0;
+
+    /* If length is less than our compress depth (from both sides),
+     * we can't compress anything. */
+    if (!quicklistAllowsCompression(quicklist) || quicklist->len == 0)
+        return;
+
+    /* Iterate until we reach compress depth for both sides of the list.
+     * Note: because we do length checks at the *top* of this function,
+     *       we can skip explicit null checks below. Everything exists. */
+    forward = quicklist->head;
+    reverse = quicklist->tail;
+    while (depth++ < quicklist->compress) {
+        quicklistDecompressNode(forward);
+        quicklistDecompressNode(reverse);
+
+        /* A node that was decompressed for use before moving within the
+         * depth must not be compressed again by quicklistRecompressOnly(). */
+        forward->recompress = 0;
+        reverse->recompress = 0;
+
+        if (forward == node || reverse == node)
+            in_depth = 1;
+
+        /* The whole list is within the uncompressed depth. */
+        if (forward == reverse || forward->next == reverse)
+            return;
+
+        forward = forward->next;
+        reverse = reverse->prev;
+    }
+
+    if (!in_depth)
+        quicklistCompressNode(node);
+
+    /* At this point, forward and reverse are one node beyond depth */
+    quicklistCompressNode(forward);
+    quicklistCompressNode(reverse);
+}
+
+/* Enforce the compression depth around 'node': it gets compressed again
+ * unless it is one of the uncompressed nodes at the ends of the list. */
+#define quicklistCompress(_ql, _node)                                          \
+    do {                                                                       \
+        (_node)->recompress = 0;                                               \
+        __quicklistCompress((_ql), (_node));                                   \
+    } while (0)
+
+/* If we previously used quicklistDecompressNodeForUse(), just recompress. */
+#define quicklistRecompressOnly(_ql, _node)                                    \
+    do {                                                                       \
+        if ((_node)->recompress)                                               \
+            quicklistCompressNode((_node));                                    \
+    } while (0)
+
+/* Insert 'new_node' after 'old_node' if 'after' is 1.
+ * Insert 'new_node' before 'old_node' if 'after' is 0.
+ * Note: 'new_node' is *always* uncompressed, so if we assign it to
+ *       head or tail, we do not need to uncompress it. */
+/*
+ * 将 new_node 插入到 old_node 之后（after 为 1）或之前（after 为 0）
+ *
+ * T = O(1)
+ */
+static void __quicklistInsertNode(quicklist *quicklist,
+                                  quicklistNode *old_node,
+                                  quicklistNode *new_node, int after) {
+    if (after) {
+        new_node->prev = old_node;
+        if (old_node) {
+            new_node->next = old_node->next;
+            if (old_node->next)
+                old_node->next->prev = new_node;
+            old_node->next = new_node;
+        }
+        if (quicklist->tail == old_node)
+            quicklist->tail = new_node;
+    } else {
+        new_node->next = old_node;
+        if (old_node) {
+            new_node->prev = old_node->prev;
+            if (old_node->prev)
+                old_node->prev->next = new_node;
+            old_node->prev = new_node;
+        }
+        if (quicklist->head == old_node)
+            quicklist->head = new_node;
+    }
+    /* If this insert creates the only element so far, initialize head/tail. */
+    if (quicklist->len == 0) {
+        quicklist->head = quicklist->tail = new_node;
+    }
+
+    /* Update len first, so in __quicklistCompress we know exactly len */
+    quicklist->len++;
+
+    if (old_node)
+        quicklistCompress(quicklist, old_node);
+}
+
+/* Wrappers for node inserting around existing node. */
+static void _quicklistInsertNodeBefore(quicklist *quicklist,
+                                       quicklistNode *old_node,
+                                       quicklistNode *new_node) {
+    __quicklistInsertNode(quicklist, old_node, new_node, 0);
+}
+
+static void _quicklistInsertNodeAfter(quicklist *quicklist,
+                                      quicklistNode *old_node,
+                                      quicklistNode *new_node) {
+    __quicklistInsertNode(quicklist, old_node, new_node, 1);
+}
+
+/*
+ * 检查 sz 字节的 ziplist 能否满足 fill 为负数时的大小限制
+ */
+static int _quicklistNodeSizeMeetsOptimizationRequirement(const size_t sz,
+                                                          const int fill) {
+    size_t offset;
+
+    if (fill >= 0)
+        return 0;
+
+    offset = (-fill) - 1;
+    if (offset < (sizeof(optimization_level) / sizeof(*optimization_level))) {
+        if (sz <= optimization_level[offset]) {
+            return 1;
+        } else {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+}
+
+#define sizeMeetsSafetyLimit(sz) ((sz) <= SIZE_SAFETY_LIMIT)
+
+/*
+ * 检查能否将一个 sz 字节的值添加到 node 的 ziplist 中，
+ * 而不超过 fill 的限制
+ */
+static int _quicklistNodeAllowInsert(const quicklistNode *node,
+                                     const int fill, const size_t sz) {
+    int ziplist_overhead;
+    unsigned int new_sz;
+
+    if (node == NULL)
+        return 0;
+
+    /* size of previous offset */
+    if (sz < 254)
+        ziplist_overhead = 1;
+    else
+        ziplist_overhead = 5;
+
+    /* size of forward offset */
+    if (sz < 64)
+        ziplist_overhead += 1;
+    else if (sz < 16384)
+        ziplist_overhead += 2;
+    else
+        ziplist_overhead += 5;
+
+    /* new_sz overestimates if 'sz' encodes to an integer type */
+    new_sz = node->sz + sz + ziplist_overhead;
+    if (node->count >= COUNT_LIMIT)
+        return 0;
+    else if (_quicklistNodeSizeMeetsOptimizationRequirement(new_sz, fill))
+        return 1;
+    else if (!sizeMeetsSafetyLimit(new_sz))
+        return 0;
+    else if ((int)node->count < fill)
+        return 1;
+    else
+        return 0;
+}
+
+/*
+ * 检查能否把节点 a 和 b 合并为一个节点，而不超过 fill 的限制
+ */
+static int _quicklistNodeAllowMerge(const quicklistNode *a,
+                                    const quicklistNode *b,
+                                    const int fill) {
+    unsigned int merge_sz;
+
+    if (!a || !b)
+        return 0;
+
+    /* approximate merged ziplist size (- 11 to remove one ziplist
+     * header/trailer) */
+    merge_sz = a->sz + b->sz - ZIPLIST_EMPTY_SIZE;
+    if (a->count + b->count > COUNT_LIMIT)
+        return 0;
+    else if (_quicklistNodeSizeMeetsOptimizationRequirement(merge_sz, fill))
+        return 1;
+    else if (!sizeMeetsSafetyLimit(merge_sz))
+        return 0;
+    else if ((int)(a->count + b->count) <= fill)
+        return 1;
+    else
+        return 0;
+}
+
+/* Add new entry to head node of quicklist.
+ *
+ * Returns 0 if used existing head.
+ * Returns 1 if new head created. */
+/*
+ * 将值推入到 quicklist 的表头
+ *
+ * 如果表头节点已满，那么创建一个新的表头节点。
+ *
+ * T = O(1) （ziplist 的大小是有限的）
+ */
+int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
+    quicklistNode *orig_head = quicklist->head;
+
+    if (_quicklistNodeAllowInsert(quicklist->head, quicklist->fill, sz)) {
+        quicklistDecompressNodeForUse(quicklist->head);
+        quicklist->head->zl =
+            ziplistPush(quicklist->head->zl, value, sz, ZIPLIST_HEAD);
+        quicklistNodeUpdateSz(quicklist->head);
+        quicklistRecompressOnly(quicklist, quicklist->head);
+    } else {
+        quicklistNode *node = quicklistCreateNode();
+        node->zl = ziplistPush(ziplistNew(), value, sz, ZIPLIST_HEAD);
+
+        quicklistNodeUpdateSz(node);
+        _quicklistInsertNodeBefore(quicklist, quicklist->head, node);
+    }
+    quicklist->count++;
+    quicklist->head->count++;
+    return (orig_head != quicklist->head);
+}
+
+/* Add new entry to tail node of quicklist.
+ *
+ * Returns 0 if used existing tail.
+ * Returns 1 if new tail created. */
+/*
+ * 将值推入到 quicklist 的表尾
+ *
+ * T = O(1)
+ */
+int quicklistPushTail(quicklist *quicklist, void *value, size_t sz) {
+    quicklistNode *orig_tail = quicklist->tail;
+
+    if (_quicklistNodeAllowInsert(quicklist->tail, quicklist->fill, sz)) {
+        quicklistDecompressNodeForUse(quicklist->tail);
+        quicklist->tail->zl =
+            ziplistPush(quicklist->tail->zl, value, sz, ZIPLIST_TAIL);
+        quicklistNodeUpdateSz(quicklist->tail);
+        quicklistRecompressOnly(quicklist, quicklist->tail);
+    } else {
+        quicklistNode *node = quicklistCreateNode();
+        node->zl = ziplistPush(ziplistNew(), value, sz, ZIPLIST_TAIL);
+
+        quicklistNodeUpdateSz(node);
+        _quicklistInsertNodeAfter(quicklist, quicklist->tail, node);
+    }
+    quicklist->count++;
+    quicklist->tail->count++;
+    return (orig_tail != quicklist->tail);
+}
+
+/* Create new node consisting of a pre-formed ziplist.
+ * Used for loading RDBs where entire ziplists have been stored
+ * to be retrieved later. */
+/*
+ * 将一个已经创建好的 ziplist 作为新节点添加到表尾，
+ * quicklist 获得 zl 的所有权。
+ *
+ * 载入 RDB 时使用。
+ */
+void quicklistAppendZiplist(quicklist *quicklist, unsigned char *zl) {
+    quicklistNode *node = quicklistCreateNode();
+
+    node->zl = zl;
+    node->count = ziplistLen(node->zl);
+    node->sz = ziplistBlobLen(zl);
+
+    _quicklistInsertNodeAfter(quicklist, quicklist->tail, node);
+    quicklist->count += node->count;
+}
+
+/* Append all values of ziplist 'zl' individually into 'quicklist'.
+ *
+ * This allows us to restore old RDB ziplists into new quicklists
+ * with smaller ziplist sizes than the saved RDB ziplist.
+ *
+ * Returns 'quicklist' argument. Frees passed-in ziplist 'zl' */
+/*
+ * 将 ziplist 中的每个值逐个推入到 quicklist 的表尾，然后释放 zl 。
+ *
+ * 用于把旧版本 RDB 中的 ziplist 编码列表转换为 quicklist 。
+ */
+quicklist *quicklistAppendValuesFromZiplist(quicklist *quicklist,
+                                            unsigned char *zl) {
+    unsigned char *value;
+    unsigned int sz;
+    long long longval;
+    char longstr[32] = {0};
+
+    unsigned char *p = ziplistIndex(zl, 0);
+    while (ziplistGet(p, &value, &sz, &longval)) {
+        if (!value) {
+            /* Write the longval as a string so we can re-add it */
+            sz = ll2string(longstr, sizeof(longstr), longval);
+            value = (unsigned char *)longstr;
+        }
+        quicklistPushTail(quicklist, value, sz);
+        p = ziplistNext(zl, p);
+    }
+    zfree(zl);
+    return quicklist;
+}
+
+/* Create new (potentially multi-node) quicklist from a single existing ziplist.
+ *
+ * Returns new quicklist.  Frees passed-in ziplist 'zl'. */
+quicklist *quicklistCreateFromZiplist(int fill, int compress,
+                                      unsigned char *zl) {
+    return quicklistAppendValuesFromZiplist(quicklistNew(fill, compress), zl);
+}
+
+/*
+ * 从 quicklist 中删除并释放节点
+ */
+static void __quicklistDelNode(quicklist *quicklist, quicklistNode *node) {
+    if (node->next)
+        node->next->prev = node->prev;
+    if (node->prev)
+        node->prev->next = node->next;
+
+    if (node == quicklist->tail) {
+        quicklist->tail = node->prev;
+    }
+
+    if (node == quicklist->head) {
+        quicklist->head = node->next;
+    }
+
+    /* Update len first, so in __quicklistCompress we know exactly len */
+    quicklist->len--;
+    quicklist->count -= node->count;
+
+    /* If we deleted a node within our compress depth, we
+     * now have compressed nodes needing to be decompressed. */
+    __quicklistCompress(quicklist, NULL);
+
+    zfree(node->zl);
+    zfree(node);
+}
+
+/* Delete one entry from list given the node for the entry and a pointer
+ * to the entry in the node.
+ *
+ * Note: quicklistDelIndex() *requires* uncompressed nodes because you
+ *       already had to get *p from an uncompressed node somewhere.
+ *
+ * Returns 1 if the entire node was deleted, 0 if node still exists.
+ * Also updates in/out param 'p' with the next offset in the ziplist. */
+/*
+ * 删除节点 node 中 p 指向的元素，
+ * 如果节点因此变空，那么删除整个节点并返回 1 ，否则返回 0 。
+ */
+static int quicklistDelIndex(quicklist *quicklist, quicklistNode *node,
+                             unsigned char **p) {
+    int gone = 0;
+
+    node->zl = ziplistDelete(node->zl, p);
+    node->count--;
+    if (node->count == 0) {
+        gone = 1;
+        __quicklistDelNode(quicklist, node);
+    } else {
+        quicklistNodeUpdateSz(node);
+    }
+    quicklist->count--;
+    /* If we deleted the node, the original node is no longer valid */
+    return gone ? 1 : 0;
+}
+
+/* Delete one element represented by 'entry'
+ *
+ * 'entry' stores enough metadata to delete the proper position in
+ * the correct ziplist in the correct quicklist node. */
+/*
+ * 删除迭代器当前返回的元素 entry ，并调整迭代器，
+ * 使得下次调用 quicklistNext() 时返回被删除元素之后（按迭代方向）的元素。
+ */
+void quicklistDelEntry(quicklistIter *iter, quicklistEntry *entry) {
+    quicklistNode *prev = entry->node->prev;
+    quicklistNode *next = entry->node->next;
+    int deleted_node = quicklistDelIndex((quicklist *)entry->quicklist,
+                                         entry->node, &entry->zi);
+
+    /* after delete, the zi is now invalid for any future usage. */
+    iter->zi = NULL;
+
+    /* If current node is deleted, we must update iterator node and offset. */
+    if (deleted_node) {
+        if (iter->direction == AL_START_HEAD) {
+            iter->current = next;
+            iter->offset = 0;
+        } else if (iter->direction == AL_START_TAIL) {
+            iter->current = prev;
+            iter->offset = -1;
+        }
+    }
+    /* else if (!deleted_node), no changes needed.
+     * we already reset iter->zi above, and the existing iter->offset
+     * doesn't move again because:
+     *   - [1, 2, 3] => delete offset 1 => [1, 3]: next element still offset 1
+     *   - [1, 2, 3] => delete offset 0 => [2, 3]: next element still offset 0
+     *  if we deleted the last element at offet N and now
+     *  length of this ziplist is N-1, the next call into
+     *  quicklistNext() will jump to the next node.
+     *  Iterating from the tail the offsets are negative, so deleting
+     *  offset -2 of [1, 2, 3] leaves the next element 1 at offset -2. */
+}
+
+/* Replace quicklist entry at offset 'index' by 'data' with length 'sz'.
+ *
+ * Returns 1 if replace happened.
+ * Returns 0 if replace failed and no changes happened. */
+/*
+ * 用 data 替换 index 处的元素
+ *
+ * 替换成功返回 1 ，index 越界返回 0 。
+ */
+int quicklistReplaceAtIndex(quicklist *quicklist, long index, void *data,
+                            int sz) {
+    quicklistEntry entry;
+
+    if (quicklistIndex(quicklist, index, &entry)) {
+        /* quicklistIndex provides an uncompressed node */
+        entry.node->zl = ziplistDelete(entry.node->zl, &entry.zi);
+        entry.node->zl = ziplistInsert(entry.node->zl, entry.zi, data, sz);
+        quicklistNodeUpdateSz(entry.node);
+        quicklistCompress(quicklist, entry.node);
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* Given two adjacent nodes, merge their ziplists into a single node.
+ *
+ * This helps us not have a quicklist with 3 element ziplists if
+ * our fill factor can handle much higher levels.
+ *
+ * Note: 'a' must be to the LEFT of 'b'. If 'keep_b' is 0 the elements of
+ * 'b' are appended to 'a' and 'b' is deleted, otherwise the elements of
+ * 'a' are prepended to 'b' and 'a' is deleted. Callers use 'keep_b' to
+ * make sure the node referenced by an iterator or entry stays valid.
+ *
+ * Returns the node that was kept. */
+/*
+ * 合并相邻的节点 a 和 b （a 在 b 的左边），
+ * 根据 keep_b 决定保留哪个节点，另一个节点会被删除。
+ *
+ * 返回被保留的节点。
+ */
+static quicklistNode *_quicklistZiplistMerge(quicklist *quicklist,
+                                             quicklistNode *a,
+                                             quicklistNode *b,
+                                             int keep_b) {
+    quicklistNode *keep = keep_b ? b : a;
+    quicklistNode *gone = keep_b ? a : b;
+    unsigned char *p, *value;
+    unsigned int sz;
+    long long longval;
+    char longstr[32];
+
+    quicklistDecompressNode(a);
+    quicklistDecompressNode(b);
+
+    /* Walk 'gone' away from 'keep', so that pushing every element at the
+     * near end of 'keep' preserves the order. */
+    p = ziplistIndex(gone->zl, keep_b ? -1 : 0);
+    while (ziplistGet(p, &value, &sz, &longval)) {
+        if (!value) {
+            sz = ll2string(longstr, sizeof(longstr), longval);
+            value = (unsigned char *)longstr;
+        }
+        keep->zl = ziplistPush(keep->zl, value, sz,
+                               keep_b ? ZIPLIST_HEAD : ZIPLIST_TAIL);
+        p = keep_b ? ziplistPrev(gone->zl, p) : ziplistNext(gone->zl, p);
+    }
+    keep->count += gone->count;
+    quicklistNodeUpdateSz(keep);
+
+    /* 'gone' no longer owns any element of the list: remove it without
+     * touching the total count. */
+    gone->count = 0;
+    __quicklistDelNode(quicklist, gone);
+    quicklistCompress(quicklist, keep);
+    return keep;
+}
+
+/* Attempt to merge ziplists within two nodes on either side of 'center'.
+ *
+ * We attempt to merge:
+ *   - (center->prev->prev, center->prev)
+ *   - (center->next, center->next->next)
+ *   - (center->prev, center)
+ *   - (center, center->next)
+ *
+ * 'center' itself is never freed.
+ */
+/*
+ * 尝试合并 center 两侧的节点，避免插入操作之后留下很多半空的节点
+ */
+static void _quicklistMergeNodes(quicklist *quicklist, quicklistNode *center) {
+    int fill = quicklist->fill;
+    quicklistNode *prev, *prev_prev, *next, *next_next;
+    prev = prev_prev = next = next_next = NULL;
+
+    if (center->prev) {
+        prev = center->prev;
+        if (center->prev->prev)
+            prev_prev = center->prev->prev;
+    }
+
+    if (center->next) {
+        next = center->next;
+        if (center->next->next)
+            next_next = center->next->next;
+    }
+
+    /* Try to merge prev_prev and prev */
+    if (_quicklistNodeAllowMerge(prev, prev_prev, fill))
+        _quicklistZiplistMerge(quicklist, prev_prev, prev, 0);
+
+    /* Try to merge next and next_next */
+    if (_quicklistNodeAllowMerge(next, next_next, fill))
+        _quicklistZiplistMerge(quicklist, next, next_next, 0);
+
+    /* Try to merge center node and previous node */
+    if (_quicklistNodeAllowMerge(center->prev, center, fill))
+        _quicklistZiplistMerge(quicklist, center->prev, center, 1);
+
+    /* Then try to merge center with the next node. */
+    if (_quicklistNodeAllowMerge(center, center->next, fill))
+        _quicklistZiplistMerge(quicklist, center, center->next, 0);
+}
+
+/* Split 'node' into two parts, parameterized by 'offset' and 'after'.
+ *
+ * The 'after' argument controls which quicklistNode gets returned.
+ * If 'after'==1, returned node has elements after 'offset'.
+ *                input node keeps elements up to 'offset', including 'offset'.
+ * If 'after'==0, returned node has elements up to 'offset', excluding 'offset'.
+ *                input node keeps elements after 'offset', including 'offset'.
+ *
+ * 'offset' must be non negative and the node must be uncompressed.
+ *
+ * Returns newly created node or NULL if split not possible. */
+/*
+ * 在 offset 处把节点分成两个，返回新创建的节点（尚未加入 quicklist ）
+ */
+static quicklistNode *_quicklistSplitNode(quicklistNode *node, int offset,
+                                          int after) {
+    size_t zl_sz = node->sz;
+    int count = node->count;
+
+    quicklistNode *new_node = quicklistCreateNode();
+    new_node->zl = zmalloc(zl_sz);
+
+    /* Copy original ziplist so we can split it */
+    memcpy(new_node->zl, node->zl, zl_sz);
+
+    if (after) {
+        /* node keeps [0, offset], new_node gets [offset+1, count-1] */
+        node->zl = ziplistDeleteRange(node->zl, offset + 1, count - offset - 1);
+        node->count = offset + 1;
+        new_node->zl = ziplistDeleteRange(new_node->zl, 0, offset + 1);
+        new_node->count = count - offset - 1;
+    } else {
+        /* node keeps [offset, count-1], new_node gets [0, offset-1] */
+        node->zl = ziplistDeleteRange(node->zl, 0, offset);
+        node->count = count - offset;
+        new_node->zl = ziplistDeleteRange(new_node->zl, offset, count - offset);
+        new_node->count = offset;
+    }
+    quicklistNodeUpdateSz(node);
+    quicklistNodeUpdateSz(new_node);
+
+    return new_node;
+}
+
+/* Insert a new entry before or after existing entry 'entry'.
+ *
+ * If after==1, the new value is inserted after 'entry', otherwise
+ * the new value is inserted before 'entry'. */
+/*
+ * 将值插入到 entry 之前或之后
+ *
+ * 如果 entry 所在的节点已满，那么尝试插入到相邻的节点，
+ * 或者创建新节点，或者在 entry 处分裂节点。
+ */
+static void _quicklistInsert(quicklist *quicklist, quicklistEntry *entry,
+                             void *value, const size_t sz, int after) {
+    int full = 0, at_tail = 0, at_head = 0, full_next = 0, full_prev = 0;
+    int fill = quicklist->fill;
+    int offset;
+    quicklistNode *node = entry->node;
+    quicklistNode *new_node = NULL;
+
+    if (!node) {
+        /* we have no reference node, so let's create only node in the list */
+        new_node = quicklistCreateNode();
+        new_node->zl = ziplistPush(ziplistNew(), value, sz, ZIPLIST_HEAD);
+        __quicklistInsertNode(quicklist, NULL, new_node, after);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        quicklist->count++;
+        return;
+    }
+
+    /* Entries returned by the iterator use negative offsets when walking
+     * from the tail, work with the positive offset from now on. */
+    offset = entry->offset < 0 ? (int)node->count + entry->offset
+                               : entry->offset;
+
+    /* Populate accounting flags for easier boolean checks later */
+    if (!_quicklistNodeAllowInsert(node, fill, sz))
+        full = 1;
+
+    if (after && offset == (int)node->count - 1) {
+        at_tail = 1;
+        if (!_quicklistNodeAllowInsert(node->next, fill, sz))
+            full_next = 1;
+    }
+
+    if (!after && offset == 0) {
+        at_head = 1;
+        if (!_quicklistNodeAllowInsert(node->prev, fill, sz))
+            full_prev = 1;
+    }
+
+    /* Now determine where and how to insert the new element */
+    if (!full) {
+        /* Insert into the current node. The entry pointer could be stale
+         * if the node was compressed meanwhile, so seek it again. */
+        unsigned char *p;
+
+        quicklistDecompressNodeForUse(node);
+        p = ziplistIndex(node->zl, offset);
+        if (after) {
+            unsigned char *next = ziplistNext(node->zl, p);
+            if (next == NULL) {
+                node->zl = ziplistPush(node->zl, value, sz, ZIPLIST_TAIL);
+            } else {
+                node->zl = ziplistInsert(node->zl, next, value, sz);
+            }
+        } else {
+            node->zl = ziplistInsert(node->zl, p, value, sz);
+        }
+        node->count++;
+        quicklistNodeUpdateSz(node);
+        quicklistRecompressOnly(quicklist, node);
+    } else if (at_tail && node->next && !full_next) {
+        /* If we are: at tail, next has free space, and inserting after:
+         *   - insert entry at head of next node. */
+        new_node = node->next;
+        quicklistDecompressNodeForUse(new_node);
+        new_node->zl = ziplistPush(new_node->zl, value, sz, ZIPLIST_HEAD);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        quicklistRecompressOnly(quicklist, new_node);
+    } else if (at_head && node->prev && !full_prev) {
+        /* If we are: at head, previous has free space, and inserting before:
+         *   - insert entry at tail of previous node. */
+        new_node = node->prev;
+        quicklistDecompressNodeForUse(new_node);
+        new_node->zl = ziplistPush(new_node->zl, value, sz, ZIPLIST_TAIL);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        quicklistRecompressOnly(quicklist, new_node);
+    } else if (at_tail || at_head) {
+        /* If we are: full, and our prev/next is full or missing:
+         *   - create new node and attach to quicklist */
+        new_node = quicklistCreateNode();
+        new_node->zl = ziplistPush(ziplistNew(), value, sz, ZIPLIST_HEAD);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        __quicklistInsertNode(quicklist, node, new_node, after);
+    } else {
+        /* else, node is full we need to split it. */
+        /* covers both after and !after cases */
+        quicklistDecompressNodeForUse(node);
+        new_node = _quicklistSplitNode(node, offset, after);
+        new_node->zl = ziplistPush(new_node->zl, value, sz,
+                                   after ? ZIPLIST_HEAD : ZIPLIST_TAIL);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        __quicklistInsertNode(quicklist, node, new_node, after);
+        _quicklistMergeNodes(quicklist, node);
+    }
+
+    quicklist->count++;
+}
+
+void quicklistInsertBefore(quicklist *quicklist, quicklistEntry *entry,
+                           void *value, const size_t sz) {
+    _quicklistInsert(quicklist, entry, value, sz, 0);
+}
+
+void quicklistInsertAfter(quicklist *quicklist, quicklistEntry *entry,
+                          void *value, const size_t sz) {
+    _quicklistInsert(quicklist, entry, value, sz, 1);
+}
+
+/* Delete a range of elements from the quicklist.
+ *
+ * elements may span across multiple quicklistNodes, so we
+ * have to be careful about tracking where we start and end.
+ *
+ * Returns 1 if entries were deleted, 0 if nothing was deleted. */
+/*
+ * 从 start 开始删除 count 个元素，start 可以是负数
+ *
+ * T = O(N)
+ */
+int quicklistDelRange(quicklist *quicklist, const long start,
+                      const long count) {
+    quicklistEntry entry;
+    quicklistNode *node;
+    unsigned long extent;
+    int offset;
+
+    if (count <= 0)
+        return 0;
+
+    extent = count; /* range is inclusive of start position */
+
+    if (start >= 0 && extent > (quicklist->count - start)) {
+        /* if requesting delete more elements than exist, limit to list size. */
+        extent = quicklist->count - start;
+    } else if (start < 0 && extent > (unsigned long)(-start)) {
+        /* else, if at negative offset, limit max size to rest of list. */
+        extent = -start; /* c.f. LREM -29 29; just delete until end. */
+    }
+
+    if (!quicklistIndex(quicklist, start, &entry))
+        return 0;
+
+    node = entry.node;
+    offset = entry.offset < 0 ? (int)node->count + entry.offset
+                              : entry.offset;
+
+    /* iterate over next nodes until everything is deleted. */
+    while (extent) {
+        quicklistNode *next = node->next;
+        unsigned long del;
+
+        if (offset == 0 && extent >= node->count) {
+            /* If we are deleting more than the count of this node, we
+             * can just delete the entire node without ziplist math. */
+            del = node->count;
+            __quicklistDelNode(quicklist, node);
+        } else {
+            /* Delete from 'offset' up to the end of the node, or less
+             * if the range ends inside this node. */
+            del = node->count - offset;
+            if (del > extent)
+                del = extent;
+
+            quicklistDecompressNodeForUse(node);
+            node->zl = ziplistDeleteRange(node->zl, offset, del);
+            node->count -= del;
+            quicklist->count -= del;
+            if (node->count == 0) {
+                __quicklistDelNode(quicklist, node);
+            } else {
+                quicklistNodeUpdateSz(node);
+                quicklistCompress(quicklist, node);
+            }
+        }
+
+        extent -= del;
+        node = next;
+        offset = 0;
+    }
+    return 1;
+}
+
+/* Passthrough to ziplistCompare() */
+int quicklistCompare(unsigned char *p1, unsigned char *p2, int p2_len) {
+    return ziplistCompare(p1, p2, p2_len);
+}
+
+/* Returns a quicklist iterator 'iter'. After the initialization every
+ * call to quicklistNext() will return the next element of the quicklist. */
+/*
+ * 创建一个迭代器，direction 为 AL_START_HEAD 时从表头向表尾迭代，
+ * 为 AL_START_TAIL 时从表尾向表头迭代
+ */
+quicklistIter *quicklistGetIterator(const quicklist *quicklist, int direction) {
+    quicklistIter *iter;
+
+    iter = zmalloc(sizeof(*iter));
+
+    if (direction == AL_START_HEAD) {
+        iter->current = quicklist->head;
+        iter->offset = 0;
+    } else {
+        iter->current = quicklist->tail;
+        iter->offset = -1;
+    }
+
+    iter->direction = direction;
+    iter->quicklist = (struct quicklist *)quicklist;
+
+    iter->zi = NULL;
+
+    return iter;
+}
+
+/* Initialize an iterator at a specific offset 'idx' and make the iterator
+ * return nodes in 'direction' direction. */
+/*
+ * 创建一个从 idx 处开始迭代的迭代器
+ */
+quicklistIter *quicklistGetIteratorAtIdx(const quicklist *quicklist,
+                                         const int direction,
+                                         const long long idx) {
+    quicklistEntry entry;
+
+    if (quicklistIndex(quicklist, idx, &entry)) {
+        quicklistIter *base = quicklistGetIterator(quicklist, direction);
+        int count = entry.node->count;
+
+        base->zi = NULL;
+        base->current = entry.node;
+        /* Offsets are positive walking towards the tail and negative
+         * walking towards the head, see quicklistDelEntry(). */
+        if (direction == AL_START_HEAD)
+            base->offset = entry.offset < 0 ? count + entry.offset
+                                            : entry.offset;
+        else
+            base->offset = entry.offset < 0 ? entry.offset
+                                            : entry.offset - count;
+        return base;
+    } else {
+        return NULL;
+    }
+}
+
+/* Release iterator.
+ * If we still have a valid current node, then re-encode current node. */
+/*
+ * 释放迭代器，如果当前节点是为了迭代而解压的，那么重新压缩它
+ */
+void quicklistReleaseIterator(quicklistIter *iter) {
+    if (iter->current)
+        quicklistCompress(iter->quicklist, iter->current);
+
+    zfree(iter);
+}
+
+/* Get next element in iterator.
+ *
+ * Note: You must NOT insert into the list while iterating over it.
+ * You *may* delete from the list while iterating using the
+ * quicklistDelEntry() function.
+ * If you insert into the quicklist while iterating, you should
+ * re-create the iterator after your addition.
+ *
+ * iter = quicklistGetIterator(quicklist,<direction>);
+ * quicklistEntry entry;
+ * while (quicklistNext(iter, &entry)) {
+ *     if (entry.value)
+ *          [[ use entry.value with entry.sz ]]
+ *     else
+ *          [[ use entry.longval ]]
+ * }
+ *
+ * Populates 'entry' with values for this iteration.
+ * Returns 0 when iteration is complete or if iteration not possible.
+ * If return value is 0, the contents of 'entry' are not valid.
+ */
+/*
+ * 取出迭代器的下一个元素，保存到 entry 中
+ *
+ * 迭代完毕时返回 0 ，否则返回 1 。
+ */
+int quicklistNext(quicklistIter *iter, quicklistEntry *entry) {
+    entry->quicklist = iter->quicklist;
+    entry->node = iter->current;
+
+    if (!iter->current)
+        return 0;
+
+    if (!iter->zi) {
+        /* If !zi, use current index. */
+        quicklistDecompressNodeForUse(iter->current);
+        iter->zi = ziplistIndex(iter->current->zl, iter->offset);
+    } else {
+        /* else, use existing iterator offset and get prev/next as necessary. */
+        if (iter->direction == AL_START_HEAD) {
+            iter->zi = ziplistNext(iter->current->zl, iter->zi);
+            iter->offset += 1;
+        } else {
+            iter->zi = ziplistPrev(iter->current->zl, iter->zi);
+            iter->offset -= 1;
+        }
+    }
+
+    entry->zi = iter->zi;
+    entry->offset = iter->offset;
+
+    if (iter->zi) {
+        /* Populate value from existing ziplist position */
+        ziplistGet(entry->zi, &entry->value, &entry->sz, &entry->longval);
+        return 1;
+    } else {
+        /* We ran out of ziplist entries.
+         * Pick next node, update offset, then re-run retrieval. */
+        quicklistCompress(iter->quicklist, iter->current);
+        if (iter->direction == AL_START_HEAD) {
+            iter->current = iter->current->next;
+            iter->offset = 0;
+        } else {
+            iter->current = iter->current->prev;
+            iter->offset = -1;
+        }
+        iter->zi = NULL;
+        return quicklistNext(iter, entry);
+    }
+}
+
+/* Populate 'entry' with the element at the specified zero-based index
+ * where 0 is the head, 1 is the element next to head
+ * and so on. Negative integers are used in order to count
+ * from the tail, -1 is the last element, -2 the penultimate
+ * and so on. If the index is out of range 0 is returned.
+ *
+ * Returns 1 if element found
+ * Returns 0 if element not found */
+/*
+ * 取出给定索引上的元素，保存到 entry 中
+ *
+ * 索引越界时返回 0 。
+ *
+ * 元素所在的节点会被解压，并且不会重新压缩：
+ * 调用者可能接着修改或者删除这个元素，节点会在下次被使用时重新压缩。
+ *
+ * T = O(N/节点大小)
+ */
+int quicklistIndex(const quicklist *quicklist, const long long idx,
+                   quicklistEntry *entry) {
+    quicklistNode *n;
+    unsigned long long accum = 0;
+    unsigned long long index;
+    int forward = idx < 0 ? 0 : 1; /* < 0 -> reverse, 0+ -> forward */
+
+    index = forward ? idx : (-idx) - 1;
+    if (index >= quicklist->count)
+        return 0;
+
+    /* Walk from the nearest end: whole nodes are skipped using their
+     * counts, only the target ziplist is scanned. */
+    n = forward ? quicklist->head : quicklist->tail;
+    while (n) {
+        if ((accum + n->count) > index) {
+            break;
+        } else {
+            accum += n->count;
+            n = forward ? n->next : n->prev;
+        }
+    }
+
+    if (!n)
+        return 0;
+
+    entry->quicklist = quicklist;
+    entry->node = n;
+    if (forward) {
+        /* forward = normal head-to-tail offset. */
+        entry->offset = index - accum;
+    } else {
+        /* reverse = need negative offset for tail-to-head, so undo
+         * the result of the original if (index < 0) above. */
+        entry->offset = (-index) - 1 + accum;
+    }
+
+    quicklistDecompressNodeForUse(entry->node);
+    entry->zi = ziplistIndex(entry->node->zl, entry->offset);
+    ziplistGet(entry->zi, &entry->value, &entry->sz, &entry->longval);
+    /* The caller will use our result, so we don't re-compress here.
+     * The caller can recompress or delete the node as needed. */
+    return 1;
+}
+
+/* Default pop function
+ *
+ * Returns malloc'd value from quicklist */
+static void *_quicklistSaver(unsigned char *data, unsigned int sz) {
+    unsigned char *vstr;
+    if (data) {
+        vstr = zmalloc(sz);
+        memcpy(vstr, data, sz);
+        return vstr;
+    }
+    return NULL;
+}
+
+/* pop from quicklist and return result in 'data' ptr.  Value of 'data'
+ * is the return value of 'saver' function pointer if the data is NOT a number.
+ *
+ * If the quicklist element is a long long, then the return value is returned in
+ * 'sval'.
+ *
+ * Return value of 0 means no elements available.
+ * Return value of 1 means check 'data' and 'sval' for values.
+ * If 'data' is set, use 'data' and 'sz'.  Otherwise, use 'sval'. */
+/*
+ * 从表头（where 为 QUICKLIST_HEAD）或表尾弹出一个元素
+ *
+ * 字符串值通过 saver 函数复制后保存到 data ，整数值保存到 sval 。
+ * 列表为空时返回 0 。
+ *
+ * T = O(1)
+ */
+int quicklistPopCustom(quicklist *quicklist, int where, unsigned char **data,
+                       unsigned int *sz, long long *sval,
+                       void *(*saver)(unsigned char *data, unsigned int sz)) {
+    unsigned char *p;
+    unsigned char *vstr;
+    unsigned int vlen;
+    long long vlong;
+    int pos = (where == QUICKLIST_HEAD) ? 0 : -1;
+    quicklistNode *node;
+
+    if (quicklist->count == 0)
+        return 0;
+
+    if (data)
+        *data = NULL;
+    if (sz)
+        *sz = 0;
+    if (sval)
+        *sval = -123456789;
+
+    if (where == QUICKLIST_HEAD && quicklist->head) {
+        node = quicklist->head;
+    } else if (where == QUICKLIST_TAIL && quicklist->tail) {
+        node = quicklist->tail;
+    } else {
+        return 0;
+    }
+
+    quicklistDecompressNodeForUse(node);
+    p = ziplistIndex(node->zl, pos);
+    if (ziplistGet(p, &vstr, &vlen, &vlong)) {
+        if (vstr) {
+            if (data)
+                *data = saver(vstr, vlen);
+            if (sz)
+                *sz = vlen;
+        } else {
+            if (data)
+                *data = NULL;
+            if (sval)
+                *sval = vlong;
+        }
+        if (!quicklistDelIndex(quicklist, node, &p))
+            quicklistRecompressOnly(quicklist, node);
+        return 1;
+    }
+    quicklistRecompressOnly(quicklist, node);
+    return 0;
+}
+
+/* Return a malloc'd quicklist entry, see quicklistPopCustom(). */
+int quicklistPop(quicklist *quicklist, int where, unsigned char **data,
+                 unsigned int *sz, long long *slong) {
+    unsigned char *vstr;
+    unsigned int vlen;
+    long long vlong;
+    if (quicklist->count == 0)
+        return 0;
+    int ret = quicklistPopCustom(quicklist, where, &vstr, &vlen, &vlong,
+                                 _quicklistSaver);
+    if (data)
+        *data = vstr;
+    if (slong)
+        *slong = vlong;
+    if (sz)
+        *sz = vlen;
+    return ret;
+}
+
+/* Wrapper to allow argument-based switching between HEAD/TAIL pop */
+/*
+ * 根据 where ，将值推入到表头或表尾
+ */
+void quicklistPush(quicklist *quicklist, void *value, const size_t sz,
+                   int where) {
+    if (where == QUICKLIST_HEAD) {
+        quicklistPushHead(quicklist, value, sz);
+    } else if (where == QUICKLIST_TAIL) {
+        quicklistPushTail(quicklist, value, sz);
+    }
+}
+
+#ifdef QUICKLIST_TEST_MAIN
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+/* Randomized test: every operation is applied both to a quicklist and to a
+ * plain array of strings, then the two are compared, together with the
+ * internal invariants of the quicklist (counts, sizes, compression depth).
+ *
+ * gcc -DQUICKLIST_TEST_MAIN -o quicklist-test quicklist.c ziplist.c \
+ *     zmalloc.c util.c sds.c lzf_c.c lzf_d.c -lm */
+
+typedef struct {
+    char **v;
+    long len;
+} model;
+
+static void modelInsert(model *m, long idx, const char *s) {
+    m->v = realloc(m->v, sizeof(char*)*(m->len+1));
+    memmove(m->v+idx+1, m->v+idx, sizeof(char*)*(m->len-idx));
+    m->v[idx] = strdup(s);
+    m->len++;
+}
+
+static void modelDelete(model *m, long idx, long count) {
+    long j;
+    for (j = idx; j < idx+count; j++) free(m->v[j]);
+    memmove(m->v+idx, m->v+idx+count, sizeof(char*)*(m->len-idx-count));
+    m->len -= count;
+}
+
+/* Write the value of 'entry' as a string into 'buf'. */
+static char *entryString(char *buf, size_t size, quicklistEntry *entry) {
+    if (entry->value) {
+        assert(entry->sz < size);
+        memcpy(buf, entry->value, entry->sz);
+        buf[entry->sz] = '\0';
+    } else {
+        ll2string(buf, size, entry->longval);
+    }
+    return buf;
+}
+
+static void randomValue(char *buf, size_t size) {
+    int r = rand() % 10;
+    if (r < 4) {
+        snprintf(buf, size, "%d", rand() % 1000 - 500);
+    } else if (r < 9) {
+        snprintf(buf, size, "value:%d", rand() % 50);
+    } else {
+        /* Long and compressible. */
+        int len = 100 + rand() % 400, j;
+        for (j = 0; j < len; j++) buf[j] = 'a' + (j/16) % 4;
+        snprintf(buf+len, size-len, ":%d", rand() % 50);
+    }
+}
+
+static void verify(quicklist *ql, model *m) {
+    quicklistNode *node;
+    quicklistIter *iter;
+    quicklistEntry entry;
+    unsigned long count = 0, len = 0;
+    char buf[1024];
+    long j;
+    unsigned int depth;
+
+    assert(ql->count == (unsigned long)m->len);
+
+    /* Node bookkeeping. */
+    for (node = ql->head; node; node = node->next) {
+        len++;
+        count += node->count;
+        assert(node->count > 0);
+        assert(node->next == NULL || node->next->prev == node);
+        if (node->encoding == QUICKLIST_NODE_ENCODING_RAW) {
+            assert(node->sz == ziplistBlobLen(node->zl));
+            assert(node->count == ziplistLen(node->zl));
+        }
+    }
+    assert(len == ql->len);
+    assert(count == ql->count);
+    assert(len == 0 || (ql->head->prev == NULL && ql->tail->next == NULL));
+
+    /* The nodes at both ends, within the compress depth, are never
+     * left compressed. */
+    node = ql->head;
+    for (depth = 0; node && depth < ql->compress; depth++, node = node->next)
+        assert(node->encoding == QUICKLIST_NODE_ENCODING_RAW);
+    node = ql->tail;
+    for (depth = 0; node && depth < ql->compress; depth++, node = node->prev)
+        assert(node->encoding == QUICKLIST_NODE_ENCODING_RAW);
+
+    /* Forward and backward iteration. */
+    iter = quicklistGetIterator(ql, AL_START_HEAD);
+    j = 0;
+    while (quicklistNext(iter, &entry))
+        assert(!strcmp(entryString(buf, sizeof(buf), &entry), m->v[j++]));
+    assert(j == m->len);
+    quicklistReleaseIterator(iter);
+
+    iter = quicklistGetIterator(ql, AL_START_TAIL);
+    j = m->len;
+    while (quicklistNext(iter, &entry))
+        assert(!strcmp(entryString(buf, sizeof(buf), &entry), m->v[--j]));
+    assert(j == 0);
+    quicklistReleaseIterator(iter);
+
+    /* Random access from both ends. */
+    for (j = 0; j < 5 && m->len; j++) {
+        long idx = rand() % m->len;
+        assert(quicklistIndex(ql, idx, &entry));
+        assert(!strcmp(entryString(buf, sizeof(buf), &entry), m->v[idx]));
+        assert(quicklistIndex(ql, idx - m->len, &entry));
+        assert(!strcmp(entryString(buf, sizeof(buf), &entry), m->v[idx]));
+    }
+    assert(!quicklistIndex(ql, m->len, &entry));
+    assert(!quicklistIndex(ql, -m->len-1, &entry));
+}
+
+static void fuzz(int fill, int compress, int ops) {
+    quicklist *ql = quicklistNew(fill, compress);
+    model m = {NULL, 0};
+    char buf[1024], got[1024];
+    int op;
+
+    while (ops--) {
+        op = rand() % 100;
+        randomValue(buf, sizeof(buf));
+
+        if (op < 30) {
+            /* Push. */
+            if (rand() % 2) {
+                quicklistPushHead(ql, buf, strlen(buf));
+                modelInsert(&m, 0, buf);
+            } else {
+                quicklistPushTail(ql, buf, strlen(buf));
+                modelInsert(&m, m.len, buf);
+            }
+        } else if (op < 45) {
+            /* Pop. */
+            unsigned char *data;
+            unsigned int sz;
+            long long lv;
+            int head = rand() % 2;
+            int ret = quicklistPop(ql, head ? QUICKLIST_HEAD : QUICKLIST_TAIL,
+                                   &data, &sz, &lv);
+            assert(ret == (m.len != 0));
+            if (ret) {
+                long idx = head ? 0 : m.len-1;
+                if (data) {
+                    memcpy(got, data, sz);
+                    got[sz] = '\0';
+                    zfree(data);
+                } else {
+                    ll2string(got, sizeof(got), lv);
+                }
+                assert(!strcmp(got, m.v[idx]));
+                modelDelete(&m, idx, 1);
+            }
+        } else if (op < 70 && m.len) {
+            /* Insert before or after a random element, found with an
+             * iterator walking in a random direction. */
+            long idx = rand() % m.len;
+            int after = rand() % 2;
+            int dir = rand() % 2 ? AL_START_HEAD : AL_START_TAIL;
+            quicklistIter *iter = quicklistGetIteratorAtIdx(ql, dir, idx);
+            quicklistEntry entry;
+
+            assert(iter && quicklistNext(iter, &entry));
+            assert(!strcmp(entryString(got, sizeof(got), &entry), m.v[idx]));
+            if (after)
+                quicklistInsertAfter(ql, &entry, buf, strlen(buf));
+            else
+                quicklistInsertBefore(ql, &entry, buf, strlen(buf));
+            quicklistReleaseIterator(iter);
+            modelInsert(&m, after ? idx+1 : idx, buf);
+        } else if (op < 78) {
+            /* Delete a range, with a positive or negative start. */
+            long start, count, real;
+            if (m.len == 0) continue;
+            start = rand() % m.len;
+            count = 1 + rand() % 20;
+            real = count > m.len-start ? m.len-start : count;
+            if (rand() % 2) {
+                quicklistDelRange(ql, start-m.len, count);
+                if (count > m.len-start) real = m.len-start;
+            } else {
+                quicklistDelRange(ql, start, count);
+            }
+            modelDelete(&m, start, real);
+        } else if (op < 86 && m.len) {
+            /* Replace. */
+            long idx = rand() % m.len;
+            assert(quicklistReplaceAtIndex(ql, idx, buf, strlen(buf)));
+            free(m.v[idx]);
+            m.v[idx] = strdup(buf);
+        } else if (op < 92 && m.len) {
+            /* Delete every occurrence of a value while iterating. */
+            int dir = rand() % 2 ? AL_START_HEAD : AL_START_TAIL;
+            quicklistIter *iter = quicklistGetIterator(ql, dir);
+            quicklistEntry entry;
+            char *target = strdup(m.v[rand() % m.len]);
+            long j;
+
+            while (quicklistNext(iter, &entry)) {
+                if (!strcmp(entryString(got, sizeof(got), &entry), target))
+                    quicklistDelEntry(iter, &entry);
+            }
+            quicklistReleaseIterator(iter);
+            for (j = m.len-1; j >= 0; j--)
+                if (!strcmp(m.v[j], target)) modelDelete(&m, j, 1);
+            free(target);
+        } else if (op < 94) {
+            /* Rebuild from a ziplist, like loading an old RDB. */
+            unsigned char *zl = ziplistNew();
+            long j;
+            for (j = 0; j < m.len; j++)
+                zl = ziplistPush(zl, (unsigned char*)m.v[j], strlen(m.v[j]),
+                                 ZIPLIST_TAIL);
+            quicklistRelease(ql);
+            ql = quicklistCreateFromZiplist(fill, compress, zl);
+        }
+        verify(ql, &m);
+    }
+    quicklistRelease(ql);
+    modelDelete(&m, 0, m.len);
+    free(m.v);
+}
+
+int main(int argc, char **argv) {
+    int fills[] = {-5, -2, -1, 1, 2, 4, 32, 128};
+    int compress[] = {0, 1, 2, 4};
+    int seed = argc > 1 ? atoi(argv[1]) : (int)time(NULL);
+    unsigned int f, c;
+
+    printf("Seed: %d\n", seed);
+    srand(seed);
+    for (f = 0; f < sizeof(fills)/sizeof(*fills); f++) {
+        for (c = 0; c < sizeof(compress)/sizeof(*compress); c++) {
+            printf("fill %d, compress %d... ", fills[f], compress[c]);
+            fflush(stdout);
+            fuzz(fills[f], compress[c], 20000);
+            printf("ok\n");
+        }
+    }
+    printf("ALL TESTS PASSED! (used memory %zu)\n", zmalloc_used_memory());
+    return 0;
+}
+#endif
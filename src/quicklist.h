@@ -0,0 +1,211 @@
+/* quicklist.h - A doubly linked list of ziplists
+ *
+ * 快速列表：由 ziplist 节点组成的双端链表，列表对象唯一的编码方式。
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QUICKLIST_H__
+#define __QUICKLIST_H__
+
+/* quicklistNode is a 32 byte struct describing a ziplist for a quicklist.
+ * Bit fields keep the node at 32 bytes:
+ * count: 16 bits, the ziplist size limits keep it well below 65536.
+ * encoding: 2 bits, RAW=1, LZF=2.
+ * recompress: 1 bit, set when the node was decompressed only to be used.
+ *
+ * quicklist 节点，每个节点保存一个 ziplist 。
+ *
+ * 节点的 ziplist 可以被 LZF 压缩，此时 zl 指向 quicklistLZF 结构，
+ * 而 sz 仍然记录未压缩时 ziplist 的字节数。 */
+typedef struct quicklistNode {
+
+    // 前驱节点
+    struct quicklistNode *prev;
+
+    // 后继节点
+    struct quicklistNode *next;
+
+    // ziplist ，或者压缩后的 quicklistLZF
+    unsigned char *zl;
+
+    // ziplist 的字节数（未压缩时）
+    unsigned int sz;             /* ziplist size in bytes */
+
+    // ziplist 中的元素数量
+    unsigned int count : 16;     /* count of items in ziplist */
+
+    // 编码，RAW 或者 LZF
+    unsigned int encoding : 2;   /* RAW==1 or LZF==2 */
+
+    // 节点是否为了使用而被临时解压
+    unsigned int recompress : 1; /* was this node previously compressed? */
+
+    unsigned int extra : 13;     /* more bits to steal for future usage */
+} quicklistNode;
+
+/* quicklistLZF is a 4+N byte struct holding 'sz' followed by 'compressed'.
+ * 'sz' is the byte length of 'compressed', the uncompressed length is
+ * stored in quicklistNode->sz. When a node is compressed, node->zl points
+ * to a quicklistLZF.
+ *
+ * 被压缩节点的内容，未压缩的长度记录在 quicklistNode->sz 里 */
+typedef struct quicklistLZF {
+    // 压缩数据的字节数
+    unsigned int sz; /* LZF size in bytes*/
+    // 压缩数据
+    char compressed[];
+} quicklistLZF;
+
+/* quicklist is a 32 byte struct (on 64-bit systems) describing a quicklist.
+ * 'count' is the number of total entries.
+ * 'len' is the number of quicklist nodes.
+ * 'compress' is 0 if compression is disabled, otherwise it's the number
+ *            of quicklistNodes to leave uncompressed at each end.
+ * 'fill' is the user-requested (or default) fill factor.
+ *
+ * quicklist 结构 */
+typedef struct quicklist {
+
+    // 表头节点
+    quicklistNode *head;
+
+    // 表尾节点
+    quicklistNode *tail;
+
+    // 所有 ziplist 中的元素总数
+    unsigned long count;        /* total count of all entries in all ziplists */
+
+    // 节点数量
+    unsigned int len;           /* number of quicklistNodes */
+
+    // 每个节点的填充因子：
+    // 正数表示节点最多保存的元素数量，
+    // -1 到 -5 表示节点 ziplist 的最大字节数为 4k 到 64k
+    int fill : 16;              /* fill factor for individual nodes */
+
+    // 两端各有多少个节点不压缩，0 表示不压缩
+    unsigned int compress : 16; /* depth of end nodes not to compress;0=off */
+} quicklist;
+
+/*
+ * quicklist 迭代器
+ */
+typedef struct quicklistIter {
+    // 被迭代的 quicklist
+    quicklist *quicklist;
+    // 当前节点
+    quicklistNode *current;
+    // 当前元素在 ziplist 中的位置，为 NULL 时按 offset 重新定位
+    unsigned char *zi;
+    // 当前元素在节点中的偏移量，从表尾向表头迭代时为负数
+    long offset; /* offset in current ziplist */
+    // 迭代方向
+    int direction;
+} quicklistIter;
+
+/*
+ * 迭代器或者 quicklistIndex 返回的元素
+ */
+typedef struct quicklistEntry {
+    // 元素所在的 quicklist
+    const quicklist *quicklist;
+    // 元素所在的节点
+    quicklistNode *node;
+    // 元素在 ziplist 中的位置
+    unsigned char *zi;
+    // 字符串值，值为整数时为 NULL
+    unsigned char *value;
+    // 整数值
+    long long longval;
+    // 字符串值的长度
+    unsigned int sz;
+    // 元素在节点中的偏移量
+    int offset;
+} quicklistEntry;
+
+#define QUICKLIST_HEAD 0
+#define QUICKLIST_TAIL -1
+
+/* quicklist node encodings */
+#define QUICKLIST_NODE_ENCODING_RAW 1
+#define QUICKLIST_NODE_ENCODING_LZF 2
+
+/* quicklist compression disable */
+#define QUICKLIST_NOCOMPRESS 0
+
+/* Iterator directions, the same values used by adlist.h. */
+#define AL_START_HEAD 0
+#define AL_START_TAIL 1
+
+#define quicklistNodeIsCompressed(node)                                        \
+    ((node)->encoding == QUICKLIST_NODE_ENCODING_LZF)
+
+/* Prototypes */
+quicklist *quicklistCreate(void);
+quicklist *quicklistNew(int fill, int compress);
+void quicklistSetCompressDepth(quicklist *quicklist, int depth);
+void quicklistSetFill(quicklist *quicklist, int fill);
+void quicklistSetOptions(quicklist *quicklist, int fill, int depth);
+void quicklistRelease(quicklist *quicklist);
+int quicklistPushHead(quicklist *quicklist, void *value, const size_t sz);
+int quicklistPushTail(quicklist *quicklist, void *value, const size_t sz);
+void quicklistPush(quicklist *quicklist, void *value, const size_t sz,
+                   int where);
+void quicklistAppendZiplist(quicklist *quicklist, unsigned char *zl);
+quicklist *quicklistAppendValuesFromZiplist(quicklist *quicklist,
+                                            unsigned char *zl);
+quicklist *quicklistCreateFromZiplist(int fill, int compress,
+                                      unsigned char *zl);
+void quicklistInsertAfter(quicklist *quicklist, quicklistEntry *node,
+                          void *value, const size_t sz);
+void quicklistInsertBefore(quicklist *quicklist, quicklistEntry *node,
+                           void *value, const size_t sz);
+void quicklistDelEntry(quicklistIter *iter, quicklistEntry *entry);
+int quicklistReplaceAtIndex(quicklist *quicklist, long index, void *data,
+                            int sz);
+int quicklistDelRange(quicklist *quicklist, const long start, const long count);
+quicklistIter *quicklistGetIterator(const quicklist *quicklist, int direction);
+quicklistIter *quicklistGetIteratorAtIdx(const quicklist *quicklist,
+                                         int direction, const long long idx);
+int quicklistNext(quicklistIter *iter, quicklistEntry *node);
+void quicklistReleaseIterator(quicklistIter *iter);
+int quicklistIndex(const quicklist *quicklist, const long long index,
+                   quicklistEntry *entry);
+int quicklistPopCustom(quicklist *quicklist, int where, unsigned char **data,
+                       unsigned int *sz, long long *sval,
+                       void *(*saver)(unsigned char *data, unsigned int sz));
+int quicklistPop(quicklist *quicklist, int where, unsigned char **data,
+                 unsigned int *sz, long long *slong);
+unsigned long quicklistCount(const quicklist *ql);
+int quicklistCompare(unsigned char *p1, unsigned char *p2, int p2_len);
+size_t quicklistGetLzf(const quicklistNode *node, void **data);
+
+#endif /* __QUICKLIST_H__ */
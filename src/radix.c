@@ -0,0 +1,527 @@
+/* radix.c - A compressed radix tree (prefix tree) of binary safe keys
+ *
+ * The tree is used to index keys by prefix: radixWalkPrefixes() visits,
+ * in a single descent, all the keys that are a prefix of a given string.
+ * Nodes with a single child and no key are merged with their child, so
+ * the number of nodes is at most twice the number of keys.
+ *
+ * 压缩基数树：
+ * radixWalkPrefixes() 只需一次从根节点出发的下降，
+ * 就可以找到所有是给定字符串前缀的键。
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "radix.h"
+#include "zmalloc.h"
+
+/* Create a node with a copy of 'len' bytes of 'edge' as edge label. */
+static radixNode *radixCreateNode(radixTree *tree, unsigned char *edge,
+                                  size_t len)
+{
+    radixNode *n = zmalloc(sizeof(*n));
+
+    n->edge = len ? zmalloc(len) : NULL;
+    if (len) memcpy(n->edge,edge,len);
+    n->edgelen = len;
+    n->iskey = 0;
+    n->value = NULL;
+    n->numchildren = 0;
+    n->children = NULL;
+    tree->numnodes++;
+    return n;
+}
+
+static void radixFreeNode(radixTree *tree, radixNode *n) {
+    zfree(n->edge);
+    zfree(n->children);
+    zfree(n);
+    tree->numnodes--;
+}
+
+/* Return the index of the child of 'n' whose edge starts with 'c', or -1
+ * if there is no such child. If 'pos' is not NULL it is set to the index
+ * where a child starting with 'c' should be inserted. */
+/*
+ * 在节点 n 的子节点中，二分查找边以字节 c 开头的子节点
+ */
+static int radixFindChild(radixNode *n, unsigned char c, int *pos) {
+    int lo = 0, hi = n->numchildren-1;
+
+    while (lo <= hi) {
+        int mid = (lo+hi)/2;
+        unsigned char mc = n->children[mid]->edge[0];
+
+        if (mc == c) {
+            if (pos) *pos = mid;
+            return mid;
+        } else if (mc < c) {
+            lo = mid+1;
+        } else {
+            hi = mid-1;
+        }
+    }
+    if (pos) *pos = lo;
+    return -1;
+}
+
+static void radixAddChild(radixNode *n, radixNode *child, int pos) {
+    n->children = zrealloc(n->children,
+                           sizeof(radixNode*)*(n->numchildren+1));
+    memmove(n->children+pos+1,n->children+pos,
+            sizeof(radixNode*)*(n->numchildren-pos));
+    n->children[pos] = child;
+    n->numchildren++;
+}
+
+static void radixDelChild(radixNode *n, int pos) {
+    memmove(n->children+pos,n->children+pos+1,
+            sizeof(radixNode*)*(n->numchildren-pos-1));
+    n->numchildren--;
+    if (n->numchildren == 0) {
+        zfree(n->children);
+        n->children = NULL;
+    }
+}
+
+/* Merge 'n', that must have no key and a single child, with its child.
+ * The node 'n' takes the place of the child, so the pointer the parent
+ * holds to 'n' stays valid. */
+/*
+ * 将没有键、只有一个子节点的节点 n 和它的子节点合并
+ */
+static void radixMergeWithChild(radixTree *tree, radixNode *n) {
+    radixNode *child = n->children[0];
+    unsigned char *edge;
+
+    edge = zmalloc(n->edgelen+child->edgelen);
+    if (n->edgelen) memcpy(edge,n->edge,n->edgelen);
+    memcpy(edge+n->edgelen,child->edge,child->edgelen);
+    zfree(n->edge);
+    zfree(n->children);
+    n->edge = edge;
+    n->edgelen += child->edgelen;
+    n->iskey = child->iskey;
+    n->value = child->value;
+    n->numchildren = child->numchildren;
+    n->children = child->children;
+    child->children = NULL;
+    radixFreeNode(tree,child);
+}
+
+/* Create a new empty tree. */
+radixTree *radixNew(void) {
+    radixTree *tree = zmalloc(sizeof(*tree));
+
+    tree->numkeys = 0;
+    tree->numnodes = 0;
+    tree->root = radixCreateNode(tree,NULL,0);
+    return tree;
+}
+
+static void radixReleaseNode(radixTree *tree, radixNode *n,
+                             void (*freevalue)(void *value))
+{
+    int j;
+
+    for (j = 0; j < n->numchildren; j++)
+        radixReleaseNode(tree,n->children[j],freevalue);
+    if (n->iskey && freevalue) freevalue(n->value);
+    radixFreeNode(tree,n);
+}
+
+/* Free the tree, calling 'freevalue' (if not NULL) for every value. */
+void radixRelease(radixTree *tree, void (*freevalue)(void *value)) {
+    radixReleaseNode(tree,tree->root,freevalue);
+    zfree(tree);
+}
+
+/* Add 'key' with the associated 'value'. Returns 1 if the key was added,
+ * or 0 if the key already exists, in which case the tree is not modified. */
+/*
+ * 将键 key 和值 value 添加到树中
+ *
+ * 添加成功返回 1 ，键已经存在时返回 0 。
+ */
+int radixInsert(radixTree *tree, unsigned char *key, size_t len, void *value) {
+    radixNode *n = tree->root;
+    size_t i = 0;
+
+    while (i < len) {
+        radixNode *child;
+        size_t j;
+        int pos;
+
+        /* No edge starts with the next byte: the rest of the key becomes
+         * the edge of a new leaf. */
+        if (radixFindChild(n,key[i],&pos) == -1) {
+            child = radixCreateNode(tree,key+i,len-i);
+            radixAddChild(n,child,pos);
+            n = child;
+            i = len;
+            break;
+        }
+
+        /* Follow the edge as long as it matches the key. */
+        child = n->children[pos];
+        for (j = 0; j < child->edgelen && i+j < len; j++)
+            if (child->edge[j] != key[i+j]) break;
+
+        /* The key diverges in the middle of the edge: split it, creating
+         * a node for the common part. */
+        // 键在边的中间出现分叉，分裂这条边
+        if (j < child->edgelen) {
+            radixNode *mid = radixCreateNode(tree,child->edge,j);
+            unsigned char *rest = zmalloc(child->edgelen-j);
+
+            memcpy(rest,child->edge+j,child->edgelen-j);
+            zfree(child->edge);
+            child->edge = rest;
+            child->edgelen -= j;
+            radixAddChild(mid,child,0);
+            n->children[pos] = mid;
+            child = mid;
+        }
+        n = child;
+        i += j;
+    }
+
+    if (n->iskey) return 0;
+    n->iskey = 1;
+    n->value = value;
+    tree->numkeys++;
+    return 1;
+}
+
+/* Lookup 'key'. Returns 1 and sets '*value' (if not NULL) if the key
+ * exists, otherwise 0 is returned. */
+int radixFind(radixTree *tree, unsigned char *key, size_t len, void **value) {
+    radixNode *n = tree->root;
+    size_t i = 0;
+
+    while (i < len) {
+        int pos = radixFindChild(n,key[i],NULL);
+
+        if (pos == -1) return 0;
+        n = n->children[pos];
+        if (n->edgelen > len-i || memcmp(n->edge,key+i,n->edgelen) != 0)
+            return 0;
+        i += n->edgelen;
+    }
+    if (!n->iskey) return 0;
+    if (value) *value = n->value;
+    return 1;
+}
+
+/* Remove 'key'. Returns 1 if the key was removed, or 0 if not found. The
+ * value is not freed. */
+/*
+ * 从树中删除键 key ，删除成功返回 1 ，键不存在返回 0 。
+ *
+ * 删除之后，没有键、只有一个子节点的节点会和子节点合并。
+ */
+int radixRemove(radixTree *tree, unsigned char *key, size_t len) {
+    radixNode *n = tree->root, *parent = NULL;
+    int pos = -1;
+    size_t i = 0;
+
+    while (i < len) {
+        int p = radixFindChild(n,key[i],NULL);
+        radixNode *child;
+
+        if (p == -1) return 0;
+        child = n->children[p];
+        if (child->edgelen > len-i ||
+            memcmp(child->edge,key+i,child->edgelen) != 0) return 0;
+        parent = n;
+        pos = p;
+        n = child;
+        i += child->edgelen;
+    }
+    if (!n->iskey) return 0;
+    n->iskey = 0;
+    n->value = NULL;
+    tree->numkeys--;
+
+    /* The root is never removed or merged. */
+    if (parent == NULL) return 1;
+
+    if (n->numchildren == 0) {
+        /* Remove the leaf, then the parent may be left with a single
+         * child and no key. */
+        radixDelChild(parent,pos);
+        radixFreeNode(tree,n);
+        if (parent != tree->root && !parent->iskey &&
+            parent->numchildren == 1)
+            radixMergeWithChild(tree,parent);
+    } else if (n->numchildren == 1) {
+        radixMergeWithChild(tree,n);
+    }
+    return 1;
+}
+
+/* Call 'fn' with the value of every key that is a prefix of 's' (the empty
+ * key included), from the shortest to the longest key. The callback must
+ * not modify the tree. */
+/*
+ * 对树中每个是字符串 s 的前缀的键，以键的值为参数调用 fn ，
+ * 调用按照键从短到长的顺序进行。
+ */
+void radixWalkPrefixes(radixTree *tree, unsigned char *s, size_t len,
+                       void (*fn)(void *value, void *privdata),
+                       void *privdata)
+{
+    radixNode *n = tree->root;
+    size_t i = 0;
+
+    while (1) {
+        int pos;
+
+        if (n->iskey) fn(n->value,privdata);
+        if (i == len) break;
+        if ((pos = radixFindChild(n,s[i],NULL)) == -1) break;
+        n = n->children[pos];
+        if (n->edgelen > len-i || memcmp(n->edge,s+i,n->edgelen) != 0)
+            break;
+        i += n->edgelen;
+    }
+}
+
+#ifdef RADIX_TEST_MAIN
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include "util.h"
+
+/* Randomized test against a plain array of keys, followed by a benchmark
+ * of the pubsub use case: for every published channel, find the patterns
+ * that match it scanning all of them, or only the ones whose literal
+ * prefix is a prefix of the channel.
+ *
+ * gcc -O2 -DRADIX_TEST_MAIN -o radix-test radix.c util.c zmalloc.c sds.c -lm */
+
+#define MODEL_KEYS 512
+
+static char *model[MODEL_KEYS];
+static int modelLen;
+
+static int modelFind(char *key) {
+    int j;
+
+    for (j = 0; j < modelLen; j++)
+        if (strcmp(model[j],key) == 0) return j;
+    return -1;
+}
+
+/* Random key of up to 6 bytes from a tiny alphabet, so that keys share
+ * prefixes often and edges are split and merged all the time. */
+static void randomKey(char *buf) {
+    int len = rand() % 7, j;
+
+    for (j = 0; j < len; j++) buf[j] = "abc"[rand() % 3];
+    buf[len] = '\0';
+}
+
+static void collectPrefix(void *value, void *privdata) {
+    char **last = privdata;
+    char *key = value;
+
+    /* Keys are reported from the shortest to the longest. */
+    assert(*last == NULL || strlen(*last) < strlen(key));
+    *last = key;
+}
+
+static void checkTree(radixTree *tree) {
+    char s[8], *last;
+    int j, count;
+
+    assert(radixSize(tree) == (unsigned long)modelLen);
+    assert(tree->numnodes <= 2*tree->numkeys+1);
+    for (j = 0; j < modelLen; j++) {
+        void *v;
+
+        assert(radixFind(tree,(unsigned char*)model[j],strlen(model[j]),&v));
+        assert(v == model[j]);
+    }
+
+    /* The walk must visit exactly the keys that are a prefix of 's'. */
+    randomKey(s);
+    for (j = 0, count = 0; j < modelLen; j++)
+        if (strncmp(model[j],s,strlen(model[j])) == 0) count++;
+    last = NULL;
+    radixWalkPrefixes(tree,(unsigned char*)s,strlen(s),collectPrefix,&last);
+    if (count == 0) {
+        assert(last == NULL);
+    } else {
+        /* The last reported key is the longest prefix of 's'. */
+        size_t longest = 0;
+
+        for (j = 0; j < modelLen; j++) {
+            size_t l = strlen(model[j]);
+            if (strncmp(model[j],s,l) == 0 && l > longest) longest = l;
+        }
+        assert(last != NULL && strlen(last) == longest);
+    }
+}
+
+static long long ustime(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+    return ((long long)tv.tv_sec)*1000000+tv.tv_usec;
+}
+
+static int benchMatches;
+
+static void benchBucket(void *value, void *privdata) {
+    char **patterns = value, *channel = privdata;
+    int j;
+
+    for (j = 0; patterns[j]; j++)
+        if (stringmatch(patterns[j],channel,0)) benchMatches++;
+}
+
+/* 'numpat' patterns "news.<id>.*", plus one "*" every 100 patterns, that
+ * can't be indexed and are always tried. */
+static void benchmark(int numpat, int publish) {
+    char **patterns = malloc(sizeof(char*)*numpat);
+    char **star = calloc(numpat/100+2,sizeof(char*));
+    char **buckets = calloc(numpat,sizeof(char*)*2);
+    radixTree *tree = radixNew();
+    long long start, linear, indexed;
+    int j, nstar = 0, m1, m2;
+    char buf[64];
+
+    for (j = 0; j < numpat; j++) {
+        if (j % 100 == 0) {
+            patterns[j] = strdup("*");
+            star[nstar++] = patterns[j];
+        } else {
+            int len = snprintf(buf,sizeof(buf),"news.%d.*",j);
+
+            patterns[j] = strdup(buf);
+            buckets[j*2] = patterns[j];
+            radixInsert(tree,(unsigned char*)buf,len-1,buckets+j*2);
+        }
+    }
+    radixInsert(tree,(unsigned char*)"",0,star);
+
+    srand(1234);
+    start = ustime();
+    benchMatches = 0;
+    for (j = 0; j < publish; j++) {
+        int k;
+
+        snprintf(buf,sizeof(buf),"news.%d.sport",rand() % numpat);
+        for (k = 0; k < numpat; k++)
+            if (stringmatch(patterns[k],buf,0)) benchMatches++;
+    }
+    linear = ustime()-start;
+    m1 = benchMatches;
+
+    srand(1234);
+    start = ustime();
+    benchMatches = 0;
+    for (j = 0; j < publish; j++) {
+        int len = snprintf(buf,sizeof(buf),"news.%d.sport",rand() % numpat);
+
+        radixWalkPrefixes(tree,(unsigned char*)buf,len,benchBucket,buf);
+    }
+    indexed = ustime()-start;
+    m2 = benchMatches;
+
+    printf("%6d patterns: linear %8.2f us/publish, "
+           "radix %6.2f us/publish (%lu nodes)\n",
+           numpat, (double)linear/publish, (double)indexed/publish,
+           tree->numnodes);
+    assert(m1 == m2);
+
+    radixRelease(tree,NULL);
+    for (j = 0; j < numpat; j++) free(patterns[j]);
+    free(patterns);
+    free(star);
+    free(buckets);
+}
+
+int main(void) {
+    radixTree *tree = radixNew();
+    char key[8];
+    int j;
+
+    srand(1234);
+    for (j = 0; j < 200000; j++) {
+        int idx;
+
+        randomKey(key);
+        idx = modelFind(key);
+        if (rand() % 2) {
+            int added;
+
+            if (idx == -1 && modelLen == MODEL_KEYS) continue;
+            added = radixInsert(tree,(unsigned char*)key,strlen(key),
+                                idx == -1 ? strdup(key) : NULL);
+            assert(added == (idx == -1));
+            if (added) {
+                void *v;
+
+                radixFind(tree,(unsigned char*)key,strlen(key),&v);
+                model[modelLen++] = v;
+            }
+        } else {
+            int removed = radixRemove(tree,(unsigned char*)key,strlen(key));
+
+            assert(removed == (idx != -1));
+            if (removed) {
+                free(model[idx]);
+                model[idx] = model[--modelLen];
+            }
+        }
+        checkTree(tree);
+    }
+    while (modelLen) {
+        char *k = model[--modelLen];
+
+        assert(radixRemove(tree,(unsigned char*)k,strlen(k)));
+        free(k);
+    }
+    assert(radixSize(tree) == 0 && tree->numnodes == 1);
+    radixRelease(tree,NULL);
+    printf("Randomized test: OK\n");
+
+    benchmark(1000,10000);
+    benchmark(10000,1000);
+    benchmark(100000,100);
+    return 0;
+}
+#endif
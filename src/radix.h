@@ -0,0 +1,84 @@
+/* radix.h - A compressed radix tree (prefix tree) of binary safe keys
+ *
+ * 压缩基数树：以二进制安全的字符串为键，
+ * 共享公共前缀的键共享树中的节点。
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RADIX_H
+#define __RADIX_H
+
+#include <stddef.h>
+
+/* Every node holds the label of the edge leading to it from its parent,
+ * so a chain of nodes with a single child is stored as a single node.
+ * The key of a node is the concatenation of the labels from the root. */
+typedef struct radixNode {
+
+    // 从父节点到这个节点的边的标签
+    unsigned char *edge;
+    size_t edgelen;
+
+    // 这个节点是否保存了一个键，以及键的值
+    int iskey;
+    void *value;
+
+    // 子节点，按照边的第一个字节排序
+    int numchildren;
+    struct radixNode **children;
+
+} radixNode;
+
+typedef struct radixTree {
+
+    // 根节点，键为空字符串
+    radixNode *root;
+
+    // 键的数量
+    unsigned long numkeys;
+
+    // 节点的数量
+    unsigned long numnodes;
+
+} radixTree;
+
+/* Prototypes */
+radixTree *radixNew(void);
+void radixRelease(radixTree *tree, void (*freevalue)(void *value));
+int radixInsert(radixTree *tree, unsigned char *key, size_t len, void *value);
+int radixRemove(radixTree *tree, unsigned char *key, size_t len);
+int radixFind(radixTree *tree, unsigned char *key, size_t len, void **value);
+void radixWalkPrefixes(radixTree *tree, unsigned char *s, size_t len,
+                       void (*fn)(void *value, void *privdata),
+                       void *privdata);
+#define radixSize(t) ((t)->numkeys)
+
+#endif /* __RADIX_H */
@@ -29,6 +29,7 @@
 
 #include "redis.h"
 #include "lzf.h"    /* LZF compression library */
+#include "lz4.h"    /* LZ4 compression library */
 #include "zipmap.h"
 #include "endianconv.h"
 
@@ -237,48 +238,107 @@ int rdbTryIntegerEncoding(char *s, size_t len, unsigned char *enc) {
     return rdbEncodeInteger(value,enc);
 }
 
-int rdbSaveLzfStringObject(rio *rdb, unsigned char *s, size_t len) {
-    size_t comprlen, outlen;
+/* String compression codecs, indexed by REDIS_RDB_CODEC_*. Both functions
+ * follow the lzf_compress() / lzf_decompress() conventions, returning the
+ * number of bytes written to the output buffer, or 0 on failure. */
+/*
+ * 字符串压缩算法表，以 REDIS_RDB_CODEC_* 为索引
+ */
+typedef struct rdbCodec {
+    char *name;     /* Name used by rdb-compression-codec. */
+    int enctype;    /* REDIS_RDB_ENC_* tag of the compressed strings. */
+    unsigned int (*compress)(const void *in, unsigned int in_len,
+                             void *out, unsigned int out_len);
+    unsigned int (*decompress)(const void *in, unsigned int in_len,
+                               void *out, unsigned int out_len);
+} rdbCodec;
+
+static rdbCodec rdbCodecs[] = {
+    {"lzf",REDIS_RDB_ENC_LZF,lzf_compress,lzf_decompress},
+    {"lz4",REDIS_RDB_ENC_LZ4,lz4_compress,lz4_decompress}
+};
+
+#define REDIS_RDB_CODECS_NUM (sizeof(rdbCodecs)/sizeof(rdbCodecs[0]))
+
+/* Return the REDIS_RDB_CODEC_* id of the codec called 'name', or -1 if there
+ * is no such codec. */
+int rdbGetCodecByName(char *name) {
+    unsigned int j;
+
+    for (j = 0; j < REDIS_RDB_CODECS_NUM; j++)
+        if (!strcasecmp(name,rdbCodecs[j].name)) return j;
+    return -1;
+}
+
+char *rdbGetCodecName(int codec) {
+    return rdbCodecs[codec].name;
+}
+
+/* Return the codec compressing strings tagged with 'enctype'. */
+static rdbCodec *rdbGetCodecByEncoding(int enctype) {
+    unsigned int j;
+
+    for (j = 0; j < REDIS_RDB_CODECS_NUM; j++)
+        if (rdbCodecs[j].enctype == enctype) return rdbCodecs+j;
+    return NULL;
+}
+
+/* Write an already compressed blob of 'compress_len' bytes that expands to
+ * 'original_len' bytes, using the string encoding 'enctype'
+ * (REDIS_RDB_ENC_LZF or REDIS_RDB_ENC_LZ4). */
+/*
+ * 将已经被压缩过的数据写入 rdb ，
+ * 载入时它会被当作普通的压缩字符串处理
+ */
+int rdbSaveCompressedBlob(rio *rdb, int enctype, void *data,
+                          size_t compress_len, size_t original_len) {
     unsigned char byte;
     int n, nwritten = 0;
-    void *out;
 
-    /* We require at least four bytes compression for this to be worth it */
-    if (len <= 4) return 0;
-    outlen = len-4;
-    if ((out = zmalloc(outlen+1)) == NULL) return 0;
-    comprlen = lzf_compress(s, len, out, outlen);
-    if (comprlen == 0) {
-        zfree(out);
-        return 0;
-    }
     /* Data compressed! Let's save it on disk */
-    byte = (REDIS_RDB_ENCVAL<<6)|REDIS_RDB_ENC_LZF;
-    if ((n = rdbWriteRaw(rdb,&byte,1)) == -1) goto writeerr;
+    byte = (REDIS_RDB_ENCVAL<<6)|enctype;
+    if ((n = rdbWriteRaw(rdb,&byte,1)) == -1) return -1;
     nwritten += n;
 
-    if ((n = rdbSaveLen(rdb,comprlen)) == -1) goto writeerr;
+    if ((n = rdbSaveLen(rdb,compress_len)) == -1) return -1;
     nwritten += n;
 
-    if ((n = rdbSaveLen(rdb,len)) == -1) goto writeerr;
+    if ((n = rdbSaveLen(rdb,original_len)) == -1) return -1;
     nwritten += n;
 
-    if ((n = rdbWriteRaw(rdb,out,comprlen)) == -1) goto writeerr;
+    if ((n = rdbWriteRaw(rdb,data,compress_len)) == -1) return -1;
     nwritten += n;
 
-    zfree(out);
     return nwritten;
+}
 
-writeerr:
+/* Compress the string with the codec selected by rdb-compression-codec. */
+int rdbSaveCompressedStringObject(rio *rdb, unsigned char *s, size_t len) {
+    rdbCodec *codec = rdbCodecs+server.rdb_compression_codec;
+    size_t comprlen, outlen;
+    void *out;
+    int nwritten;
+
+    /* We require at least four bytes compression for this to be worth it */
+    if (len <= 4) return 0;
+    outlen = len-4;
+    if ((out = zmalloc(outlen+1)) == NULL) return 0;
+    comprlen = codec->compress(s, len, out, outlen);
+    if (comprlen == 0) {
+        zfree(out);
+        return 0;
+    }
+    nwritten = rdbSaveCompressedBlob(rdb,codec->enctype,out,comprlen,len);
     zfree(out);
-    return -1;
+    return nwritten;
 }
 
 /*
- * 读取并解压被 lzf 算法压缩的字符串，
+ * 读取并解压被 enctype 所指定的算法压缩的字符串，
  * 返回一个保存解压后的字符串内容的字符串对象
  */
-robj *rdbLoadLzfStringObject(rio *rdb) {
+robj *rdbLoadCompressedStringObject(rio *rdb, int enctype) {
+    rdbCodec *codec = rdbGetCodecByEncoding(enctype);
     unsigned int len, clen;
     unsigned char *c = NULL;
     sds val = NULL;
@@ -294,7 +354,7 @@ robj *rdbLoadLzfStringObject(rio *rdb) {
     // 读取压缩内容
     if (rioRead(rdb,c,clen) == 0) goto err;
     // 将压缩内容解码到 sds
-    if (lzf_decompress(c,clen,val,len) == 0) goto err;
+    if (codec->decompress(c,clen,val,len) != len) goto err;
     // 释放存放压缩内容的空间
     zfree(c);
     // 为解压内容创建字符串对象
@@ -320,10 +380,10 @@ int rdbSaveRawString(rio *rdb, unsigned char *s, size_t len) {
         }
     }
 
-    /* Try LZF compression - under 20 bytes it's unable to compress even
+    /* Try compression - under 20 bytes it's unable to compress even
      * aaaaaaaaaaaaaaaaaa so skip it */
     if (server.rdb_compression && len > 20) {
-        n = rdbSaveLzfStringObject(rdb,s,len);
+        n = rdbSaveCompressedStringObject(rdb,s,len);
         if (n == -1) return -1;
         if (n > 0) return n;
         /* Return value of 0 means data can't be compressed, save the old way */
@@ -377,7 +437,7 @@ int rdbSaveStringObject(rio *rdb, robj *obj) {
         return rdbSaveLongLongAsStringObject(rdb,(long)obj->ptr);
     } else {
         // 如果是字符串，直接写入 rdb
-        redisAssertWithInfo(NULL,obj,obj->encoding == REDIS_ENCODING_RAW);
+        redisAssertWithInfo(NULL,obj,sdsEncodedObject(obj));
         return rdbSaveRawString(rdb,obj->ptr,sdslen(obj->ptr));
     }
 }
@@ -400,8 +460,9 @@ robj *rdbGenericLoadStringObject(rio *rdb, int encode) {
             // 字节串是整数，创建整数对象并返回
             return rdbLoadIntegerObject(rdb,len,encode);
         case REDIS_RDB_ENC_LZF:
-            // 字节串是被 lzf 算法压缩的字符串
-            return rdbLoadLzfStringObject(rdb);
+        case REDIS_RDB_ENC_LZ4:
+            // 字节串是被 lzf 或者 lz4 算法压缩的字符串
+            return rdbLoadCompressedStringObject(rdb,len);
         default:
             redisPanic("Unknown RDB encoding type");
         }
@@ -499,12 +560,9 @@ int rdbSaveObjectType(rio *rdb, robj *o) {
         return rdbSaveType(rdb,REDIS_RDB_TYPE_STRING);
     // 列表
     case REDIS_LIST:
-        // ziplist 编码
-        if (o->encoding == REDIS_ENCODING_ZIPLIST)
-            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST_ZIPLIST);
-        // 双端链表
-        else if (o->encoding == REDIS_ENCODING_LINKEDLIST)
-            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST);
+        // quicklist
+        if (o->encoding == REDIS_ENCODING_QUICKLIST)
+            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST_QUICKLIST);
         else
             redisPanic("Unknown list encoding");
     // 集合
@@ -574,28 +632,28 @@ int rdbSaveObject(rio *rdb, robj *o) {
         nwritten += n;
     } else if (o->type == REDIS_LIST) {
         /* Save a list value */
-        if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-            // 保存 ziplist 占用的字节数量
-            size_t l = ziplistBlobLen((unsigned char*)o->ptr);
-
-            // 以字符串形式保存整个 ziplist
-            if ((n = rdbSaveRawString(rdb,o->ptr,l)) == -1) return -1;
-            nwritten += n;
-        } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-            list *list = o->ptr;
-            listIter li;
-            listNode *ln;
+        if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+            quicklist *ql = o->ptr;
+            quicklistNode *node = ql->head;
 
-            // 保存入节点数量
-            if ((n = rdbSaveLen(rdb,listLength(list))) == -1) return -1;
+            // 保存节点数量
+            if ((n = rdbSaveLen(rdb,ql->len)) == -1) return -1;
             nwritten += n;
 
-            // 遍历所有链表节点，取出值，并以字符形式保存它们
-            listRewind(list,&li);
-            while((ln = listNext(&li))) {
-                robj *eleobj = listNodeValue(ln);
-                if ((n = rdbSaveStringObject(rdb,eleobj)) == -1) return -1;
-                nwritten += n;
+            // 以字符串形式保存每个节点的 ziplist ，
+            // 已经压缩的节点直接写入压缩数据，不必解压再压缩
+            while (node) {
+                if (quicklistNodeIsCompressed(node)) {
+                    void *data;
+                    size_t compress_len = quicklistGetLzf(node, &data);
+                    if ((n = rdbSaveCompressedBlob(rdb,REDIS_RDB_ENC_LZF,data,
+                                                      compress_len,node->sz)) == -1) return -1;
+                    nwritten += n;
+                } else {
+                    if ((n = rdbSaveRawString(rdb,node->zl,node->sz)) == -1) return -1;
+                    nwritten += n;
+                }
+                node = node->next;
             }
         } else {
             redisPanic("Unknown list encoding");
@@ -754,38 +812,29 @@ int rdbSaveKeyValuePair(rio *rdb, robj *key, robj *val,
     return 1;
 }
 
-/* Save the DB on disk. Return REDIS_ERR on error, REDIS_OK on success */
-/*
- * 将数据库保存到磁盘上。成功返回 REDIS_OK ，失败返回 REDIS_ERR 。
- */
-int rdbSave(char *filename) {
+/* Produces a dump of the database in RDB format sending it to the specified
+ * Redis I/O channel. On success REDIS_OK is returned, otherwise REDIS_ERR
+ * is returned and part of the output, or all the output, can be
+ * missing because of I/O errors.
+ *
+ * 将数据库以 RDB 格式写入到给定的 rio 中，
+ * 成功返回 REDIS_OK ，出错返回 REDIS_ERR 。 */
+int rdbSaveRio(rio *rdb, int flags) {
     dictIterator *di = NULL;
     dictEntry *de;
-    char tmpfile[256];
     char magic[10];
     int j;
     long long now = mstime();
-    FILE *fp;
-    rio rdb;
+    long long processed = 0;
+    uint32_t db_size, expires_size;
     uint64_t cksum;
 
-    // 以 "temp-<pid>.rdb" 格式创建临时文件名
-    snprintf(tmpfile,256,"temp-%d.rdb", (int) getpid());
-    fp = fopen(tmpfile,"w");
-    if (!fp) {
-        redisLog(REDIS_WARNING, "Failed opening .rdb for saving: %s",
-            strerror(errno));
-        return REDIS_ERR;
-    }
-
-    // 初始化 rio 文件
-    rioInitWithFile(&rdb,fp);
     // 如果有需要的话，设置校验和计算函数
     if (server.rdb_checksum)
-        rdb.update_cksum = rioGenericUpdateChecksum;
+        rdb->update_cksum = rioGenericUpdateChecksum;
     // 以 "REDIS <VERSION>" 格式写入文件头，以及 RDB 的版本
     snprintf(magic,sizeof(magic),"REDIS%04d",REDIS_RDB_VERSION);
-    if (rdbWriteRaw(&rdb,magic,9) == -1) goto werr;
+    if (rdbWriteRaw(rdb,magic,9) == -1) goto werr;
 
     // 遍历所有数据库，保存它们的数据
     for (j = 0; j < server.dbnum; j++) {
@@ -798,15 +847,24 @@ int rdbSave(char *filename) {
 
         // 创建迭代器
         di = dictGetSafeIterator(d);
-        if (!di) {
-            fclose(fp);
-            return REDIS_ERR;
-        }
+        if (!di) return REDIS_ERR;
 
         /* Write the SELECT DB opcode */
         // 记录正在使用的数据库的号码
-        if (rdbSaveType(&rdb,REDIS_RDB_OPCODE_SELECTDB) == -1) goto werr;
-        if (rdbSaveLen(&rdb,j) == -1) goto werr;
+        if (rdbSaveType(rdb,REDIS_RDB_OPCODE_SELECTDB) == -1) goto werr;
+        if (rdbSaveLen(rdb,j) == -1) goto werr;
+
+        /* Write the RESIZE DB opcode: the number of keys and of keys with
+         * an expire are just hints, used by the loader in order to size
+         * the hash tables once instead of rehashing while loading. */
+        // 记录数据库的键数量和过期键数量，载入时用于预先扩展字典
+        db_size = (dictSize(db->dict) <= UINT32_MAX) ?
+                  dictSize(db->dict) : UINT32_MAX;
+        expires_size = (dictSize(db->expires) <= UINT32_MAX) ?
+                       dictSize(db->expires) : UINT32_MAX;
+        if (rdbSaveType(rdb,REDIS_RDB_OPCODE_RESIZEDB) == -1) goto werr;
+        if (rdbSaveLen(rdb,db_size) == -1) goto werr;
+        if (rdbSaveLen(rdb,expires_size) == -1) goto werr;
 
         /* Iterate this DB writing every entry */
         // 将数据库中的所有节点保存到 RDB 文件
@@ -821,25 +879,107 @@ int rdbSave(char *filename) {
             initStaticStringObject(key,keystr);
             // 取出过期时间
             expire = getExpire(db,&key);
-            if (rdbSaveKeyValuePair(&rdb,&key,o,expire,now) == -1) goto werr;
+            if (rdbSaveKeyValuePair(rdb,&key,o,expire,now) == -1) goto werr;
+
+            /* When this RDB is produced as part of an AOF rewrite, move
+             * accumulated diff from parent to child while rewriting in
+             * order to have a smaller final write. */
+            // 作为 AOF 重写前导时，每保存一批键就读取一次父进程发来的差异数据
+            if (flags & REDIS_RDB_SAVE_AOF_PREAMBLE &&
+                ++processed % 1024 == 0)
+            {
+                aofReadDiffFromParent();
+            }
         }
         dictReleaseIterator(di);
     }
     di = NULL; /* So that we don't release it again on error. */
 
     /* EOF opcode */
-    if (rdbSaveType(&rdb,REDIS_RDB_OPCODE_EOF) == -1) goto werr;
+    if (rdbSaveType(rdb,REDIS_RDB_OPCODE_EOF) == -1) goto werr;
 
     /* CRC64 checksum. It will be zero if checksum computation is disabled, the
      * loading code skips the check in this case. */
-    cksum = rdb.cksum;
+    cksum = rdb->cksum;
     memrev64ifbe(&cksum);
-    rioWrite(&rdb,&cksum,8);
+    if (rioWrite(rdb,&cksum,8) == 0) goto werr;
+    return REDIS_OK;
+
+werr:
+    if (di) dictReleaseIterator(di);
+    return REDIS_ERR;
+}
+
+/* This is just a wrapper to rdbSaveRio() that additionally adds a prefix
+ * and a suffix to the generated RDB dump. The prefix is:
+ *
+ * $EOF:<40 bytes unguessable hex string>\r\n
+ *
+ * While the suffix is the 40 bytes hex string we announced in the prefix.
+ * This way processes receiving the payload can understand when it ends
+ * without doing any processing of the content.
+ *
+ * 在 RDB 数据的前后加上 EOF 标记，
+ * 让接收方在事先不知道数据长度的情况下，也能知道数据在哪里结束。 */
+int rdbSaveRioWithEOFMark(rio *rdb) {
+    char eofmark[REDIS_EOF_MARK_SIZE];
+
+    getRandomHexChars(eofmark,REDIS_EOF_MARK_SIZE);
+    if (rioWrite(rdb,"$EOF:",5) == 0) return REDIS_ERR;
+    if (rioWrite(rdb,eofmark,REDIS_EOF_MARK_SIZE) == 0) return REDIS_ERR;
+    if (rioWrite(rdb,"\r\n",2) == 0) return REDIS_ERR;
+    if (rdbSaveRio(rdb,REDIS_RDB_SAVE_NONE) == REDIS_ERR) return REDIS_ERR;
+    /* The mark is not part of the checksummed payload. */
+    rdb->update_cksum = NULL;
+    if (rioWrite(rdb,eofmark,REDIS_EOF_MARK_SIZE) == 0) return REDIS_ERR;
+    return REDIS_OK;
+}
+
+/* Save the DB on disk. Return REDIS_ERR on error, REDIS_OK on success */
+/*
+ * 将数据库保存到磁盘上。成功返回 REDIS_OK ，失败返回 REDIS_ERR 。
+ */
+int rdbSave(char *filename) {
+    char tmpfile[256];
+    FILE *fp;
+    rio rdb, zrdb;
+
+    // 以 "temp-<pid>.rdb" 格式创建临时文件名
+    snprintf(tmpfile,256,"temp-%d.rdb", (int) getpid());
+    fp = fopen(tmpfile,"w");
+    if (!fp) {
+        redisLog(REDIS_WARNING, "Failed opening .rdb for saving: %s",
+            strerror(errno));
+        return REDIS_ERR;
+    }
+
+    // 初始化 rio 文件
+    rioInitWithFile(&rdb,fp);
+    if (server.rdb_stream_compression) {
+        /* Compress the whole payload: write the stream magic, then save the
+         * DB as usual through a compressed stream writing to the file. */
+        // 压缩整个文件：先写入标识，然后通过压缩流保存数据库
+        if (rdbWriteRaw(&rdb,REDIS_RDB_STREAM_MAGIC,
+                        REDIS_RDB_STREAM_MAGIC_LEN) == -1) goto werr;
+        rioInitWithCompressor(&zrdb,&rdb);
+        if (rdbSaveRio(&zrdb,REDIS_RDB_SAVE_NONE) == REDIS_ERR ||
+            rioFlush(&zrdb) == 0)
+        {
+            rioFreeZstream(&zrdb);
+            goto werr;
+        }
+        rioFreeZstream(&zrdb);
+    } else {
+        if (rdbSaveRio(&rdb,REDIS_RDB_SAVE_NONE) == REDIS_ERR) goto werr;
+    }
 
     /* Make sure data will not remain on the OS's output buffers */
-    fflush(fp);
-    fsync(fileno(fp));
-    fclose(fp);
+    if (fflush(fp) == EOF) goto werr;
+    if (fsync(fileno(fp)) == -1) goto werr;
+    if (fclose(fp) == EOF) {
+        fp = NULL;
+        goto werr;
+    }
 
     /* Use RENAME to make sure the DB file is changed atomically only
      * if the generate DB file is ok. */
@@ -860,10 +1000,9 @@ int rdbSave(char *filename) {
     return REDIS_OK;
 
 werr:
-    fclose(fp);
-    unlink(tmpfile);
     redisLog(REDIS_WARNING,"Write error saving DB on disk: %s", strerror(errno));
-    if (di) dictReleaseIterator(di);
+    if (fp) fclose(fp);
+    unlink(tmpfile);
     return REDIS_ERR;
 }
 
@@ -908,6 +1047,7 @@ int rdbSaveBackground(char *filename) {
         /* Parent */
         // 记录最后一次 fork 的时间
         server.stat_fork_time = ustime()-start;
+        latencyAddSampleIfNeeded("fork",server.stat_fork_time/1000);
 
         // 创建子进程失败时进行错误报告
         if (childpid == -1) {
@@ -922,6 +1062,7 @@ int rdbSaveBackground(char *filename) {
         server.rdb_save_time_start = time(NULL);
         // 记录子进程的 id
         server.rdb_child_pid = childpid;
+        server.rdb_child_type = REDIS_RDB_CHILD_TYPE_DISK;
         // 在执行时关闭对数据库的 rehash
         // 避免 copy-on-write
         updateDictResizePolicy();
@@ -932,6 +1073,154 @@ int rdbSaveBackground(char *filename) {
     return REDIS_OK; /* unreached */
 }
 
+/* Spawn an RDB child that writes the RDB to the sockets of the slaves
+ * that are currently in REDIS_REPL_WAIT_BGSAVE_START state, instead of
+ * writing it to disk first.
+ *
+ * The payload is framed with rdbSaveRioWithEOFMark(), since its size is
+ * not known in advance. When the child exits it reports, through a pipe,
+ * which slaves received the whole payload: see
+ * backgroundSaveDoneHandlerSocket().
+ *
+ * 创建一个子进程，将 RDB 数据直接写入到所有处于
+ * WAIT_BGSAVE_START 状态的附属节点的套接字，不经过磁盘。 */
+int rdbSaveToSlavesSockets(void) {
+    int *fds;
+    int numfds;
+    listNode *ln;
+    listIter li;
+    pid_t childpid;
+    long long start;
+    int pipefds[2];
+
+    if (server.rdb_child_pid != -1) return REDIS_ERR;
+
+    /* Before to fork, create a pipe that will be used in order to
+     * send back to the parent the file descriptors of the slaves that
+     * successfully received all the writes. */
+    if (pipe(pipefds) == -1) return REDIS_ERR;
+    server.rdb_pipe_read_result_from_child = pipefds[0];
+    server.rdb_pipe_write_result_to_child = pipefds[1];
+
+    /* Collect the file descriptors of the slaves we want to transfer
+     * the RDB to, which are in WAIT_BGSAVE_START state. */
+    fds = zmalloc(sizeof(int)*listLength(server.slaves));
+    numfds = 0;
+
+    listRewind(server.slaves,&li);
+    while((ln = listNext(&li))) {
+        redisClient *slave = ln->value;
+
+        if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START) {
+            fds[numfds++] = slave->fd;
+            slave->replstate = REDIS_REPL_WAIT_BGSAVE_END;
+            /* The +FULLRESYNC reply must reach the slave before the child
+             * starts streaming the payload on the same socket. */
+            replicationSetupSlaveForFullResync(slave,server.master_repl_offset);
+        }
+    }
+
+    /* Create the child process. */
+    server.dirty_before_bgsave = server.dirty;
+    start = ustime();
+    if ((childpid = fork()) == 0) {
+        /* Child */
+        int retval;
+        rio slave_sockets;
+
+        if (server.ipfd > 0) close(server.ipfd);
+        if (server.sofd > 0) close(server.sofd);
+        close(server.rdb_pipe_read_result_from_child);
+
+        rioInitWithFdset(&slave_sockets,fds,numfds,
+                         (long long)server.repl_timeout*1000);
+        zfree(fds);
+
+        retval = rdbSaveRioWithEOFMark(&slave_sockets);
+        if (retval == REDIS_OK && rioFlush(&slave_sockets) == 0)
+            retval = REDIS_ERR;
+
+        if (retval == REDIS_OK) {
+            size_t private_dirty = zmalloc_get_private_dirty();
+
+            if (private_dirty) {
+                redisLog(REDIS_NOTICE,
+                    "RDB: %lu MB of memory used by copy-on-write",
+                    private_dirty/(1024*1024));
+            }
+
+            /* If we are returning OK, at least one slave was served
+             * with the RDB file as expected, so we need to send a report
+             * to the parent via the pipe. The format of the message is:
+             *
+             * <len> <slave[0].fd> <slave[0].error> ...
+             *
+             * len, slave fd and slave error, are all uint64_t integers,
+             * so basically the reply is composed of 64 bit integers, with
+             * the error set to 0 for the slaves that received the whole
+             * payload. */
+            void *msg = zmalloc(sizeof(uint64_t)*(1+2*numfds));
+            uint64_t *len = msg;
+            uint64_t *ids = len+1;
+            int j, msglen;
+
+            *len = numfds;
+            for (j = 0; j < numfds; j++) {
+                *ids++ = slave_sockets.io.fdset.fds[j];
+                *ids++ = slave_sockets.io.fdset.state[j];
+            }
+
+            /* Write the message to the parent. If we have no good slaves or
+             * we are unable to transfer the message to the parent, we exit
+             * with an error so that the parent will abort the replication
+             * process with all the slaves that were waiting. */
+            msglen = sizeof(uint64_t)*(1+2*numfds);
+            if (*len == 0 ||
+                write(server.rdb_pipe_write_result_to_child,msg,msglen)
+                != msglen)
+            {
+                retval = REDIS_ERR;
+            }
+            zfree(msg);
+        }
+        rioFreeFdset(&slave_sockets);
+        exitFromChild((retval == REDIS_OK) ? 0 : 1);
+    } else {
+        /* Parent */
+        zfree(fds);
+        close(server.rdb_pipe_write_result_to_child);
+        server.stat_fork_time = ustime()-start;
+        latencyAddSampleIfNeeded("fork",server.stat_fork_time/1000);
+
+        if (childpid == -1) {
+            redisLog(REDIS_WARNING,"Can't save in background: fork: %s",
+                strerror(errno));
+
+            /* Undo the state change. The caller will perform cleanup on
+             * all the slaves in BGSAVE_START state, but we already turned
+             * them into BGSAVE_END before forking. */
+            listRewind(server.slaves,&li);
+            while((ln = listNext(&li))) {
+                redisClient *slave = ln->value;
+
+                if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_END)
+                    slave->replstate = REDIS_REPL_WAIT_BGSAVE_START;
+            }
+            close(server.rdb_pipe_read_result_from_child);
+            return REDIS_ERR;
+        }
+
+        redisLog(REDIS_NOTICE,"Background RDB transfer started by pid %d",
+            childpid);
+        server.rdb_save_time_start = time(NULL);
+        server.rdb_child_pid = childpid;
+        server.rdb_child_type = REDIS_RDB_CHILD_TYPE_SOCKET;
+        updateDictResizePolicy();
+        return REDIS_OK;
+    }
+    return REDIS_OK; /* unreached */
+}
+
 void rdbRemoveTempFile(pid_t childpid) {
     char tmpfile[256];
 
@@ -945,7 +1234,7 @@ void rdbRemoveTempFile(pid_t childpid) {
  * 根据 rdbtype 所指定的类型，从 rdb 中读取并返回对象
  */
 robj *rdbLoadObject(int rdbtype, rio *rdb) {
-    robj *o, *ele, *dec;
+    robj *o, *ele;
     size_t len;
     unsigned int i;
 
@@ -962,36 +1251,13 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
         /* Read list value */
         if ((len = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR) return NULL;
 
-        /* Use a real list when there are too many entries */
-        if (len > server.list_max_ziplist_entries) {
-            o = createListObject();
-        } else {
-            o = createZiplistObject();
-        }
+        o = createQuicklistObject();
 
         /* Load every single element of the list */
         while(len--) {
             if ((ele = rdbLoadEncodedStringObject(rdb)) == NULL) return NULL;
-
-            /* If we are using a ziplist and the value is too big, convert
-             * the object to a real list. */
-            // 这一段可以用以下两句来代替
-            // listTypePush(o, ele, REDIS_TAIL);
-            // decrRefCount(ele);
-            if (o->encoding == REDIS_ENCODING_ZIPLIST &&
-                ele->encoding == REDIS_ENCODING_RAW &&
-                sdslen(ele->ptr) > server.list_max_ziplist_value)
-                    listTypeConvert(o,REDIS_ENCODING_LINKEDLIST);
-
-            if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-                dec = getDecodedObject(ele);
-                o->ptr = ziplistPush(o->ptr,dec->ptr,sdslen(dec->ptr),REDIS_TAIL);
-                decrRefCount(dec);
-                decrRefCount(ele);
-            } else {
-                ele = tryObjectEncoding(ele);
-                listAddNodeTail(o->ptr,ele);
-            }
+            listTypePush(o,ele,REDIS_TAIL);
+            decrRefCount(ele);
         }
 
     // 读取并返回集合对象
@@ -1059,7 +1325,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
             if (rdbLoadDoubleValue(rdb,&score) == -1) return NULL;
 
             /* Don't care about integer-encoded strings. */
-            if (ele->encoding == REDIS_ENCODING_RAW &&
+            if (sdsEncodedObject(ele) &&
                 sdslen(ele->ptr) > maxelelen)
                     maxelelen = sdslen(ele->ptr);
 
@@ -1095,10 +1361,10 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
             /* Load raw strings */
             field = rdbLoadStringObject(rdb);
             if (field == NULL) return NULL;
-            redisAssert(field->encoding == REDIS_ENCODING_RAW);
+            redisAssert(sdsEncodedObject(field));
             value = rdbLoadStringObject(rdb);
             if (value == NULL) return NULL;
-            redisAssert(field->encoding == REDIS_ENCODING_RAW);
+            redisAssert(sdsEncodedObject(field));
 
             /* Add pair to ziplist */
             o->ptr = ziplistPush(o->ptr, field->ptr, sdslen(field->ptr), ZIPLIST_TAIL);
@@ -1138,6 +1404,23 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
         /* All pairs should be read by now */
         redisAssert(len == 0);
 
+    // 读取并返回 quicklist 编码的列表对象
+    } else if (rdbtype == REDIS_RDB_TYPE_LIST_QUICKLIST) {
+        if ((len = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR) return NULL;
+        o = createQuicklistObject();
+
+        // 每个节点都以字符串形式保存了一个 ziplist
+        while (len--) {
+            robj *aux = rdbLoadStringObject(rdb);
+            unsigned char *zl;
+
+            if (aux == NULL) return NULL;
+            zl = zmalloc(sdslen(aux->ptr));
+            memcpy(zl,aux->ptr,sdslen(aux->ptr));
+            decrRefCount(aux);
+            quicklistAppendZiplist(o->ptr,zl);
+        }
+
     } else if (rdbtype == REDIS_RDB_TYPE_HASH_ZIPMAP  ||
                rdbtype == REDIS_RDB_TYPE_LIST_ZIPLIST ||
                rdbtype == REDIS_RDB_TYPE_SET_INTSET   ||
@@ -1196,8 +1479,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
             case REDIS_RDB_TYPE_LIST_ZIPLIST:
                 o->type = REDIS_LIST;
                 o->encoding = REDIS_ENCODING_ZIPLIST;
-                if (ziplistLen(o->ptr) > server.list_max_ziplist_entries)
-                    listTypeConvert(o,REDIS_ENCODING_LINKEDLIST);
+                listTypeConvert(o,REDIS_ENCODING_QUICKLIST);
                 break;
             case REDIS_RDB_TYPE_SET_INTSET:
                 o->type = REDIS_SET;
@@ -1235,14 +1517,20 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
 void startLoading(FILE *fp) {
     struct stat sb;
 
+    if (fstat(fileno(fp), &sb) == -1)
+        startLoadingSize(0);
+    else
+        startLoadingSize(sb.st_size);
+}
+
+/* Like startLoading() but for payloads that are not files, like the RDB
+ * read straight from the master link. A zero size means unknown. */
+void startLoadingSize(off_t size) {
     /* Load the DB */
     server.loading = 1;
     server.loading_start_time = time(NULL);
-    if (fstat(fileno(fp), &sb) == -1) {
-        server.loading_total_bytes = 1; /* just to avoid division by zero */
-    } else {
-        server.loading_total_bytes = sb.st_size;
-    }
+    /* Avoid a division by zero when the size is not known. */
+    server.loading_total_bytes = size ? size : 1;
 }
 
 /* Refresh the loading progress info */
@@ -1260,49 +1548,491 @@ void stopLoading(void) {
     server.loading = 0;
 }
 
+/* -----------------------------------------------------------------------------
+ * Threaded RDB loading
+ *
+ * When rdb-load-threads is greater than 1, rdbLoadRio() does not decode keys
+ * and values itself: the main thread only finds the boundaries of every
+ * record, copying its raw bytes (LZF compressed strings included) into a
+ * batch. Full batches are decoded by the loading threads, and by the main
+ * thread while it waits for them, calling rdbLoadStringObject() and
+ * rdbLoadObject() against an in memory rio. There are two batches, so that
+ * the main thread can parse the next batch and add the keys of the previous
+ * one to the databases while the threads are decoding. Keys are always added
+ * by the main thread in file order, so the result is the same obtained by
+ * the serial loader.
+ *
+ * The loading threads never touch the reference count of shared objects:
+ * while they run server.rdb_load_unshared is set, so that the object
+ * constructors don't return shared integers, and the main thread replaces
+ * integer string values with the shared ones when it adds them to the
+ * databases.
+ *
+ * 多线程载入 RDB
+ *
+ * 在 rdb-load-threads 大于 1 时，主线程只负责找出每个键值对的边界，
+ * 并将它们未经解码（包括 LZF 压缩的字符串）的原始字节复制到批次中。
+ * 装满的批次由载入线程（以及等待中的主线程）负责解码。
+ * 程序使用两个批次，在载入线程解码一个批次的同时，
+ * 主线程读取下一个批次，并将上一个批次的键值对添加到数据库。
+ * 键值对总是由主线程按照文件中的顺序添加，所以载入的结果和顺序载入相同。
+ *
+ * 载入线程不会修改共享对象的引用计数：
+ * 载入期间 server.rdb_load_unshared 为真，对象构造函数不会返回共享整数，
+ * 主线程在将值添加到数据库时，再把整数字符串值替换为共享对象。
+ * -------------------------------------------------------------------------- */
+
+#define REDIS_RDB_LOAD_BATCH_KEYS 1024               /* Max records per batch */
+#define REDIS_RDB_LOAD_BATCH_BYTES (1024*1024*4)     /* Max raw bytes per batch */
+#define REDIS_RDB_LOAD_CHUNK_KEYS 16    /* Records claimed by a thread at once */
+
+/* A key/value pair saved inside a batch as raw RDB bytes. */
+typedef struct rdbLoadRecord {
+    redisDb *db;            /* Database the key belongs to. */
+    int type;               /* RDB type of the value. */
+    long long expiretime;   /* Expire time in milliseconds, or -1. */
+    size_t offset;          /* Offset of the key inside the batch raw bytes. */
+    robj *key, *val;        /* Decoded key and value, NULL on errors. */
+} rdbLoadRecord;
+
+typedef struct rdbLoadBatch {
+    sds raw;                /* Raw bytes of all the records. */
+    rdbLoadRecord *records;
+    int count;              /* Number of records in the batch. */
+    int next;               /* First record not yet claimed by a thread. */
+    int pending;            /* Number of records not yet decoded. */
+} rdbLoadBatch;
+
+static pthread_t rdb_load_threads[REDIS_RDB_LOAD_THREADS_MAX_NUM];
+static pthread_mutex_t rdb_load_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 主线程通过这个条件变量通知载入线程有新的批次需要解码
+static pthread_cond_t rdb_load_job_cond = PTHREAD_COND_INITIALIZER;
+// 批次解码完毕时，通过这个条件变量通知主线程
+static pthread_cond_t rdb_load_done_cond = PTHREAD_COND_INITIALIZER;
+static rdbLoadBatch rdb_load_batches[2];
+// 正在被主线程填充的批次
+static rdbLoadBatch *rdb_load_filling;
+// 正在被解码的批次，没有时为 NULL
+static rdbLoadBatch *rdb_load_decoding;
+// 过期键值对的原始字节被读入这里，然后丢弃
+static sds rdb_load_discard;
+// 已创建的载入线程数量（不包括主线程）
+static int rdb_load_threads_num;
+static int rdb_load_stop;
+
+/* Append 'len' bytes read from 'rdb' to the sds pointed by 'dst'. */
+static int rdbCopyRaw(rio *rdb, sds *dst, size_t len) {
+    size_t curlen = sdslen(*dst);
+
+    if (len == 0) return REDIS_OK;
+    *dst = sdsMakeRoomFor(*dst,len);
+    if (rioRead(rdb,*dst+curlen,len) == 0) return REDIS_ERR;
+    sdsIncrLen(*dst,len);
+    return REDIS_OK;
+}
+
+/* Like rdbLoadLen(), but the length is also appended to 'dst' exactly as
+ * it was encoded in the file. */
+static uint32_t rdbCopyLen(rio *rdb, sds *dst, int *isencoded) {
+    unsigned char buf[5];
+    uint32_t len;
+    int type, buflen = 1;
+
+    if (isencoded) *isencoded = 0;
+    if (rioRead(rdb,buf,1) == 0) return REDIS_RDB_LENERR;
+    type = (buf[0]&0xC0)>>6;
+    if (type == REDIS_RDB_ENCVAL) {
+        if (isencoded) *isencoded = 1;
+        len = buf[0]&0x3F;
+    } else if (type == REDIS_RDB_6BITLEN) {
+        len = buf[0]&0x3F;
+    } else if (type == REDIS_RDB_14BITLEN) {
+        if (rioRead(rdb,buf+1,1) == 0) return REDIS_RDB_LENERR;
+        len = ((buf[0]&0x3F)<<8)|buf[1];
+        buflen = 2;
+    } else {
+        if (rioRead(rdb,buf+1,4) == 0) return REDIS_RDB_LENERR;
+        memcpy(&len,buf+1,4);
+        len = ntohl(len);
+        buflen = 5;
+    }
+    *dst = sdscatlen(*dst,buf,buflen);
+    return len;
+}
+
+/* Copy a string object to 'dst' without decoding it: integers stay encoded
+ * and LZF compressed strings stay compressed. */
+static int rdbCopyStringObject(rio *rdb, sds *dst) {
+    int isencoded;
+    uint32_t len, clen;
+
+    len = rdbCopyLen(rdb,dst,&isencoded);
+    if (isencoded) {
+        switch(len) {
+        case REDIS_RDB_ENC_INT8: return rdbCopyRaw(rdb,dst,1);
+        case REDIS_RDB_ENC_INT16: return rdbCopyRaw(rdb,dst,2);
+        case REDIS_RDB_ENC_INT32: return rdbCopyRaw(rdb,dst,4);
+        case REDIS_RDB_ENC_LZF:
+        case REDIS_RDB_ENC_LZ4:
+            // 压缩后的长度，以及未压缩时的长度
+            if ((clen = rdbCopyLen(rdb,dst,NULL)) == REDIS_RDB_LENERR ||
+                rdbCopyLen(rdb,dst,NULL) == REDIS_RDB_LENERR)
+                return REDIS_ERR;
+            return rdbCopyRaw(rdb,dst,clen);
+        default:
+            redisPanic("Unknown RDB encoding type");
+        }
+    }
+    if (len == REDIS_RDB_LENERR) return REDIS_ERR;
+    return rdbCopyRaw(rdb,dst,len);
+}
+
+/* Copy a double saved with rdbSaveDoubleValue() to 'dst'. */
+static int rdbCopyDoubleValue(rio *rdb, sds *dst) {
+    unsigned char len;
+
+    if (rioRead(rdb,&len,1) == 0) return REDIS_ERR;
+    *dst = sdscatlen(*dst,&len,1);
+    // 253 、 254 和 255 分别表示 NaN 、正无穷和负无穷
+    if (len >= 253) return REDIS_OK;
+    return rdbCopyRaw(rdb,dst,len);
+}
+
+/* Copy the raw bytes of a value of the specified RDB type to 'dst',
+ * following the same layout expected by rdbLoadObject(). */
+static int rdbCopyObject(int rdbtype, rio *rdb, sds *dst) {
+    uint32_t len;
+
+    switch(rdbtype) {
+    case REDIS_RDB_TYPE_STRING:
+    case REDIS_RDB_TYPE_HASH_ZIPMAP:
+    case REDIS_RDB_TYPE_LIST_ZIPLIST:
+    case REDIS_RDB_TYPE_SET_INTSET:
+    case REDIS_RDB_TYPE_ZSET_ZIPLIST:
+    case REDIS_RDB_TYPE_HASH_ZIPLIST:
+        return rdbCopyStringObject(rdb,dst);
+    case REDIS_RDB_TYPE_LIST:
+    case REDIS_RDB_TYPE_LIST_QUICKLIST:
+    case REDIS_RDB_TYPE_SET:
+    case REDIS_RDB_TYPE_ZSET:
+    case REDIS_RDB_TYPE_HASH:
+        if ((len = rdbCopyLen(rdb,dst,NULL)) == REDIS_RDB_LENERR)
+            return REDIS_ERR;
+        // 有序集合的元素后面跟着分值，哈希的域后面跟着值
+        while(len--) {
+            if (rdbCopyStringObject(rdb,dst) == REDIS_ERR) return REDIS_ERR;
+            if (rdbtype == REDIS_RDB_TYPE_ZSET &&
+                rdbCopyDoubleValue(rdb,dst) == REDIS_ERR) return REDIS_ERR;
+            if (rdbtype == REDIS_RDB_TYPE_HASH &&
+                rdbCopyStringObject(rdb,dst) == REDIS_ERR) return REDIS_ERR;
+        }
+        return REDIS_OK;
+    default:
+        redisPanic("Unknown object type");
+    }
+    return REDIS_ERR; /* Just to avoid warnings. */
+}
+
+/* Decode the records of the batch in the range [start,end). */
+static void rdbLoadDecodeRecords(rdbLoadBatch *b, int start, int end) {
+    rio r;
+    int j;
+
+    for (j = start; j < end; j++) {
+        rdbLoadRecord *rec = b->records+j;
+
+        rioInitWithBuffer(&r,b->raw);
+        r.io.buffer.pos = rec->offset;
+        if ((rec->key = rdbLoadStringObject(&r)) == NULL) continue;
+        rec->val = rdbLoadObject(rec->type,&r);
+    }
+}
+
+/* Claim the next chunk of records of the batch and decode it. Must be called
+ * with the mutex locked, that is released while decoding. Returns 0 if there
+ * was nothing left to claim. */
+static int rdbLoadDecodeChunk(rdbLoadBatch *b) {
+    int start = b->next, end;
+
+    if (start == b->count) return 0;
+    end = start + REDIS_RDB_LOAD_CHUNK_KEYS;
+    if (end > b->count) end = b->count;
+    b->next = end;
+    pthread_mutex_unlock(&rdb_load_mutex);
+
+    rdbLoadDecodeRecords(b,start,end);
+
+    pthread_mutex_lock(&rdb_load_mutex);
+    b->pending -= end-start;
+    if (b->pending == 0) pthread_cond_signal(&rdb_load_done_cond);
+    return 1;
+}
+
+/* Main function of the loading threads. */
+static void *rdbLoadThreadMain(void *arg) {
+    sigset_t sigset;
+
+    REDIS_NOTUSED(arg);
+
+    /* Block SIGALRM so we are sure that only the main thread will
+     * receive the watchdog signal. */
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &sigset, NULL))
+        redisLog(REDIS_WARNING,
+            "Warning: can't mask SIGALRM in RDB loading thread: %s",
+            strerror(errno));
+
+    pthread_mutex_lock(&rdb_load_mutex);
+    while(!rdb_load_stop) {
+        if (rdb_load_decoding == NULL ||
+            !rdbLoadDecodeChunk(rdb_load_decoding))
+        {
+            pthread_cond_wait(&rdb_load_job_cond,&rdb_load_mutex);
+        }
+    }
+    pthread_mutex_unlock(&rdb_load_mutex);
+    return NULL;
+}
+
+/* Hand the batch to the loading threads. */
+static void rdbLoadDispatchBatch(rdbLoadBatch *b) {
+    pthread_mutex_lock(&rdb_load_mutex);
+    b->next = 0;
+    b->pending = b->count;
+    rdb_load_decoding = b;
+    pthread_cond_broadcast(&rdb_load_job_cond);
+    pthread_mutex_unlock(&rdb_load_mutex);
+}
+
+/* Wait for the batch being decoded, if any, helping the loading threads
+ * with the records not yet claimed. */
+static void rdbLoadWaitBatch(void) {
+    rdbLoadBatch *b = rdb_load_decoding;
+
+    if (b == NULL) return;
+    pthread_mutex_lock(&rdb_load_mutex);
+    while(b->pending) {
+        if (!rdbLoadDecodeChunk(b))
+            pthread_cond_wait(&rdb_load_done_cond,&rdb_load_mutex);
+    }
+    rdb_load_decoding = NULL;
+    pthread_mutex_unlock(&rdb_load_mutex);
+}
+
+/* The loading threads never return shared integers, so that they don't
+ * touch the reference count of shared objects. Integer string values are
+ * replaced by the shared ones here, in the main thread, following the same
+ * rules of tryObjectEncoding(). */
 /*
- * 读取 rdb 文件，并将其中的对象保存到内存中
+ * 载入线程不会使用共享整数对象，
+ * 所以由主线程在这里把整数字符串值替换为共享对象
  */
-int rdbLoad(char *filename) {
+static robj *rdbLoadShareValue(robj *val) {
+    long value;
+
+    if (val->type != REDIS_STRING || val->encoding != REDIS_ENCODING_INT ||
+        server.maxmemory) return val;
+    value = (long)val->ptr;
+    if (value < 0 || value >= REDIS_SHARED_INTEGERS) return val;
+    decrRefCount(val);
+    incrRefCount(shared.integers[value]);
+    return shared.integers[value];
+}
+
+/* Add the records of a decoded batch to the databases, in file order, and
+ * empty the batch. Returns REDIS_ERR if some record could not be decoded,
+ * in which case the records following it are discarded. */
+static int rdbLoadInsertBatch(rdbLoadBatch *b) {
+    int j, retval = REDIS_OK;
+
+    for (j = 0; j < b->count; j++) {
+        rdbLoadRecord *rec = b->records+j;
+
+        if (retval == REDIS_OK && rec->key && rec->val) {
+            rec->val = rdbLoadShareValue(rec->val);
+            dbAdd(rec->db,rec->key,rec->val);
+            if (rec->expiretime != -1)
+                setExpire(rec->db,rec->key,rec->expiretime);
+        } else {
+            retval = REDIS_ERR;
+            if (rec->val) decrRefCount(rec->val);
+        }
+        if (rec->key) decrRefCount(rec->key);
+        rec->key = rec->val = NULL;
+    }
+    b->count = 0;
+    sdsclear(b->raw);
+    return retval;
+}
+
+/* Copy the key and the value of the next record into the batch being
+ * filled. The bytes of expired keys are read but discarded. */
+static int rdbLoadCopyRecord(rio *rdb, redisDb *db, int type,
+                             long long expiretime, int expired)
+{
+    rdbLoadBatch *b = rdb_load_filling;
+    sds *dst = expired ? &rdb_load_discard : &b->raw;
+    size_t offset = sdslen(*dst);
+    rdbLoadRecord *rec;
+
+    if (rdbCopyStringObject(rdb,dst) == REDIS_ERR ||
+        rdbCopyObject(type,rdb,dst) == REDIS_ERR) return REDIS_ERR;
+    if (expired) {
+        sdsclear(rdb_load_discard);
+        return REDIS_OK;
+    }
+
+    rec = b->records+b->count++;
+    rec->db = db;
+    rec->type = type;
+    rec->expiretime = expiretime;
+    rec->offset = offset;
+    rec->key = rec->val = NULL;
+    return REDIS_OK;
+}
+
+/* Called when the batch being filled is full: it is handed to the loading
+ * threads, while the main thread adds the keys of the previous batch to the
+ * databases. Calling it twice at the end of the payload flushes everything.
+ * Returns REDIS_ERR if some record of the previous batch was not valid. */
+static int rdbLoadSubmitBatch(void) {
+    rdbLoadBatch *prev = rdb_load_decoding, *b = rdb_load_filling;
+    int retval = REDIS_OK;
+
+    rdbLoadWaitBatch();
+    if (b->count) rdbLoadDispatchBatch(b);
+    if (prev) retval = rdbLoadInsertBatch(prev);
+    // 两个批次交替使用
+    rdb_load_filling = (b == rdb_load_batches) ?
+                       rdb_load_batches+1 : rdb_load_batches;
+    return retval;
+}
+
+/* Spawn the loading threads and allocate the batches. */
+static void rdbLoadThreadsStart(void) {
+    pthread_attr_t attr;
+    size_t stacksize;
+    int j;
+
+    for (j = 0; j < 2; j++) {
+        rdbLoadBatch *b = rdb_load_batches+j;
+
+        b->raw = sdsMakeRoomFor(sdsempty(),REDIS_RDB_LOAD_BATCH_BYTES);
+        b->records = zcalloc(sizeof(rdbLoadRecord)*REDIS_RDB_LOAD_BATCH_KEYS);
+        b->count = b->next = b->pending = 0;
+    }
+    rdb_load_filling = rdb_load_batches;
+    rdb_load_decoding = NULL;
+    rdb_load_discard = sdsempty();
+    rdb_load_stop = 0;
+    // 载入线程不能修改共享对象的引用计数
+    server.rdb_load_unshared = 1;
+
+    /* Set the stack size as by default it may be small in some system */
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr,&stacksize);
+    if (!stacksize) stacksize = 1; /* The world is full of Solaris Fixes */
+    while (stacksize < REDIS_THREAD_STACK_SIZE) stacksize *= 2;
+    pthread_attr_setstacksize(&attr, stacksize);
+
+    // 主线程也会参与解码，所以线程创建失败时仍然可以继续载入
+    rdb_load_threads_num = 0;
+    for (j = 1; j < server.rdb_load_threads; j++) {
+        int err = pthread_create(&rdb_load_threads[rdb_load_threads_num],
+                                 &attr,rdbLoadThreadMain,NULL);
+        if (err != 0) {
+            redisLog(REDIS_WARNING,
+                "Can't create RDB loading thread: %s", strerror(err));
+            break;
+        }
+        rdb_load_threads_num++;
+    }
+}
+
+/* Wait for the batch in flight, join the loading threads and release the
+ * batches, including the objects not yet added to the databases. */
+static void rdbLoadThreadsStop(void) {
+    int j, k;
+
+    rdbLoadWaitBatch();
+    pthread_mutex_lock(&rdb_load_mutex);
+    rdb_load_stop = 1;
+    pthread_cond_broadcast(&rdb_load_job_cond);
+    pthread_mutex_unlock(&rdb_load_mutex);
+    for (j = 0; j < rdb_load_threads_num; j++)
+        pthread_join(rdb_load_threads[j],NULL);
+    rdb_load_threads_num = 0;
+
+    for (j = 0; j < 2; j++) {
+        rdbLoadBatch *b = rdb_load_batches+j;
+
+        for (k = 0; k < b->count; k++) {
+            if (b->records[k].key) decrRefCount(b->records[k].key);
+            if (b->records[k].val) decrRefCount(b->records[k].val);
+        }
+        sdsfree(b->raw);
+        zfree(b->records);
+        b->raw = NULL;
+        b->records = NULL;
+        b->count = 0;
+    }
+    sdsfree(rdb_load_discard);
+    rdb_load_discard = NULL;
+    server.rdb_load_unshared = 0;
+}
+
+/* Load an RDB payload from the specified rio stream into memory.
+ * The caller is in charge of startLoading() / stopLoading().
+ *
+ * On error REDIS_ERR is returned with errno set to EINVAL if the payload
+ * is not a valid RDB, or to EIO on short read, OOM or checksum mismatch.
+ *
+ * 从 rio 中读取 RDB 数据，并将其中的对象保存到内存中 */
+int rdbLoadRio(rio *rdb) {
     uint32_t dbid;
     int type, rdbver;
     redisDb *db = server.db+0;
     char buf[1024];
     long long expiretime, now = mstime();
     long loops = 0;
-    FILE *fp;
-    rio rdb;
+    int threaded = server.rdb_load_threads > 1;
 
-    // 打开文件
-    fp = fopen(filename,"r");
-    if (!fp) {
-        errno = ENOENT;
-        return REDIS_ERR;
-    }
-
-    // 初始化 rdb 文件
-    rioInitWithFile(&rdb,fp);
     if (server.rdb_checksum)
-        rdb.update_cksum = rioGenericUpdateChecksum;
+        rdb->update_cksum = rioGenericUpdateChecksum;
 
     // 检查 rdb 文件头（“REDIS”字符串，以及版本号）
-    if (rioRead(&rdb,buf,9) == 0) goto eoferr;
+    if (rioRead(rdb,buf,9) == 0) goto eoferr;
     buf[9] = '\0';
+    if (memcmp(buf,REDIS_RDB_STREAM_MAGIC,REDIS_RDB_STREAM_MAGIC_LEN) == 0) {
+        /* The file was saved with rdb-stream-compression: load the payload
+         * through a decompressing stream. The checksum, if any, covers the
+         * uncompressed payload, so it is computed by the inner call. */
+        // 整个文件被压缩过，通过解压流载入其中的 RDB 数据
+        rio zrdb;
+        int retval;
+
+        rdb->update_cksum = NULL;
+        rioInitWithDecompressor(&zrdb,rdb);
+        retval = rdbLoadRio(&zrdb);
+        rioFreeZstream(&zrdb);
+        return retval;
+    }
     if (memcmp(buf,"REDIS",5) != 0) {   // "REDIS"
-        fclose(fp);
         redisLog(REDIS_WARNING,"Wrong signature trying to load DB from file");
         errno = EINVAL;
         return REDIS_ERR;
     }
     rdbver = atoi(buf+5);   // 版本号
     if (rdbver < 1 || rdbver > REDIS_RDB_VERSION) {
-        fclose(fp);
         redisLog(REDIS_WARNING,"Can't handle RDB format version %d",rdbver);
         errno = EINVAL;
         return REDIS_ERR;
     }
 
-    startLoading(fp);
+    // 创建载入线程
+    if (threaded) rdbLoadThreadsStart();
+
     while(1) {
         robj *key, *val;
         expiretime = -1;
@@ -1311,22 +2041,22 @@ int rdbLoad(char *filename) {
         // 间隔性服务客户端
         if (!(loops++ % 1000)) {
             // 刷新载入进程信息
-            loadingProgress(rioTell(&rdb));
+            loadingProgress(rioTell(rdb));
             // 处理事件
             aeProcessEvents(server.el, AE_FILE_EVENTS|AE_DONT_WAIT);
         }
 
         /* Read type. */
         // 读入类型标识符
-        if ((type = rdbLoadType(&rdb)) == -1) goto eoferr;
+        if ((type = rdbLoadType(rdb)) == -1) goto eoferr;
 
         // 接下来的值是一个过期时间
         if (type == REDIS_RDB_OPCODE_EXPIRETIME) {
             // 读取毫秒计数的过期时间
-            if ((expiretime = rdbLoadTime(&rdb)) == -1) goto eoferr;
+            if ((expiretime = rdbLoadTime(rdb)) == -1) goto eoferr;
             /* We read the time so we need to read the object type again. */
             // 读取下一个值（一个字符串 key ）的类型标识符
-            if ((type = rdbLoadType(&rdb)) == -1) goto eoferr;
+            if ((type = rdbLoadType(rdb)) == -1) goto eoferr;
             /* the EXPIRETIME opcode specifies time in seconds, so convert
              * into milliesconds. */
              // 将毫秒转换为秒
@@ -1335,10 +2065,10 @@ int rdbLoad(char *filename) {
             /* Milliseconds precision expire times introduced with RDB
              * version 3. */
             // 读取毫秒计数的过期时间
-            if ((expiretime = rdbLoadMillisecondTime(&rdb)) == -1) goto eoferr;
+            if ((expiretime = rdbLoadMillisecondTime(rdb)) == -1) goto eoferr;
             /* We read the time so we need to read the object type again. */
             // 读取下一个值（一个字符串 key ）的类型标识符
-            if ((type = rdbLoadType(&rdb)) == -1) goto eoferr;
+            if ((type = rdbLoadType(rdb)) == -1) goto eoferr;
         }
     
         // 到达 EOF ，跳出
@@ -1349,7 +2079,7 @@ int rdbLoad(char *filename) {
         // 数据库号码标识符
         if (type == REDIS_RDB_OPCODE_SELECTDB) {
             // 读取数据库号
-            if ((dbid = rdbLoadLen(&rdb,NULL)) == REDIS_RDB_LENERR)
+            if ((dbid = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR)
                 goto eoferr;
             // 检查数据库号是否合法
             if (dbid >= (unsigned)server.dbnum) {
@@ -1360,13 +2090,45 @@ int rdbLoad(char *filename) {
             continue;
         }
 
+        /* RESIZEDB: hint about the size of the keys in the currently
+         * selected database, in order to avoid useless rehashing. */
+        // 根据键数量提示，预先扩展数据库的字典
+        if (type == REDIS_RDB_OPCODE_RESIZEDB) {
+            uint32_t db_size, expires_size;
+
+            if ((db_size = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR)
+                goto eoferr;
+            if ((expires_size = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR)
+                goto eoferr;
+            if (db_size) dictExpand(db->dict,db_size);
+            if (expires_size) dictExpand(db->expires,expires_size);
+            continue;
+        }
+
+        /* With threaded loading just copy the record into the current
+         * batch: keys and values are decoded by the loading threads. */
+        // 多线程载入时，只将键值对的原始字节复制到批次中
+        if (threaded) {
+            int expired = server.masterhost == NULL && expiretime != -1 &&
+                          expiretime < now;
+
+            if (rdbLoadCopyRecord(rdb,db,type,expiretime,expired) ==
+                REDIS_ERR) goto eoferr;
+            if (rdb_load_filling->count == REDIS_RDB_LOAD_BATCH_KEYS ||
+                sdslen(rdb_load_filling->raw) >= REDIS_RDB_LOAD_BATCH_BYTES)
+            {
+                if (rdbLoadSubmitBatch() == REDIS_ERR) goto eoferr;
+            }
+            continue;
+        }
+
         /* Read key */
         // 读入 key
-        if ((key = rdbLoadStringObject(&rdb)) == NULL) goto eoferr;
+        if ((key = rdbLoadStringObject(rdb)) == NULL) goto eoferr;
 
         /* Read value */
         // 读入 value
-        if ((val = rdbLoadObject(type,&rdb)) == NULL) goto eoferr;
+        if ((val = rdbLoadObject(type,rdb)) == NULL) goto eoferr;
 
         /* Check if the key already expired. This function is used when loading
          * an RDB file from disk, either at startup, or when an RDB was
@@ -1391,36 +2153,76 @@ int rdbLoad(char *filename) {
         decrRefCount(key);
     }
 
+    /* Add the keys of the last two batches to the databases. */
+    // 添加最后两个批次中的键值对，然后停止载入线程
+    if (threaded) {
+        if (rdbLoadSubmitBatch() == REDIS_ERR ||
+            rdbLoadSubmitBatch() == REDIS_ERR) goto eoferr;
+        rdbLoadThreadsStop();
+        threaded = 0;
+    }
+
     /* Verify the checksum if RDB version is >= 5 */
     // 检查校验和
     if (rdbver >= 5 && server.rdb_checksum) {
-        uint64_t cksum, expected = rdb.cksum;
+        uint64_t cksum, expected = rdb->cksum;
 
-        if (rioRead(&rdb,&cksum,8) == 0) goto eoferr;
+        if (rioRead(rdb,&cksum,8) == 0) goto eoferr;
         memrev64ifbe(&cksum);
         if (cksum == 0) {
             redisLog(REDIS_WARNING,"RDB file was saved with checksum disabled: no check performed.");
         } else if (cksum != expected) {
-            redisLog(REDIS_WARNING,"Wrong RDB checksum. Aborting now.");
-            exit(1);
+            redisLog(REDIS_WARNING,"Wrong RDB checksum.");
+            errno = EIO;
+            return REDIS_ERR;
         }
     }
+    return REDIS_OK;
 
+eoferr: /* unexpected end of file is handled here */
+    if (threaded) rdbLoadThreadsStop();
+    redisLog(REDIS_WARNING,"Short read or OOM loading DB.");
+    errno = EIO;
+    return REDIS_ERR;
+}
+
+/*
+ * 读取 rdb 文件，并将其中的对象保存到内存中
+ */
+int rdbLoad(char *filename) {
+    FILE *fp;
+    rio rdb;
+    int retval;
+
+    // 打开文件
+    fp = fopen(filename,"r");
+    if (!fp) {
+        errno = ENOENT;
+        return REDIS_ERR;
+    }
+
+    // 初始化 rdb 文件
+    rioInitWithFile(&rdb,fp);
+    startLoading(fp);
+    retval = rdbLoadRio(&rdb);
     fclose(fp);
     stopLoading();
-    return REDIS_OK;
 
-eoferr: /* unexpected end of file is handled here with a fatal exit */
-    redisLog(REDIS_WARNING,"Short read or OOM loading DB. Unrecoverable error, aborting now.");
-    exit(1);
-    return REDIS_ERR; /* Just to avoid warning */
+    /* A truncated or corrupted file on disk is an unrecoverable error. */
+    if (retval == REDIS_ERR && errno == EIO) {
+        redisLog(REDIS_WARNING,"Unrecoverable error loading the DB file, aborting now.");
+        exit(1);
+    }
+    return retval;
 }
 
-/* A background saving child (BGSAVE) terminated its work. Handle this. */
+
+/* A background saving child (BGSAVE) terminated its work. Handle this.
+ * This function covers the case of actual BGSAVEs. */
 /*
  * 根据 BGSAVE 子进程的返回值，对服务器状态进行更新
  */
-void backgroundSaveDoneHandler(int exitcode, int bysignal) {
+void backgroundSaveDoneHandlerDisk(int exitcode, int bysignal) {
     // 保存成功
     if (!bysignal && exitcode == 0) {
         redisLog(REDIS_NOTICE,
@@ -1442,13 +2244,119 @@ void backgroundSaveDoneHandler(int exitcode, int bysignal) {
 
     // 更新服务器状态
     server.rdb_child_pid = -1;
+    server.rdb_child_type = REDIS_RDB_CHILD_TYPE_NONE;
     server.rdb_save_time_last = time(NULL)-server.rdb_save_time_start;
     server.rdb_save_time_start = -1;
 
     /* Possibly there are slaves waiting for a BGSAVE in order to be served
      * (the first stage of SYNC is a bulk transfer of dump.rdb) */
     // 将 rdb 文件保存完毕的消息报告可能正在等待复制的附属节点
-    updateSlavesWaitingBgsave(exitcode == 0 ? REDIS_OK : REDIS_ERR);
+    updateSlavesWaitingBgsave((!bysignal && exitcode == 0) ? REDIS_OK : REDIS_ERR,
+        REDIS_RDB_CHILD_TYPE_DISK);
+}
+
+/* A background saving child (BGSAVE) terminated its work. Handle this.
+ * This function covers the case of RDB -> Slaves socket transfers for
+ * diskless replication. */
+/*
+ * 处理直接向附属节点套接字写入 RDB 的子进程的退出
+ *
+ * 子进程通过管道报告每个附属节点的传送结果，
+ * 传送失败的附属节点会被释放。
+ */
+void backgroundSaveDoneHandlerSocket(int exitcode, int bysignal) {
+    uint64_t *ok_slaves;
+
+    if (!bysignal && exitcode == 0) {
+        redisLog(REDIS_NOTICE,
+            "Background RDB transfer terminated with success");
+    } else if (!bysignal && exitcode != 0) {
+        redisLog(REDIS_WARNING, "Background transfer error");
+    } else {
+        redisLog(REDIS_WARNING,
+            "Background transfer terminated by signal %d", bysignal);
+    }
+    server.rdb_child_pid = -1;
+    server.rdb_child_type = REDIS_RDB_CHILD_TYPE_NONE;
+    server.rdb_save_time_start = -1;
+
+    /* If the child returns an OK exit code, read the set of slave client
+     * fds and the associated status code. We'll terminate all the slaves
+     * in BGSAVE_END state that didn't receive the whole payload. */
+    ok_slaves = zmalloc(sizeof(uint64_t)); /* Make space for the count. */
+    ok_slaves[0] = 0;
+    if (!bysignal && exitcode == 0) {
+        int readlen = sizeof(uint64_t);
+
+        if (read(server.rdb_pipe_read_result_from_child, ok_slaves, readlen) ==
+                 readlen)
+        {
+            readlen = ok_slaves[0]*sizeof(uint64_t)*2;
+
+            /* Make space for enough elements as specified by the first
+             * uint64_t element in the array. */
+            ok_slaves = zrealloc(ok_slaves,sizeof(uint64_t)+readlen);
+            if (readlen &&
+                read(server.rdb_pipe_read_result_from_child, ok_slaves+1,
+                     readlen) != readlen)
+            {
+                ok_slaves[0] = 0;
+            }
+        }
+    }
+
+    close(server.rdb_pipe_read_result_from_child);
+
+    /* We can continue the replication process with all the slaves that
+     * correctly received the full payload. Others are terminated. */
+    listNode *ln;
+    listIter li;
+
+    listRewind(server.slaves,&li);
+    while((ln = listNext(&li))) {
+        redisClient *slave = ln->value;
+
+        if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_END) {
+            uint64_t j;
+            int errorcode = 0;
+
+            /* Search for the slave fd in the list of fds the child
+             * reported. */
+            for (j = 0; j < ok_slaves[0]; j++) {
+                if (slave->fd == (int)ok_slaves[2*j+1]) {
+                    errorcode = ok_slaves[2*j+2];
+                    break; /* Found in slaves list. */
+                }
+            }
+            if (j == ok_slaves[0] || errorcode != 0) {
+                redisLog(REDIS_WARNING,
+                    "Closing slave (listening port %d): child->slave RDB transfer failed: %s",
+                    slave->slave_listening_port,
+                    (errorcode == 0) ? "RDB transfer child aborted"
+                                     : strerror(errorcode));
+                freeClient(slave);
+            }
+        }
+    }
+    zfree(ok_slaves);
+
+    updateSlavesWaitingBgsave((!bysignal && exitcode == 0) ? REDIS_OK : REDIS_ERR,
+        REDIS_RDB_CHILD_TYPE_SOCKET);
+}
+
+/* When a background RDB saving/transfer terminates, call the right handler. */
+void backgroundSaveDoneHandler(int exitcode, int bysignal) {
+    switch(server.rdb_child_type) {
+    case REDIS_RDB_CHILD_TYPE_DISK:
+        backgroundSaveDoneHandlerDisk(exitcode,bysignal);
+        break;
+    case REDIS_RDB_CHILD_TYPE_SOCKET:
+        backgroundSaveDoneHandlerSocket(exitcode,bysignal);
+        break;
+    default:
+        redisPanic("Unknown RDB child type.");
+        break;
+    }
 }
 
 /*
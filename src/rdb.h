@@ -41,7 +41,7 @@
 /*
  * RDB 的版本，当新版本不向就版本兼容时，增一
  */
-#define REDIS_RDB_VERSION 6
+#define REDIS_RDB_VERSION 7
 
 /* Defines related to the dump file format. To store 32 bits lengths for short
  * keys requires a lot of space, so we check the most significant 2 bits of
@@ -79,6 +79,24 @@
 #define REDIS_RDB_ENC_INT16 1       /* 16 bit signed integer */
 #define REDIS_RDB_ENC_INT32 2       /* 32 bit signed integer */
 #define REDIS_RDB_ENC_LZF 3         /* string compressed with FASTLZ */
+#define REDIS_RDB_ENC_LZ4 4         /* string compressed with LZ4 */
+
+/* Codecs that can be used to compress strings (rdb-compression-codec). Each
+ * codec has its own encoding tag above, so every codec can always be loaded.
+ *
+ * 压缩字符串时使用的算法，每种算法都有自己的编码标识，
+ * 所以无论当前配置使用哪种算法，载入时都可以正确解压 */
+#define REDIS_RDB_CODEC_LZF 0
+#define REDIS_RDB_CODEC_LZ4 1
+
+/* Files saved with rdb-stream-compression start with this magic instead of
+ * "REDIS<version>", followed by the LZ4 compressed frames of a normal RDB
+ * payload (see the compressed stream rio in rio.c).
+ *
+ * 使用整个文件压缩时，文件以这个标识开头，
+ * 之后是一个普通 RDB 文件经过 LZ4 压缩后的各个帧 */
+#define REDIS_RDB_STREAM_MAGIC "REDIS-LZ4"
+#define REDIS_RDB_STREAM_MAGIC_LEN 9
 
 /* Dup object types to RDB object types. Only reason is readability (are we
  * dealing with RDB types or with in-memory object types?).
@@ -100,22 +118,31 @@
 #define REDIS_RDB_TYPE_SET_INTSET    11
 #define REDIS_RDB_TYPE_ZSET_ZIPLIST  12
 #define REDIS_RDB_TYPE_HASH_ZIPLIST  13
+#define REDIS_RDB_TYPE_LIST_QUICKLIST 14
 
 /* Test if a type is an object type. */
 /*
  * 检查给定类型是否对象
  */
-#define rdbIsObjectType(t) ((t >= 0 && t <= 4) || (t >= 9 && t <= 13))
+#define rdbIsObjectType(t) ((t >= 0 && t <= 4) || (t >= 9 && t <= 14))
 
 /* Special RDB opcodes (saved/loaded with rdbSaveType/rdbLoadType). */
 /*
  * 特殊标识符
  */
+#define REDIS_RDB_OPCODE_RESIZEDB   251     // 数据库键数量提示
 #define REDIS_RDB_OPCODE_EXPIRETIME_MS 252  // 以 MS 计算的过期时间
 #define REDIS_RDB_OPCODE_EXPIRETIME 253     // 以秒计算的过期时间
 #define REDIS_RDB_OPCODE_SELECTDB   254     // 选择数据库
 #define REDIS_RDB_OPCODE_EOF        255     // 结尾
 
+/* Flags for rdbSaveRio(). */
+/*
+ * rdbSaveRio() 的选项
+ */
+#define REDIS_RDB_SAVE_NONE 0
+#define REDIS_RDB_SAVE_AOF_PREAMBLE (1<<0)  // 作为 AOF 重写的前导部分保存
+
 int rdbSaveType(rio *rdb, unsigned char type);
 int rdbLoadType(rio *rdb);
 int rdbSaveTime(rio *rdb, time_t t);
@@ -125,9 +152,13 @@ uint32_t rdbLoadLen(rio *rdb, int *isencoded);
 int rdbSaveObjectType(rio *rdb, robj *o);
 int rdbLoadObjectType(rio *rdb);
 int rdbLoad(char *filename);
+int rdbLoadRio(rio *rdb);
 int rdbSaveBackground(char *filename);
+int rdbSaveToSlavesSockets(void);
 void rdbRemoveTempFile(pid_t childpid);
 int rdbSave(char *filename);
+int rdbSaveRio(rio *rdb, int flags);
+int rdbSaveRioWithEOFMark(rio *rdb);
 int rdbSaveObject(rio *rdb, robj *o);
 off_t rdbSavedObjectLen(robj *o);
 off_t rdbSavedObjectPages(robj *o);
@@ -135,5 +166,7 @@ robj *rdbLoadObject(int type, rio *rdb);
 void backgroundSaveDoneHandler(int exitcode, int bysignal);
 int rdbSaveKeyValuePair(rio *rdb, robj *key, robj *val, long long expiretime, long long now);
 robj *rdbLoadStringObject(rio *rdb);
+int rdbGetCodecByName(char *name);
+char *rdbGetCodecName(int codec);
 
 #endif
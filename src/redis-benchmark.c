@@ -48,6 +48,24 @@
 
 #define REDIS_NOTUSED(V) ((void) V)
 
+/* Latencies are accumulated in a log-linear histogram with microsecond
+ * resolution: values below LATENCY_HIST_SUB_BUCKETS get one bucket per
+ * microsecond, every following power of two is split into
+ * LATENCY_HIST_SUB_BUCKETS/2 equal buckets, so the relative error of any
+ * reported percentile is below 0.2% whatever the magnitude of the value.
+ * Latencies larger than 2^LATENCY_HIST_MAX_EXP microseconds are clamped.
+ *
+ * 延迟以对数-线性直方图记录，精度为微秒：
+ * 小于 1024 微秒的值每微秒一个桶，之后每个 2 的幂区间平均分成 512 个桶，
+ * 无论延迟大小，百分位数的相对误差都不超过 0.2% ，
+ * 而内存占用是固定的，与请求数量无关。 */
+#define LATENCY_HIST_SUB_BITS 10
+#define LATENCY_HIST_SUB_BUCKETS (1<<LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_HALF_BUCKETS (LATENCY_HIST_SUB_BUCKETS/2)
+#define LATENCY_HIST_MAX_EXP 40
+#define LATENCY_HIST_BUCKETS \
+    ((LATENCY_HIST_MAX_EXP-LATENCY_HIST_SUB_BITS+3)*LATENCY_HIST_HALF_BUCKETS)
+
 static struct config {
     aeEventLoop *el;
     const char *hostip;
@@ -66,7 +84,11 @@ static struct config {
     int pipeline;
     long long start;
     long long totlatency;
-    long long *latency;
+    long long *latency_hist;    /* Latency histogram, see LATENCY_HIST_* */
+    long long latency_count;    /* Number of samples in the histogram */
+    long long latency_sum;      /* Sum of the samples, for the average */
+    long long latency_min;
+    long long latency_max;
     const char *title;
     list *clients;
     int quiet;
@@ -79,8 +101,9 @@ static struct config {
 typedef struct _client {
     redisContext *context;
     sds obuf;
-    char *randptr[32]; /* needed for MSET against 10 keys */
-    size_t randlen;
+    char **randptr; /* Pointers to the :rand: placeholders in 'obuf' */
+    size_t randlen; /* Number of used entries in 'randptr' */
+    size_t randfree; /* Number of free entries in 'randptr' */
     unsigned int written; /* bytes of 'obuf' already written */
     long long start; /* start time of a request */
     long long latency; /* request latency */
@@ -112,12 +135,75 @@ static long long mstime(void) {
     return mst;
 }
 
+/* Return the histogram bucket of a latency expressed in microseconds. */
+static int latencyHistIndex(long long us) {
+    int exp;
+
+    if (us < 0) us = 0;
+    if (us >= (1LL<<LATENCY_HIST_MAX_EXP)) us = (1LL<<LATENCY_HIST_MAX_EXP)-1;
+    if (us < LATENCY_HIST_SUB_BUCKETS) return (int)us;
+
+    /* 'exp' is the number of low bits dropped so that the value fits in
+     * the [HALF_BUCKETS, SUB_BUCKETS) range. */
+    exp = (63-__builtin_clzll((unsigned long long)us))-(LATENCY_HIST_SUB_BITS-1);
+    return exp*LATENCY_HIST_HALF_BUCKETS + (int)(us >> exp);
+}
+
+/* Return the highest latency, in microseconds, that maps into 'idx'. */
+static long long latencyHistValue(int idx) {
+    int exp;
+
+    if (idx < LATENCY_HIST_SUB_BUCKETS) return idx;
+    exp = idx/LATENCY_HIST_HALF_BUCKETS-1;
+    return ((long long)(idx-exp*LATENCY_HIST_HALF_BUCKETS) << exp) +
+           ((1LL<<exp)-1);
+}
+
+static void resetLatencyHist(void) {
+    memset(config.latency_hist,0,sizeof(long long)*LATENCY_HIST_BUCKETS);
+    config.latency_count = 0;
+    config.latency_sum = 0;
+    config.latency_min = -1;
+    config.latency_max = 0;
+}
+
+static void recordLatency(long long us) {
+    config.latency_hist[latencyHistIndex(us)]++;
+    config.latency_count++;
+    config.latency_sum += us;
+    if (config.latency_min == -1 || us < config.latency_min)
+        config.latency_min = us;
+    if (us > config.latency_max) config.latency_max = us;
+}
+
+/* Return the latency in microseconds below which 'perc' percent of the
+ * samples fall. The exact maximum is returned for the last bucket so that
+ * "max" and "p100" agree. */
+static long long latencyPercentile(double perc) {
+    long long target, seen = 0;
+    int j;
+
+    if (config.latency_count == 0) return 0;
+    target = (long long)((perc/100)*config.latency_count+0.5);
+    if (target < 1) target = 1;
+    if (target > config.latency_count) target = config.latency_count;
+    for (j = 0; j < LATENCY_HIST_BUCKETS; j++) {
+        seen += config.latency_hist[j];
+        if (seen >= target) {
+            long long v = latencyHistValue(j);
+            return v > config.latency_max ? config.latency_max : v;
+        }
+    }
+    return config.latency_max;
+}
+
 static void freeClient(client c) {
     listNode *ln;
     aeDeleteFileEvent(config.el,c->context->fd,AE_WRITABLE);
     aeDeleteFileEvent(config.el,c->context->fd,AE_READABLE);
     redisFree(c->context);
     sdsfree(c->obuf);
+    zfree(c->randptr);
     zfree(c);
     config.liveclients--;
     ln = listSearchKey(config.clients,c);
@@ -199,8 +285,10 @@ static void readHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
 
                 freeReplyObject(reply);
 
-                if (config.requests_finished < config.requests)
-                    config.latency[config.requests_finished++] = c->latency;
+                if (config.requests_finished < config.requests) {
+                    config.requests_finished++;
+                    recordLatency(c->latency);
+                }
                 c->pending--;
                 if (c->pending == 0) {
                     clientDone(c);
@@ -221,11 +309,15 @@ static void writeHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
 
     /* Initialize request when nothing was written. */
     if (c->written == 0) {
-        /* Enforce upper bound to number of requests. */
-        if (config.requests_issued++ >= config.requests) {
+        /* Enforce upper bound to number of requests. Every write sends a
+         * whole pipeline of requests, so account for all of them at once,
+         * otherwise with -P we would issue 'pipeline' times the requests
+         * the user asked for. */
+        if (config.requests_issued >= config.requests) {
             freeClient(c);
             return;
         }
+        config.requests_issued += config.pipeline;
 
         /* Really initialize: randomize keys and set start time. */
         if (config.randomkeys) randomizeClientKey(c);
@@ -273,16 +365,25 @@ static client createClient(char *cmd, size_t len) {
     c->obuf = sdsempty();
     for (j = 0; j < config.pipeline; j++)
         c->obuf = sdscatlen(c->obuf,cmd,len);
+    c->randptr = NULL;
     c->randlen = 0;
+    c->randfree = 0;
     c->written = 0;
     c->pending = config.pipeline;
 
-    /* Find substrings in the output buffer that need to be randomized. */
+    /* Find substrings in the output buffer that need to be randomized.
+     * With pipelining every copy of the command has its own placeholders,
+     * so the array grows as needed. */
     if (config.randomkeys) {
         char *p = c->obuf;
         while ((p = strstr(p,":rand:")) != NULL) {
-            assert(c->randlen < (signed)(sizeof(c->randptr)/sizeof(char*)));
+            if (c->randfree == 0) {
+                size_t newsize = c->randlen ? c->randlen*2 : 8;
+                c->randptr = zrealloc(c->randptr,sizeof(char*)*newsize);
+                c->randfree = newsize-c->randlen;
+            }
             c->randptr[c->randlen++] = p+6;
+            c->randfree--;
             p += 6;
         }
     }
@@ -308,15 +409,21 @@ static void createMissingClients(client c) {
     }
 }
 
-static int compareLatency(const void *a, const void *b) {
-    return (*(long long*)a)-(*(long long*)b);
-}
-
 static void showLatencyReport(void) {
-    int i, curlat = 0;
+    int j, curlat = -1;
+    long long seen = 0;
     float perc, reqpersec;
+    double avg, p50, p99, p999, min, max;
 
     reqpersec = (float)config.requests_finished/((float)config.totlatency/1000);
+    avg = config.latency_count ?
+          (double)config.latency_sum/config.latency_count/1000 : 0;
+    min = (config.latency_min == -1 ? 0 : config.latency_min)/1000.0;
+    max = config.latency_max/1000.0;
+    p50 = latencyPercentile(50)/1000.0;
+    p99 = latencyPercentile(99)/1000.0;
+    p999 = latencyPercentile(99.9)/1000.0;
+
     if (!config.quiet && !config.csv) {
         printf("====== %s ======\n", config.title);
         printf("  %d requests completed in %.2f seconds\n", config.requests_finished,
@@ -324,19 +431,33 @@ static void showLatencyReport(void) {
         printf("  %d parallel clients\n", config.numclients);
         printf("  %d bytes payload\n", config.datasize);
         printf("  keep alive: %d\n", config.keepalive);
+        if (config.pipeline > 1)
+            printf("  pipeline: %d\n", config.pipeline);
         printf("\n");
 
-        qsort(config.latency,config.requests,sizeof(long long),compareLatency);
-        for (i = 0; i < config.requests; i++) {
-            if (config.latency[i]/1000 != curlat || i == (config.requests-1)) {
-                curlat = config.latency[i]/1000;
-                perc = ((float)(i+1)*100)/config.requests;
+        /* Cumulative distribution, one line for every millisecond that
+         * has samples. */
+        for (j = 0; j < LATENCY_HIST_BUCKETS; j++) {
+            int lat;
+
+            if (config.latency_hist[j] == 0) continue;
+            lat = (int)((latencyHistValue(j)+999)/1000);
+            if (lat != curlat && curlat != -1) {
+                perc = ((float)seen*100)/config.latency_count;
                 printf("%.2f%% <= %d milliseconds\n", perc, curlat);
             }
+            curlat = lat;
+            seen += config.latency_hist[j];
         }
+        if (curlat != -1)
+            printf("100.00%% <= %d milliseconds\n", curlat);
+        printf("\n  latency (msec): avg %.3f min %.3f p50 %.3f p99 %.3f "
+               "p99.9 %.3f max %.3f\n", avg, min, p50, p99, p999, max);
         printf("%.2f requests per second\n\n", reqpersec);
     } else if (config.csv) {
-        printf("\"%s\",\"%.2f\"\n", config.title, reqpersec);
+        printf("\"%s\",\"%.2f\",\"%.3f\",\"%.3f\",\"%.3f\",\"%.3f\","
+               "\"%.3f\",\"%.3f\"\n",
+            config.title, reqpersec, avg, min, p50, p99, p999, max);
     } else {
         printf("%s: %.2f requests per second\n", config.title, reqpersec);
     }
@@ -348,6 +469,7 @@ static void benchmark(char *title, char *cmd, int len) {
     config.title = title;
     config.requests_issued = 0;
     config.requests_finished = 0;
+    resetLatencyHist();
 
     c = createClient(cmd,len);
     createMissingClients(c);
@@ -457,7 +579,8 @@ usage:
 "  range will be allowed.\n"
 " -P <numreq>        Pipeline <numreq> requests. Default 1 (no pipeline).\n"
 " -q                 Quiet. Just show query/sec values\n"
-" --csv              Output in CSV format\n"
+" --csv              Output in CSV format: test name, requests per second and\n"
+"                    the avg, min, p50, p99, p99.9 and max latency in msec.\n"
 " -l                 Loop. Run the tests forever\n"
 " -t <tests>         Only run the comma separated list of tests. The test\n"
 "                    names are the same as the ones produced as output.\n"
@@ -471,6 +594,8 @@ usage:
 "   $ redis-benchmark -t set -n 1000000 -r 100000000\n\n"
 " Benchmark 127.0.0.1:6379 for a few commands producing CSV output:\n"
 "   $ redis-benchmark -t ping,set,get -n 100000 --csv\n\n"
+" Send 16 GET requests per round trip using pipelining:\n"
+"   $ redis-benchmark -t get -n 1000000 -P 16\n\n"
 " Fill a list with 10000 random elements:\n"
 "   $ redis-benchmark -r 10000 -n 10000 lpush mylist ele:rand:000000000000\n\n"
     );
@@ -529,7 +654,7 @@ int main(int argc, const char **argv) {
     config.csv = 0;
     config.loop = 0;
     config.idlemode = 0;
-    config.latency = NULL;
+    config.latency_hist = NULL;
     config.clients = listCreate();
     config.hostip = "127.0.0.1";
     config.hostport = 6379;
@@ -540,7 +665,14 @@ int main(int argc, const char **argv) {
     argc -= i;
     argv += i;
 
-    config.latency = zmalloc(sizeof(long long)*config.requests);
+    config.latency_hist = zmalloc(sizeof(long long)*LATENCY_HIST_BUCKETS);
+    resetLatencyHist();
+
+    if (config.csv) {
+        printf("\"test\",\"rps\",\"avg_latency_ms\",\"min_latency_ms\","
+               "\"p50_latency_ms\",\"p99_latency_ms\",\"p99.9_latency_ms\","
+               "\"max_latency_ms\"\n");
+    }
 
     if (config.keepalive == 0) {
         printf("WARNING: keepalive disabled, you probably need 'echo 1 > /proc/sys/net/ipv4/tcp_tw_reuse' for Linux and 'sudo sysctl -w net.inet.tcp.msl=1000' for Mac OS X in order to use a lot of clients/requests\n");
@@ -185,6 +185,16 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
+    /* AOF files rewritten with aof-use-rdb-preamble start with an RDB
+     * payload this tool can't parse: refuse to touch them, so that --fix
+     * never truncates a valid file. */
+    char sig[5];
+    if (fread(sig,1,5,fp) == 5 && memcmp(sig,"REDIS",5) == 0) {
+        printf("The AOF starts with an RDB preamble: can't check it.\n");
+        exit(1);
+    }
+    rewind(fp);
+
     off_t pos = process(fp);
     off_t diff = size-pos;
     printf("AOF analyzed: size=%lld, ok_up_to=%lld, diff=%lld\n",
@@ -40,6 +40,7 @@
 #include <stdint.h>
 #include <limits.h>
 #include "lzf.h"
+#include "lz4.h"
 #include "crc64.h"
 
 /* Object types */
@@ -53,6 +54,7 @@
 #define REDIS_SET_INTSET 11
 #define REDIS_ZSET_ZIPLIST 12
 #define REDIS_HASH_ZIPLIST 13
+#define REDIS_LIST_QUICKLIST 14
 
 /* Objects encoding. Some kind of objects like Strings and Hashes can be
  * internally represented in multiple ways. The 'encoding' field of the object
@@ -63,6 +65,7 @@
 #define REDIS_ENCODING_HT 3     /* Encoded as an hash table */
 
 /* Object types only used for dumping to disk */
+#define REDIS_RESIZEDB 251
 #define REDIS_EXPIRETIME_MS 252
 #define REDIS_EXPIRETIME 253
 #define REDIS_SELECTDB 254
@@ -94,6 +97,12 @@
 #define REDIS_RDB_ENC_INT16 1       /* 16 bit signed integer */
 #define REDIS_RDB_ENC_INT32 2       /* 32 bit signed integer */
 #define REDIS_RDB_ENC_LZF 3         /* string compressed with FASTLZ */
+#define REDIS_RDB_ENC_LZ4 4         /* string compressed with LZ4 */
+
+/* Files saved with rdb-stream-compression start with this magic, followed
+ * by frames of LZ4 compressed RDB payload. */
+#define REDIS_RDB_STREAM_MAGIC "REDIS-LZ4"
+#define REDIS_RDB_STREAM_MAGIC_LEN 9
 
 #define ERROR(...) { \
     printf(__VA_ARGS__); \
@@ -146,9 +155,9 @@ int checkType(unsigned char t) {
     /* In case a new object type is added, update the following 
      * condition as necessary. */
     return
-        (t >= REDIS_HASH_ZIPMAP && t <= REDIS_HASH_ZIPLIST) ||
+        (t >= REDIS_HASH_ZIPMAP && t <= REDIS_LIST_QUICKLIST) ||
         t <= REDIS_HASH ||
-        t >= REDIS_EXPIRETIME_MS;
+        t >= REDIS_RESIZEDB;
 }
 
 /* when number of bytes to read is negative, do a peek */
@@ -180,7 +189,7 @@ int processHeader() {
     }
 
     dump_version = (int)strtol(buf + 5, NULL, 10);
-    if (dump_version < 1 || dump_version > 6) {
+    if (dump_version < 1 || dump_version > 7) {
         ERROR("Unknown RDB format version: %d\n", dump_version);
     }
     return dump_version;
@@ -287,8 +296,8 @@ char *loadIntegerObject(int enctype) {
     return buf;
 }
 
-char* loadLzfStringObject() {
-    unsigned int slen, clen;
+char* loadCompressedStringObject(int enctype) {
+    unsigned int slen, clen, dlen;
     char *c, *s;
 
     if ((clen = loadLength(NULL)) == REDIS_RDB_LENERR) return NULL;
@@ -301,7 +310,11 @@ char* loadLzfStringObject() {
     }
 
     s = malloc(slen+1);
-    if (lzf_decompress(c,clen,s,slen) == 0) {
+    if (enctype == REDIS_RDB_ENC_LZF)
+        dlen = lzf_decompress(c,clen,s,slen);
+    else
+        dlen = lz4_decompress(c,clen,s,slen);
+    if (dlen != slen) {
         free(c); free(s);
         return NULL;
     }
@@ -324,7 +337,8 @@ char* loadStringObject() {
         case REDIS_RDB_ENC_INT32:
             return loadIntegerObject(len);
         case REDIS_RDB_ENC_LZF:
-            return loadLzfStringObject();
+        case REDIS_RDB_ENC_LZ4:
+            return loadCompressedStringObject(len);
         default:
             /* unknown encoding */
             SHIFT_ERROR(offset, "Unknown string encoding (0x%02x)", len);
@@ -415,6 +429,7 @@ int loadPair(entry *e) {
 
     uint32_t length = 0;
     if (e->type == REDIS_LIST ||
+        e->type == REDIS_LIST_QUICKLIST ||
         e->type == REDIS_SET  ||
         e->type == REDIS_ZSET ||
         e->type == REDIS_HASH) {
@@ -437,6 +452,7 @@ int loadPair(entry *e) {
         }
     break;
     case REDIS_LIST:
+    case REDIS_LIST_QUICKLIST:
     case REDIS_SET:
         for (i = 0; i < length; i++) {
             offset = CURR_OFFSET;
@@ -505,6 +521,12 @@ entry loadEntry() {
             SHIFT_ERROR(offset[1], "Database number out of range (%d)", length);
             return e;
         }
+    } else if (e.type == REDIS_RESIZEDB) {
+        if (loadLength(NULL) == REDIS_RDB_LENERR ||
+            loadLength(NULL) == REDIS_RDB_LENERR) {
+            SHIFT_ERROR(offset[1], "Error reading database size hints");
+            return e;
+        }
     } else if (e.type == REDIS_EOF) {
         if (positions[level].offset < positions[level].size) {
             SHIFT_ERROR(offset[0], "Unexpected EOF");
@@ -705,6 +727,44 @@ void process() {
     }
 }
 
+/* Decompress the frames of a file saved with rdb-stream-compression. Every
+ * frame is <uncompressed len><compressed len><data>, with both lengths
+ * stored as 32 bit little endian integers, and a compressed length of 0
+ * meaning the data is stored as it is. Returns NULL on corrupted input. */
+void *decompressStream(unsigned char *p, size_t len, size_t *outlen) {
+    size_t cap = len*2+1, used = 0;
+    unsigned char *out = malloc(cap);
+
+    while (len) {
+        uint32_t rawlen, zlen;
+
+        if (len < 8) goto err;
+        rawlen = p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24);
+        zlen = p[4] | (p[5]<<8) | (p[6]<<16) | ((uint32_t)p[7]<<24);
+        p += 8; len -= 8;
+        if (rawlen == 0 || zlen >= rawlen) goto err;
+        if ((zlen ? zlen : rawlen) > len) goto err;
+        while (used+rawlen > cap) {
+            cap *= 2;
+            out = realloc(out,cap);
+        }
+        if (zlen == 0) {
+            memcpy(out+used,p,rawlen);
+            p += rawlen; len -= rawlen;
+        } else {
+            if (lz4_decompress(p,zlen,out+used,rawlen) != rawlen) goto err;
+            p += zlen; len -= zlen;
+        }
+        used += rawlen;
+    }
+    *outlen = used;
+    return out;
+
+err:
+    free(out);
+    return NULL;
+}
+
 int main(int argc, char **argv) {
     /* expect the first argument to be the dump file */
     if (argc <= 1) {
@@ -740,6 +800,22 @@ int main(int argc, char **argv) {
     positions[0].data = data;
     positions[0].size = size;
     positions[0].offset = 0;
+
+    /* Check the uncompressed payload of compressed files. */
+    if (size >= REDIS_RDB_STREAM_MAGIC_LEN &&
+        memcmp(data,REDIS_RDB_STREAM_MAGIC,REDIS_RDB_STREAM_MAGIC_LEN) == 0)
+    {
+        size_t rawsize;
+
+        positions[0].data = decompressStream(
+            (unsigned char*)data+REDIS_RDB_STREAM_MAGIC_LEN,
+            size-REDIS_RDB_STREAM_MAGIC_LEN,&rawsize);
+        if (positions[0].data == NULL) {
+            ERROR("Corrupted compressed stream: %s\n", argv[1]);
+        }
+        positions[0].size = rawsize;
+        printf("Checking the LZ4 compressed payload of the file\n");
+    }
     errors.level = 0;
 
     /* Object types */
@@ -748,10 +824,12 @@ int main(int argc, char **argv) {
     sprintf(types[REDIS_SET], "SET");
     sprintf(types[REDIS_ZSET], "ZSET");
     sprintf(types[REDIS_HASH], "HASH");
+    sprintf(types[REDIS_LIST_QUICKLIST], "LIST_QUICKLIST");
 
     /* Object types only used for dumping to disk */
     sprintf(types[REDIS_EXPIRETIME], "EXPIRETIME");
     sprintf(types[REDIS_SELECTDB], "SELECTDB");
+    sprintf(types[REDIS_RESIZEDB], "RESIZEDB");
     sprintf(types[REDIS_EOF], "EOF");
 
     /* Double constants initialization */
@@ -762,6 +840,7 @@ int main(int argc, char **argv) {
 
     process();
 
+    if (positions[0].data != data) free(positions[0].data);
     munmap(data, size);
     close(fd);
     return 0;
@@ -108,8 +108,13 @@ struct redisCommand *commandTable;
  * calls: total number of calls of this command.
  *        命令被执行的总次数
  *
+ * latency_hist: histogram of the execution times, allocated on the first
+ *               call of the command.
+ *               命令执行时间的直方图，在命令第一次被执行时创建
+ *
  * The flags, microseconds and calls fields are computed by Redis and should
- * always be set to zero.
+ * always be set to zero. latency_hist is left out of the table, so it is
+ * initialized to NULL.
  * microseconds 和 call 由 Redis 计算，总是初始化为 0 。
  *
  * Command flags are expressed using strings where every character represents
@@ -171,6 +176,7 @@ struct redisCommand redisCommandTable[] = {
     {"append",appendCommand,3,"wm",0,NULL,1,1,1,0,0},
     {"strlen",strlenCommand,2,"r",0,NULL,1,1,1,0,0},
     {"del",delCommand,-2,"w",0,noPreloadGetKeys,1,-1,1,0,0},
+    {"unlink",unlinkCommand,-2,"w",0,noPreloadGetKeys,1,-1,1,0,0},
     {"exists",existsCommand,2,"r",0,NULL,1,1,1,0,0},
     {"setbit",setbitCommand,4,"wm",0,NULL,1,1,1,0,0},
     {"getbit",getbitCommand,3,"r",0,NULL,1,1,1,0,0},
@@ -211,6 +217,7 @@ struct redisCommand redisCommandTable[] = {
     {"sdiff",sdiffCommand,-2,"rS",0,NULL,1,-1,1,0,0},
     {"sdiffstore",sdiffstoreCommand,-3,"wm",0,NULL,1,-1,1,0,0},
     {"smembers",sinterCommand,2,"rS",0,NULL,1,1,1,0,0},
+    {"sscan",sscanCommand,-3,"rR",0,NULL,1,1,1,0,0},
     {"zadd",zaddCommand,-4,"wm",0,NULL,1,1,1,0,0},
     {"zincrby",zincrbyCommand,4,"wm",0,NULL,1,1,1,0,0},
     {"zrem",zremCommand,-3,"w",0,NULL,1,1,1,0,0},
@@ -227,6 +234,7 @@ struct redisCommand redisCommandTable[] = {
     {"zscore",zscoreCommand,3,"r",0,NULL,1,1,1,0,0},
     {"zrank",zrankCommand,3,"r",0,NULL,1,1,1,0,0},
     {"zrevrank",zrevrankCommand,3,"r",0,NULL,1,1,1,0,0},
+    {"zscan",zscanCommand,-3,"rR",0,NULL,1,1,1,0,0},
     {"hset",hsetCommand,4,"wm",0,NULL,1,1,1,0,0},
     {"hsetnx",hsetnxCommand,4,"wm",0,NULL,1,1,1,0,0},
     {"hget",hgetCommand,3,"r",0,NULL,1,1,1,0,0},
@@ -240,6 +248,7 @@ struct redisCommand redisCommandTable[] = {
     {"hvals",hvalsCommand,2,"rS",0,NULL,1,1,1,0,0},
     {"hgetall",hgetallCommand,2,"r",0,NULL,1,1,1,0,0},
     {"hexists",hexistsCommand,3,"r",0,NULL,1,1,1,0,0},
+    {"hscan",hscanCommand,-3,"rR",0,NULL,1,1,1,0,0},
     {"incrby",incrbyCommand,3,"wm",0,NULL,1,1,1,0,0},
     {"decrby",decrbyCommand,3,"wm",0,NULL,1,1,1,0,0},
     {"incrbyfloat",incrbyfloatCommand,3,"wm",0,NULL,1,1,1,0,0},
@@ -256,6 +265,7 @@ struct redisCommand redisCommandTable[] = {
     {"pexpire",pexpireCommand,3,"w",0,NULL,1,1,1,0,0},
     {"pexpireat",pexpireatCommand,3,"w",0,NULL,1,1,1,0,0},
     {"keys",keysCommand,2,"rS",0,NULL,0,0,0,0,0},
+    {"scan",scanCommand,-2,"rR",0,NULL,0,0,0,0,0},
     {"dbsize",dbsizeCommand,1,"r",0,NULL,0,0,0,0,0},
     {"auth",authCommand,2,"rs",0,NULL,0,0,0,0,0},
     {"ping",pingCommand,1,"r",0,NULL,0,0,0,0,0},
@@ -270,9 +280,10 @@ struct redisCommand redisCommandTable[] = {
     {"exec",execCommand,1,"sM",0,NULL,0,0,0,0,0},
     {"discard",discardCommand,1,"rs",0,NULL,0,0,0,0,0},
     {"sync",syncCommand,1,"ars",0,NULL,0,0,0,0,0},
+    {"psync",syncCommand,3,"ars",0,NULL,0,0,0,0,0},
     {"replconf",replconfCommand,-1,"ars",0,NULL,0,0,0,0,0},
-    {"flushdb",flushdbCommand,1,"w",0,NULL,0,0,0,0,0},
-    {"flushall",flushallCommand,1,"w",0,NULL,0,0,0,0,0},
+    {"flushdb",flushdbCommand,-1,"w",0,NULL,0,0,0,0,0},
+    {"flushall",flushallCommand,-1,"w",0,NULL,0,0,0,0,0},
     {"sort",sortCommand,-2,"wm",0,NULL,1,1,1,0,0},
     {"info",infoCommand,-1,"rlt",0,NULL,0,0,0,0,0},
     {"monitor",monitorCommand,1,"ars",0,NULL,0,0,0,0,0},
@@ -299,10 +310,12 @@ struct redisCommand redisCommandTable[] = {
     {"eval",evalCommand,-3,"s",0,zunionInterGetKeys,0,0,0,0,0},
     {"evalsha",evalShaCommand,-3,"s",0,zunionInterGetKeys,0,0,0,0,0},
     {"slowlog",slowlogCommand,-2,"r",0,NULL,0,0,0,0,0},
+    {"latency",latencyCommand,-2,"arslt",0,NULL,0,0,0,0,0},
     {"script",scriptCommand,-2,"ras",0,NULL,0,0,0,0,0},
     {"time",timeCommand,1,"rR",0,NULL,0,0,0,0,0},
     {"bitop",bitopCommand,-4,"wm",0,NULL,2,-1,1,0,0},
-    {"bitcount",bitcountCommand,-2,"r",0,NULL,1,1,1,0,0}
+    {"bitcount",bitcountCommand,-2,"r",0,NULL,1,1,1,0,0},
+    {"bitpos",bitposCommand,-3,"r",0,NULL,1,1,1,0,0}
 };
 
 /*============================ Utility functions ============================ */
@@ -513,7 +526,7 @@ int dictEncObjKeyCompare(void *privdata, const void *key1,
 unsigned int dictEncObjHash(const void *key) {
     robj *o = (robj*) key;
 
-    if (o->encoding == REDIS_ENCODING_RAW) {
+    if (sdsEncodedObject(o)) {
         return dictGenHashFunction(o->ptr, sdslen((sds)o->ptr));
     } else {
         if (o->encoding == REDIS_ENCODING_INT) {
@@ -720,88 +733,222 @@ void updateDictResizePolicy(void) {
 /* ======================= Cron: called every 100 ms ======================== */
 // 在新版中，已经可以设置 HZ 的时间了
 
+/* Helper function for the activeExpireCycle() function.
+ * This function will try to expire the key that is stored in the hash table
+ * entry 'de' of the 'expires' hash table of a Redis database.
+ *
+ * If the key is found to be expired, it is removed from the database and
+ * 1 is returned. Otherwise no operation is performed and 0 is returned.
+ *
+ * When a key is expired, server.stat_expiredkeys is incremented.
+ *
+ * 如果键已经过期，那么删除它并返回 1 ，否则返回 0
+ */
+static int activeExpireCycleTryExpire(redisDb *db, dictEntry *de, long long now) {
+    long long t = dictGetSignedIntegerVal(de);
+
+    if (now > t) {
+        sds key = dictGetKey(de);
+        robj *keyobj = createStringObject(key,sdslen(key));
+
+        propagateExpire(db,keyobj);
+        dbDelete(db,keyobj);
+        decrRefCount(keyobj);
+        server.stat_expiredkeys++;
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
 /* Try to expire a few timed out keys. The algorithm used is adaptive and
  * will use few CPU cycles if there are few expiring keys, otherwise
  * it will get more aggressive to avoid that too much memory is used by
- * keys that can be removed from the keyspace. */
-/*
- * 主动清除过期 key 
+ * keys that can be removed from the keyspace.
+ *
+ * Every DB keeps a cursor in its expires dictionary, so every cycle checks
+ * the buckets following the ones checked by the previous cycle, and the
+ * DB where the previous cycle stopped is the first one tested, so that
+ * no DB and no key is starved even if the time limit is reached often.
+ * In a DB the cycle keeps running while more than
+ * REDIS_EXPIRE_CYCLE_ACCEPTABLE_STALE percent of the checked keys were
+ * expired.
+ *
+ * The function can perform more or less work depending on the 'type':
+ *
+ * If type is REDIS_EXPIRE_CYCLE_FAST the function will try to run a
+ * "fast" expire cycle that takes no longer than
+ * REDIS_EXPIRE_CYCLE_FAST_DURATION microseconds, and is not repeated
+ * again before the same amount of time. It is called from beforeSleep()
+ * and does nothing unless the previous cycle stopped for reaching its
+ * time limit, or the estimated percentage of stale keys is above the
+ * acceptable one.
+ *
+ * If type is REDIS_EXPIRE_CYCLE_SLOW, that normal expire cycle is
+ * executed, where the time limit is a percentage of the REDIS_HZ period
+ * as specified by the REDIS_EXPIRELOOKUPS_TIME_PERC define.
+ *
+ * 主动清除过期 key
+ *
+ * 每个数据库都记录了一个过期字典的游标，每次执行都从上次停下的位置继续，
+ * 数据库之间也从上次停下的数据库继续，避免某些键总是得不到检查。
+ *
+ * REDIS_EXPIRE_CYCLE_SLOW 由 serverCron 调用，
+ * REDIS_EXPIRE_CYCLE_FAST 由 beforeSleep 调用，
+ * 只有在上次执行因为超时而中止，或者估计的过期键比例较高时才会执行。
  */
-void activeExpireCycle(void) {
+void activeExpireCycle(int type) {
+    /* This function has some global state in order to continue the work
+     * incrementally across calls. */
+    static unsigned int current_db = 0; /* Last DB tested. */
+    static int timelimit_exit = 0;      /* Time limit hit in previous call? */
+    static long long last_fast_cycle = 0; /* When last fast cycle ran. */
+
     int j, iteration = 0;
-    long long start = ustime(), timelimit;
+    int dbs_per_call = REDIS_EXPIRE_CYCLE_DBS_PER_CALL;
+    long long start = ustime(), timelimit, elapsed;
+    unsigned long total_sampled = 0, total_expired = 0;
+    double current_perc;
+
+    if (type == REDIS_EXPIRE_CYCLE_FAST) {
+        /* Don't start a fast cycle if the previous cycle did not exit for
+         * time limit, unless the percentage of estimated stale keys is
+         * too high. Also never repeat a fast cycle for the same period
+         * as the fast cycle total duration itself. */
+        // 上次执行没有超时，并且过期键比例可以接受，不执行快速周期
+        if (!timelimit_exit &&
+            server.stat_expired_stale_perc <
+                (double)REDIS_EXPIRE_CYCLE_ACCEPTABLE_STALE/100) return;
+        if (start < last_fast_cycle + REDIS_EXPIRE_CYCLE_FAST_DURATION*2)
+            return;
+        last_fast_cycle = start;
+    }
+
+    /* We usually should test REDIS_EXPIRE_CYCLE_DBS_PER_CALL per iteration,
+     * with two exceptions:
+     *
+     * 1) Don't test more DBs than we have.
+     * 2) If last time we hit the time limit, we want to scan all DBs
+     * in this iteration, as there is work to do in some DB and we don't want
+     * expired keys to use memory for too much time. */
+    if (dbs_per_call > server.dbnum || timelimit_exit)
+        dbs_per_call = server.dbnum;
 
     /* We can use at max REDIS_EXPIRELOOKUPS_TIME_PERC percentage of CPU time
      * per iteration. Since this function gets called with a frequency of
      * REDIS_HZ times per second, the following is the max amount of
      * microseconds we can spend in this function. */
-    // 这个函数可以使用的时长（毫秒）
+    // 这个函数可以使用的时长（微秒）
     timelimit = 1000000*REDIS_EXPIRELOOKUPS_TIME_PERC/REDIS_HZ/100;
+    timelimit_exit = 0;
     if (timelimit <= 0) timelimit = 1;
 
-    for (j = 0; j < server.dbnum; j++) {
-        int expired;
-        redisDb *db = server.db+j;
+    if (type == REDIS_EXPIRE_CYCLE_FAST)
+        timelimit = REDIS_EXPIRE_CYCLE_FAST_DURATION; /* in microseconds. */
+
+    for (j = 0; j < dbs_per_call && timelimit_exit == 0; j++) {
+        unsigned long expired, sampled;
+        redisDb *db = server.db+(current_db % server.dbnum);
 
-        /* Continue to expire if at the end of the cycle more than 25%
-         * of the keys were expired. */
+        /* Increment the DB now so we are sure if we run out of time
+         * in the current DB we'll restart from the next. This allows to
+         * distribute the time evenly across DBs. */
+        current_db++;
+
+        /* Continue to expire if at the end of the cycle more than
+         * REDIS_EXPIRE_CYCLE_ACCEPTABLE_STALE percent of the keys were
+         * expired. */
         do {
-            unsigned long num = dictSize(db->expires);
-            unsigned long slots = dictSlots(db->expires);
-            long long now = mstime();
+            unsigned long num, slots, max_buckets, checked_buckets = 0;
+            long long now;
+            int table;
+
+            iteration++;
 
-            /* When there are less than 1% filled slots getting random
-             * keys is expensive, so stop here waiting for better times...
+            /* If there is nothing to expire try next DB ASAP. */
+            if ((num = dictSize(db->expires)) == 0) break;
+            slots = dictSlots(db->expires);
+            now = mstime();
+
+            /* When there are less than 1% filled slots sampling the key
+             * space is expensive, so stop here waiting for better times...
              * The dictionary will be resized asap. */
-            // 过期字典里只有 %1 位置被占用，调用随机 key 的消耗比较高
-            // 等 key 多一点再来
-            if (num && slots > DICT_HT_INITIAL_SIZE &&
+            // 过期字典里只有 %1 位置被占用，检查的消耗比较高
+            // 等字典缩小之后再来
+            if (slots > DICT_HT_INITIAL_SIZE &&
                 (num*100/slots < 1)) break;
 
-            /* The main collection cycle. Sample random keys among keys
-             * with an expire set, checking for expired ones. */
-            // 从过期字典中随机取出 key ，检查它是否过期
-            expired = 0;    // 被删除 key 计数
-            if (num > REDIS_EXPIRELOOKUPS_PER_CRON) // 最多每次可查找的次数
+            /* The main collection cycle. Check the keys of the buckets
+             * following the DB cursor, until REDIS_EXPIRELOOKUPS_PER_CRON
+             * keys are checked. Empty buckets are cheap but are not free,
+             * so we also stop after checking 20 times more buckets. */
+            // 从游标所在的桶开始，顺序检查过期字典中的键
+            expired = 0;
+            sampled = 0;
+            if (num > REDIS_EXPIRELOOKUPS_PER_CRON)
                 num = REDIS_EXPIRELOOKUPS_PER_CRON;
-            while (num--) {
-                dictEntry *de;
-                long long t;
-
-                // 随机查找带有 TTL 的 key ，看它是否过期
-                // 如果数据库为空，跳出
-                if ((de = dictGetRandomKey(db->expires)) == NULL) break;
-
-                t = dictGetSignedIntegerVal(de);
-                if (now > t) {
-                    // 已过期
-                    sds key = dictGetKey(de);
-                    robj *keyobj = createStringObject(key,sdslen(key));
-
-                    propagateExpire(db,keyobj);
-                    dbDelete(db,keyobj);
-                    decrRefCount(keyobj);
-                    expired++;
-                    server.stat_expiredkeys++;
+            max_buckets = num*20;
+
+            while (sampled < num && checked_buckets < max_buckets) {
+                for (table = 0; table < 2; table++) {
+                    unsigned long idx;
+                    dictEntry *de;
+
+                    if (table == 1 && !dictIsRehashing(db->expires)) break;
+
+                    idx = db->expires_cursor &
+                          db->expires->ht[table].sizemask;
+                    de = db->expires->ht[table].table[idx];
+                    checked_buckets++;
+
+                    /* Fetch the next entry before the current one may be
+                     * deleted. */
+                    while(de) {
+                        dictEntry *e = de;
+                        de = de->next;
+                        if (activeExpireCycleTryExpire(db,e,now)) expired++;
+                        sampled++;
+                    }
                 }
+                db->expires_cursor++;
             }
+            total_expired += expired;
+            total_sampled += sampled;
+
             /* We can't block forever here even if there are many keys to
              * expire. So after a given amount of milliseconds return to the
              * caller waiting for the other active expire cycle. */
-            // 每次进行 16 次循环之后，检查时间是否超过，如果超过，则退出
-            iteration++;
-            if ((iteration & 0xf) == 0 && /* check once every 16 cycles. */
-                (ustime()-start) > timelimit) return;
-
-        } while (expired > REDIS_EXPIRELOOKUPS_PER_CRON/4);
+            // 每进行 16 次循环之后，检查时间是否超过，如果超过，则退出
+            if ((iteration & 0xf) == 0) { /* check once every 16 iterations. */
+                elapsed = ustime()-start;
+                if (elapsed > timelimit) {
+                    timelimit_exit = 1;
+                    server.stat_expired_time_cap_reached_count++;
+                    break;
+                }
+            }
+        } while (sampled == 0 ||
+                 expired*100/sampled > REDIS_EXPIRE_CYCLE_ACCEPTABLE_STALE);
     }
+
+    elapsed = ustime()-start;
+    server.stat_expire_cycle_time_used += elapsed;
+    latencyAddSampleIfNeeded("expire-cycle",elapsed/1000);
+
+    /* Update our estimate of keys existing but yet to be expired.
+     * Running average with this sample accounting for 5%. A cycle that
+     * found nothing to check counts as no stale keys. */
+    // 更新对尚未删除的过期键比例的估计
+    current_perc = total_sampled ? (double)total_expired/total_sampled : 0;
+    server.stat_expired_stale_perc = (current_perc*0.05)+
+                                     (server.stat_expired_stale_perc*0.95);
 }
 
 /*
  * 更新服务器的 LRU 时间
  */
 void updateLRUClock(void) {
-    server.lruclock = (server.unixtime/REDIS_LRU_CLOCK_RESOLUTION) &
+    server.lruclock = (mstime()/REDIS_LRU_CLOCK_RESOLUTION) &
                                                 REDIS_LRU_CLOCK_MAX;
 }
 
@@ -991,13 +1138,14 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
     run_with_period(100) trackOperationsPerSecond();
 
     /* We have just 22 bits per object for LRU information.
-     * So we use an (eventually wrapping) LRU clock with 10 seconds resolution.
-     * 2^22 bits with 10 seconds resoluton is more or less 1.5 years.
+     * So we use an (eventually wrapping) LRU clock with 1 second resolution.
+     * 2^22 bits with 1 second resolution is more or less 48 days.
      *
-     * Note that even if this will wrap after 1.5 years it's not a problem,
+     * Note that even if this will wrap after 48 days it's not a problem,
      * everything will still work but just some object will appear younger
      * to Redis. But for this to happen a given object should never be touched
-     * for 1.5 years.
+     * for 48 days. A finer resolution is what makes the idle times of
+     * the sampled keys comparable when evicting.
      *
      * Note that you can change the resolution altering the
      * REDIS_LRU_CLOCK_RESOLUTION define.
@@ -1140,7 +1288,7 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
      * in order to guarantee a strict consistency. */
     // 如果服务器是主节点的话，进行过期键删除
     // 如果服务器是附属节点的话，那么等待主节点发来的 DEL 命令
-    if (server.masterhost == NULL) activeExpireCycle();
+    if (server.masterhost == NULL) activeExpireCycle(REDIS_EXPIRE_CYCLE_SLOW);
 
     /* Close clients that need to be closed asynchronous */
     // 关闭那些需要异步删除的客户端
@@ -1181,6 +1329,10 @@ void beforeSleep(struct aeEventLoop *eventLoop) {
     listNode *ln;
     redisClient *c;
 
+    /* Read and execute the queries queued for the I/O threads. */
+    // 使用 I/O 线程读入并分析客户端的查询，然后执行命令
+    handleClientsWithPendingReads();
+
     /* Try to process pending commands for clients that were just unblocked. */
     // 处理所有刚被取消阻塞的客户端的缓存
     while (listLength(server.unblocked_clients)) {
@@ -1199,9 +1351,21 @@ void beforeSleep(struct aeEventLoop *eventLoop) {
         }
     }
 
+    /* Run a fast expire cycle (the called function will return
+     * ASAP if a fast cycle is not needed). */
+    // 执行一次快速的主动过期周期（如果需要的话）
+    if (server.masterhost == NULL) activeExpireCycle(REDIS_EXPIRE_CYCLE_FAST);
+
     /* Write the AOF buffer on disk */
     // 如果有需要的话，尝试保存 AOF 到磁盘
     flushAppendOnlyFile(0);
+
+    /* Write the replies queued for the I/O threads. This must happen after
+     * the AOF flush, so that clients are never told that a write was
+     * performed before it reaches the AOF buffer on disk. */
+    // 使用 I/O 线程将回复写入到客户端，
+    // 这一步必须在写入 AOF 之后进行
+    handleClientsWithPendingWrites();
 }
 
 /* =========================== Server initialization ======================== */
@@ -1219,6 +1383,8 @@ void createSharedObjects(void) {
     shared.nullbulk = createObject(REDIS_STRING,sdsnew("$-1\r\n"));
     shared.nullmultibulk = createObject(REDIS_STRING,sdsnew("*-1\r\n"));
     shared.emptymultibulk = createObject(REDIS_STRING,sdsnew("*0\r\n"));
+    // SCAN 系列命令作用于不存在的键时的回复：游标 0 和空列表
+    shared.emptyscan = createObject(REDIS_STRING,sdsnew("*2\r\n$1\r\n0\r\n*0\r\n"));
     shared.pong = createObject(REDIS_STRING,sdsnew("+PONG\r\n"));
     shared.queued = createObject(REDIS_STRING,sdsnew("+QUEUED\r\n"));
     shared.wrongtypeerr = createObject(REDIS_STRING,sdsnew(
@@ -1266,7 +1432,8 @@ void createSharedObjects(void) {
     shared.lpop = createStringObject("LPOP",4);
     shared.lpush = createStringObject("LPUSH",5);
     for (j = 0; j < REDIS_SHARED_INTEGERS; j++) {
-        shared.integers[j] = createObject(REDIS_STRING,(void*)(long)j);
+        shared.integers[j] =
+            makeObjectShared(createObject(REDIS_STRING,(void*)(long)j));
         shared.integers[j]->encoding = REDIS_ENCODING_INT;
     }
     for (j = 0; j < REDIS_SHARED_BULKHDR_LEN; j++) {
@@ -1322,6 +1489,8 @@ void initServerConfig() {
     server.aof_state = REDIS_AOF_OFF;
     server.aof_fsync = AOF_FSYNC_EVERYSEC;
     server.aof_no_fsync_on_rewrite = 0;
+    server.aof_use_rdb_preamble = REDIS_DEFAULT_AOF_USE_RDB_PREAMBLE;
+    server.aof_write_thread = REDIS_DEFAULT_AOF_WRITE_THREAD;
     server.aof_rewrite_perc = REDIS_AOF_REWRITE_PERC;
     server.aof_rewrite_min_size = REDIS_AOF_REWRITE_MIN_SIZE;
     server.aof_rewrite_base_size = 0;
@@ -1331,6 +1500,16 @@ void initServerConfig() {
     server.aof_rewrite_time_start = -1;
     server.aof_lastbgrewrite_status = REDIS_OK;
     server.aof_delayed_fsync = 0;
+    server.aof_rewrite_diff_bytes_last = -1;
+    server.aof_rewrite_diff_time_last = -1;
+    server.aof_pipe_write_data_to_child = -1;
+    server.aof_pipe_read_data_from_parent = -1;
+    server.aof_pipe_write_ack_to_parent = -1;
+    server.aof_pipe_read_ack_from_child = -1;
+    server.aof_pipe_write_ack_to_child = -1;
+    server.aof_pipe_read_ack_from_parent = -1;
+    server.aof_stop_sending_diff = 0;
+    server.aof_child_diff = NULL;
     server.aof_fd = -1;
     server.aof_selected_db = -1; /* Make sure the first time will not match */
     server.aof_flush_postponed_start = 0;
@@ -1341,25 +1520,33 @@ void initServerConfig() {
     server.aof_filename = zstrdup("appendonly.aof");
     server.requirepass = NULL;
     server.rdb_compression = 1;
+    server.rdb_compression_codec = REDIS_DEFAULT_RDB_CODEC;
+    server.rdb_stream_compression = REDIS_DEFAULT_RDB_STREAM_COMPRESSION;
     server.rdb_checksum = 1;
+    server.rdb_load_threads = REDIS_RDB_LOAD_THREADS_NUM;
+    server.rdb_load_unshared = 0;
 
     // 开启主动 rehash
     server.activerehashing = 1;
 
     // 最大客户端数量
     server.maxclients = REDIS_MAX_CLIENTS;
+    // I/O 线程数量
+    server.io_threads_num = REDIS_IO_THREADS_NUM;
     server.bpop_blocked_clients = 0;
 
     // 内存相关
     server.maxmemory = 0;
     server.maxmemory_policy = REDIS_MAXMEMORY_VOLATILE_LRU;
     server.maxmemory_samples = 3;
+    server.lfu_log_factor = REDIS_DEFAULT_LFU_LOG_FACTOR;
+    server.lfu_decay_time = REDIS_DEFAULT_LFU_DECAY_TIME;
 
     // 压缩数据结构实体数量限制
     server.hash_max_ziplist_entries = REDIS_HASH_MAX_ZIPLIST_ENTRIES;
     server.hash_max_ziplist_value = REDIS_HASH_MAX_ZIPLIST_VALUE;
-    server.list_max_ziplist_entries = REDIS_LIST_MAX_ZIPLIST_ENTRIES;
-    server.list_max_ziplist_value = REDIS_LIST_MAX_ZIPLIST_VALUE;
+    server.list_max_ziplist_size = REDIS_LIST_MAX_ZIPLIST_SIZE;
+    server.list_compress_depth = REDIS_LIST_COMPRESS_DEPTH;
     server.set_max_intset_entries = REDIS_SET_MAX_INTSET_ENTRIES;
     server.zset_max_ziplist_entries = REDIS_ZSET_MAX_ZIPLIST_ENTRIES;
     server.zset_max_ziplist_value = REDIS_ZSET_MAX_ZIPLIST_VALUE;
@@ -1400,9 +1587,27 @@ void initServerConfig() {
     server.repl_syncio_timeout = REDIS_REPL_SYNCIO_TIMEOUT;
     server.repl_serve_stale_data = 1;
     server.repl_slave_ro = 1;
+    server.repl_diskless_sync = REDIS_DEFAULT_REPL_DISKLESS_SYNC;
+    server.repl_diskless_sync_delay = REDIS_DEFAULT_REPL_DISKLESS_SYNC_DELAY;
+    server.repl_diskless_load = REDIS_DEFAULT_REPL_DISKLESS_LOAD;
+    server.repl_transfer_tmpfile = NULL;
     server.repl_down_since = time(NULL);
     server.slave_priority = REDIS_DEFAULT_SLAVE_PRIORITY;
 
+    /* Replication partial resync backlog */
+    // 复制积压缓冲区，在第一个附属节点连接时才创建
+    server.slaveseldb = -1; /* Force to emit the first SELECT command. */
+    server.master_repl_offset = 0;
+    server.repl_backlog = NULL;
+    server.repl_backlog_size = REDIS_DEFAULT_REPL_BACKLOG_SIZE;
+    server.repl_backlog_histlen = 0;
+    server.repl_backlog_idx = 0;
+    server.repl_backlog_off = 0;
+    server.repl_backlog_time_limit = REDIS_DEFAULT_REPL_BACKLOG_TIME_LIMIT;
+    server.repl_no_slaves_since = time(NULL);
+    server.cached_master = NULL;
+    server.repl_master_initial_offset = -1;
+
     // 客户端输出缓存限制
     /* Client output buffer limits */
     server.client_obuf_limits[REDIS_CLIENT_LIMIT_CLASS_NORMAL].hard_limit_bytes = 0;
@@ -1437,6 +1642,7 @@ void initServerConfig() {
     // 慢查询
     server.slowlog_log_slower_than = REDIS_SLOWLOG_LOG_SLOWER_THAN;
     server.slowlog_max_len = REDIS_SLOWLOG_MAX_LEN;
+    server.latency_monitor_threshold = REDIS_LATENCY_MONITOR_THRESHOLD;
 
     /* Debugging */
     // 调试
@@ -1512,6 +1718,8 @@ void initServer() {
     server.current_client = NULL;
     // 所有客户端
     server.clients = listCreate();
+    // 空闲回复块池
+    server.reply_blocks = listCreate();
     // 要被关闭的客户端
     server.clients_to_close = listCreate();
     // 附属节点
@@ -1570,6 +1778,10 @@ void initServer() {
         server.db[j].ready_keys = dictCreate(&setDictType,NULL);
         // 被 WATCH 命令监视的键
         server.db[j].watched_keys = dictCreate(&keylistDictType,NULL);
+        // LRU 淘汰候选池
+        server.db[j].eviction_pool = evictionPoolAlloc();
+        // 主动过期的游标
+        server.db[j].expires_cursor = 0;
         // 数据库 ID
         server.db[j].id = j;
     }
@@ -1579,12 +1791,14 @@ void initServer() {
     server.pubsub_patterns = listCreate();
     listSetFreeMethod(server.pubsub_patterns,freePubsubPattern);
     listSetMatchMethod(server.pubsub_patterns,listMatchPubsubPattern);
+    server.pubsub_prefixes = radixNew();
 
     // CRON 执行计数
     server.cronloops = 0;
 
     // BGSAVE 执行指示变量
     server.rdb_child_pid = -1;
+    server.rdb_child_type = REDIS_RDB_CHILD_TYPE_NONE;
     // BGREWRITEAOF 执行指示变量
     server.aof_child_pid = -1;
     // 初始化 AOF 重写缓存
@@ -1602,6 +1816,9 @@ void initServer() {
     server.stat_numcommands = 0;
     server.stat_numconnections = 0;
     server.stat_expiredkeys = 0;
+    server.stat_expired_stale_perc = 0;
+    server.stat_expired_time_cap_reached_count = 0;
+    server.stat_expire_cycle_time_used = 0;
     server.stat_evictedkeys = 0;
     server.stat_starttime = time(NULL);
     server.stat_keyspace_misses = 0;
@@ -1609,6 +1826,11 @@ void initServer() {
     server.stat_peak_memory = 0;
     server.stat_fork_time = 0;
     server.stat_rejected_conn = 0;
+    server.stat_io_reads_processed = 0;
+    server.stat_io_writes_processed = 0;
+    server.stat_sync_full = 0;
+    server.stat_sync_partial_ok = 0;
+    server.stat_sync_partial_err = 0;
     memset(server.ops_sec_samples,0,sizeof(server.ops_sec_samples));
     server.ops_sec_idx = 0;
     server.ops_sec_last_sample_time = mstime();
@@ -1657,8 +1879,17 @@ void initServer() {
     // 初始化慢查询
     slowlogInit();
 
+    // 初始化延迟监视器
+    latencyMonitorInit();
+
     // 初始化后台 IO 
     bioInit();
+
+    // 初始化 AOF 写入线程所需的状态
+    aofInitWriteThread();
+
+    // 初始化 I/O 线程
+    initThreadedIO();
 }
 
 /* Populates the Redis Command Table starting from the hard coded list
@@ -1709,9 +1940,71 @@ void resetCommandTableStats(void) {
 
         c->microseconds = 0;
         c->calls = 0;
+        zfree(c->latency_hist);
+        c->latency_hist = NULL;
     }
 }
 
+/* Return the histogram bucket of a latency expressed in microseconds. */
+static int commandLatencyIndex(long long us) {
+    int exp;
+
+    if (us < 0) us = 0;
+    if (us >= (1LL<<REDIS_CMD_LATENCY_MAX_EXP))
+        us = (1LL<<REDIS_CMD_LATENCY_MAX_EXP)-1;
+    if (us < REDIS_CMD_LATENCY_SUB_BUCKETS) return (int)us;
+
+    /* 'exp' is the number of low bits dropped so that the value fits in
+     * the [HALF_BUCKETS, SUB_BUCKETS) range. */
+    exp = (63-__builtin_clzll((unsigned long long)us))-
+          (REDIS_CMD_LATENCY_SUB_BITS-1);
+    return exp*REDIS_CMD_LATENCY_HALF_BUCKETS + (int)(us >> exp);
+}
+
+/* Return the highest latency, in microseconds, that maps into 'idx'. */
+static long long commandLatencyValue(int idx) {
+    int exp;
+
+    if (idx < REDIS_CMD_LATENCY_SUB_BUCKETS) return idx;
+    exp = idx/REDIS_CMD_LATENCY_HALF_BUCKETS-1;
+    return ((long long)(idx-exp*REDIS_CMD_LATENCY_HALF_BUCKETS) << exp) +
+           ((1LL<<exp)-1);
+}
+
+/*
+ * 将命令的执行时间记录到命令的直方图中
+ */
+void commandLatencyRecord(struct redisCommand *cmd, long long us) {
+    if (cmd->latency_hist == NULL)
+        cmd->latency_hist =
+            zcalloc(sizeof(long long)*REDIS_CMD_LATENCY_BUCKETS);
+    cmd->latency_hist[commandLatencyIndex(us)]++;
+}
+
+/* Return the latency in microseconds below which 'perc' percent of the
+ * calls of 'cmd' fall. Like HdrHistogram we report the highest value of
+ * the bucket, so the result is never below the real percentile. */
+/*
+ * 返回命令执行时间的百分位数
+ */
+long long commandLatencyPercentile(struct redisCommand *cmd, double perc) {
+    long long count = 0, target, seen = 0;
+    int j;
+
+    if (cmd->latency_hist == NULL) return 0;
+    for (j = 0; j < REDIS_CMD_LATENCY_BUCKETS; j++)
+        count += cmd->latency_hist[j];
+    if (count == 0) return 0;
+    target = (long long)((perc/100)*count+0.5);
+    if (target < 1) target = 1;
+    if (target > count) target = count;
+    for (j = 0; j < REDIS_CMD_LATENCY_BUCKETS; j++) {
+        seen += cmd->latency_hist[j];
+        if (seen >= target) break;
+    }
+    return commandLatencyValue(j);
+}
+
 /* ========================== Redis OP Array API ============================ */
 
 /*
@@ -1794,7 +2087,7 @@ void propagate(struct redisCommand *cmd, int dbid, robj **argv, int argc,
 {
     if (server.aof_state != REDIS_AOF_OFF && flags & REDIS_PROPAGATE_AOF)
         feedAppendOnlyFile(cmd,dbid,argv,argc);
-    if (flags & REDIS_PROPAGATE_REPL && listLength(server.slaves))
+    if (flags & REDIS_PROPAGATE_REPL)
         replicationFeedSlaves(server.slaves,dbid,argv,argc);
 }
 
@@ -1844,13 +2137,16 @@ void call(redisClient *c, int flags) {
     /* Log the command into the Slow log if needed, and populate the
      * per-command statistics that we show in INFO commandstats. */
     // 根据命令执行耗费的时间，看是否需要将命令添加到 slowlog
-    if (flags & REDIS_CALL_SLOWLOG)
+    if (flags & REDIS_CALL_SLOWLOG) {
         slowlogPushEntryIfNeeded(c->argv,c->argc,duration);
+        latencyAddSampleIfNeeded("command",duration/1000);
+    }
 
     // 添加命令到统计数据
     if (flags & REDIS_CALL_STATS) {
         c->cmd->microseconds += duration;
         c->cmd->calls++;
+        commandLatencyRecord(c->cmd,duration);
     }
 
     /* Propagate the command into the AOF and replication link */
@@ -1866,6 +2162,10 @@ void call(redisClient *c, int flags) {
 
         if (flags != REDIS_PROPAGATE_NONE)
             propagate(c->cmd,c->db->id,c->argv,c->argc,flags);
+
+        /* With threaded AOF writes the reply waits for the write. */
+        // 使用 AOF 写入线程时，回复需要等待命令写入磁盘
+        if (flags & REDIS_PROPAGATE_AOF) aofHoldClientReply(c);
     }
     /* Commands such as LPUSH or BRPOPLPUSH may propagate an additional
      * PUSH command. */
@@ -2333,7 +2633,8 @@ sds genRedisInfoString(char *section) {
             "used_memory_peak_human:%s\r\n"
             "used_memory_lua:%lld\r\n"
             "mem_fragmentation_ratio:%.2f\r\n"
-            "mem_allocator:%s\r\n",
+            "mem_allocator:%s\r\n"
+            "lazyfree_pending_objects:%zu\r\n",
             zmalloc_used_memory(),
             hmem,
             zmalloc_get_rss(),
@@ -2341,7 +2642,8 @@ sds genRedisInfoString(char *section) {
             peak_hmem,
             ((long long)lua_gc(server.lua,LUA_GCCOUNT,0))*1024LL,
             zmalloc_get_fragmentation_ratio(),
-            ZMALLOC_LIB
+            ZMALLOC_LIB,
+            lazyfreeGetPendingObjectsCount()
             );
     }
 
@@ -2362,7 +2664,9 @@ sds genRedisInfoString(char *section) {
             "aof_rewrite_scheduled:%d\r\n"
             "aof_last_rewrite_time_sec:%ld\r\n"
             "aof_current_rewrite_time_sec:%ld\r\n"
-            "aof_last_bgrewrite_status:%s\r\n",
+            "aof_last_bgrewrite_status:%s\r\n"
+            "aof_last_rewrite_diff_bytes:%lld\r\n"
+            "aof_last_rewrite_diff_write_usec:%lld\r\n",
             server.loading,
             server.dirty,
             server.rdb_child_pid != -1,
@@ -2377,7 +2681,9 @@ sds genRedisInfoString(char *section) {
             server.aof_rewrite_time_last,
             (server.aof_child_pid == -1) ?
                 -1 : time(NULL)-server.aof_rewrite_time_start,
-            (server.aof_lastbgrewrite_status == REDIS_OK) ? "ok" : "err");
+            (server.aof_lastbgrewrite_status == REDIS_OK) ? "ok" : "err",
+            server.aof_rewrite_diff_bytes_last,
+            server.aof_rewrite_diff_time_last);
 
         if (server.aof_state != REDIS_AOF_OFF) {
             info = sdscatprintf(info,
@@ -2439,25 +2745,41 @@ sds genRedisInfoString(char *section) {
             "instantaneous_ops_per_sec:%lld\r\n"
             "rejected_connections:%lld\r\n"
             "expired_keys:%lld\r\n"
+            "expired_stale_perc:%.2f\r\n"
+            "expired_time_cap_reached_count:%lld\r\n"
+            "expire_cycle_cpu_milliseconds:%lld\r\n"
             "evicted_keys:%lld\r\n"
             "keyspace_hits:%lld\r\n"
             "keyspace_misses:%lld\r\n"
             "pubsub_channels:%ld\r\n"
             "pubsub_patterns:%lu\r\n"
             "latest_fork_usec:%lld\r\n"
-            "migrate_cached_sockets:%ld\r\n",
+            "migrate_cached_sockets:%ld\r\n"
+            "io_threaded_reads_processed:%lld\r\n"
+            "io_threaded_writes_processed:%lld\r\n"
+            "sync_full:%lld\r\n"
+            "sync_partial_ok:%lld\r\n"
+            "sync_partial_err:%lld\r\n",
             server.stat_numconnections,
             server.stat_numcommands,
             getOperationsPerSecond(),
             server.stat_rejected_conn,
             server.stat_expiredkeys,
+            server.stat_expired_stale_perc*100,
+            server.stat_expired_time_cap_reached_count,
+            server.stat_expire_cycle_time_used/1000,
             server.stat_evictedkeys,
             server.stat_keyspace_hits,
             server.stat_keyspace_misses,
             dictSize(server.pubsub_channels),
             listLength(server.pubsub_patterns),
             server.stat_fork_time,
-            dictSize(server.migrate_cached_sockets));
+            dictSize(server.migrate_cached_sockets),
+            server.stat_io_reads_processed,
+            server.stat_io_writes_processed,
+            server.stat_sync_full,
+            server.stat_sync_partial_ok,
+            server.stat_sync_partial_err);
     }
 
     /* Replication */
@@ -2499,8 +2821,11 @@ sds genRedisInfoString(char *section) {
                     (long)server.unixtime-server.repl_down_since);
             }
             info = sdscatprintf(info,
+                "slave_repl_offset:%lld\r\n"
                 "slave_priority:%d\r\n"
                 "slave_read_only:%d\r\n",
+                server.master ? server.master->reploff :
+                    (server.cached_master ? server.cached_master->reploff : -1),
                 server.slave_priority,
                 server.repl_slave_ro);
         }
@@ -2538,6 +2863,17 @@ sds genRedisInfoString(char *section) {
                 slaveid++;
             }
         }
+        info = sdscatprintf(info,
+            "master_repl_offset:%lld\r\n"
+            "repl_backlog_active:%d\r\n"
+            "repl_backlog_size:%lld\r\n"
+            "repl_backlog_first_byte_offset:%lld\r\n"
+            "repl_backlog_histlen:%lld\r\n",
+            server.master_repl_offset,
+            server.repl_backlog != NULL,
+            server.repl_backlog_size,
+            server.repl_backlog_off,
+            server.repl_backlog_histlen);
     }
 
     /* CPU */
@@ -2565,9 +2901,13 @@ sds genRedisInfoString(char *section) {
 
             if (!c->calls) continue;
             info = sdscatprintf(info,
-                "cmdstat_%s:calls=%lld,usec=%lld,usec_per_call=%.2f\r\n",
+                "cmdstat_%s:calls=%lld,usec=%lld,usec_per_call=%.2f,"
+                "p50=%lld,p99=%lld,p999=%lld\r\n",
                 c->name, c->calls, c->microseconds,
-                (c->calls == 0) ? 0 : ((float)c->microseconds/c->calls));
+                (c->calls == 0) ? 0 : ((float)c->microseconds/c->calls),
+                commandLatencyPercentile(c,50),
+                commandLatencyPercentile(c,99),
+                commandLatencyPercentile(c,99.9));
         }
     }
 
@@ -2619,13 +2959,135 @@ void monitorCommand(redisClient *c) {
     if (c->flags & REDIS_SLAVE) return;
 
     c->flags |= (REDIS_SLAVE|REDIS_MONITOR);
-    c->slaveseldb = 0;
     listAddNodeTail(server.monitors,c);
     addReply(c,shared.ok);
 }
 
 /* ============================ Maxmemory directive  ======================== */
 
+/* Create a new eviction pool. */
+// 创建一个新的淘汰候选池
+struct evictionPoolEntry *evictionPoolAlloc(void) {
+    struct evictionPoolEntry *ep;
+    int j;
+
+    ep = zmalloc(sizeof(*ep)*REDIS_EVICTION_POOL_SIZE);
+    for (j = 0; j < REDIS_EVICTION_POOL_SIZE; j++) {
+        ep[j].idle = 0;
+        ep[j].key = NULL;
+    }
+    return ep;
+}
+
+/* This is a helper function for freeMemoryIfNeeded(), it is used in order
+ * to populate the evictionPool with a few entries every time we want to
+ * expire a key. Keys with idle time greater than the one of the current
+ * keys are added. Keys are always added if there are free entries.
+ * With the LFU policies the idle time is replaced by a score that grows
+ * as the access frequency gets lower.
+ *
+ * We insert keys in place in ascending order, so keys with the smaller
+ * idle time are on the left, and keys with the greater idle time on the
+ * right.
+ *
+ * 从 sampledict 中取样 maxmemory_samples 个键，
+ * 把空转时长比池中已有键更长的键插入到候选池中，
+ * 池中有空位时总是插入。
+ *
+ * 池中的键按空转时长从小到大排列。
+ */
+#define EVICTION_SAMPLES_ARRAY_SIZE 16
+void evictionPoolPopulate(dict *sampledict, dict *keydict, struct evictionPoolEntry *pool) {
+    int j, k, count;
+    dictEntry *_samples[EVICTION_SAMPLES_ARRAY_SIZE];
+    dictEntry **samples;
+
+    /* Try to use a static buffer: this function is called for every key
+     * we evict. */
+    if (server.maxmemory_samples <= EVICTION_SAMPLES_ARRAY_SIZE) {
+        samples = _samples;
+    } else {
+        samples = zmalloc(sizeof(samples[0])*server.maxmemory_samples);
+    }
+
+    count = dictGetSomeKeys(sampledict,samples,server.maxmemory_samples);
+    for (j = 0; j < count; j++) {
+        unsigned long long idle;
+        sds key;
+        robj *o;
+        dictEntry *de;
+
+        de = samples[j];
+        key = dictGetKey(de);
+        /* If the dictionary we are sampling from is not the main
+         * dictionary (but the expires one) we need to lookup the key
+         * again in the key dictionary to obtain the value object. */
+        if (sampledict != keydict) de = dictFind(keydict, key);
+        o = dictGetVal(de);
+        /* With the LFU policies the pool is sorted by the inverse of the
+         * access frequency, so that the "idle" score grows as the key is
+         * a better candidate in both cases. */
+        // LFU 策略下，以 255 减去访问频率作为评分
+        if (REDIS_MAXMEMORY_IS_LFU(server.maxmemory_policy))
+            idle = REDIS_LFU_COUNTER_MAX - LFUDecrAndReturn(o);
+        else
+            idle = estimateObjectIdleTime(o);
+
+        /* The same key may be sampled again while it is already in the
+         * pool, possibly after being accessed: drop the old entry so that
+         * the key is inserted again with its current idle time. */
+        // 键已经在池中，先删除旧的项，再按新的空转时长重新插入
+        for (k = 0; k < REDIS_EVICTION_POOL_SIZE && pool[k].key; k++) {
+            if (sdscmp(pool[k].key,key) == 0) {
+                sdsfree(pool[k].key);
+                memmove(pool+k,pool+k+1,
+                    sizeof(pool[0])*(REDIS_EVICTION_POOL_SIZE-k-1));
+                pool[REDIS_EVICTION_POOL_SIZE-1].key = NULL;
+                pool[REDIS_EVICTION_POOL_SIZE-1].idle = 0;
+                break;
+            }
+        }
+
+        /* Insert the element inside the pool.
+         * First, find the first empty bucket or the first populated
+         * bucket that has an idle time greater than our idle time. */
+        // 找到第一个空位，或者第一个空转时长不小于新键的项
+        k = 0;
+        while (k < REDIS_EVICTION_POOL_SIZE &&
+               pool[k].key &&
+               pool[k].idle < idle) k++;
+        if (k == 0 && pool[REDIS_EVICTION_POOL_SIZE-1].key != NULL) {
+            /* Can't insert if the element is < the worst element we have
+             * and there are no empty buckets. */
+            // 池已满，并且新键比池中所有键都新，不插入
+            continue;
+        } else if (k < REDIS_EVICTION_POOL_SIZE && pool[k].key == NULL) {
+            /* Inserting into empty position. No setup needed before insert. */
+        } else {
+            /* Inserting in the middle. Now k points to the first element
+             * greater than the element to insert.  */
+            if (pool[REDIS_EVICTION_POOL_SIZE-1].key == NULL) {
+                /* Free space on the right? Insert at k shifting
+                 * all the elements from k to end to the right. */
+                // 右边有空位，把 k 及之后的项右移一位
+                memmove(pool+k+1,pool+k,
+                    sizeof(pool[0])*(REDIS_EVICTION_POOL_SIZE-k-1));
+            } else {
+                /* No free space on right? Insert at k-1 */
+                // 右边没有空位，丢弃空转时长最小的项，把 k 之前的项左移一位
+                k--;
+                /* Shift all elements on the left of k (included) to the
+                 * left, so we discard the element with smaller idle time. */
+                sdsfree(pool[0].key);
+                memmove(pool,pool+1,sizeof(pool[0])*k);
+            }
+        }
+        pool[k].key = sdsdup(key);
+        pool[k].idle = idle;
+    }
+    if (samples != _samples) zfree(samples);
+}
+
 /* This function gets called when 'maxmemory' is set on the config file to limit
  * the max memory used by the server, before processing a command.
  *
@@ -2645,6 +3107,7 @@ void monitorCommand(redisClient *c) {
 int freeMemoryIfNeeded(void) {
     size_t mem_used, mem_tofree, mem_freed;
     int slaves = listLength(server.slaves);
+    long long latency, eviction_latency;
 
     /* Remove the size of slaves output buffers and AOF buffer from the
      * count of used memory. */
@@ -2679,6 +3142,7 @@ int freeMemoryIfNeeded(void) {
     /* Compute how much memory we need to free. */
     mem_tofree = mem_used - server.maxmemory;
     mem_freed = 0;
+    latencyStartMonitor(latency);
     while (mem_freed < mem_tofree) {
         int j, k, keys_freed = 0;
 
@@ -2691,6 +3155,7 @@ int freeMemoryIfNeeded(void) {
             dict *dict;
 
             if (server.maxmemory_policy == REDIS_MAXMEMORY_ALLKEYS_LRU ||
+                server.maxmemory_policy == REDIS_MAXMEMORY_ALLKEYS_LFU ||
                 server.maxmemory_policy == REDIS_MAXMEMORY_ALLKEYS_RANDOM)
             {
                 dict = server.db[j].dict;
@@ -2708,29 +3173,40 @@ int freeMemoryIfNeeded(void) {
                 bestkey = dictGetKey(de);
             }
 
-            /* volatile-lru and allkeys-lru policy */
-            // LRU 算法
+            /* volatile-lru, allkeys-lru, volatile-lfu and allkeys-lfu */
+            // LRU 和 LFU 算法
             else if (server.maxmemory_policy == REDIS_MAXMEMORY_ALLKEYS_LRU ||
-                server.maxmemory_policy == REDIS_MAXMEMORY_VOLATILE_LRU)
+                server.maxmemory_policy == REDIS_MAXMEMORY_VOLATILE_LRU ||
+                REDIS_MAXMEMORY_IS_LFU(server.maxmemory_policy))
             {
-                for (k = 0; k < server.maxmemory_samples; k++) {
-                    sds thiskey;
-                    long thisval;
-                    robj *o;
-
-                    de = dictGetRandomKey(dict);
-                    thiskey = dictGetKey(de);
-                    /* When policy is volatile-lru we need an additional lookup
-                     * to locate the real key, as dict is set to db->expires. */
-                    if (server.maxmemory_policy == REDIS_MAXMEMORY_VOLATILE_LRU)
-                        de = dictFind(db->dict, thiskey);
-                    o = dictGetVal(de);
-                    thisval = estimateObjectIdleTime(o);
-
-                    /* Higher idle time is better candidate for deletion */
-                    if (bestkey == NULL || thisval > bestval) {
-                        bestkey = thiskey;
-                        bestval = thisval;
+                struct evictionPoolEntry *pool = db->eviction_pool;
+
+                while(bestkey == NULL) {
+                    // 取样，并把更好的候选键合并到候选池中
+                    evictionPoolPopulate(dict, db->dict, db->eviction_pool);
+                    /* Go backward from best to worst element to evict. */
+                    // 从空转时长最大的项开始，找到第一个仍然存在的键
+                    for (k = REDIS_EVICTION_POOL_SIZE-1; k >= 0; k--) {
+                        if (pool[k].key == NULL) continue;
+                        de = dictFind(dict,pool[k].key);
+
+                        /* Remove the entry from the pool. */
+                        sdsfree(pool[k].key);
+                        /* Shift all elements on its right to left. */
+                        memmove(pool+k,pool+k+1,
+                            sizeof(pool[0])*(REDIS_EVICTION_POOL_SIZE-k-1));
+                        /* Clear the element on the right which is empty
+                         * since we shifted one position to the left.  */
+                        pool[REDIS_EVICTION_POOL_SIZE-1].key = NULL;
+                        pool[REDIS_EVICTION_POOL_SIZE-1].idle = 0;
+
+                        /* If the key exists, is our pick. Otherwise it is
+                         * a ghost (deleted since it entered the pool) and
+                         * we need to try the next element. */
+                        if (de) {
+                            bestkey = dictGetKey(de);
+                            break;
+                        }
                     }
                 }
             }
@@ -2738,11 +3214,19 @@ int freeMemoryIfNeeded(void) {
             /* volatile-ttl */
             // TTL 算法
             else if (server.maxmemory_policy == REDIS_MAXMEMORY_VOLATILE_TTL) {
-                for (k = 0; k < server.maxmemory_samples; k++) {
+                dictEntry *_samples[EVICTION_SAMPLES_ARRAY_SIZE];
+                dictEntry **samples = _samples;
+                int count;
+
+                if (server.maxmemory_samples > EVICTION_SAMPLES_ARRAY_SIZE)
+                    samples = zmalloc(sizeof(samples[0])*
+                                      server.maxmemory_samples);
+                count = dictGetSomeKeys(dict,samples,server.maxmemory_samples);
+                for (k = 0; k < count; k++) {
                     sds thiskey;
                     long thisval;
 
-                    de = dictGetRandomKey(dict);
+                    de = samples[k];
                     thiskey = dictGetKey(de);
                     thisval = (long) dictGetVal(de);
 
@@ -2753,6 +3237,7 @@ int freeMemoryIfNeeded(void) {
                         bestval = thisval;
                     }
                 }
+                if (samples != _samples) zfree(samples);
             }
 
             /* Finally remove the selected key. */
@@ -2771,7 +3256,10 @@ int freeMemoryIfNeeded(void) {
                  * AOF and Output buffer memory will be freed eventually so
                  * we only care about memory used by the key space. */
                 delta = (long long) zmalloc_used_memory();
+                latencyStartMonitor(eviction_latency);
                 dbDelete(db,keyobj);
+                latencyEndMonitor(eviction_latency);
+                latencyAddSampleIfNeeded("eviction-del",eviction_latency);
                 delta -= (long long) zmalloc_used_memory();
                 mem_freed += delta;
                 server.stat_evictedkeys++;
@@ -2785,8 +3273,14 @@ int freeMemoryIfNeeded(void) {
                 if (slaves) flushSlavesOutputBuffers();
             }
         }
-        if (!keys_freed) return REDIS_ERR; /* nothing to free... */
+        if (!keys_freed) {
+            latencyEndMonitor(latency);
+            latencyAddSampleIfNeeded("eviction-cycle",latency);
+            return REDIS_ERR; /* nothing to free... */
+        }
     }
+    latencyEndMonitor(latency);
+    latencyAddSampleIfNeeded("eviction-cycle",latency);
     return REDIS_OK;
 }
 
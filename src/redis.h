@@ -58,6 +58,8 @@
 #include "zmalloc.h" /* total memory usage aware version of malloc/free */
 #include "anet.h"    /* Networking the easy way */
 #include "ziplist.h" /* Compact list data structure */
+#include "quicklist.h" /* Lists are encoded as linked lists of ziplists */
+#include "radix.h"   /* Prefix index of pattern subscriptions */
 #include "intset.h"  /* Compact integer set structure */
 #include "version.h" /* Version macro */
 #include "util.h"    /* Misc functions useful in many places */
@@ -78,12 +80,24 @@
 // 数据库数量
 #define REDIS_DEFAULT_DBNUM     16
 #define REDIS_CONFIGLINE_MAX    1024
-#define REDIS_EXPIRELOOKUPS_PER_CRON    10 /* lookup 10 expires per loop */
+#define REDIS_EXPIRELOOKUPS_PER_CRON    20 /* lookup 20 expires per loop */
 #define REDIS_EXPIRELOOKUPS_TIME_PERC   25 /* CPU max % for keys collection */
+#define REDIS_EXPIRE_CYCLE_SLOW 0       /* Active expire cycle from serverCron */
+#define REDIS_EXPIRE_CYCLE_FAST 1       /* Active expire cycle from beforeSleep */
+#define REDIS_EXPIRE_CYCLE_FAST_DURATION 1000 /* Microseconds */
+#define REDIS_EXPIRE_CYCLE_ACCEPTABLE_STALE 10 /* % of stale keys to keep
+                                                  expiring in the same DB. */
+#define REDIS_EXPIRE_CYCLE_DBS_PER_CALL 16 /* DBs tested per slow cycle. */
 // 每次事件执行时最大的可写入字节数
 // 写入超过这个值的写时间会被中断，等待下次继续写
 // 从而避免大回复独占服务器时间
 #define REDIS_MAX_WRITE_PER_EVENT (1024*64)
+// 每次 writev 调用最多写入的块数量（静态缓存和回复链表节点）
+#ifdef IOV_MAX
+#define REDIS_IOV_MAX IOV_MAX
+#else
+#define REDIS_IOV_MAX 1024
+#endif
 #define REDIS_SHARED_SELECT_CMDS 10
 // 最大共享整数数值
 #define REDIS_SHARED_INTEGERS 10000
@@ -92,15 +106,32 @@
 #define REDIS_AOF_REWRITE_PERC  100
 #define REDIS_AOF_REWRITE_MIN_SIZE (1024*1024)
 #define REDIS_AOF_REWRITE_ITEMS_PER_CMD 64
+#define REDIS_DEFAULT_AOF_USE_RDB_PREAMBLE 0
+#define REDIS_DEFAULT_AOF_WRITE_THREAD 0
+#define REDIS_DEFAULT_RDB_CODEC REDIS_RDB_CODEC_LZF
+#define REDIS_DEFAULT_RDB_STREAM_COMPRESSION 0
 #define REDIS_SLOWLOG_LOG_SLOWER_THAN 10000
 #define REDIS_SLOWLOG_MAX_LEN 128
+#define REDIS_LATENCY_MONITOR_THRESHOLD 0 /* Latency monitor disabled. */
 #define REDIS_MAX_CLIENTS 10000
 #define REDIS_AUTHPASS_MAX_LEN 512
 #define REDIS_DEFAULT_SLAVE_PRIORITY 100
 #define REDIS_REPL_TIMEOUT 60
 #define REDIS_REPL_PING_SLAVE_PERIOD 10
+#define REDIS_DEFAULT_REPL_BACKLOG_SIZE (1024*1024)    /* 1mb */
+#define REDIS_DEFAULT_REPL_BACKLOG_TIME_LIMIT (60*60)  /* 1 hour */
+#define REDIS_REPL_BACKLOG_MIN_SIZE (1024*16)          /* 16k */
+#define REDIS_DEFAULT_REPL_DISKLESS_SYNC 0
+#define REDIS_DEFAULT_REPL_DISKLESS_SYNC_DELAY 5
+#define REDIS_DEFAULT_REPL_DISKLESS_LOAD 0
 #define REDIS_RUN_ID_SIZE 40
+#define REDIS_EOF_MARK_SIZE 40
+#define REDIS_LONGSTR_SIZE 21          /* Bytes needed for long -> str */
+/* Make sure we have enough stack to perform all the things we do in the
+ * main thread. Used by the bio.c and I/O threads. */
+#define REDIS_THREAD_STACK_SIZE (1024*1024*4)
 #define REDIS_OPS_SEC_SAMPLES 16
+#define REDIS_LAZYFREE_THRESHOLD 64 /* Free effort to use a bio thread. */
 
 /* Protocol and I/O related defines */
 #define REDIS_MAX_QUERYBUF_LEN  (1024*1024*1024) /* 1GB max query buffer. */
@@ -108,6 +139,42 @@
 #define REDIS_REPLY_CHUNK_BYTES (16*1024) /* 16k output buffer */
 #define REDIS_INLINE_MAX_SIZE   (1024*64) /* Max size of inline reads */
 #define REDIS_MBULK_BIG_ARG     (1024*32)
+#define REDIS_ARGV_POOL_MAX     1024 /* Bigger argv arrays are not reused */
+#define REDIS_SHARED_REPLY_MIN_LEN 1024 /* Smaller replies are copied */
+/* Replies that don't fit the static buffer are copied into blocks growing
+ * from the size of the first reply (but at least MIN_BYTES) up to this
+ * size, so that the sds header, the data and the null term of a full block
+ * take exactly REDIS_REPLY_CHUNK_BYTES. */
+#define REDIS_REPLY_BLOCK_BYTES (REDIS_REPLY_CHUNK_BYTES-sizeof(struct sdshdr)-1)
+#define REDIS_REPLY_BLOCK_MIN_BYTES 256
+#define REDIS_REPLY_BLOCK_POOL_SIZE 64 /* Max free reply blocks to reuse */
+
+/* Threaded I/O */
+#define REDIS_IO_THREADS_NUM        1   /* Default: I/O threads disabled. */
+#define REDIS_IO_THREADS_MAX_NUM    128 /* Max number of I/O threads. */
+#define REDIS_IO_THREADS_MIN_CLIENTS 2  /* Min pending clients per thread to
+                                           make the hand-off worth it. */
+#define REDIS_IO_THREADS_OP_READ    0
+#define REDIS_IO_THREADS_OP_WRITE   1
+
+/* Threaded RDB loading */
+#define REDIS_RDB_LOAD_THREADS_NUM      1  /* Default: serial RDB loading. */
+#define REDIS_RDB_LOAD_THREADS_MAX_NUM  64 /* Max number of loading threads. */
+
+/* Per command latency histograms. Latencies in microseconds are recorded
+ * in log-linear buckets: values below REDIS_CMD_LATENCY_SUB_BUCKETS get one
+ * bucket each, every following power of two is split into
+ * REDIS_CMD_LATENCY_SUB_BUCKETS/2 buckets, so the relative error of the
+ * reported percentiles is below 2/REDIS_CMD_LATENCY_SUB_BUCKETS. Latencies
+ * of 2^REDIS_CMD_LATENCY_MAX_EXP microseconds (~71 minutes) or more are
+ * clamped. */
+#define REDIS_CMD_LATENCY_SUB_BITS      5
+#define REDIS_CMD_LATENCY_SUB_BUCKETS   (1<<REDIS_CMD_LATENCY_SUB_BITS)
+#define REDIS_CMD_LATENCY_HALF_BUCKETS  (REDIS_CMD_LATENCY_SUB_BUCKETS/2)
+#define REDIS_CMD_LATENCY_MAX_EXP       32
+#define REDIS_CMD_LATENCY_BUCKETS \
+    ((REDIS_CMD_LATENCY_MAX_EXP-REDIS_CMD_LATENCY_SUB_BITS+3)* \
+     REDIS_CMD_LATENCY_HALF_BUCKETS)
 
 /* Hash table parameters */
 #define REDIS_HT_MINFILL        10      /* Minimal hash table fill 10% */
@@ -146,10 +213,22 @@
 #define REDIS_ENCODING_INT 1     /* Encoded as integer */
 #define REDIS_ENCODING_HT 2      /* Encoded as hash table */
 #define REDIS_ENCODING_ZIPMAP 3  /* Encoded as zipmap */
-#define REDIS_ENCODING_LINKEDLIST 4 /* Encoded as regular linked list */
+#define REDIS_ENCODING_LINKEDLIST 4 /* No longer used: old list encoding. */
 #define REDIS_ENCODING_ZIPLIST 5 /* Encoded as ziplist */
 #define REDIS_ENCODING_INTSET 6  /* Encoded as intset */
 #define REDIS_ENCODING_SKIPLIST 7  /* Encoded as skiplist */
+#define REDIS_ENCODING_QUICKLIST 8 /* Encoded as linked list of ziplists */
+#define REDIS_ENCODING_EMBSTR 9  /* Embedded sds string encoding */
+
+/* Strings up to this length are created with the EMBSTR encoding: the robj,
+ * the sds header and the string are in a single 64 bytes allocation. */
+// 长度不超过这个值的字符串使用 EMBSTR 编码，
+// 对象、 sds 头和字符串内容被分配在同一块 64 字节的内存中
+#define REDIS_ENCODING_EMBSTR_SIZE_LIMIT 39
+
+/* Objects whose ptr is a sds string (RAW or EMBSTR encoded). */
+// 对象的 ptr 是否指向一个 sds 字符串
+#define sdsEncodedObject(objptr) (objptr->encoding == REDIS_ENCODING_RAW || objptr->encoding == REDIS_ENCODING_EMBSTR)
 
 /* Defines related to the dump file format. To store 32 bits lengths for short
  * keys requires a lot of space, so we check the most significant 2 bits of
@@ -198,6 +277,14 @@
 #define REDIS_CLOSE_ASAP (1<<10)/* Close this client ASAP */
 #define REDIS_UNIX_SOCKET (1<<11) /* Client connected via Unix domain socket */
 #define REDIS_DIRTY_EXEC (1<<12)  /* EXEC will fail for errors while queueing */
+#define REDIS_PENDING_READ (1<<13) /* Read is queued for the I/O threads */
+#define REDIS_PENDING_WRITE (1<<14) /* Write is queued for the I/O threads */
+#define REDIS_PENDING_COMMAND (1<<15) /* An I/O thread parsed a command that
+                                         the main thread has to execute. */
+#define REDIS_IO_CLOSE (1<<16)  /* An I/O thread asks to free the client */
+#define REDIS_PRE_PSYNC (1<<17) /* Instance don't understand PSYNC. */
+#define REDIS_AOF_WAIT (1<<18)  /* Reply held until the AOF batch with the
+                                   client writes is on disk. */
 
 /* Client request types */
 #define REDIS_REQ_INLINE 1
@@ -218,8 +305,9 @@
 #define REDIS_REPL_CONNECT 1 /* Must connect to master */
 #define REDIS_REPL_CONNECTING 2 /* Connecting to master */
 #define REDIS_REPL_RECEIVE_PONG 3 /* Wait for PING reply */
-#define REDIS_REPL_TRANSFER 4 /* Receiving .rdb from master */
-#define REDIS_REPL_CONNECTED 5 /* Connected to master */
+#define REDIS_REPL_RECEIVE_PSYNC 4 /* Wait for PSYNC reply */
+#define REDIS_REPL_TRANSFER 5 /* Receiving .rdb from master */
+#define REDIS_REPL_CONNECTED 6 /* Connected to master */
 
 /* Synchronous read timeout - slave side */
 #define REDIS_REPL_SYNCIO_TIMEOUT 5
@@ -236,6 +324,19 @@
 #define REDIS_REPL_SEND_BULK 5 /* master is sending the bulk DB */
 #define REDIS_REPL_ONLINE 6 /* bulk DB already transmitted, receive updates */
 
+/* Slave capabilities, announced with REPLCONF capa.
+ *
+ * 附属节点支持的复制特性 */
+#define REDIS_SLAVE_CAPA_NONE 0
+#define REDIS_SLAVE_CAPA_EOF (1<<0) /* Can parse the RDB EOF streaming format. */
+
+/* Type of the RDB child, if any.
+ *
+ * RDB 子进程的类型：写入磁盘，或者直接写入附属节点的套接字 */
+#define REDIS_RDB_CHILD_TYPE_NONE 0
+#define REDIS_RDB_CHILD_TYPE_DISK 1     /* RDB is written to disk. */
+#define REDIS_RDB_CHILD_TYPE_SOCKET 2   /* RDB is written to slave socket. */
+
 /* List related stuff 
  *
  * 列表头/尾
@@ -282,8 +383,8 @@
  */
 #define REDIS_HASH_MAX_ZIPLIST_ENTRIES 512
 #define REDIS_HASH_MAX_ZIPLIST_VALUE 64
-#define REDIS_LIST_MAX_ZIPLIST_ENTRIES 512
-#define REDIS_LIST_MAX_ZIPLIST_VALUE 64
+#define REDIS_LIST_MAX_ZIPLIST_SIZE -2
+#define REDIS_LIST_COMPRESS_DEPTH 0
 #define REDIS_SET_MAX_INTSET_ENTRIES 512
 #define REDIS_ZSET_MAX_ZIPLIST_ENTRIES 128
 #define REDIS_ZSET_MAX_ZIPLIST_VALUE 64
@@ -303,6 +404,13 @@
 #define REDIS_MAXMEMORY_ALLKEYS_LRU 3
 #define REDIS_MAXMEMORY_ALLKEYS_RANDOM 4
 #define REDIS_MAXMEMORY_NO_EVICTION 5
+#define REDIS_MAXMEMORY_VOLATILE_LFU 6
+#define REDIS_MAXMEMORY_ALLKEYS_LFU 7
+#define REDIS_MAXMEMORY_IS_LFU(p) ((p) == REDIS_MAXMEMORY_VOLATILE_LFU || \
+                                   (p) == REDIS_MAXMEMORY_ALLKEYS_LFU)
+
+/* Size of the pool of eviction candidates kept by every DB. */
+#define REDIS_EVICTION_POOL_SIZE 16
 
 /* Scripting */
 #define REDIS_LUA_TIME_LIMIT 5000 /* milliseconds */
@@ -347,8 +455,28 @@
 /* A redis object, that is a type able to hold a string / list / set */
 
 /* The actual Redis Object */
-#define REDIS_LRU_CLOCK_MAX ((1<<21)-1) /* Max value of obj->lru */
-#define REDIS_LRU_CLOCK_RESOLUTION 10 /* LRU clock resolution in seconds */
+#define REDIS_LRU_CLOCK_MAX ((1<<22)-1) /* Max value of obj->lru */
+#define REDIS_LRU_CLOCK_RESOLUTION 1000 /* LRU clock resolution in ms */
+
+/* With the LFU policies the 22 lru bits of an object are split in two:
+ *
+ *      14 bits      8 bits
+ * +-------------+--------+
+ * | Last access | LOG_C  |
+ * +-------------+--------+
+ *
+ * LOG_C is a logarithmic access counter, incremented with a probability
+ * that gets lower as the counter grows. "Last access" is the time, in
+ * minutes (wrapping every ~11 days), of the last access: the counter
+ * loses one unit every lfu-decay-time minutes elapsed since then, so that
+ * keys that are no longer accessed can be evicted. New objects start with
+ * REDIS_LFU_INIT_VAL, so that they have a chance to accumulate hits before
+ * being evicted. */
+#define REDIS_LFU_INIT_VAL 5
+#define REDIS_LFU_COUNTER_MAX 255
+#define REDIS_LFU_TIME_MAX ((1<<14)-1)
+#define REDIS_DEFAULT_LFU_LOG_FACTOR 10
+#define REDIS_DEFAULT_LFU_DECAY_TIME 1
 /*
  * Redis 对象
  */
@@ -357,8 +485,11 @@ typedef struct redisObject {
     // 类型
     unsigned type:4;        
 
+    // 是否为可以放回池中的回复块，见 networking.c
+    unsigned replyblock:1;  /* Poolable reply block, see createReplyBlock() */
+
     // 不使用(对齐位)
-    unsigned notused:2;
+    unsigned notused:1;
 
     // 编码方式
     unsigned encoding:4;
@@ -374,6 +505,10 @@ typedef struct redisObject {
 
 } robj;
 
+/* Reference count of shared objects, see makeObjectShared(). */
+// 共享对象的引用计数，这类对象的引用计数永远不会被修改
+#define REDIS_SHARED_REFCOUNT INT_MAX
+
 /* Macro used to initalize a Redis object allocated on the stack.
  * Note that this macro is taken near the structure definition to make sure
  * we'll update it when the structure is changed, to avoid bugs like
@@ -388,6 +523,20 @@ typedef struct redisObject {
     _var.ptr = _ptr; \
 } while(0);
 
+/* To improve the quality of the LRU approximation we keep, for every DB,
+ * a pool of good candidates for eviction that survives across calls of
+ * freeMemoryIfNeeded(). Entries are sorted by idle time, from the smaller
+ * to the greater, and empty entries have a NULL key.
+ *
+ * 淘汰候选池的项，每个数据库保存一个按空转时长从小到大排列的候选池
+ */
+struct evictionPoolEntry {
+    // 对象的空转时长
+    unsigned long long idle;    /* Object idle time. */
+    // 键名（sds 副本）
+    sds key;                    /* Key name. */
+};
+
 /*
  * 数据库结构
  */
@@ -402,6 +551,10 @@ typedef struct redisDb {
     dict *ready_keys;           /* Blocked keys that received a PUSH */
     // 正在监视某个/某些 key 的所有客户端
     dict *watched_keys;         /* WATCHED keys for MULTI/EXEC CAS */
+    // LRU 淘汰候选池
+    struct evictionPoolEntry *eviction_pool;    /* Eviction pool of keys */
+    // 主动过期下次从过期字典的哪个桶开始检查
+    unsigned long expires_cursor; /* Next bucket checked by active expire */
     // 数据库的号码
     int id;
 } redisDb;
@@ -494,6 +647,7 @@ typedef struct redisClient {
 
     // 字符串表示的命令，以及命令的参数
     robj **argv;
+    int argv_len;           /* Size of the argv array, reused among commands */
 
     // 命令，以及上个命令
     struct redisCommand *cmd, *lastcmd;
@@ -510,13 +664,20 @@ typedef struct redisClient {
 
     // 统计数据
     int sentlen;
+    // I/O 线程已经完整写出、但还未释放的回复链表节点数量
+    unsigned long io_sent_nodes; /* Reply nodes written by an I/O thread */
+    // 客户端在 I/O 线程读写队列中的节点，用于 O(1) 删除
+    listNode *pending_read_node;  /* Node in server.clients_pending_read */
+    listNode *pending_write_node; /* Node in server.clients_pending_write */
+    // 回复需要等待这个 AOF 批次写入磁盘之后才能发送
+    long long aof_wait_seq; /* AOF batch to wait for if REDIS_AOF_WAIT */
+    listNode *aof_wait_node; /* Node in server.clients_waiting_aof */
     time_t ctime;           /* Client creation time */
     time_t lastinteraction; /* time of the last interaction, used for timeout */
     time_t obuf_soft_limit_reached_time;
     int flags;              /* REDIS_SLAVE | REDIS_MONITOR | REDIS_MULTI ... */
 
     // 复制功能相关
-    int slaveseldb;         /* slave selected db, if this client is a slave */
     int authenticated;      /* when requirepass is non-NULL */
     // 客户端当前的同步状态
     int replstate;          /* replication state if this is a slave */
@@ -527,6 +688,16 @@ typedef struct redisClient {
     // 同步数据库文件的大小
     off_t repldbsize;       /* replication DB file size */
     int slave_listening_port; /* As configured with: SLAVECONF listening-port */
+    // 附属节点支持的复制特性， REDIS_SLAVE_CAPA_*
+    int slave_capa;         /* Slave capabilities: REDIS_SLAVE_CAPA_* bitwise OR. */
+    // 主节点复制流中已读入的字节偏移量（客户端是主节点时使用）
+    long long read_reploff; /* Read replication offset if this is our master */
+    // 主节点复制流中已执行的字节偏移量（客户端是主节点时使用）
+    long long reploff;      /* Applied replication offset if this is our master */
+    // 主节点的运行 ID （客户端是主节点时使用）
+    char replrunid[REDIS_RUN_ID_SIZE+1]; /* Master run id if this is a master */
+    // 完整重同步开始时的复制偏移量（客户端是附属节点时使用）
+    long long psync_initoffset; /* FULLRESYNC reply offset if this is a slave */
 
     // 事务实现
     multiState mstate;      /* MULTI/EXEC state */
@@ -541,7 +712,9 @@ typedef struct redisClient {
 
     // 订阅与发布
     dict *pubsub_channels;  /* channels a client is interested in (SUBSCRIBE) */
-    list *pubsub_patterns;  /* patterns a client is interested in (SUBSCRIBE) */
+    list *pubsub_patterns;  /* pubsubPattern records of the client (PSUBSCRIBE) */
+    // 模式到 pubsubPattern 记录的映射，用于快速查找客户端订阅的模式
+    dict *pubsub_patterns_dict; /* Pattern -> pubsubPattern record */
 
     /* Response buffer */
     // 回复缓存的当前缓存
@@ -566,7 +739,7 @@ struct sharedObjectsStruct {
     *masterdownerr, *roslaveerr, *execaborterr,
     *oomerr, *plus, *messagebulk, *pmessagebulk, *subscribebulk,
     *unsubscribebulk, *psubscribebulk, *punsubscribebulk, *del, *rpop, *lpop,
-    *lpush,
+    *lpush, *emptyscan,
     *select[REDIS_SHARED_SELECT_CMDS],
     *integers[REDIS_SHARED_INTEGERS],
     *mbulkhdr[REDIS_SHARED_BULKHDR_LEN], /* "*<value>\r\n" */
@@ -790,7 +963,7 @@ struct redisServer {
     aeEventLoop *el;
 
     // LRU
-    unsigned lruclock:22;       /* Clock incrementing every minute, for LRU */
+    unsigned lruclock:22;       /* Clock for LRU eviction */
     unsigned lruclock_padding:10;
 
     // 关闭标志
@@ -835,10 +1008,17 @@ struct redisServer {
     list *clients;              /* List of active clients */
     // 所有等待关闭的客户端
     list *clients_to_close;     /* Clients to close asynchronously */
+    // 可以被所有客户端重用的空闲回复块
+    list *reply_blocks;         /* Free reply blocks, see networking.c */
     // 所有附属节点和 MONITOR
     list *slaves, *monitors;    /* List of slaves and MONITORs */
     // 当前客户端，只在创建崩溃报告时使用
     redisClient *current_client; /* Current client, only used on crash report */
+    // 等待 I/O 线程读入和写出的客户端
+    list *clients_pending_read;  /* Clients with reads queued for I/O threads */
+    list *clients_pending_write; /* Clients with writes queued for I/O threads */
+    // I/O 线程数量（包括主线程），为 1 时不使用 I/O 线程
+    int io_threads_num;          /* Number of I/O threads, main included */
 
     char neterr[ANET_ERR_LEN];   /* Error buffer for anet.c */
     dict *migrate_cached_sockets;/* MIGRATE cached sockets */
@@ -858,12 +1038,20 @@ struct redisServer {
     long long stat_numcommands;     /* Number of processed commands */
     long long stat_numconnections;  /* Number of connections received */
     long long stat_expiredkeys;     /* Number of expired keys */
+    double stat_expired_stale_perc; /* Percentage of keys probably expired */
+    long long stat_expired_time_cap_reached_count; /* Early expire cylce stops.*/
+    long long stat_expire_cycle_time_used; /* Cumulative microseconds used. */
     long long stat_evictedkeys;     /* Number of evicted keys (maxmemory) */
     long long stat_keyspace_hits;   /* Number of successful lookups of keys */
     long long stat_keyspace_misses; /* Number of failed lookups of keys */
     size_t stat_peak_memory;        /* Max used memory record */
     long long stat_fork_time;       /* Time needed to perform latets fork() */
     long long stat_rejected_conn;   /* Clients rejected because of maxclients */
+    long long stat_io_reads_processed;  /* Reads performed by I/O threads */
+    long long stat_io_writes_processed; /* Writes performed by I/O threads */
+    long long stat_sync_full;       /* Number of full resyncs with slaves. */
+    long long stat_sync_partial_ok; /* Number of accepted PSYNC requests. */
+    long long stat_sync_partial_err;/* Number of unaccepted PSYNC requests. */
 
     // 保存慢查询日志的链表
     list *slowlog;                  /* SLOWLOG list of commands */
@@ -875,6 +1063,11 @@ struct redisServer {
     // 慢查询日志的最大条目数量
     unsigned long slowlog_max_len;     /* SLOWLOG max number of items logged */
 
+    // 延迟监视器记录的事件
+    dict *latency_events;           /* Event name -> latencyTimeSeries */
+    // 延迟监视器的时间限制，为 0 时关闭监视器
+    long long latency_monitor_threshold; /* Min latency (ms) to be logged */
+
     /* The following two are used to track instantaneous "load" in terms
      * of operations per second. */
     long long ops_sec_last_sample_time; /* Timestamp of last sample (in ms) */
@@ -895,6 +1088,8 @@ struct redisServer {
     int aof_fsync;                  /* Kind of fsync() policy */
     char *aof_filename;             /* Name of the AOF file */
     int aof_no_fsync_on_rewrite;    /* Don't fsync if a rewrite is in prog. */
+    int aof_use_rdb_preamble;       /* Rewrite the AOF as RDB + commands tail. */
+    int aof_write_thread;           /* Write and fsync the AOF in a thread. */
     int aof_rewrite_perc;           /* Rewrite AOF if % growth is > M and... */
     off_t aof_rewrite_min_size;     /* the AOF file is at least N bytes. */
     off_t aof_rewrite_base_size;    /* AOF size on latest startup or rewrite. */
@@ -911,16 +1106,47 @@ struct redisServer {
     time_t aof_rewrite_time_start;  /* Current AOF rewrite start time. */
     int aof_lastbgrewrite_status;   /* REDIS_OK or REDIS_ERR */
     unsigned long aof_delayed_fsync;  /* delayed AOF fsync() counter */
+    long long aof_rewrite_diff_bytes_last; /* Diff flushed by the parent. */
+    long long aof_rewrite_diff_time_last;  /* Time (us) to flush that diff. */
+    /* AOF pipes used to communicate between parent and child during rewrite. */
+    int aof_pipe_write_data_to_child;
+    int aof_pipe_read_data_from_parent;
+    int aof_pipe_write_ack_to_parent;
+    int aof_pipe_read_ack_from_child;
+    int aof_pipe_write_ack_to_child;
+    int aof_pipe_read_ack_from_parent;
+    int aof_stop_sending_diff;     /* If true stop sending accumulated diffs
+                                      to child process. */
+    sds aof_child_diff;             /* AOF diff accumulator child side. */
+    /* Threaded AOF writes: server.aof_buf is handed to the bio thread as a
+     * batch, while new writes accumulate in a fresh buffer. */
+    int aof_write_in_progress;      /* A batch is being written by the thread. */
+    long long aof_batch_seq;        /* Sequence number of the batch being
+                                       accumulated in server.aof_buf. */
+    int aof_write_done_pipe[2];     /* The thread notifies finished batches. */
+    sds aof_buf_spare;              /* Buffer of the last written batch. */
+    list *clients_waiting_aof;      /* Clients with REDIS_AOF_WAIT set. */
 
     /* RDB persistence */
     long long dirty;                /* Changes to DB from the last save */
     long long dirty_before_bgsave;  /* Used to restore dirty on failed BGSAVE */
     pid_t rdb_child_pid;            /* PID of RDB saving child */
+    int rdb_child_type;             /* Type of save by active child. */
+    int rdb_pipe_write_result_to_child; /* RDB pipes used to return the state */
+    int rdb_pipe_read_result_from_child; /* of each slave in diskless SYNC. */
     struct saveparam *saveparams;   /* Save points array for RDB */
     int saveparamslen;              /* Number of saving points */
     char *rdb_filename;             /* Name of RDB file */
     int rdb_compression;            /* Use compression in RDB? */
+    // 压缩字符串使用的算法
+    int rdb_compression_codec;      /* REDIS_RDB_CODEC_* used for strings. */
+    // 是否压缩整个 RDB 文件
+    int rdb_stream_compression;     /* Compress the whole RDB file? */
     int rdb_checksum;               /* Use RDB checksum? */
+    // 载入 RDB 时使用的线程数量（包括主线程），为 1 时顺序载入
+    int rdb_load_threads;           /* Threads decoding the RDB on load. */
+    // 载入线程运行期间为真，此时不使用共享整数对象
+    int rdb_load_unshared;          /* Don't return shared integers. */
     time_t lastsave;                /* Unix time of last save succeeede */
     time_t rdb_save_time_last;      /* Time used by last RDB save run. */
     time_t rdb_save_time_start;     /* Current RDB save start time. */
@@ -935,6 +1161,31 @@ struct redisServer {
     char *syslog_ident;             /* Syslog ident */
     int syslog_facility;            /* Syslog facility */
 
+    /* Replication (master) */
+    // 向附属节点发送命令时最后选择的数据库
+    int slaveseldb;                 /* Last SELECTed DB in replication output */
+    // 复制流的全局偏移量
+    long long master_repl_offset;   /* Global replication offset */
+    // 复制积压缓冲区，一个环形缓冲区
+    char *repl_backlog;             /* Replication backlog for partial syncs */
+    long long repl_backlog_size;    /* Backlog circular buffer size */
+    // 积压缓冲区中实际保存的数据长度
+    long long repl_backlog_histlen; /* Backlog actual data length */
+    // 积压缓冲区下一个写入位置
+    long long repl_backlog_idx;     /* Backlog circular buffer current offset */
+    // 积压缓冲区第一个字节对应的复制偏移量
+    long long repl_backlog_off;     /* Replication offset of first byte in the
+                                       backlog buffer. */
+    // 没有附属节点时，积压缓冲区在多少秒之后被释放
+    time_t repl_backlog_time_limit; /* Time without slaves after the backlog
+                                       gets released. */
+    time_t repl_no_slaves_since;    /* We have no slaves since that time.
+                                       Only valid if server.slaves len is 0. */
+    // 是否将 RDB 直接写入附属节点的套接字，而不是先写入磁盘
+    int repl_diskless_sync;         /* Send RDB to slaves sockets directly. */
+    // 开始无盘同步之前等待更多附属节点的秒数
+    int repl_diskless_sync_delay;   /* Delay to start a diskless repl BGSAVE. */
+
     /* Slave specific fields */
     char *masterauth;               /* AUTH with this password with master */
     char *masterhost;               /* Hostname of master */
@@ -950,10 +1201,17 @@ struct redisServer {
     int repl_transfer_s;     /* Slave -> Master SYNC socket */
     int repl_transfer_fd;    /* Slave -> Master SYNC temp file descriptor */
     char *repl_transfer_tmpfile; /* Slave-> master SYNC temp file name */
+    // 是否直接从套接字载入主节点发来的 RDB ，不经过临时文件
+    int repl_diskless_load;  /* Load the RDB straight from the master socket. */
     time_t repl_transfer_lastio; /* Unix time of the latest read, for timeout */
     int repl_serve_stale_data; /* Serve stale data when link is down? */
     int repl_slave_ro;          /* Slave is read only? */
     time_t repl_down_since; /* Unix time at which link with master went down */
+    // 断线之后被缓存的主节点，用于尝试部分重同步
+    redisClient *cached_master; /* Cached master to be reused for PSYNC. */
+    // 完整重同步时主节点发来的运行 ID 和初始偏移量
+    char repl_master_runid[REDIS_RUN_ID_SIZE+1];  /* Master run id for PSYNC. */
+    long long repl_master_initial_offset;         /* Master PSYNC offset. */
     int slave_priority;             /* Reported in INFO and used by Sentinel. */
 
     /* Limits */
@@ -961,6 +1219,8 @@ struct redisServer {
     unsigned long long maxmemory;   /* Max number of memory bytes to use */
     int maxmemory_policy;           /* Policy for key evition */
     int maxmemory_samples;          /* Pricision of random sampling */
+    int lfu_log_factor;             /* LFU logarithmic counter factor. */
+    int lfu_decay_time;             /* LFU counter decay time in minutes. */
 
     /* Blocked clients */
     unsigned int bpop_blocked_clients; /* Number of clients blocked by lists */
@@ -977,8 +1237,8 @@ struct redisServer {
     /* Zip structure config, see redis.conf for more information  */
     size_t hash_max_ziplist_entries;
     size_t hash_max_ziplist_value;
-    size_t list_max_ziplist_entries;
-    size_t list_max_ziplist_value;
+    int list_max_ziplist_size;
+    int list_compress_depth;
     size_t set_max_intset_entries;
     size_t zset_max_ziplist_entries;
     size_t zset_max_ziplist_value;
@@ -989,6 +1249,8 @@ struct redisServer {
     dict *pubsub_channels;  /* Map channels to list of subscribed clients */
     // 模式
     list *pubsub_patterns;  /* A list of pubsub_patterns */
+    // 模式的字面前缀索引，值为拥有这个前缀的模式链表
+    radixTree *pubsub_prefixes; /* Literal prefix -> list of pubsub_patterns */
 
     /* Cluster */
     int cluster_enabled;    /* Is cluster enabled? */
@@ -1025,6 +1287,13 @@ typedef struct pubsubPattern {
     redisClient *client;
     // 订阅的模式
     robj *pattern;
+    // 模式在 server.pubsub_patterns 链表中的节点
+    listNode *node;
+    // 模式在 client->pubsub_patterns 链表中的节点
+    listNode *clientnode;
+    // 保存模式的前缀桶，以及模式在桶中的节点
+    list *bucket;
+    listNode *bucketnode;
 } pubsubPattern;
 
 typedef void redisCommandProc(redisClient *c);
@@ -1055,6 +1324,9 @@ struct redisCommand {
     long long microseconds;
     // 这个命令被调用的总次数
     long long calls;
+    // 命令执行时间的直方图，在命令第一次被执行时创建
+    long long *latency_hist; /* REDIS_CMD_LATENCY_BUCKETS counters, or NULL
+                                if the command was not called yet. */
 };
 
 struct redisFunctionSym {
@@ -1080,15 +1352,13 @@ typedef struct {
     robj *subject;
     unsigned char encoding;
     unsigned char direction; /* Iteration direction */
-    unsigned char *zi;
-    listNode *ln;
+    quicklistIter *iter;
 } listTypeIterator;
 
 /* Structure for an entry while iterating over a list. */
 typedef struct {
     listTypeIterator *li;
-    unsigned char *zi;  /* Entry in ziplist */
-    listNode *ln;       /* Entry in linked list */
+    quicklistEntry entry; /* Entry in quicklist */
 } listTypeEntry;
 
 /* Structure to hold set iteration abstraction. */
@@ -1131,6 +1401,7 @@ extern dictType setDictType;
 extern dictType zsetDictType;
 extern dictType clusterNodesDictType;
 extern dictType dbDictType;
+extern dictType keyptrDictType;
 extern dictType shaScriptObjectDictType;
 extern double R_Zero, R_PosInf, R_NegInf, R_Nan;
 extern dictType hashDictType;
@@ -1142,6 +1413,7 @@ extern dictType hashDictType;
 /* Utils */
 long long ustime(void);
 long long mstime(void);
+void dictVanillaFree(void *privdata, void *val);
 void getRandomHexChars(char *p, unsigned int len);
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
 void exitFromChild(int retcode);
@@ -1150,7 +1422,10 @@ void exitFromChild(int retcode);
 redisClient *createClient(int fd);
 void closeTimedoutClients(void);
 void freeClient(redisClient *c);
+void freeClientAsync(redisClient *c);
+void freeClientArgv(redisClient *c);
 void resetClient(redisClient *c);
+void resetClientParser(redisClient *c);
 void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask);
 void addReply(redisClient *c, robj *obj);
 void *addDeferredMultiBulkLength(redisClient *c);
@@ -1166,6 +1441,7 @@ void addReplyBulkCBuffer(redisClient *c, void *p, size_t len);
 void addReplyBulkLongLong(redisClient *c, long long ll);
 void acceptHandler(aeEventLoop *el, int fd, void *privdata, int mask);
 void addReply(redisClient *c, robj *obj);
+void addReplyShared(redisClient *c, robj *obj);
 void addReplySds(redisClient *c, sds s);
 void addReplyError(redisClient *c, char *err);
 void addReplyStatus(redisClient *c, char *status);
@@ -1174,6 +1450,8 @@ void addReplyLongLong(redisClient *c, long long ll);
 void addReplyMultiBulkLen(redisClient *c, long length);
 void copyClientOutputBuffer(redisClient *dst, redisClient *src);
 void *dupClientReplyValue(void *o);
+void freeClientReplyValue(void *o);
+size_t zmalloc_size_sds(sds s);
 void getClientsMaxBuffers(unsigned long *longest_output_list,
                           unsigned long *biggest_input_buffer);
 sds getClientInfoString(redisClient *client);
@@ -1187,6 +1465,10 @@ int getClientLimitClassByName(char *name);
 char *getClientLimitClassName(int class);
 void flushSlavesOutputBuffers(void);
 void disconnectSlaves(void);
+void initThreadedIO(void);
+void handleClientsWithPendingReads(void);
+void handleClientsWithPendingWrites(void);
+void scheduleClientReplyWrite(redisClient *c);
 
 #ifdef __GNUC__
 void addReplyErrorFormat(redisClient *c, const char *fmt, ...)
@@ -1199,7 +1481,6 @@ void addReplyStatusFormat(redisClient *c, const char *fmt, ...);
 #endif
 
 /* List data type */
-void listTypeTryConversion(robj *subject, robj *value);
 void listTypePush(robj *subject, robj *value, int where);
 robj *listTypePop(robj *subject, int where);
 unsigned long listTypeLength(robj *subject);
@@ -1229,6 +1510,7 @@ void flagTransaction(redisClient *c);
 void decrRefCount(void *o);
 void incrRefCount(robj *o);
 robj *resetRefCount(robj *obj);
+robj *makeObjectShared(robj *o);
 void freeStringObject(robj *o);
 void freeListObject(robj *o);
 void freeSetObject(robj *o);
@@ -1236,15 +1518,17 @@ void freeZsetObject(robj *o);
 void freeHashObject(robj *o);
 robj *createObject(int type, void *ptr);
 robj *createStringObject(char *ptr, size_t len);
+robj *createRawStringObject(char *ptr, size_t len);
+robj *createEmbeddedStringObject(char *ptr, size_t len);
 robj *dupStringObject(robj *o);
 int isObjectRepresentableAsLongLong(robj *o, long long *llongval);
 robj *tryObjectEncoding(robj *o);
 robj *getDecodedObject(robj *o);
 size_t stringObjectLen(robj *o);
+size_t getStringObjectSdsUsedMemory(robj *o);
 robj *createStringObjectFromLongLong(long long value);
 robj *createStringObjectFromLongDouble(long double value);
-robj *createListObject(void);
-robj *createZiplistObject(void);
+robj *createQuicklistObject(void);
 robj *createSetObject(void);
 robj *createIntsetObject(void);
 robj *createHashObject(void);
@@ -1261,6 +1545,9 @@ char *strEncoding(int encoding);
 int compareStringObjects(robj *a, robj *b);
 int equalStringObjects(robj *a, robj *b);
 unsigned long estimateObjectIdleTime(robj *o);
+unsigned int objectGetLRUOrLFU(void);
+unsigned long LFUDecrAndReturn(robj *o);
+void updateObjectLFU(robj *o);
 
 /* Synchronous I/O with timeout */
 ssize_t syncWrite(int fd, char *ptr, ssize_t size, long long timeout);
@@ -1270,17 +1557,26 @@ ssize_t syncReadLine(int fd, char *ptr, ssize_t size, long long timeout);
 /* Replication */
 void replicationFeedSlaves(list *slaves, int dictid, robj **argv, int argc);
 void replicationFeedMonitors(redisClient *c, list *monitors, int dictid, robj **argv, int argc);
-void updateSlavesWaitingBgsave(int bgsaveerr);
+void updateSlavesWaitingBgsave(int bgsaveerr, int type);
+int replicationSetupSlaveForFullResync(redisClient *slave, long long offset);
 void replicationCron(void);
+void replicationHandleMasterDisconnection(void);
+void replicationCacheMaster(redisClient *c);
+void replicationDiscardCachedMaster(void);
+void resizeReplicationBacklog(long long newsize);
 
 /* Generic persistence functions */
 void startLoading(FILE *fp);
+void startLoadingSize(off_t size);
 void loadingProgress(off_t pos);
 void stopLoading(void);
 
 /* RDB persistence */
 #include "rdb.h"
 
+/* Latency monitor */
+#include "latency.h"
+
 /* AOF persistence */
 void flushAppendOnlyFile(int force);
 void feedAppendOnlyFile(struct redisCommand *cmd, int dictid, robj **argv, int argc);
@@ -1292,6 +1588,12 @@ int startAppendOnly(void);
 void backgroundRewriteDoneHandler(int exitcode, int bysignal);
 void aofRewriteBufferReset(void);
 unsigned long aofRewriteBufferSize(void);
+ssize_t aofReadDiffFromParent(void);
+void aofClosePipes(void);
+void aofInitWriteThread(void);
+void aofWriteBatchFromBioThread(void *ptr);
+void aofHoldClientReply(redisClient *c);
+void aofUnlinkWaitingClient(redisClient *c);
 
 /* Sorted sets data type */
 
@@ -1319,6 +1621,7 @@ void zsetConvert(robj *zobj, int encoding);
 
 /* Core functions */
 int freeMemoryIfNeeded(void);
+struct evictionPoolEntry *evictionPoolAlloc(void);
 int processCommand(redisClient *c);
 void setupSignalHandlers(void);
 struct redisCommand *lookupCommand(sds name);
@@ -1336,6 +1639,8 @@ int htNeedsResize(dict *dict);
 void oom(const char *msg);
 void populateCommandTable(void);
 void resetCommandTableStats(void);
+void commandLatencyRecord(struct redisCommand *cmd, long long us);
+long long commandLatencyPercentile(struct redisCommand *cmd, double perc);
 
 /* Set data type */
 robj *setTypeCreate(robj *value);
@@ -1404,6 +1709,16 @@ int selectDb(redisClient *c, int id);
 void signalModifiedKey(redisDb *db, robj *key);
 void signalFlushedDb(int dbid);
 unsigned int GetKeysInSlot(unsigned int hashslot, robj **keys, unsigned int count);
+int parseScanCursorOrReply(redisClient *c, robj *o, unsigned long *cursor);
+void scanGenericCommand(redisClient *c, robj *o, unsigned long cursor);
+
+/* lazyfree.c -- Lazy freeing API */
+size_t lazyfreeGetFreeEffort(robj *obj);
+int dbAsyncDelete(redisDb *db, robj *key);
+long long emptyDbAsync(redisDb *db);
+size_t lazyfreeGetPendingObjectsCount(void);
+void lazyfreeFreeObjectFromBioThread(robj *o);
+void lazyfreeFreeDatabaseFromBioThread(dict *ht1, dict *ht2);
 
 /* API to get key arguments from commands */
 #define REDIS_GETKEYS_ALL 0
@@ -1449,6 +1764,7 @@ void setexCommand(redisClient *c);
 void psetexCommand(redisClient *c);
 void getCommand(redisClient *c);
 void delCommand(redisClient *c);
+void unlinkCommand(redisClient *c);
 void existsCommand(redisClient *c);
 void setbitCommand(redisClient *c);
 void getbitCommand(redisClient *c);
@@ -1462,6 +1778,7 @@ void incrbyfloatCommand(redisClient *c);
 void selectCommand(redisClient *c);
 void randomkeyCommand(redisClient *c);
 void keysCommand(redisClient *c);
+void scanCommand(redisClient *c);
 void dbsizeCommand(redisClient *c);
 void lastsaveCommand(redisClient *c);
 void saveCommand(redisClient *c);
@@ -1492,6 +1809,7 @@ void scardCommand(redisClient *c);
 void spopCommand(redisClient *c);
 void srandmemberCommand(redisClient *c);
 void sinterCommand(redisClient *c);
+void sscanCommand(redisClient *c);
 void sinterstoreCommand(redisClient *c);
 void sunionCommand(redisClient *c);
 void sunionstoreCommand(redisClient *c);
@@ -1521,6 +1839,7 @@ void msetnxCommand(redisClient *c);
 void zaddCommand(redisClient *c);
 void zincrbyCommand(redisClient *c);
 void zrangeCommand(redisClient *c);
+void zscanCommand(redisClient *c);
 void zrangebyscoreCommand(redisClient *c);
 void zrevrangebyscoreCommand(redisClient *c);
 void zcountCommand(redisClient *c);
@@ -1552,6 +1871,7 @@ void zinterstoreCommand(redisClient *c);
 void hkeysCommand(redisClient *c);
 void hvalsCommand(redisClient *c);
 void hgetallCommand(redisClient *c);
+void hscanCommand(redisClient *c);
 void hexistsCommand(redisClient *c);
 void configCommand(redisClient *c);
 void hincrbyCommand(redisClient *c);
@@ -1576,6 +1896,7 @@ void scriptCommand(redisClient *c);
 void timeCommand(redisClient *c);
 void bitopCommand(redisClient *c);
 void bitcountCommand(redisClient *c);
+void bitposCommand(redisClient *c);
 void replconfCommand(redisClient *c);
 
 #if defined(__GNUC__)
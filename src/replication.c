@@ -37,38 +37,220 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 
+/* --------------------------- BACKLOG HANDLING ----------------------------- */
+
+/* The replication backlog is a circular buffer holding the most recent part
+ * of the replication stream. Every byte sent to the slaves advances the
+ * global replication offset (server.master_repl_offset), so that a slave
+ * that was disconnected for a short time can ask, with PSYNC, to continue
+ * from the offset it already processed, instead of performing a full
+ * resynchronization.
+ *
+ * 复制积压缓冲区是一个环形缓冲区，保存着最近发送给附属节点的复制流。
+ * 每个发送给附属节点的字节都会增加全局复制偏移量，
+ * 这样，短暂断线的附属节点就可以通过 PSYNC 从它已处理的偏移量继续复制，
+ * 而不必执行完整重同步。 */
+
+/*
+ * 创建复制积压缓冲区
+ */
+void createReplicationBacklog(void) {
+    redisAssert(server.repl_backlog == NULL);
+    server.repl_backlog = zmalloc(server.repl_backlog_size);
+    server.repl_backlog_histlen = 0;
+    server.repl_backlog_idx = 0;
+    /* When a new backlog buffer is created, we increment the replication
+     * offset by one to make sure we'll not be able to PSYNC with any
+     * previous slave. This is needed because we avoid incrementing the
+     * master_repl_offset if no backlog exists nor slaves are attached. */
+    // 将偏移量加一，保证之前的附属节点不能在新的缓冲区上执行 PSYNC
+    server.master_repl_offset++;
+
+    /* We don't have any data inside our buffer, but virtually the first
+     * byte we have is the next byte that will be generated for the
+     * replication stream. */
+    server.repl_backlog_off = server.master_repl_offset+1;
+}
+
+/* This function is called when the user modifies the replication backlog
+ * size at runtime. It is up to the function to both update the
+ * server.repl_backlog_size and to resize the buffer and setup it so that
+ * it contains the same data as the previous one (possibly less data, but
+ * the most recent bytes, or the same data and more free space in case the
+ * buffer is enlarged).
+ *
+ * 在运行时修改积压缓冲区的大小。
+ * 为了简单起见，缓冲区中已有的数据会被丢弃。
+ */
+void resizeReplicationBacklog(long long newsize) {
+    if (newsize < REDIS_REPL_BACKLOG_MIN_SIZE)
+        newsize = REDIS_REPL_BACKLOG_MIN_SIZE;
+    if (server.repl_backlog_size == newsize) return;
+
+    server.repl_backlog_size = newsize;
+    if (server.repl_backlog != NULL) {
+        /* What we actually do is to flush the old buffer and realloc a new
+         * empty one. It will refill with new data incrementally.
+         * The reason is that copying a few gigabytes adds latency and even
+         * worse often we need to alloc additional space before freeing the
+         * old buffer. */
+        zfree(server.repl_backlog);
+        server.repl_backlog = zmalloc(server.repl_backlog_size);
+        server.repl_backlog_histlen = 0;
+        server.repl_backlog_idx = 0;
+        /* Next byte we have is... the next since the buffer is emtpy. */
+        server.repl_backlog_off = server.master_repl_offset+1;
+    }
+}
+
+/*
+ * 释放复制积压缓冲区
+ */
+void freeReplicationBacklog(void) {
+    redisAssert(server.repl_backlog != NULL);
+    zfree(server.repl_backlog);
+    server.repl_backlog = NULL;
+}
+
+/* Add data to the replication backlog.
+ * This function also increments the global replication offset stored at
+ * server.master_repl_offset, because there is no case where we want to feed
+ * the backlog without incrementing the buffer.
+ *
+ * 将数据添加到复制积压缓冲区，并增加全局复制偏移量。
+ *
+ * T = O(N)
+ */
+void feedReplicationBacklog(void *ptr, size_t len) {
+    unsigned char *p = ptr;
+
+    server.master_repl_offset += len;
+
+    /* This is a circular buffer, so write as much data we can at every
+     * iteration and rewind the "idx" index if we reach the limit. */
+    while(len) {
+        size_t thislen = server.repl_backlog_size - server.repl_backlog_idx;
+        if (thislen > len) thislen = len;
+        memcpy(server.repl_backlog+server.repl_backlog_idx,p,thislen);
+        server.repl_backlog_idx += thislen;
+        if (server.repl_backlog_idx == server.repl_backlog_size)
+            server.repl_backlog_idx = 0;
+        len -= thislen;
+        p += thislen;
+        server.repl_backlog_histlen += thislen;
+    }
+    if (server.repl_backlog_histlen > server.repl_backlog_size)
+        server.repl_backlog_histlen = server.repl_backlog_size;
+    /* Set the offset of the first byte we have in the backlog. */
+    server.repl_backlog_off = server.master_repl_offset -
+                              server.repl_backlog_histlen + 1;
+}
+
+/* Wrapper for feedReplicationBacklog() that takes Redis string objects
+ * as input.
+ *
+ * 将字符串对象作为批量回复的格式添加到积压缓冲区 */
+void feedReplicationBacklogWithObject(robj *o) {
+    char llstr[REDIS_LONGSTR_SIZE];
+    void *p;
+    size_t len;
+
+    if (o->encoding == REDIS_ENCODING_INT) {
+        len = ll2string(llstr,sizeof(llstr),(long)o->ptr);
+        p = llstr;
+    } else {
+        len = sdslen(o->ptr);
+        p = o->ptr;
+    }
+    feedReplicationBacklog(p,len);
+}
+
 /* ---------------------------------- MASTER -------------------------------- */
 
+/*
+ * 将命令传播给附属节点，同时写入复制积压缓冲区
+ *
+ * 所有附属节点共享同一个复制流，所以最后选择的数据库记录在
+ * server.slaveseldb 中，而不是每个附属节点各自记录。
+ */
 void replicationFeedSlaves(list *slaves, int dictid, robj **argv, int argc) {
     listNode *ln;
     listIter li;
-    int j;
+    int j, len;
+
+    /* If there aren't slaves, and there is no backlog buffer to populate,
+     * we have no reason to proceed. */
+    if (server.repl_backlog == NULL && listLength(slaves) == 0) return;
+
+    /* We can't have slaves attached and no backlog. */
+    redisAssert(!(listLength(slaves) != 0 && server.repl_backlog == NULL));
+
+    /* Send SELECT command to every slave if needed. */
+    if (server.slaveseldb != dictid) {
+        robj *selectcmd;
+
+        if (dictid >= 0 && dictid < REDIS_SHARED_SELECT_CMDS) {
+            selectcmd = shared.select[dictid];
+            incrRefCount(selectcmd);
+        } else {
+            selectcmd = createObject(REDIS_STRING,
+                sdscatprintf(sdsempty(),"select %d\r\n",dictid));
+        }
+
+        /* Add the SELECT command into the backlog. */
+        if (server.repl_backlog) feedReplicationBacklogWithObject(selectcmd);
 
+        /* Send it to slaves. */
+        listRewind(slaves,&li);
+        while((ln = listNext(&li))) {
+            redisClient *slave = ln->value;
+            // 不要向还在等待 BGSAVE 开始的附属节点发送命令
+            if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START) continue;
+            addReply(slave,selectcmd);
+        }
+        decrRefCount(selectcmd);
+    }
+    server.slaveseldb = dictid;
+
+    /* Write the command to the replication backlog if any. */
+    if (server.repl_backlog) {
+        char aux[REDIS_LONGSTR_SIZE+3];
+
+        /* Add the multi bulk reply length. */
+        aux[0] = '*';
+        len = ll2string(aux+1,sizeof(aux)-1,argc);
+        aux[len+1] = '\r';
+        aux[len+2] = '\n';
+        feedReplicationBacklog(aux,len+3);
+
+        for (j = 0; j < argc; j++) {
+            long objlen = stringObjectLen(argv[j]);
+
+            /* We need to feed the buffer with the object as a bulk reply
+             * not just as a plain string, so create the $..CRLF payload len
+             * ad add the final CRLF */
+            aux[0] = '$';
+            len = ll2string(aux+1,sizeof(aux)-1,objlen);
+            aux[len+1] = '\r';
+            aux[len+2] = '\n';
+            feedReplicationBacklog(aux,len+3);
+            feedReplicationBacklogWithObject(argv[j]);
+            feedReplicationBacklog(aux+len+1,2);
+        }
+    }
+
+    /* Write the command to every slave. */
     listRewind(slaves,&li);
     while((ln = listNext(&li))) {
         redisClient *slave = ln->value;
 
         /* Don't feed slaves that are still waiting for BGSAVE to start */
-        // 不要向还在等待 BGSAVE 的附属节点发送命令
+        // 不要向还在等待 BGSAVE 开始的附属节点发送命令
         if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START) continue;
 
         /* Feed slaves that are waiting for the initial SYNC (so these commands
          * are queued in the output buffer until the intial SYNC completes),
          * or are already in sync with the master. */
-        if (slave->slaveseldb != dictid) {
-            robj *selectcmd;
-
-            if (dictid >= 0 && dictid < REDIS_SHARED_SELECT_CMDS) {
-                selectcmd = shared.select[dictid];
-                incrRefCount(selectcmd);
-            } else {
-                selectcmd = createObject(REDIS_STRING,
-                    sdscatprintf(sdsempty(),"select %d\r\n",dictid));
-            }
-            addReply(slave,selectcmd);
-            decrRefCount(selectcmd);
-            slave->slaveseldb = dictid;
-        }
         addReplyMultiBulkLen(slave,argc);
         for (j = 0; j < argc; j++) addReplyBulk(slave,argv[j]);
     }
@@ -115,9 +297,159 @@ void replicationFeedMonitors(redisClient *c, list *monitors, int dictid, robj **
     decrRefCount(cmdobj);
 }
 
-/*
- * 
+/* Feed the slave 'c' with the replication backlog starting from the
+ * specified 'offset' up to the end of the backlog.
+ *
+ * 将积压缓冲区中从 offset 开始直到末尾的数据发送给附属节点 c 。
+ *
+ * T = O(N)
  */
+long long addReplyReplicationBacklog(redisClient *c, long long offset) {
+    long long j, skip, len;
+
+    if (server.repl_backlog_histlen == 0) return 0;
+
+    /* Compute the amount of bytes we need to discard. */
+    skip = offset - server.repl_backlog_off;
+
+    /* Point j to the oldest byte, that is actaully our
+     * server.repl_backlog_off byte. */
+    j = (server.repl_backlog_idx +
+        (server.repl_backlog_size-server.repl_backlog_histlen)) %
+        server.repl_backlog_size;
+
+    /* Discard the amount of data to seek to the specified 'offset'. */
+    j = (j + skip) % server.repl_backlog_size;
+
+    /* Feed slave with data. Since it is a circular buffer we have to
+     * split the reply in two parts if we are cross-boundary. */
+    len = server.repl_backlog_histlen - skip;
+    while(len) {
+        long long thislen =
+            ((server.repl_backlog_size - j) < len) ?
+            (server.repl_backlog_size - j) : len;
+
+        addReplySds(c,sdsnewlen(server.repl_backlog + j, thislen));
+        len -= thislen;
+        j = 0;
+    }
+    return server.repl_backlog_histlen - skip;
+}
+
+/* Send the FULLRESYNC reply to a slave that is going to receive a full
+ * resynchronization, and remember the replication offset the RDB file
+ * will correspond to.
+ *
+ * The reply is written directly to the socket since the output buffer of
+ * the slave is used to accumulate the commands to send after the RDB file.
+ * Slaves that don't understand PSYNC only get the bulk payload.
+ *
+ * 向即将执行完整重同步的附属节点发送 FULLRESYNC 回复，
+ * 并记录 RDB 文件对应的复制偏移量。
+ *
+ * 因为附属节点的输出缓冲区用于积累 RDB 之后要发送的命令，
+ * 所以这个回复直接写入套接字。
+ *
+ * Returns REDIS_ERR if the slave was scheduled for closing. */
+int replicationSetupSlaveForFullResync(redisClient *slave, long long offset) {
+    char buf[128];
+    int buflen;
+
+    slave->psync_initoffset = offset;
+
+    /* We are going to accumulate the incremental changes for this
+     * slave as well. Set slaveseldb to -1 in order to force to re-emit
+     * a SELECT statement in the replication stream. */
+    server.slaveseldb = -1;
+
+    /* Don't send this reply to slaves that approached us with
+     * the old SYNC command. */
+    if (!(slave->flags & REDIS_PRE_PSYNC)) {
+        buflen = snprintf(buf,sizeof(buf),"+FULLRESYNC %s %lld\r\n",
+                          server.runid,offset);
+        if (write(slave->fd,buf,buflen) != buflen) {
+            freeClientAsync(slave);
+            return REDIS_ERR;
+        }
+    }
+    return REDIS_OK;
+}
+
+/* This function handles the PSYNC command from the point of view of a
+ * master receiving a request for partial resynchronization.
+ *
+ * 以主节点的角度处理 PSYNC 命令。
+ *
+ * On success return REDIS_OK, otherwise REDIS_ERR is returned and we proceed
+ * with the usual full resync.
+ *
+ * 部分重同步成功时返回 REDIS_OK ，
+ * 否则返回 REDIS_ERR ，由调用者执行完整重同步。 */
+int masterTryPartialResynchronization(redisClient *c) {
+    long long psync_offset, psync_len;
+    char *master_runid = c->argv[1]->ptr;
+    char buf[128];
+    int buflen;
+
+    /* Is the runid of this master the same advertised by the wannabe slave
+     * via PSYNC? If runid changed this master is a different instance and
+     * there is no way to continue. */
+    // 运行 ID 不同，说明附属节点之前复制的不是本实例（或本实例已经重启）
+    if (strcasecmp(master_runid, server.runid)) {
+        /* Run id "?" is used by slaves that want to force a full resync. */
+        if (master_runid[0] != '?') {
+            redisLog(REDIS_NOTICE,"Partial resynchronization not accepted: "
+                "Runid mismatch (Client asked for '%s', I'm '%s')",
+                master_runid, server.runid);
+        } else {
+            redisLog(REDIS_NOTICE,"Full resync requested by slave.");
+        }
+        goto need_full_resync;
+    }
+
+    /* We still have the data our slave is asking for? */
+    // 积压缓冲区中是否还保存着附属节点需要的数据？
+    if (getLongLongFromObjectOrReply(c,c->argv[2],&psync_offset,NULL) !=
+       REDIS_OK) goto need_full_resync;
+    if (!server.repl_backlog ||
+        psync_offset < server.repl_backlog_off ||
+        psync_offset > (server.repl_backlog_off + server.repl_backlog_histlen))
+    {
+        redisLog(REDIS_NOTICE,
+            "Unable to partial resync with the slave for lack of backlog (Slave request was: %lld).", psync_offset);
+        goto need_full_resync;
+    }
+
+    /* If we reached this point, we are able to perform a partial resync:
+     * 1) Set client state to make it a slave.
+     * 2) Inform the client we can continue with +CONTINUE
+     * 3) Send the backlog data (from the offset to the end) to the slave. */
+    c->flags |= REDIS_SLAVE;
+    c->replstate = REDIS_REPL_ONLINE;
+    c->repldbfd = -1;
+    listAddNodeTail(server.slaves,c);
+    /* We can't use the connection buffers since they are used to accumulate
+     * new commands at this stage. But we are sure the socket send buffer is
+     * emtpy so this write will never fail actually. */
+    buflen = snprintf(buf,sizeof(buf),"+CONTINUE\r\n");
+    if (write(c->fd,buf,buflen) != buflen) {
+        freeClientAsync(c);
+        return REDIS_OK;
+    }
+    psync_len = addReplyReplicationBacklog(c,psync_offset);
+    redisLog(REDIS_NOTICE,
+        "Partial resynchronization request accepted. Sending %lld bytes of backlog starting from offset %lld.", psync_len, psync_offset);
+    return REDIS_OK; /* The caller can return, no full resync needed. */
+
+need_full_resync:
+    /* We need a full resync for some reason... the caller will send the
+     * +FULLRESYNC reply once the offset of the RDB file is known. */
+    return REDIS_ERR;
+}
+
+/* SYNC ad PSYNC command implemenation.
+ *
+ * SYNC 和 PSYNC 命令的实现 */
 void syncCommand(redisClient *c) {
     /* ignore SYNC if aleady slave or in monitor mode */
     // 客户端已经是附属节点时，直接返回
@@ -143,10 +475,50 @@ void syncCommand(redisClient *c) {
 
     redisLog(REDIS_NOTICE,"Slave ask for synchronization");
 
+    /* Try a partial resynchronization if this is a PSYNC command.
+     * If it fails, we continue with usual full resynchronization, however
+     * when this happens masterTryPartialResynchronization() already
+     * replied with:
+     *
+     * +FULLRESYNC <runid> <offset>
+     *
+     * So the slave knows the new runid and offset to try a PSYNC later
+     * if the connection with the master is lost. */
+    // 尝试执行部分重同步，失败的话执行完整重同步
+    if (!strcasecmp(c->argv[0]->ptr,"psync")) {
+        if (masterTryPartialResynchronization(c) == REDIS_OK) {
+            server.stat_sync_partial_ok++;
+            return; /* No full resync needed, return. */
+        } else {
+            char *master_runid = c->argv[1]->ptr;
+
+            /* Increment stats for failed PSYNCs, but only if the
+             * runid is not "?", as this is used by slaves to force a full
+             * resync on purpose when they are not albe to partially
+             * resync. */
+            if (master_runid[0] != '?') server.stat_sync_partial_err++;
+        }
+    } else {
+        /* If a slave uses SYNC, we are dealing with an old implementation
+         * of the replication protocol (like redis-cli --slave). Flag the client
+         * so that we don't expect to receive REPLCONF ACK feedbacks. */
+        c->flags |= REDIS_PRE_PSYNC;
+    }
+
+    /* Full resynchronization. */
+    server.stat_sync_full++;
+
+    /* Create the replication backlog before the offset of the RDB file is
+     * taken, since creating it advances the replication offset. */
+    // 第一个附属节点连接时创建复制积压缓冲区
+    if (server.repl_backlog == NULL) createReplicationBacklog();
+
     /* Here we need to check if there is a background saving operation
      * in progress, or if it is required to start one */
     // 检查是否已经有 BGSAVE 在执行，否则就创建一个新的 BGSAVE 任务
-    if (server.rdb_child_pid != -1) {
+    if (server.rdb_child_pid != -1 &&
+        server.rdb_child_type == REDIS_RDB_CHILD_TYPE_DISK)
+    {
         /* Ok a background save is in progress. Let's check if it is a good
          * one for replication, i.e. if there is another slave that is
          * registering differences since the server forked to save */
@@ -166,8 +538,11 @@ void syncCommand(redisClient *c) {
              * another slave. Set the right state, and copy the buffer. */
             // 找到一个同样在等到 SYNC 的客户端
             // 设置当前客户端的状态，并复制 buffer 。
+            // 两者共用同一个 RDB 文件，所以复制偏移量也相同
             copyClientOutputBuffer(c,slave);
             c->replstate = REDIS_REPL_WAIT_BGSAVE_END;
+            if (replicationSetupSlaveForFullResync(c,slave->psync_initoffset)
+                == REDIS_ERR) return;
             redisLog(REDIS_NOTICE,"Waiting for end of BGSAVE for SYNC");
         } else {
             /* No way, we need to wait for the next BGSAVE in order to
@@ -176,6 +551,22 @@ void syncCommand(redisClient *c) {
             c->replstate = REDIS_REPL_WAIT_BGSAVE_START;
             redisLog(REDIS_NOTICE,"Waiting for next BGSAVE for SYNC");
         }
+    } else if (server.rdb_child_pid != -1) {
+        /* A diskless transfer is in progress: its child already has the set
+         * of sockets it writes to, so we need to wait for the next one. */
+        // 正在进行无盘传送，只能等待下次 BGSAVE
+        c->replstate = REDIS_REPL_WAIT_BGSAVE_START;
+        redisLog(REDIS_NOTICE,"Waiting for next BGSAVE for SYNC");
+    } else if (server.repl_diskless_sync &&
+               (c->slave_capa & REDIS_SLAVE_CAPA_EOF))
+    {
+        /* Diskless replication: don't start the BGSAVE right now, so that
+         * more slaves arriving in the next seconds can share the same
+         * transfer. replicationCron() starts it after
+         * repl-diskless-sync-delay seconds. */
+        // 无盘复制：延迟启动 BGSAVE ，让之后到达的附属节点共用同一次传送
+        c->replstate = REDIS_REPL_WAIT_BGSAVE_START;
+        redisLog(REDIS_NOTICE,"Delay next BGSAVE for diskless SYNC");
     } else {
         // 没有 BGSAVE 在进行，自己启动一个。
         /* Ok we don't have a BGSAVE in progress, let's start one */
@@ -187,10 +578,11 @@ void syncCommand(redisClient *c) {
         }
         // 等待 BGSAVE 结束
         c->replstate = REDIS_REPL_WAIT_BGSAVE_END;
+        if (replicationSetupSlaveForFullResync(c,server.master_repl_offset)
+            == REDIS_ERR) return;
     }
     c->repldbfd = -1;
     c->flags |= REDIS_SLAVE;
-    c->slaveseldb = 0;
     listAddNodeTail(server.slaves,c);
 
     return;
@@ -200,14 +592,12 @@ void syncCommand(redisClient *c) {
  * This command is used by a slave in order to configure the replication
  * process before starting it with the SYNC command.
  *
- * Currently the only use of this command is to communicate to the master
- * what is the listening port of the Slave redis instance, so that the
- * master can accurately list slaves and their listening ports in
- * the INFO output.
- *
- * In the future the same command can be used in order to configure
- * the replication to initiate an incremental replication instead of a
- * full resync. */
+ * Currently it is used to communicate to the master what is the listening
+ * port of the Slave redis instance, so that the master can accurately list
+ * slaves and their listening ports in the INFO output, and the capabilities
+ * of the slave with "capa <name>": a slave announcing "capa eof" is able to
+ * receive the RDB payload in the streamed EOF-mark format used by diskless
+ * replication. */
 void replconfCommand(redisClient *c) {
     int j;
 
@@ -227,6 +617,10 @@ void replconfCommand(redisClient *c) {
                     &port,NULL) != REDIS_OK))
                 return;
             c->slave_listening_port = port;
+        } else if (!strcasecmp(c->argv[j]->ptr,"capa")) {
+            /* Ignore capabilities not understood by this master. */
+            if (!strcasecmp(c->argv[j+1]->ptr,"eof"))
+                c->slave_capa |= REDIS_SLAVE_CAPA_EOF;
         } else {
             addReplyErrorFormat(c,"Unrecognized REPLCONF option: %s",
                 (char*)c->argv[j]->ptr);
@@ -314,24 +708,75 @@ void sendBulkToSlave(aeEventLoop *el, int fd, void *privdata, int mask) {
     }
 }
 
+/* Start a BGSAVE for replication, serving all the slaves in
+ * WAIT_BGSAVE_START state. The RDB is written to the slaves sockets if
+ * diskless replication is enabled and all the waiting slaves are able to
+ * parse the EOF-mark format (mincapa is the bitwise AND of their
+ * capabilities), otherwise it is written to disk as usual.
+ *
+ * On failure the waiting slaves are freed and REDIS_ERR is returned.
+ *
+ * 为复制启动一次 BGSAVE ，服务所有处于 WAIT_BGSAVE_START 状态的附属节点。
+ * 开启了无盘复制，并且所有等待的附属节点都支持 EOF 格式时，
+ * RDB 直接写入到附属节点的套接字，否则写入到磁盘。 */
+int startBgsaveForReplication(int mincapa) {
+    int retval;
+    int socket_target = server.repl_diskless_sync &&
+                        (mincapa & REDIS_SLAVE_CAPA_EOF);
+    listNode *ln;
+    listIter li;
+
+    redisLog(REDIS_NOTICE,"Starting BGSAVE for SYNC with target: %s",
+        socket_target ? "slaves sockets" : "disk");
+
+    if (socket_target)
+        retval = rdbSaveToSlavesSockets();
+    else
+        retval = rdbSaveBackground(server.rdb_filename);
+
+    listRewind(server.slaves,&li);
+    while((ln = listNext(&li))) {
+        redisClient *slave = ln->value;
+
+        if (slave->replstate != REDIS_REPL_WAIT_BGSAVE_START) continue;
+        if (retval == REDIS_ERR) {
+            // BGSAVE 启动失败，释放所有等待它的附属节点
+            freeClient(slave);
+        } else if (!socket_target) {
+            /* Now that the BGSAVE started, the slaves that were waiting for
+             * it know the offset their RDB file corresponds to. Slaves served
+             * by a socket target were already set up before the fork. */
+            // BGSAVE 已经开始，通知等待它的附属节点 RDB 对应的复制偏移量
+            slave->replstate = REDIS_REPL_WAIT_BGSAVE_END;
+            replicationSetupSlaveForFullResync(slave,server.master_repl_offset);
+        }
+    }
+    if (retval == REDIS_ERR)
+        redisLog(REDIS_WARNING,"SYNC failed. BGSAVE failed");
+    return retval;
+}
+
 /* This function is called at the end of every backgrond saving.
  * 
  * 这个函数在每次 BGSAVE 执行之后被调用。
  *
  * The argument bgsaveerr is REDIS_OK if the background saving succeeded
  * otherwise REDIS_ERR is passed to the function.
+ * The 'type' argument is the type of the child that terminated
+ * (if it had a disk or socket target).
  *
  * 如果 BGSAVE 执行成功，那么 bgsaveerr 参数的值为 REDIS_OK ，
- * 否则为 REDIS_ERR 。
+ * 否则为 REDIS_ERR 。 type 参数是结束的子进程的类型（磁盘或套接字）。
  *
  * The goal of this function is to handle slaves waiting for a successful
  * background saving in order to perform non-blocking synchronization. 
  *
  * 这个函数用于实现附属节点的非阻塞同步。
  */
-void updateSlavesWaitingBgsave(int bgsaveerr) {
+void updateSlavesWaitingBgsave(int bgsaveerr, int type) {
     listNode *ln;
     int startbgsave = 0;
+    int mincapa = -1;
     listIter li;
 
     // 遍历所有附属节点
@@ -340,9 +785,10 @@ void updateSlavesWaitingBgsave(int bgsaveerr) {
         redisClient *slave = ln->value;
 
         if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START) {
-            // 告诉那些这次不能同步的客户端，可以等待下次 BGSAVE 了。
+            // 这些附属节点需要等待下次 BGSAVE
             startbgsave = 1;
-            slave->replstate = REDIS_REPL_WAIT_BGSAVE_END;
+            mincapa = (mincapa == -1) ? slave->slave_capa :
+                                        (mincapa & slave->slave_capa);
         } else if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_END) {
             // 这些是本次可以同步的客户端
 
@@ -354,6 +800,22 @@ void updateSlavesWaitingBgsave(int bgsaveerr) {
                 redisLog(REDIS_WARNING,"SYNC failed. BGSAVE child returned an error");
                 continue;
             }
+
+            /* With a socket target the payload was already streamed by the
+             * child, so the slave can start receiving the replication stream
+             * accumulated in its output buffer. */
+            // 无盘传送已经由子进程完成，附属节点直接上线
+            if (type == REDIS_RDB_CHILD_TYPE_SOCKET) {
+                slave->replstate = REDIS_REPL_ONLINE;
+                if (aeCreateFileEvent(server.el, slave->fd, AE_WRITABLE,
+                    sendReplyToClient, slave) == AE_ERR) {
+                    freeClient(slave);
+                    continue;
+                }
+                redisLog(REDIS_NOTICE,"Streamed RDB transfer with slave succeeded (socket)");
+                continue;
+            }
+
             // 打开 .rdb 文件
             if ((slave->repldbfd = open(server.rdb_filename,O_RDONLY)) == -1 ||
                 // 如果打开失败，释放并清除
@@ -378,26 +840,133 @@ void updateSlavesWaitingBgsave(int bgsaveerr) {
         }
     }
 
-    // 有客户端没有在这次 BGSAVE 中成功同步
-    if (startbgsave) {
-        // 再启动一次 BGSAVE
-        if (rdbSaveBackground(server.rdb_filename) != REDIS_OK) {
-            // 如果 BGSAVE 失败，清空附属节点
-            listIter li;
+    // 有附属节点没有在这次 BGSAVE 中同步，再启动一次 BGSAVE
+    if (startbgsave) startBgsaveForReplication(mincapa);
+}
 
-            listRewind(server.slaves,&li);
-            redisLog(REDIS_WARNING,"SYNC failed. BGSAVE failed");
-            while((ln = listNext(&li))) {
-                redisClient *slave = ln->value;
+/* ----------------------------------- SLAVE -------------------------------- */
 
-                if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START)
-                    freeClient(slave);
-            }
-        }
+/* In order to implement partial synchronization we need to be able to cache
+ * our master's client structure after a transient disconnection.
+ * It is cached into server.cached_master and flushed away using the following
+ * functions.
+ *
+ * 为了实现部分重同步，主节点在短暂断线之后，
+ * 它的客户端结构会被缓存到 server.cached_master 中。 */
+
+/* This function is called by freeClient() in order to cache the master
+ * client structure instead of destryoing it. freeClient() will return
+ * ASAP after this function returns, so every action needed to avoid problems
+ * with a client that is really "suspended" has to be done by this function.
+ *
+ * 由 freeClient() 调用，缓存主节点而不是释放它。
+ *
+ * The other functions that will deal with the cached master are:
+ *
+ * replicationDiscardCachedMaster() that will make sure to kill the client
+ * as for some reason we don't want to use it in the future.
+ *
+ * replicationResurrectCachedMaster() that is used after a successful PSYNC
+ * handshake in order to reactivate the cached master.
+ */
+void replicationCacheMaster(redisClient *c) {
+    listNode *ln;
+
+    redisAssert(server.master != NULL && server.cached_master == NULL);
+    redisLog(REDIS_NOTICE,"Caching the disconnected master state.");
+
+    /* Remove from the list of clients, we don't want this client to be
+     * listed by CLIENT LIST or processed in any way by batch operations. */
+    ln = listSearchKey(server.clients,c);
+    redisAssert(ln != NULL);
+    listDelNode(server.clients,ln);
+
+    /* Save the master. Server.master will be set to null later by
+     * replicationHandleMasterDisconnection(). */
+    server.cached_master = server.master;
+
+    /* Remove the event handlers and close the socket. We'll later reuse
+     * the socket of the new connection with the master during PSYNC. */
+    aeDeleteFileEvent(server.el,c->fd,AE_READABLE);
+    aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+    close(c->fd);
+
+    /* Set fd to -1 so that we can safely call freeClient(c) later. */
+    c->fd = -1;
+
+    /* Discard the unprocessed part of the query buffer and of the half
+     * parsed command: the master will send them again starting from
+     * c->reploff+1. Replies to the master are never sent anyway. */
+    // 丢弃未处理的查询缓存和回复，主节点会从 reploff+1 开始重新发送
+    sdsclear(c->querybuf);
+    freeClientArgv(c);
+    resetClientParser(c);
+    c->read_reploff = c->reploff;
+    c->bufpos = 0;
+    c->sentlen = 0;
+    while(listLength(c->reply)) listDelNode(c->reply,listFirst(c->reply));
+    c->reply_bytes = 0;
+
+    /* Caching the master happens instead of the actual freeClient() call,
+     * so make sure to adjust the replication state as needed. */
+    replicationHandleMasterDisconnection();
+}
+
+/* Free a cached master, called when there are no longer the conditions for
+ * a partial resync on reconnection.
+ *
+ * 释放缓存的主节点，在不可能执行部分重同步时调用。 */
+void replicationDiscardCachedMaster(void) {
+    if (server.cached_master == NULL) return;
+
+    redisLog(REDIS_NOTICE,"Discarding previously cached master state.");
+    server.cached_master->flags &= ~REDIS_MASTER;
+    freeClient(server.cached_master);
+    server.cached_master = NULL;
+}
+
+/* Turn the cached master into the current master, using the file descriptor
+ * passed as argument as the socket for the new master.
+ *
+ * This funciton is called when successfully setup a partial resynchronization
+ * so the stream of data that we'll receive will start from were this
+ * master left.
+ *
+ * 部分重同步成功之后，使用新的套接字 newfd 将缓存的主节点恢复为当前主节点，
+ * 之后收到的复制流会从主节点断线时的位置继续。 */
+void replicationResurrectCachedMaster(int newfd) {
+    server.master = server.cached_master;
+    server.cached_master = NULL;
+    server.master->fd = newfd;
+    server.master->flags &= ~(REDIS_CLOSE_AFTER_REPLY|REDIS_CLOSE_ASAP);
+    server.master->authenticated = 1;
+    server.master->lastinteraction = server.unixtime;
+    server.repl_state = REDIS_REPL_CONNECTED;
+
+    /* Re-add to the list of clients. */
+    listAddNodeTail(server.clients,server.master);
+    if (aeCreateFileEvent(server.el, newfd, AE_READABLE,
+                          readQueryFromClient, server.master)) {
+        redisLog(REDIS_WARNING,"Error resurrecting the cached master, impossible to add the readable handler: %s", strerror(errno));
+        freeClientAsync(server.master); /* Close ASAP. */
     }
 }
 
-/* ----------------------------------- SLAVE -------------------------------- */
+/* This function is called when the connection with our master is lost,
+ * both when the master client is freed and when it is cached.
+ *
+ * 与主节点的连接断开时调用（无论主节点是被释放还是被缓存）。 */
+void replicationHandleMasterDisconnection(void) {
+    server.master = NULL;
+    server.repl_state = REDIS_REPL_CONNECT;
+    server.repl_down_since = server.unixtime;
+    /* We lost connection with our master, force our slaves to resync
+     * with us as well to load the new data set.
+     *
+     * If server.masterhost is NULL the user called SLAVEOF NO ONE so
+     * slave resync is not needed. */
+    if (server.masterhost != NULL) disconnectSlaves();
+}
 
 /* Abort the async download of the bulk dataset while SYNC-ing with master */
 void replicationAbortSyncTransfer(void) {
@@ -405,12 +974,155 @@ void replicationAbortSyncTransfer(void) {
 
     aeDeleteFileEvent(server.el,server.repl_transfer_s,AE_READABLE);
     close(server.repl_transfer_s);
-    close(server.repl_transfer_fd);
-    unlink(server.repl_transfer_tmpfile);
-    zfree(server.repl_transfer_tmpfile);
+    // 无盘载入时没有临时文件
+    if (server.repl_transfer_tmpfile) {
+        close(server.repl_transfer_fd);
+        unlink(server.repl_transfer_tmpfile);
+        zfree(server.repl_transfer_tmpfile);
+        server.repl_transfer_tmpfile = NULL;
+    }
     server.repl_state = REDIS_REPL_CONNECT;
 }
 
+/* Final setup of the slave <- master link after a successful full
+ * synchronization. 'leftover' holds bytes of the replication stream that
+ * were read from the socket together with the end of the RDB payload, if
+ * any: they are processed as if they were just read from the master.
+ *
+ * 完整同步成功之后，创建主节点客户端。
+ * leftover 是和 RDB 数据一起读入的复制流数据，会被当作主节点发来的命令执行。 */
+static void replicationFinishFullSync(sds leftover) {
+    server.master = createClient(server.repl_transfer_s);
+    server.master->flags |= REDIS_MASTER;
+    server.master->authenticated = 1;
+    server.repl_state = REDIS_REPL_CONNECTED;
+    // 记录主节点的运行 ID 和复制偏移量，供之后的 PSYNC 使用
+    server.master->reploff = server.repl_master_initial_offset;
+    server.master->read_reploff = server.master->reploff;
+    memcpy(server.master->replrunid, server.repl_master_runid,
+        sizeof(server.repl_master_runid));
+    /* If master offset is set to -1, this master is old and is not
+     * PSYNC capable, so we flag it accordingly. */
+    if (server.master->reploff == -1)
+        server.master->flags |= REDIS_PRE_PSYNC;
+    /* Our dataset was replaced, so the history in our own backlog no
+     * longer describes it: drop the backlog so that our slaves can't
+     * partially resync from it. A new one is created (advancing the
+     * replication offset) when a slave attaches again. */
+    // 数据集已经被替换，释放积压缓冲区，
+    // 防止本节点的附属节点从过时的历史中执行部分重同步
+    if (server.repl_backlog) freeReplicationBacklog();
+    redisLog(REDIS_NOTICE, "MASTER <-> SLAVE sync: Finished with success");
+    /* Restart the AOF subsystem now that we finished the sync. This
+     * will trigger an AOF rewrite, and when done will start appending
+     * to the new file. */
+    if (server.aof_state != REDIS_AOF_OFF) {
+        int retry = 10;
+
+        stopAppendOnly();
+        while (retry-- && startAppendOnly() == REDIS_ERR) {
+            redisLog(REDIS_WARNING,"Failed enabling the AOF after successful master synchrnization! Trying it again in one second.");
+            sleep(1);
+        }
+        if (!retry) {
+            redisLog(REDIS_WARNING,"FATAL: this slave instance finished the synchronization with its master, but the AOF can't be turned on. Exiting now.");
+            exit(1);
+        }
+    }
+
+    /* Process the part of the replication stream we already read. */
+    // 执行已经读入的复制流
+    if (leftover && sdslen(leftover)) {
+        server.master->querybuf = sdscatsds(server.master->querybuf,leftover);
+        server.master->read_reploff += sdslen(leftover);
+        server.current_client = server.master;
+        processInputBuffer(server.master);
+        server.current_client = NULL;
+    }
+}
+
+/* Load the RDB payload straight from the master socket, without writing
+ * it to a temp file first. The socket is read synchronously: the loading
+ * code serves the other clients from time to time as it does when loading
+ * from disk. If 'eofmark' is not NULL the payload is terminated by the
+ * mark, otherwise it is server.repl_transfer_size bytes long.
+ *
+ * 直接从主节点套接字载入 RDB 数据，不经过临时文件。 */
+static void readSyncBulkPayloadFromSocket(int fd, char *eofmark) {
+    rio rdb;
+    sds leftover;
+    int loaded;
+
+    /* We are going to read synchronously: the readable handler must be
+     * removed, otherwise rdbLoadRio() would call it recursively when it
+     * processes events from time to time. */
+    aeDeleteFileEvent(server.el,fd,AE_READABLE);
+
+    redisLog(REDIS_NOTICE, "MASTER <-> SLAVE sync: Loading DB in memory from socket");
+    emptyDb();
+    rioInitWithFd(&rdb,fd,eofmark ? 0 : server.repl_transfer_size,
+                  (long long)server.repl_timeout*1000);
+    startLoadingSize(eofmark ? 0 : server.repl_transfer_size);
+    loaded = (rdbLoadRio(&rdb) == REDIS_OK);
+    if (loaded && eofmark) {
+        char mark[REDIS_EOF_MARK_SIZE];
+
+        /* The mark is not part of the checksummed payload. */
+        rdb.update_cksum = NULL;
+        if (rioRead(&rdb,mark,REDIS_EOF_MARK_SIZE) == 0 ||
+            memcmp(mark,eofmark,REDIS_EOF_MARK_SIZE) != 0)
+        {
+            redisLog(REDIS_WARNING,"Missing or wrong EOF mark at the end of the payload from MASTER");
+            loaded = 0;
+        }
+    } else if (loaded && rioTell(&rdb) != server.repl_transfer_size) {
+        redisLog(REDIS_WARNING,"The RDB payload from MASTER is shorter than announced");
+        loaded = 0;
+    }
+    stopLoading();
+    leftover = rioFreeFd(&rdb);
+
+    if (!loaded) {
+        redisLog(REDIS_WARNING,"Failed trying to load the MASTER synchronization DB from socket: %s", strerror(errno));
+        /* Don't leave a partially loaded dataset around. */
+        emptyDb();
+        sdsfree(leftover);
+        replicationAbortSyncTransfer();
+        return;
+    }
+    server.repl_transfer_read = rioTell(&rdb);
+    replicationFinishFullSync(leftover);
+    sdsfree(leftover);
+}
+
+/* The whole payload was written to the temp file: load it and finish
+ * the synchronization.
+ *
+ * RDB 数据已经全部写入临时文件，载入它并完成同步。 */
+static void readSyncBulkPayloadDone(sds leftover) {
+    if (rename(server.repl_transfer_tmpfile,server.rdb_filename) == -1) {
+        redisLog(REDIS_WARNING,"Failed trying to rename the temp DB into dump.rdb in MASTER <-> SLAVE synchronization: %s", strerror(errno));
+        replicationAbortSyncTransfer();
+        return;
+    }
+    redisLog(REDIS_NOTICE, "MASTER <-> SLAVE sync: Loading DB in memory");
+    emptyDb();
+    /* Before loading the DB into memory we need to delete the readable
+     * handler, otherwise it will get called recursively since
+     * rdbLoad() will call the event loop to process events from time to
+     * time for non blocking loading. */
+    aeDeleteFileEvent(server.el,server.repl_transfer_s,AE_READABLE);
+    if (rdbLoad(server.rdb_filename) != REDIS_OK) {
+        redisLog(REDIS_WARNING,"Failed trying to load the MASTER synchronization DB from disk");
+        replicationAbortSyncTransfer();
+        return;
+    }
+    zfree(server.repl_transfer_tmpfile);
+    server.repl_transfer_tmpfile = NULL;
+    close(server.repl_transfer_fd);
+    replicationFinishFullSync(leftover);
+}
+
 /* Asynchronously read the SYNC payload we receive from a master */
 #define REPL_MAX_WRITTEN_BEFORE_FSYNC (1024*1024*8) /* 8 MB */
 void readSyncBulkPayload(aeEventLoop *el, int fd, void *privdata, int mask) {
@@ -421,6 +1133,16 @@ void readSyncBulkPayload(aeEventLoop *el, int fd, void *privdata, int mask) {
     REDIS_NOTUSED(privdata);
     REDIS_NOTUSED(mask);
 
+    /* Static vars used to hold the EOF mark, and the last bytes received
+     * from the server: when they match, we reached the end of the transfer.
+     *
+     * 使用 EOF 格式传送时，保存 EOF 标记，
+     * 以及最后收到的、可能属于 EOF 标记的那部分数据 */
+    static char eofmark[REDIS_EOF_MARK_SIZE];
+    static char lastbytes[REDIS_EOF_MARK_SIZE];
+    static int lastbyteslen = 0;
+    static int usemark = 0;
+
     /* If repl_transfer_size == -1 we still have to read the bulk length
      * from the master reply. */
     if (server.repl_transfer_size == -1) {
@@ -446,16 +1168,50 @@ void readSyncBulkPayload(aeEventLoop *el, int fd, void *privdata, int mask) {
             redisLog(REDIS_WARNING,"Bad protocol from MASTER, the first byte is not '$', are you sure the host and port are right?");
             goto error;
         }
-        server.repl_transfer_size = strtol(buf+1,NULL,10);
-        redisLog(REDIS_NOTICE,
-            "MASTER <-> SLAVE sync: receiving %ld bytes from master",
-            server.repl_transfer_size);
+
+        /* There are two possible forms for the bulk payload. One is the
+         * usual $<count> bulk format. The other is used for diskless
+         * transfers when the master does not know beforehand the size of the
+         * file to transfer. In the latter case, the following format is used:
+         *
+         * $EOF:<40 bytes delimiter>
+         *
+         * At the end of the file the announced delimiter is transmitted. The
+         * delimiter is long and random enough that the probability of a
+         * collision with the actual file content can be ignored. */
+        if (strncmp(buf+1,"EOF:",4) == 0 &&
+            strlen(buf+5) >= REDIS_EOF_MARK_SIZE)
+        {
+            usemark = 1;
+            memcpy(eofmark,buf+5,REDIS_EOF_MARK_SIZE);
+            lastbyteslen = 0;
+            /* Set any repl_transfer_size to avoid entering this code path
+             * at the next call. */
+            server.repl_transfer_size = 0;
+            redisLog(REDIS_NOTICE,
+                "MASTER <-> SLAVE sync: receiving streamed RDB from master");
+        } else {
+            usemark = 0;
+            server.repl_transfer_size = strtol(buf+1,NULL,10);
+            redisLog(REDIS_NOTICE,
+                "MASTER <-> SLAVE sync: receiving %ld bytes from master",
+                (long) server.repl_transfer_size);
+        }
+
+        /* Without a temp file the payload is loaded right now, straight
+         * from the socket. */
+        if (server.repl_transfer_tmpfile == NULL)
+            readSyncBulkPayloadFromSocket(fd,usemark ? eofmark : NULL);
         return;
     }
 
     /* Read bulk data */
-    left = server.repl_transfer_size - server.repl_transfer_read;
-    readlen = (left < (signed)sizeof(buf)) ? left : (signed)sizeof(buf);
+    if (usemark) {
+        readlen = sizeof(buf);
+    } else {
+        left = server.repl_transfer_size - server.repl_transfer_read;
+        readlen = (left < (signed)sizeof(buf)) ? left : (signed)sizeof(buf);
+    }
     nread = read(fd,buf,readlen);
     if (nread <= 0) {
         redisLog(REDIS_WARNING,"I/O error trying to sync with MASTER: %s",
@@ -464,11 +1220,57 @@ void readSyncBulkPayload(aeEventLoop *el, int fd, void *privdata, int mask) {
         return;
     }
     server.repl_transfer_lastio = server.unixtime;
-    if (write(server.repl_transfer_fd,buf,nread) != nread) {
-        redisLog(REDIS_WARNING,"Write error or short write writing to the DB dump file needed for MASTER <-> SLAVE synchronization: %s", strerror(errno));
-        goto error;
+
+    if (usemark) {
+        /* The master starts sending the replication stream as soon as the
+         * payload is transferred, so the mark is not necessarily at the end
+         * of what we read. The last bytes that may belong to a mark split
+         * across two reads are held back until more data arrives.
+         *
+         * 主节点在传送完 RDB 之后马上开始发送复制流，
+         * 所以 EOF 标记不一定位于读入数据的末尾。
+         * 可能属于 EOF 标记的最后几个字节会被暂时保留，直到读入更多数据。 */
+        sds data = sdsnewlen(lastbytes,lastbyteslen);
+        char *mark;
+        size_t towrite;
+        sds leftover = NULL;
+
+        data = sdscatlen(data,buf,nread);
+        mark = memmem(data,sdslen(data),eofmark,REDIS_EOF_MARK_SIZE);
+        if (mark) {
+            towrite = mark-data;
+            leftover = sdsnewlen(mark+REDIS_EOF_MARK_SIZE,
+                sdslen(data)-towrite-REDIS_EOF_MARK_SIZE);
+        } else {
+            towrite = (sdslen(data) > REDIS_EOF_MARK_SIZE) ?
+                      sdslen(data)-REDIS_EOF_MARK_SIZE : 0;
+            lastbyteslen = sdslen(data)-towrite;
+            memcpy(lastbytes,data+towrite,lastbyteslen);
+        }
+        if (towrite &&
+            write(server.repl_transfer_fd,data,towrite) != (ssize_t)towrite)
+        {
+            redisLog(REDIS_WARNING,"Write error or short write writing to the DB dump file needed for MASTER <-> SLAVE synchronization: %s", strerror(errno));
+            sdsfree(data);
+            sdsfree(leftover);
+            goto error;
+        }
+        sdsfree(data);
+        server.repl_transfer_read += towrite;
+        if (leftover) {
+            /* Transfer complete: the announced size is now known. */
+            server.repl_transfer_size = server.repl_transfer_read;
+            readSyncBulkPayloadDone(leftover);
+            sdsfree(leftover);
+            return;
+        }
+    } else {
+        if (write(server.repl_transfer_fd,buf,nread) != nread) {
+            redisLog(REDIS_WARNING,"Write error or short write writing to the DB dump file needed for MASTER <-> SLAVE synchronization: %s", strerror(errno));
+            goto error;
+        }
+        server.repl_transfer_read += nread;
     }
-    server.repl_transfer_read += nread;
 
     /* Sync data on disk from time to time, otherwise at the end of the transfer
      * we may suffer a big delay as the memory buffers are copied into the
@@ -484,50 +1286,8 @@ void readSyncBulkPayload(aeEventLoop *el, int fd, void *privdata, int mask) {
     }
 
     /* Check if the transfer is now complete */
-    if (server.repl_transfer_read == server.repl_transfer_size) {
-        if (rename(server.repl_transfer_tmpfile,server.rdb_filename) == -1) {
-            redisLog(REDIS_WARNING,"Failed trying to rename the temp DB into dump.rdb in MASTER <-> SLAVE synchronization: %s", strerror(errno));
-            replicationAbortSyncTransfer();
-            return;
-        }
-        redisLog(REDIS_NOTICE, "MASTER <-> SLAVE sync: Loading DB in memory");
-        emptyDb();
-        /* Before loading the DB into memory we need to delete the readable
-         * handler, otherwise it will get called recursively since
-         * rdbLoad() will call the event loop to process events from time to
-         * time for non blocking loading. */
-        aeDeleteFileEvent(server.el,server.repl_transfer_s,AE_READABLE);
-        if (rdbLoad(server.rdb_filename) != REDIS_OK) {
-            redisLog(REDIS_WARNING,"Failed trying to load the MASTER synchronization DB from disk");
-            replicationAbortSyncTransfer();
-            return;
-        }
-        /* Final setup of the connected slave <- master link */
-        zfree(server.repl_transfer_tmpfile);
-        close(server.repl_transfer_fd);
-        server.master = createClient(server.repl_transfer_s);
-        server.master->flags |= REDIS_MASTER;
-        server.master->authenticated = 1;
-        server.repl_state = REDIS_REPL_CONNECTED;
-        redisLog(REDIS_NOTICE, "MASTER <-> SLAVE sync: Finished with success");
-        /* Restart the AOF subsystem now that we finished the sync. This
-         * will trigger an AOF rewrite, and when done will start appending
-         * to the new file. */
-        if (server.aof_state != REDIS_AOF_OFF) {
-            int retry = 10;
-
-            stopAppendOnly();
-            while (retry-- && startAppendOnly() == REDIS_ERR) {
-                redisLog(REDIS_WARNING,"Failed enabling the AOF after successful master synchrnization! Trying it again in one second.");
-                sleep(1);
-            }
-            if (!retry) {
-                redisLog(REDIS_WARNING,"FATAL: this slave instance finished the synchronization with its master, but the AOF can't be turned on. Exiting now.");
-                exit(1);
-            }
-        }
-    }
-
+    if (!usemark && server.repl_transfer_read == server.repl_transfer_size)
+        readSyncBulkPayloadDone(NULL);
     return;
 
 error:
@@ -581,9 +1341,147 @@ char *sendSynchronousCommand(int fd, ...) {
     return NULL; /* No errors. */
 }
 
+/* Try a partial resynchronization with the master if we are about to
+ * reconnect. If there is no cached master structure, at least try to issue
+ * a "PSYNC ? -1" command in order to trigger a full resync using the PSYNC
+ * command in order to obtain the master run id and the master replication
+ * global offset.
+ *
+ * 如果有缓存的主节点，那么发送 "PSYNC <runid> <offset>" 尝试部分重同步，
+ * 否则发送 "PSYNC ? -1" ，以完整重同步的方式取得主节点的运行 ID 和偏移量。
+ *
+ * Returns REDIS_ERR on I/O error. */
+int slaveSendPSync(int fd) {
+    char *psync_runid;
+    char psync_offset[32];
+    sds cmd;
+    int retval;
+
+    if (server.cached_master) {
+        psync_runid = server.cached_master->replrunid;
+        snprintf(psync_offset,sizeof(psync_offset),"%lld",
+            server.cached_master->reploff+1);
+        redisLog(REDIS_NOTICE,"Trying a partial resynchronization (request %s:%s).", psync_runid, psync_offset);
+    } else {
+        redisLog(REDIS_NOTICE,"Partial resynchronization not possible (no cached master)");
+        psync_runid = "?";
+        memcpy(psync_offset,"-1",3);
+    }
+
+    /* Issue the PSYNC command */
+    cmd = sdscatprintf(sdsempty(),"PSYNC %s %s\r\n",psync_runid,psync_offset);
+    retval = syncWrite(fd,cmd,sdslen(cmd),server.repl_syncio_timeout*1000);
+    sdsfree(cmd);
+    if (retval == -1) {
+        redisLog(REDIS_WARNING,"I/O error writing to MASTER: %s",
+            strerror(errno));
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+
+/* Read the reply of the master to PSYNC. Return values:
+ *
+ * 读取主节点对 PSYNC 的回复，返回值：
+ *
+ * PSYNC_CONTINUE: If the PSYNC command succeded and we can continue.
+ *                 部分重同步成功，调用者应该恢复缓存的主节点。
+ * PSYNC_FULLRESYNC: If PSYNC is supported but a full resync is needed.
+ *                   In this case the master run_id and global replication
+ *                   offset is saved.
+ *                   需要执行完整重同步，主节点的运行 ID 和偏移量已被保存。
+ * PSYNC_NOT_SUPPORTED: If the server does not understand PSYNC at all and
+ *                      the caller should fall back to SYNC.
+ *                      主节点不支持 PSYNC ，调用者应该改用 SYNC 。
+ * PSYNC_WAIT_REPLY: The master only sent a newline to keep the link alive,
+ *                   the reply will arrive later.
+ *                   主节点只发送了一个保持连接的换行符，稍后再读。
+ * PSYNC_ERROR: I/O error reading the reply.
+ *              读取回复出错。
+ */
+#define PSYNC_CONTINUE 0
+#define PSYNC_FULLRESYNC 1
+#define PSYNC_NOT_SUPPORTED 2
+#define PSYNC_WAIT_REPLY 3
+#define PSYNC_ERROR 4
+int slaveReadPSyncReply(int fd) {
+    char buf[256];
+
+    if (syncReadLine(fd,buf,sizeof(buf),
+        server.repl_syncio_timeout*1000) == -1)
+    {
+        redisLog(REDIS_WARNING,
+            "I/O error reading PSYNC reply from master: %s",
+            strerror(errno));
+        return PSYNC_ERROR;
+    }
+    server.repl_transfer_lastio = server.unixtime;
+
+    /* Newlines are sent by the master to slaves waiting for a BGSAVE in
+     * order to refresh the link. */
+    if (buf[0] == '\0') return PSYNC_WAIT_REPLY;
+
+    if (!strncmp(buf,"+FULLRESYNC",11)) {
+        char *runid = NULL, *offset = NULL;
+
+        /* FULL RESYNC, parse the reply in order to extract the run id
+         * and the replication offset. */
+        runid = strchr(buf,' ');
+        if (runid) {
+            runid++;
+            offset = strchr(runid,' ');
+            if (offset) offset++;
+        }
+        if (!runid || !offset || (offset-runid-1) != REDIS_RUN_ID_SIZE) {
+            redisLog(REDIS_WARNING,
+                "Master replied with wrong +FULLRESYNC syntax.");
+            /* This is an unexpected condition, actually the +FULLRESYNC
+             * reply means that the master supports PSYNC, but the reply
+             * format seems wrong. To stay safe we blank the master
+             * runid to make sure next PSYNCs will fail. */
+            memset(server.repl_master_runid,0,REDIS_RUN_ID_SIZE+1);
+            server.repl_master_initial_offset = -1;
+        } else {
+            memcpy(server.repl_master_runid, runid, offset-runid-1);
+            server.repl_master_runid[REDIS_RUN_ID_SIZE] = '\0';
+            server.repl_master_initial_offset = strtoll(offset,NULL,10);
+            redisLog(REDIS_NOTICE,"Full resync from master: %s:%lld",
+                server.repl_master_runid,
+                server.repl_master_initial_offset);
+        }
+        /* We are going to full resync, discard the cached master structure. */
+        replicationDiscardCachedMaster();
+        return PSYNC_FULLRESYNC;
+    }
+
+    if (!strncmp(buf,"+CONTINUE",9)) {
+        /* Partial resync was accepted, set the replication state accordingly */
+        redisLog(REDIS_NOTICE,
+            "Successful partial resynchronization with master.");
+        return PSYNC_CONTINUE;
+    }
+
+    /* If we reach this point we receied either an error since the master does
+     * not understand PSYNC, or an unexpected reply from the master.
+     * Return PSYNC_NOT_SUPPORTED to the caller in both cases. */
+    if (strncmp(buf,"-ERR",4)) {
+        /* If it's not an error, log the unexpected event. */
+        redisLog(REDIS_WARNING,
+            "Unexpected reply to PSYNC from master: %s", buf);
+    } else {
+        redisLog(REDIS_NOTICE,
+            "Master does not support PSYNC or is in "
+            "error state (reply: %s)", buf);
+    }
+    replicationDiscardCachedMaster();
+    server.repl_master_initial_offset = -1;
+    return PSYNC_NOT_SUPPORTED;
+}
+
 void syncWithMaster(aeEventLoop *el, int fd, void *privdata, int mask) {
     char tmpfile[256], *err;
     int dfd, maxtries = 5;
+    int psync_result;
     int sockerr = 0;
     socklen_t errlen = sizeof(sockerr);
     REDIS_NOTUSED(el);
@@ -655,7 +1553,7 @@ void syncWithMaster(aeEventLoop *el, int fd, void *privdata, int mask) {
     }
 
     /* AUTH with the master if required. */
-    if(server.masterauth) {
+    if (server.repl_state != REDIS_REPL_RECEIVE_PSYNC && server.masterauth) {
         err = sendSynchronousCommand(fd,"AUTH",server.masterauth,NULL);
         if (err) {
             redisLog(REDIS_WARNING,"Unable to AUTH to MASTER: %s",err);
@@ -666,7 +1564,7 @@ void syncWithMaster(aeEventLoop *el, int fd, void *privdata, int mask) {
 
     /* Set the slave port, so that Master's INFO command can list the
      * slave listening port correctly. */
-    {
+    if (server.repl_state != REDIS_REPL_RECEIVE_PSYNC) {
         sds port = sdsfromlonglong(server.port);
         err = sendSynchronousCommand(fd,"REPLCONF","listening-port",port,
                                          NULL);
@@ -677,26 +1575,78 @@ void syncWithMaster(aeEventLoop *el, int fd, void *privdata, int mask) {
             redisLog(REDIS_NOTICE,"(non critical): Master does not understand REPLCONF listening-port: %s", err);
             sdsfree(err);
         }
+
+        /* Inform the master of our capabilities: we are able to parse
+         * the streamed RDB format used for diskless replication. Older
+         * masters just reply with an error. */
+        // 告诉主节点本节点支持无盘复制使用的 EOF 格式
+        err = sendSynchronousCommand(fd,"REPLCONF","capa","eof",NULL);
+        if (err) {
+            redisLog(REDIS_NOTICE,"(non critical): Master does not understand REPLCONF capa: %s", err);
+            sdsfree(err);
+        }
     }
 
-    /* Issue the SYNC command */
-    if (syncWrite(fd,"SYNC\r\n",6,server.repl_syncio_timeout*1000) == -1) {
-        redisLog(REDIS_WARNING,"I/O error writing to MASTER: %s",
-            strerror(errno));
-        goto error;
+    /* Try a partial resynchonization. If we don't have a cached master
+     * slaveSendPSync() will at least try to use PSYNC to start a full
+     * resynchronization, so that we get the master run id and the global
+     * offset, to try a partial resync at the next reconnection attempt.
+     * The reply is read asynchronously, since the master may delay it until
+     * a BGSAVE is started for us. */
+    // 发送 PSYNC ，回复由 slaveReadPSyncReply() 异步读取
+    if (server.repl_state != REDIS_REPL_RECEIVE_PSYNC) {
+        if (slaveSendPSync(fd) == REDIS_ERR) goto error;
+        server.repl_state = REDIS_REPL_RECEIVE_PSYNC;
+        server.repl_transfer_lastio = server.unixtime;
+        if (aeCreateFileEvent(server.el,fd,AE_READABLE,syncWithMaster,NULL)
+                == AE_ERR)
+        {
+            redisLog(REDIS_WARNING,"Can't create readable event for PSYNC");
+            goto error;
+        }
+        return;
     }
 
-    /* Prepare a suitable temp file for bulk transfer */
-    while(maxtries--) {
-        snprintf(tmpfile,256,
-            "temp-%d.%ld.rdb",(int)server.unixtime,(long int)getpid());
-        dfd = open(tmpfile,O_CREAT|O_WRONLY|O_EXCL,0644);
-        if (dfd != -1) break;
-        sleep(1);
+    /* Read the reply to PSYNC. */
+    psync_result = slaveReadPSyncReply(fd);
+    if (psync_result == PSYNC_WAIT_REPLY) return; /* Try again later... */
+    aeDeleteFileEvent(server.el,fd,AE_READABLE);
+    if (psync_result == PSYNC_CONTINUE) {
+        replicationResurrectCachedMaster(fd);
+        redisLog(REDIS_NOTICE, "MASTER <-> SLAVE sync: Master accepted a Partial Resynchronization.");
+        return;
     }
-    if (dfd == -1) {
-        redisLog(REDIS_WARNING,"Opening the temp file needed for MASTER <-> SLAVE synchronization: %s",strerror(errno));
-        goto error;
+    if (psync_result == PSYNC_ERROR) goto error;
+
+    /* Fall back to SYNC if needed. Otherwise psync_result == PSYNC_FULLRESYNC
+     * and the server.repl_master_runid and repl_master_initial_offset are
+     * already populated. */
+    // 主节点不支持 PSYNC ，退回到 SYNC
+    if (psync_result == PSYNC_NOT_SUPPORTED) {
+        redisLog(REDIS_NOTICE,"Retrying with SYNC...");
+        if (syncWrite(fd,"SYNC\r\n",6,server.repl_syncio_timeout*1000) == -1) {
+            redisLog(REDIS_WARNING,"I/O error writing to MASTER: %s",
+                strerror(errno));
+            goto error;
+        }
+    }
+
+    /* Prepare a suitable temp file for bulk transfer, unless the payload
+     * is going to be loaded straight from the socket. */
+    // 使用无盘载入时不需要临时文件
+    dfd = -1;
+    if (!server.repl_diskless_load) {
+        while(maxtries--) {
+            snprintf(tmpfile,256,
+                "temp-%d.%ld.rdb",(int)server.unixtime,(long int)getpid());
+            dfd = open(tmpfile,O_CREAT|O_WRONLY|O_EXCL,0644);
+            if (dfd != -1) break;
+            sleep(1);
+        }
+        if (dfd == -1) {
+            redisLog(REDIS_WARNING,"Opening the temp file needed for MASTER <-> SLAVE synchronization: %s",strerror(errno));
+            goto error;
+        }
     }
 
     /* Setup the non blocking download of the bulk file. */
@@ -713,10 +1663,11 @@ void syncWithMaster(aeEventLoop *el, int fd, void *privdata, int mask) {
     server.repl_transfer_last_fsync_off = 0;
     server.repl_transfer_fd = dfd;
     server.repl_transfer_lastio = server.unixtime;
-    server.repl_transfer_tmpfile = zstrdup(tmpfile);
+    server.repl_transfer_tmpfile = (dfd != -1) ? zstrdup(tmpfile) : NULL;
     return;
 
 error:
+    aeDeleteFileEvent(server.el,fd,AE_READABLE|AE_WRITABLE);
     close(fd);
     server.repl_transfer_s = -1;
     server.repl_state = REDIS_REPL_CONNECT;
@@ -753,7 +1704,8 @@ void undoConnectWithMaster(void) {
     int fd = server.repl_transfer_s;
 
     redisAssert(server.repl_state == REDIS_REPL_CONNECTING ||
-                server.repl_state == REDIS_REPL_RECEIVE_PONG);
+                server.repl_state == REDIS_REPL_RECEIVE_PONG ||
+                server.repl_state == REDIS_REPL_RECEIVE_PSYNC);
     aeDeleteFileEvent(server.el,fd,AE_READABLE|AE_WRITABLE);
     close(fd);
     server.repl_transfer_s = -1;
@@ -767,10 +1719,12 @@ void slaveofCommand(redisClient *c) {
             sdsfree(server.masterhost);
             server.masterhost = NULL;
             if (server.master) freeClient(server.master);
+            replicationDiscardCachedMaster();
             if (server.repl_state == REDIS_REPL_TRANSFER)
                 replicationAbortSyncTransfer();
             else if (server.repl_state == REDIS_REPL_CONNECTING ||
-                     server.repl_state == REDIS_REPL_RECEIVE_PONG)
+                     server.repl_state == REDIS_REPL_RECEIVE_PONG ||
+                     server.repl_state == REDIS_REPL_RECEIVE_PSYNC)
                 undoConnectWithMaster();
             server.repl_state = REDIS_REPL_NONE;
             redisLog(REDIS_NOTICE,"MASTER MODE enabled (user request)");
@@ -794,9 +1748,14 @@ void slaveofCommand(redisClient *c) {
         server.masterhost = sdsdup(c->argv[1]->ptr);
         server.masterport = port;
         if (server.master) freeClient(server.master);
+        replicationDiscardCachedMaster(); /* Don't try a PSYNC. */
         disconnectSlaves(); /* Force our slaves to resync with us as well. */
         if (server.repl_state == REDIS_REPL_TRANSFER)
             replicationAbortSyncTransfer();
+        else if (server.repl_state == REDIS_REPL_CONNECTING ||
+                 server.repl_state == REDIS_REPL_RECEIVE_PONG ||
+                 server.repl_state == REDIS_REPL_RECEIVE_PSYNC)
+            undoConnectWithMaster();
         server.repl_state = REDIS_REPL_CONNECT;
         redisLog(REDIS_NOTICE,"SLAVE OF %s:%d enabled (user request)",
             server.masterhost, server.masterport);
@@ -810,7 +1769,8 @@ void replicationCron(void) {
     /* Non blocking connection timeout? */
     if (server.masterhost &&
         (server.repl_state == REDIS_REPL_CONNECTING ||
-         server.repl_state == REDIS_REPL_RECEIVE_PONG) &&
+         server.repl_state == REDIS_REPL_RECEIVE_PONG ||
+         server.repl_state == REDIS_REPL_RECEIVE_PSYNC) &&
         (time(NULL)-server.repl_transfer_lastio) > server.repl_timeout)
     {
         redisLog(REDIS_WARNING,"Timeout connecting to the MASTER...");
@@ -845,30 +1805,88 @@ void replicationCron(void) {
      * So slaves can implement an explicit timeout to masters, and will
      * be able to detect a link disconnection even if the TCP connection
      * will not actually go down. */
-    if (!(server.cronloops % (server.repl_ping_slave_period * REDIS_HZ))) {
+    if (!(server.cronloops % (server.repl_ping_slave_period * REDIS_HZ)) &&
+        listLength(server.slaves))
+    {
         listIter li;
         listNode *ln;
-
+        robj *ping_argv[1];
+
+        /* First, send PING. It goes through the replication backlog as
+         * every other command, so that the offsets of master and slaves
+         * stay in agreement. */
+        // PING 和其他命令一样经由复制流（以及积压缓冲区）发送，
+        // 这样主节点和附属节点的复制偏移量才能保持一致
+        ping_argv[0] = createStringObject("PING",4);
+        replicationFeedSlaves(server.slaves, server.slaveseldb, ping_argv, 1);
+        decrRefCount(ping_argv[0]);
+
+        /* Second, send a newline to all the slaves in pre-synchronization
+         * stage, that is, slaves waiting for the master to create the RDB
+         * file. Just a newline will do the work of refreshing the
+         * connection last interaction time, and at the same time we'll be
+         * sure that being a single char there are no short-write problems.
+         *
+         * Slaves served by a diskless transfer are skipped while the child
+         * is streaming the payload to their sockets. */
         listRewind(server.slaves,&li);
         while((ln = listNext(&li))) {
             redisClient *slave = ln->value;
 
-            /* Don't ping slaves that are in the middle of a bulk transfer
-             * with the master for first synchronization. */
-            if (slave->replstate == REDIS_REPL_SEND_BULK) continue;
-            if (slave->replstate == REDIS_REPL_ONLINE) {
-                /* If the slave is online send a normal ping */
-                addReplySds(slave,sdsnew("*1\r\n$4\r\nPING\r\n"));
-            } else {
-                /* Otherwise we are in the pre-synchronization stage.
-                 * Just a newline will do the work of refreshing the
-                 * connection last interaction time, and at the same time
-                 * we'll be sure that being a single char there are no
-                 * short-write problems. */
+            if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START ||
+                (slave->replstate == REDIS_REPL_WAIT_BGSAVE_END &&
+                 server.rdb_child_type != REDIS_RDB_CHILD_TYPE_SOCKET)) {
                 if (write(slave->fd, "\n", 1) == -1) {
                     /* Don't worry, it's just a ping. */
                 }
             }
         }
     }
+
+    /* Start a BGSAVE good for replication if we have slaves in
+     * WAIT_BGSAVE_START state. With diskless replication the first waiting
+     * slave waits repl-diskless-sync-delay seconds, so that more slaves
+     * can be served by the same transfer. */
+    // 有附属节点在等待 BGSAVE ，并且等待时间超过了无盘复制的延迟时，
+    // 启动一次新的 BGSAVE
+    if (server.rdb_child_pid == -1) {
+        time_t idle, max_idle = 0;
+        int slaves_waiting = 0;
+        int mincapa = -1;
+        listNode *ln;
+        listIter li;
+
+        listRewind(server.slaves,&li);
+        while((ln = listNext(&li))) {
+            redisClient *slave = ln->value;
+
+            if (slave->replstate == REDIS_REPL_WAIT_BGSAVE_START) {
+                idle = server.unixtime - slave->lastinteraction;
+                if (idle > max_idle) max_idle = idle;
+                slaves_waiting++;
+                mincapa = (mincapa == -1) ? slave->slave_capa :
+                                            (mincapa & slave->slave_capa);
+            }
+        }
+
+        if (slaves_waiting && max_idle >= server.repl_diskless_sync_delay)
+            startBgsaveForReplication(mincapa);
+    }
+
+    /* If we have no attached slaves and there is a replication backlog
+     * using memory, free it after some (configured) time. */
+    // 没有附属节点一段时间之后，释放复制积压缓冲区
+    if (listLength(server.slaves) == 0 && server.repl_backlog_time_limit &&
+        server.repl_backlog)
+    {
+        time_t idle = server.unixtime - server.repl_no_slaves_since;
+
+        if (idle > server.repl_backlog_time_limit) {
+            freeReplicationBacklog();
+            redisLog(REDIS_NOTICE,
+                "Replication backlog freed after %d seconds "
+                "without connected slaves.",
+                (int) server.repl_backlog_time_limit);
+        }
+    }
 }
@@ -62,9 +62,14 @@
 #include "fmacros.h"
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
 #include "rio.h"
 #include "util.h"
 #include "crc64.h"
+#include "lz4.h"
+#include "endianconv.h"
+#include "redis.h"
 
 /* Returns 1 or 0 for success/failure. */
 /*
@@ -104,6 +109,16 @@ static off_t rioBufferTell(rio *r) {
     return r->io.buffer.pos;
 }
 
+/* Flushes any buffer to target device if applicable. Returns 1 on success
+ * and 0 on failures. */
+/*
+ * 内存流没有需要写出的缓存，总是返回 1 。
+ */
+static int rioBufferFlush(rio *r) {
+    REDIS_NOTUSED(r);
+    return 1;
+}
+
 /* Returns 1 or 0 for success/failure. */
 /*
  * 将长度为 len 的内容 buf 写入到文件中。
@@ -132,6 +147,15 @@ static off_t rioFileTell(rio *r) {
     return ftello(r->io.file.fp);
 }
 
+/* Flushes any buffer to target device if applicable. Returns 1 on success
+ * and 0 on failures. */
+/*
+ * 将 stdio 缓存中的数据写入到文件
+ */
+static int rioFileFlush(rio *r) {
+    return (fflush(r->io.file.fp) == 0) ? 1 : 0;
+}
+
 /*
  * 流为内存时所使用的结构
  */
@@ -139,6 +163,7 @@ static const rio rioBufferIO = {
     rioBufferRead,
     rioBufferWrite,
     rioBufferTell,
+    rioBufferFlush,
     NULL,           /* update_checksum */
     0,              /* current checksum */
     { { NULL, 0 } } /* union for io-specific vars */
@@ -151,6 +176,7 @@ static const rio rioFileIO = {
     rioFileRead,
     rioFileWrite,
     rioFileTell,
+    rioFileFlush,
     NULL,           /* update_checksum */
     0,              /* current checksum */
     { { NULL, 0 } } /* union for io-specific vars */
@@ -173,6 +199,381 @@ void rioInitWithBuffer(rio *r, sds s) {
     r->io.buffer.pos = 0;
 }
 
+/* ------------------- Socket (read) implementation ------------------------
+ * Used to load an RDB payload straight from the master link. Data is read
+ * from the socket in big chunks, so the caller must use rioFreeFd() to get
+ * back the bytes that were read but not consumed. */
+
+/* Returns 1 or 0 for success/failure. */
+/*
+ * 从套接字中读取 len 字节到 buf 中。
+ *
+ * 缓存中的数据不足时，一次从套接字读入尽量多的数据，
+ * 但不会超过 read_limit 所指定的偏移量。
+ */
+static size_t rioFdRead(rio *r, void *buf, size_t len) {
+    size_t avail = sdslen(r->io.fd.buf)-r->io.fd.bufpos;
+
+    if (avail < len) {
+        size_t needed = len-avail, toread;
+
+        /* Discard the consumed part of the buffer before reading more. */
+        sdsrange(r->io.fd.buf,r->io.fd.bufpos,-1);
+        r->io.fd.bufpos = 0;
+
+        toread = (needed < REDIS_IOBUF_LEN) ? REDIS_IOBUF_LEN : needed;
+        if (r->io.fd.read_limit) {
+            off_t left = r->io.fd.read_limit - r->io.fd.read_so_far;
+
+            if ((off_t)needed > left) {
+                errno = EOVERFLOW;
+                return 0;
+            }
+            if ((off_t)toread > left) toread = left;
+        }
+        r->io.fd.buf = sdsMakeRoomFor(r->io.fd.buf,toread);
+
+        while(needed) {
+            ssize_t nread;
+
+            nread = read(r->io.fd.fd,r->io.fd.buf+sdslen(r->io.fd.buf),toread);
+            if (nread == 0) {
+                errno = ECONNRESET;
+                return 0;
+            } else if (nread == -1) {
+                if (errno != EAGAIN) return 0;
+                if (aeWait(r->io.fd.fd,AE_READABLE,r->io.fd.timeout) <= 0) {
+                    errno = ETIMEDOUT;
+                    return 0;
+                }
+                continue;
+            }
+            sdsIncrLen(r->io.fd.buf,nread);
+            r->io.fd.read_so_far += nread;
+            toread -= nread;
+            needed = ((size_t)nread >= needed) ? 0 : needed-nread;
+        }
+    }
+
+    memcpy(buf,r->io.fd.buf+r->io.fd.bufpos,len);
+    r->io.fd.bufpos += len;
+    r->io.fd.pos += len;
+    return 1;
+}
+
+/* The socket target is read only. */
+static size_t rioFdWrite(rio *r, const void *buf, size_t len) {
+    REDIS_NOTUSED(r);
+    REDIS_NOTUSED(buf);
+    REDIS_NOTUSED(len);
+    return 0;
+}
+
+/* Returns the number of bytes consumed so far. */
+static off_t rioFdTell(rio *r) {
+    return r->io.fd.pos;
+}
+
+static int rioFdFlush(rio *r) {
+    REDIS_NOTUSED(r);
+    return 1;
+}
+
+static const rio rioFdIO = {
+    rioFdRead,
+    rioFdWrite,
+    rioFdTell,
+    rioFdFlush,
+    NULL,           /* update_checksum */
+    0,              /* current checksum */
+    { { NULL, 0 } } /* union for io-specific vars */
+};
+
+/*
+ * 初始化套接字读取流
+ *
+ * read_limit 不为 0 时，最多从套接字读取 read_limit 字节，
+ * 读取操作阻塞的时间不超过 timeout 毫秒。
+ */
+void rioInitWithFd(rio *r, int fd, off_t read_limit, long long timeout) {
+    *r = rioFdIO;
+    r->io.fd.fd = fd;
+    r->io.fd.buf = sdsempty();
+    r->io.fd.bufpos = 0;
+    r->io.fd.pos = 0;
+    r->io.fd.read_limit = read_limit;
+    r->io.fd.read_so_far = 0;
+    r->io.fd.timeout = timeout;
+}
+
+/* Release the stream, returning the data that was read from the socket
+ * but not consumed. The caller owns the returned string. */
+/*
+ * 释放套接字读取流，返回已从套接字读入、但尚未被使用的数据
+ */
+sds rioFreeFd(rio *r) {
+    sds remaining = r->io.fd.buf;
+
+    sdsrange(remaining,r->io.fd.bufpos,-1);
+    r->io.fd.buf = NULL;
+    return remaining;
+}
+
+/* ------------------- File descriptors set implementation -------------------
+ * Used to stream the same RDB payload to many slaves at once. Writes are
+ * buffered and then sent to every socket that did not fail yet: the stream
+ * is considered broken only when all the sockets failed. */
+
+/* Returns 1 or 0 for success/failure. */
+/*
+ * 将缓存中的数据写入到所有仍然可用的套接字，
+ * 所有套接字都出错时返回 0 。
+ */
+static int rioFdsetFlush(rio *r) {
+    int j, broken = 0;
+    size_t len = sdslen(r->io.fdset.buf);
+
+    for (j = 0; j < r->io.fdset.numfds; j++) {
+        if (r->io.fdset.state[j] != 0) {
+            broken++;
+            continue;
+        }
+        if (len &&
+            syncWrite(r->io.fdset.fds[j],r->io.fdset.buf,len,
+                      r->io.fdset.timeout) == -1)
+        {
+            r->io.fdset.state[j] = errno ? errno : EIO;
+            broken++;
+        }
+    }
+    sdsclear(r->io.fdset.buf);
+    if (broken == r->io.fdset.numfds) return 0;
+    return 1;
+}
+
+/* Returns 1 or 0 for success/failure. */
+/*
+ * 将 buf 追加到缓存中，缓存足够大时写入到所有套接字
+ */
+static size_t rioFdsetWrite(rio *r, const void *buf, size_t len) {
+    r->io.fdset.buf = sdscatlen(r->io.fdset.buf,buf,len);
+    r->io.fdset.pos += len;
+    if (sdslen(r->io.fdset.buf) >= REDIS_IOBUF_LEN)
+        return rioFdsetFlush(r);
+    return 1;
+}
+
+/* The set of sockets is write only. */
+static size_t rioFdsetRead(rio *r, void *buf, size_t len) {
+    REDIS_NOTUSED(r);
+    REDIS_NOTUSED(buf);
+    REDIS_NOTUSED(len);
+    return 0;
+}
+
+/* Returns the number of bytes written so far. */
+static off_t rioFdsetTell(rio *r) {
+    return r->io.fdset.pos;
+}
+
+static const rio rioFdsetIO = {
+    rioFdsetRead,
+    rioFdsetWrite,
+    rioFdsetTell,
+    rioFdsetFlush,
+    NULL,           /* update_checksum */
+    0,              /* current checksum */
+    { { NULL, 0 } } /* union for io-specific vars */
+};
+
+/*
+ * 初始化多套接字写入流，每次写入阻塞的时间不超过 timeout 毫秒
+ */
+void rioInitWithFdset(rio *r, int *fds, int numfds, long long timeout) {
+    int j;
+
+    *r = rioFdsetIO;
+    r->io.fdset.fds = zmalloc(sizeof(int)*numfds);
+    r->io.fdset.state = zmalloc(sizeof(int)*numfds);
+    memcpy(r->io.fdset.fds,fds,sizeof(int)*numfds);
+    for (j = 0; j < numfds; j++) r->io.fdset.state[j] = 0;
+    r->io.fdset.numfds = numfds;
+    r->io.fdset.pos = 0;
+    r->io.fdset.buf = sdsempty();
+    r->io.fdset.timeout = timeout;
+}
+
+/*
+ * 释放多套接字写入流
+ */
+void rioFreeFdset(rio *r) {
+    zfree(r->io.fdset.fds);
+    zfree(r->io.fdset.state);
+    sdsfree(r->io.fdset.buf);
+}
+
+/* ------------------- Compressed stream implementation ----------------------
+ * Wraps another stream: the data written is collected into blocks of
+ * REDIS_RIO_ZBLOCK_LEN bytes, and every block is compressed with LZ4 and
+ * written to the target stream as a frame:
+ *
+ * <uncompressed len><compressed len><compressed data>
+ *
+ * Both lengths are 32 bit little endian integers. A compressed length of
+ * zero means the block did not shrink and is stored as it is. Reads work the
+ * other way around, decompressing one frame at a time, so the wrapped stream
+ * is never read past the last frame requested. Tell returns the offset of
+ * the target stream, so that progress reports refer to the real file size.
+ *
+ * 压缩流：写入的数据按块收集，每块使用 LZ4 压缩后作为一个帧写入目标流。
+ * 读取时则每次读入并解压一个帧。 */
+
+#define REDIS_RIO_ZBLOCK_LEN (1024*64)
+
+/* Compress and write the pending block, if any. Returns 1 or 0 for
+ * success/failure. */
+/*
+ * 压缩缓存中的块，并将它作为一个帧写入到目标流
+ */
+static int rioZstreamWriteFrame(rio *r) {
+    uint32_t hdr[2];
+    unsigned int zlen;
+
+    if (r->io.zstream.len == 0) return 1;
+    zlen = lz4_compress(r->io.zstream.buf,r->io.zstream.len,
+                        r->io.zstream.zbuf,r->io.zstream.len-1);
+    hdr[0] = r->io.zstream.len;
+    hdr[1] = zlen;
+    memrev32ifbe(&hdr[0]);
+    memrev32ifbe(&hdr[1]);
+    if (rioWrite(r->io.zstream.target,hdr,sizeof(hdr)) == 0) return 0;
+    if (zlen) {
+        if (rioWrite(r->io.zstream.target,r->io.zstream.zbuf,zlen) == 0)
+            return 0;
+    } else {
+        if (rioWrite(r->io.zstream.target,r->io.zstream.buf,
+                     r->io.zstream.len) == 0) return 0;
+    }
+    r->io.zstream.len = 0;
+    return 1;
+}
+
+/* Read and decompress the next frame. Returns 1 or 0 for success/failure. */
+/*
+ * 读入并解压下一个帧
+ */
+static int rioZstreamReadFrame(rio *r) {
+    uint32_t hdr[2];
+
+    if (rioRead(r->io.zstream.target,hdr,sizeof(hdr)) == 0) return 0;
+    memrev32ifbe(&hdr[0]);
+    memrev32ifbe(&hdr[1]);
+    if (hdr[0] == 0 || hdr[0] > REDIS_RIO_ZBLOCK_LEN ||
+        hdr[1] >= hdr[0]) return 0;
+    if (hdr[1] == 0) {
+        if (rioRead(r->io.zstream.target,r->io.zstream.buf,hdr[0]) == 0)
+            return 0;
+    } else {
+        if (rioRead(r->io.zstream.target,r->io.zstream.zbuf,hdr[1]) == 0 ||
+            lz4_decompress(r->io.zstream.zbuf,hdr[1],
+                           r->io.zstream.buf,hdr[0]) != hdr[0]) return 0;
+    }
+    r->io.zstream.len = hdr[0];
+    r->io.zstream.bufpos = 0;
+    return 1;
+}
+
+/* Returns 1 or 0 for success/failure. */
+static size_t rioZstreamWrite(rio *r, const void *buf, size_t len) {
+    const char *p = buf;
+
+    while (len) {
+        size_t avail = REDIS_RIO_ZBLOCK_LEN - r->io.zstream.len;
+        size_t count = (len < avail) ? len : avail;
+
+        memcpy(r->io.zstream.buf+r->io.zstream.len,p,count);
+        r->io.zstream.len += count;
+        p += count;
+        len -= count;
+        if (r->io.zstream.len == REDIS_RIO_ZBLOCK_LEN &&
+            rioZstreamWriteFrame(r) == 0) return 0;
+    }
+    return 1;
+}
+
+/* Returns 1 or 0 for success/failure. */
+static size_t rioZstreamRead(rio *r, void *buf, size_t len) {
+    char *p = buf;
+
+    while (len) {
+        size_t avail = r->io.zstream.len - r->io.zstream.bufpos;
+        size_t count = (len < avail) ? len : avail;
+
+        if (avail == 0) {
+            if (rioZstreamReadFrame(r) == 0) return 0;
+            continue;
+        }
+        memcpy(p,r->io.zstream.buf+r->io.zstream.bufpos,count);
+        r->io.zstream.bufpos += count;
+        p += count;
+        len -= count;
+    }
+    return 1;
+}
+
+/* Returns the offset of the target stream. */
+static off_t rioZstreamTell(rio *r) {
+    return rioTell(r->io.zstream.target);
+}
+
+/* Write the pending block and flush the target stream. Returns 1 or 0 for
+ * success/failure. */
+static int rioZstreamFlush(rio *r) {
+    if (rioZstreamWriteFrame(r) == 0) return 0;
+    return rioFlush(r->io.zstream.target);
+}
+
+static const rio rioZstreamIO = {
+    rioZstreamRead,
+    rioZstreamWrite,
+    rioZstreamTell,
+    rioZstreamFlush,
+    NULL,           /* update_checksum */
+    0,              /* current checksum */
+    { { NULL, 0 } } /* union for io-specific vars */
+};
+
+/*
+ * 初始化压缩流，写入的数据被压缩后写入到 target
+ */
+void rioInitWithCompressor(rio *r, rio *target) {
+    *r = rioZstreamIO;
+    r->io.zstream.target = target;
+    r->io.zstream.buf = zmalloc(REDIS_RIO_ZBLOCK_LEN);
+    r->io.zstream.len = 0;
+    r->io.zstream.bufpos = 0;
+    r->io.zstream.zbuf = zmalloc(REDIS_RIO_ZBLOCK_LEN);
+}
+
+/*
+ * 初始化解压流，从 target 读入压缩的数据
+ */
+void rioInitWithDecompressor(rio *r, rio *target) {
+    rioInitWithCompressor(r,target);
+}
+
+/* Release the buffers of the stream. Data written but not yet flushed
+ * with rioFlush() is lost. */
+/*
+ * 释放压缩流
+ */
+void rioFreeZstream(rio *r) {
+    zfree(r->io.zstream.buf);
+    zfree(r->io.zstream.zbuf);
+    r->io.zstream.buf = NULL;
+    r->io.zstream.zbuf = NULL;
+}
+
 /* This function can be installed both in memory and file streams when checksum
  * computation is needed. */
 /*
@@ -47,6 +47,9 @@ struct _rio {
     size_t (*read)(struct _rio *, void *buf, size_t len);
     size_t (*write)(struct _rio *, const void *buf, size_t len);
     off_t (*tell)(struct _rio *);
+    /* Write the data still buffered by the backend, if any. */
+    // 将后端缓存的数据写出
+    int (*flush)(struct _rio *);
     /* The update_cksum method if not NULL is used to compute the checksum of all the
      * data that was read or written so far. 
      * 如果 update_cksum 函数不为空，那么用它计算所有已写入或读取的数据的校验值。
@@ -73,6 +76,33 @@ struct _rio {
         struct {
             FILE *fp;
         } file;
+        // 从套接字读取时使用
+        struct {
+            int fd;             /* Socket to read from. */
+            sds buf;            /* Data read from the socket, not consumed. */
+            size_t bufpos;      /* Consumed part of buf. */
+            off_t pos;          /* Bytes returned to the caller so far. */
+            off_t read_limit;   /* Don't read past this offset, 0 = no limit. */
+            off_t read_so_far;  /* Bytes read from the socket so far. */
+            long long timeout;  /* Read timeout in milliseconds. */
+        } fd;
+        // 同时写入多个套接字时使用
+        struct {
+            int *fds;           /* Sockets to write to. */
+            int *state;         /* Error state of each fd, 0 or errno. */
+            int numfds;
+            off_t pos;
+            sds buf;            /* Data not yet written to the sockets. */
+            long long timeout;  /* Write timeout in milliseconds. */
+        } fdset;
+        // 压缩写入（或者解压读取）另一个流时使用
+        struct {
+            struct _rio *target;    /* Stream holding the compressed frames. */
+            unsigned char *buf;     /* Uncompressed data of current block. */
+            size_t len;             /* Bytes of uncompressed data in buf. */
+            size_t bufpos;          /* Consumed part of buf, reads only. */
+            unsigned char *zbuf;    /* Compressed data of current block. */
+        } zstream;
     } io;
 };
 
@@ -116,8 +146,22 @@ static inline off_t rioTell(rio *r) {
     return r->tell(r);
 }
 
+/*
+ * 将缓存的数据写出，成功返回 1 ，失败返回 0 。
+ */
+static inline int rioFlush(rio *r) {
+    return r->flush(r);
+}
+
 void rioInitWithFile(rio *r, FILE *fp);
 void rioInitWithBuffer(rio *r, sds s);
+void rioInitWithFd(rio *r, int fd, off_t read_limit, long long timeout);
+sds rioFreeFd(rio *r);
+void rioInitWithFdset(rio *r, int *fds, int numfds, long long timeout);
+void rioFreeFdset(rio *r);
+void rioInitWithCompressor(rio *r, rio *target);
+void rioInitWithDecompressor(rio *r, rio *target);
+void rioFreeZstream(rio *r);
 
 size_t rioWriteBulkCount(rio *r, char prefix, int count);
 size_t rioWriteBulkString(rio *r, const char *buf, size_t len);
@@ -79,7 +79,7 @@ slowlogEntry *slowlogCreateEntry(robj **argv, int argc, long long duration) {
             /* Trim too long strings as well... */
             // 如果参数太长，那么进行截断
             if (argv[j]->type == REDIS_STRING &&
-                argv[j]->encoding == REDIS_ENCODING_RAW &&
+                sdsEncodedObject(argv[j]) &&
                 sdslen(argv[j]->ptr) > SLOWLOG_ENTRY_MAX_STRING)
             {
                 sds s = sdsnewlen(argv[j]->ptr, SLOWLOG_ENTRY_MAX_STRING);
@@ -88,9 +88,15 @@ slowlogEntry *slowlogCreateEntry(robj **argv, int argc, long long duration) {
                     (unsigned long)
                     sdslen(argv[j]->ptr) - SLOWLOG_ENTRY_MAX_STRING);
                 se->argv[j] = createObject(REDIS_STRING,s);
-            } else {
+            } else if (argv[j]->refcount == REDIS_SHARED_REFCOUNT) {
                 se->argv[j] = argv[j];
-                incrRefCount(argv[j]);
+            } else {
+                /* The arguments are duplicated, otherwise they may end up
+                 * shared with the elements stored into keys, and a bio
+                 * thread releasing a value lazily would race with the
+                 * main thread on their reference counts. */
+                // 复制参数，避免慢查询日志和数据库中的元素共享同一个对象
+                se->argv[j] = dupStringObject(argv[j]);
             }
         }
     }
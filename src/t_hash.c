@@ -52,7 +52,7 @@ void hashTypeTryConversion(robj *o, robj **argv, int start, int end) {
     // 检查所有字符串参数的长度，看是否超过 server.hash_max_ziplist_value
     // 如果有一个结果为真的话，就对 o 进行转换
     for (i = start; i <= end; i++) {
-        if (argv[i]->encoding == REDIS_ENCODING_RAW &&
+        if (sdsEncodedObject(argv[i]) &&
             sdslen(argv[i]->ptr) > server.hash_max_ziplist_value)
         {
             // 转换
@@ -1151,3 +1151,16 @@ void hexistsCommand(redisClient *c) {
     // 测试给定域是否存在
     addReply(c, hashTypeExists(o,c->argv[2]) ? shared.cone : shared.czero);
 }
+
+/*
+ * HSCAN 命令的实现
+ */
+void hscanCommand(redisClient *c) {
+    robj *o;
+    unsigned long cursor;
+
+    if (parseScanCursorOrReply(c,c->argv[2],&cursor) == REDIS_ERR) return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyscan)) == NULL ||
+        checkType(c,o,REDIS_HASH)) return;
+    scanGenericCommand(c,o,cursor);
+}
@@ -35,146 +35,70 @@ void signalListAsReady(redisClient *c, robj *key);
  * List API
  *----------------------------------------------------------------------------*/
 
-/* Check the argument length to see if it requires us to convert the ziplist
- * to a real list. Only check raw-encoded objects because integer encoded
- * objects are never too long. */
-/*
- * 检查 value ，如果它是一个字符串的话，看看 ziplist 能否满足储存它的长度要求
- * 如果不能的话，将 subject 转换为双端链表
- *
- * 如果 value 为整数类型，那么不必对它检查，因为整数对象最长只能是 long 类型
- *
- * T = O(N)
- */
-void listTypeTryConversion(robj *subject, robj *value) {
-
-    // 已经是 LINKEDLIST
-    if (subject->encoding != REDIS_ENCODING_ZIPLIST) return;
-
-    if (value->encoding == REDIS_ENCODING_RAW &&
-        sdslen(value->ptr) > server.list_max_ziplist_value)
-            listTypeConvert(subject,REDIS_ENCODING_LINKEDLIST);
-}
-
-/* The function pushes an elmenet to the specified list object 'subject',
+/* The function pushes an element to the specified list object 'subject',
  * at head or tail position as specified by 'where'.
  *
- * There is no need for the caller to incremnet the refcount of 'value' as
+ * There is no need for the caller to increment the refcount of 'value' as
  * the function takes care of it if needed. */
 /*
  * 多态推入函数
  *
  * 根据 where 参数，将 value 推入列表 subject 的表头或表尾
  *
- * 调用者不必对 value 进行计数，这个函数会处理它
+ * 值会被复制到 quicklist 的 ziplist 中，调用者不必对 value 进行计数
  *
- * T = O(N^2)
+ * T = O(1)
  */
 void listTypePush(robj *subject, robj *value, int where) {
-    /* Check if we need to convert the ziplist */
-    // 检查是否需要对列表进行编码转换
-    // O(N)
-    listTypeTryConversion(subject,value);
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST &&
-        ziplistLen(subject->ptr) >= server.list_max_ziplist_entries)
-            listTypeConvert(subject,REDIS_ENCODING_LINKEDLIST);
-
-    // ziplist
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST) {
-        int pos = (where == REDIS_HEAD) ? ZIPLIST_HEAD : ZIPLIST_TAIL;
+    if (subject->encoding == REDIS_ENCODING_QUICKLIST) {
+        int pos = (where == REDIS_HEAD) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
         value = getDecodedObject(value);
-        // O(N^2)
-        subject->ptr = ziplistPush(subject->ptr,value->ptr,sdslen(value->ptr),pos);
+        size_t len = sdslen(value->ptr);
+        quicklistPush(subject->ptr, value->ptr, len, pos);
         decrRefCount(value);
-    // 双端链表
-    } else if (subject->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // O(1)
-        if (where == REDIS_HEAD) {
-            listAddNodeHead(subject->ptr,value);
-        } else {
-            listAddNodeTail(subject->ptr,value);
-        }
-        incrRefCount(value);
     } else {
         redisPanic("Unknown list encoding");
     }
 }
 
+/*
+ * quicklistPopCustom() 使用的保存函数，为弹出的字符串值创建对象
+ */
+static void *listPopSaver(unsigned char *data, unsigned int sz) {
+    return createStringObject((char*)data,sz);
+}
+
 /*
  * 多态 pop 对象
  *
  * T = O(1)
  */
 robj *listTypePop(robj *subject, int where) {
-
+    long long vlong;
     robj *value = NULL;
 
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST) {
-        // 从 ziplist 中 pop
-        unsigned char *p;
-        unsigned char *vstr;
-        unsigned int vlen;
-        long long vlong;
-        // pop 表头或表尾？
-        int pos = (where == REDIS_HEAD) ? 0 : -1;
-        // O(1)
-        p = ziplistIndex(subject->ptr,pos);
-        // 元素获取成功？
-        if (ziplistGet(p,&vstr,&vlen,&vlong)) {
-            // 取出值
-            if (vstr) {
-                value = createStringObject((char*)vstr,vlen);
-            } else {
+    int ql_where = where == REDIS_HEAD ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+    if (subject->encoding == REDIS_ENCODING_QUICKLIST) {
+        if (quicklistPopCustom(subject->ptr, ql_where, (unsigned char **)&value,
+                               NULL, &vlong, listPopSaver)) {
+            // 整数值不会经过保存函数，需要在这里创建对象
+            if (!value)
                 value = createStringObjectFromLongLong(vlong);
-            }
-            /* We only need to delete an element when it exists */
-            // 删除它
-            subject->ptr = ziplistDelete(subject->ptr,&p);
-        }
-    } else if (subject->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // O(1)
-
-        // 从双端列表中 pop
-        list *list = subject->ptr;
-        listNode *ln;
-        // 取出表头节点
-        if (where == REDIS_HEAD) {
-            ln = listFirst(list);
-        // 取出表尾节点
-        } else {
-            ln = listLast(list);
-        }
-
-        if (ln != NULL) {
-            // 取出节点的值
-            value = listNodeValue(ln);
-
-            incrRefCount(value);
-            
-            // 删除节点
-            listDelNode(list,ln);
         }
     } else {
         redisPanic("Unknown list encoding");
     }
-
     return value;
 }
 
 /*
  * 多态列表长度获取函数
  *
- * T = O(N)
+ * T = O(1)
  */
 unsigned long listTypeLength(robj *subject) {
-    // ziplist
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST) {
-        // O(N)
-        return ziplistLen(subject->ptr);
-    } else if (subject->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // adlist
-        // O(1)
-        return listLength((list*)subject->ptr);
+    if (subject->encoding == REDIS_ENCODING_QUICKLIST) {
+        return quicklistCount(subject->ptr);
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -184,7 +108,10 @@ unsigned long listTypeLength(robj *subject) {
 /*
  * 创建多态列表迭代器
  *
- * T = O(1)
+ * direction 为 REDIS_TAIL 时从 index 开始向表尾迭代，
+ * 为 REDIS_HEAD 时向表头迭代
+ *
+ * T = O(N/节点大小)
  */
 listTypeIterator *listTypeInitIterator(robj *subject, long index, unsigned char direction) {
 
@@ -194,15 +121,16 @@ listTypeIterator *listTypeInitIterator(robj *subject, long index, unsigned char
     li->subject = subject;
     li->encoding = subject->encoding;
     li->direction = direction;
+    li->iter = NULL;
 
-    // 迭代 ziplist
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
-        li->zi = ziplistIndex(subject->ptr,index);
-
-    // 迭代双端链表
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        li->ln = listIndex(subject->ptr,index);
+    /* REDIS_HEAD means start at TAIL and move *towards* head.
+     * REDIS_TAIL means start at HEAD and move *towards tail. */
+    int iter_direction =
+        direction == REDIS_HEAD ? AL_START_TAIL : AL_START_HEAD;
 
+    if (li->encoding == REDIS_ENCODING_QUICKLIST) {
+        li->iter = quicklistGetIteratorAtIdx(li->subject->ptr,
+                                             iter_direction, index);
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -217,6 +145,7 @@ listTypeIterator *listTypeInitIterator(robj *subject, long index, unsigned char
  * T = O(1)
  */
 void listTypeReleaseIterator(listTypeIterator *li) {
+    if (li->iter) quicklistReleaseIterator(li->iter);
     zfree(li);
 }
 
@@ -235,111 +164,57 @@ int listTypeNext(listTypeIterator *li, listTypeEntry *entry) {
     redisAssert(li->subject->encoding == li->encoding);
 
     entry->li = li;
-
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
-        // ziplist, O(1)
-        entry->zi = li->zi;
-        if (entry->zi != NULL) {
-            if (li->direction == REDIS_TAIL)
-                li->zi = ziplistNext(li->subject->ptr,li->zi);
-            else
-                li->zi = ziplistPrev(li->subject->ptr,li->zi);
-            return 1;
-        }
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // adlist, O(1)
-        entry->ln = li->ln;
-        if (entry->ln != NULL) {
-            if (li->direction == REDIS_TAIL)
-                li->ln = li->ln->next;
-            else
-                li->ln = li->ln->prev;
-            return 1;
-        }
+    if (li->encoding == REDIS_ENCODING_QUICKLIST) {
+        // 索引越界时没有 quicklist 迭代器
+        if (li->iter == NULL) return 0;
+        return quicklistNext(li->iter, &entry->entry);
     } else {
         redisPanic("Unknown list encoding");
     }
-
     return 0;
 }
 
 /* Return entry or NULL at the current position of the iterator. */
 /*
- * 返回迭代器当前节点的值，如果迭代已经完成，返回 NULL 
+ * 返回迭代器当前节点的值，如果迭代已经完成，返回 NULL
  *
  * T = O(1)
  */
 robj *listTypeGet(listTypeEntry *entry) {
-
-    listTypeIterator *li = entry->li;
-
     robj *value = NULL;
-
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
-        unsigned char *vstr;
-        unsigned int vlen;
-        long long vlong;
-        redisAssert(entry->zi != NULL);
-        // O(1)
-        if (ziplistGet(entry->zi,&vstr,&vlen,&vlong)) {
-            if (vstr) {
-                value = createStringObject((char*)vstr,vlen);
-            } else {
-                value = createStringObjectFromLongLong(vlong);
-            }
+    if (entry->li->encoding == REDIS_ENCODING_QUICKLIST) {
+        if (entry->entry.value) {
+            value = createStringObject((char *)entry->entry.value,
+                                       entry->entry.sz);
+        } else {
+            value = createStringObjectFromLongLong(entry->entry.longval);
         }
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        redisAssert(entry->ln != NULL);
-        // O(1)
-        value = listNodeValue(entry->ln);
-        incrRefCount(value);
     } else {
         redisPanic("Unknown list encoding");
     }
-
     return value;
 }
 
 /*
- * 多态插入函数 
+ * 多态插入函数，将 value 插入到 entry 之前（REDIS_HEAD）或之后（REDIS_TAIL）
  *
- * T = O(N^2)
+ * 插入之后迭代器不能再继续使用，只能释放
+ *
+ * T = O(节点大小)
  */
 void listTypeInsert(listTypeEntry *entry, robj *value, int where) {
-
-    robj *subject = entry->li->subject;
-
-    if (entry->li->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (entry->li->encoding == REDIS_ENCODING_QUICKLIST) {
         value = getDecodedObject(value);
+        sds str = value->ptr;
+        size_t len = sdslen(str);
         if (where == REDIS_TAIL) {
-            // 插入到表尾
-
-            // O(1)
-            unsigned char *next = ziplistNext(subject->ptr,entry->zi);
-
-            /* When we insert after the current element, but the current element
-             * is the tail of the list, we need to do a push. */
-            // 找到 next 就将节点插入在 next 之后，没找到就将节点放到表尾
-            if (next == NULL) {
-                // O(N^2)
-                subject->ptr = ziplistPush(subject->ptr,value->ptr,sdslen(value->ptr),REDIS_TAIL);
-            } else {
-                // O(N^2)
-                subject->ptr = ziplistInsert(subject->ptr,next,value->ptr,sdslen(value->ptr));
-            }
-        } else {
-            // 插入到表头，O(N^2)
-            subject->ptr = ziplistInsert(subject->ptr,entry->zi,value->ptr,sdslen(value->ptr));
+            quicklistInsertAfter((quicklist *)entry->entry.quicklist,
+                                 &entry->entry, str, len);
+        } else if (where == REDIS_HEAD) {
+            quicklistInsertBefore((quicklist *)entry->entry.quicklist,
+                                  &entry->entry, str, len);
         }
         decrRefCount(value);
-    } else if (entry->li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // O(1)
-        if (where == REDIS_TAIL) {
-            listInsertNode(subject->ptr,entry->ln,value,AL_START_TAIL);
-        } else {
-            listInsertNode(subject->ptr,entry->ln,value,AL_START_HEAD);
-        }
-        incrRefCount(value);
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -352,16 +227,9 @@ void listTypeInsert(listTypeEntry *entry, robj *value, int where) {
  * T = O(N)
  */
 int listTypeEqual(listTypeEntry *entry, robj *o) {
-
-    listTypeIterator *li = entry->li;
-
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
-        redisAssertWithInfo(NULL,o,o->encoding == REDIS_ENCODING_RAW);
-        // O(1)
-        return ziplistCompare(entry->zi,o->ptr,sdslen(o->ptr));
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // O(N) 
-        return equalStringObjects(o,listNodeValue(entry->ln));
+    if (entry->li->encoding == REDIS_ENCODING_QUICKLIST) {
+        redisAssertWithInfo(NULL,o,sdsEncodedObject(o));
+        return quicklistCompare(entry->entry.zi,o->ptr,sdslen(o->ptr));
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -369,69 +237,36 @@ int listTypeEqual(listTypeEntry *entry, robj *o) {
 
 /* Delete the element pointed to. */
 /*
- * 多态删除 entry 指向的元素
+ * 删除 entry 指向的元素，迭代器可以继续使用
  *
- * T = O(N^2)
+ * T = O(节点大小)
  */
 void listTypeDelete(listTypeEntry *entry) {
-
-    listTypeIterator *li = entry->li;
-
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
-        unsigned char *p = entry->zi;
-        // O(N^2)
-        li->subject->ptr = ziplistDelete(li->subject->ptr,&p);
-
-        /* Update position of the iterator depending on the direction */
-        if (li->direction == REDIS_TAIL)
-            li->zi = p;
-        else
-            li->zi = ziplistPrev(li->subject->ptr,p);
-    } else if (entry->li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // O(1)
-        listNode *next;
-        if (li->direction == REDIS_TAIL)
-            next = entry->ln->next;
-        else
-            next = entry->ln->prev;
-        listDelNode(li->subject->ptr,entry->ln);
-        li->ln = next;
+    if (entry->li->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklistDelEntry(entry->li->iter, &entry->entry);
     } else {
         redisPanic("Unknown list encoding");
     }
 }
 
+/* Create a quicklist from a single ziplist */
 /*
  * 将列表转换为给定的编码类型
  *
- * 目前只支持将 ziplist 转换为双端链表
+ * 目前只支持将 ziplist 转换为 quicklist ，
+ * 用于载入旧版本 RDB 文件中的 ziplist 编码列表
  *
  * T = O(N)
  */
 void listTypeConvert(robj *subject, int enc) {
-    listTypeIterator *li;
-    listTypeEntry entry;
     redisAssertWithInfo(NULL,subject,subject->type == REDIS_LIST);
+    redisAssertWithInfo(NULL,subject,subject->encoding==REDIS_ENCODING_ZIPLIST);
 
-    if (enc == REDIS_ENCODING_LINKEDLIST) {
-        // 创建双端列表
-        list *l = listCreate();
-        listSetFreeMethod(l,decrRefCount);
-
-        /* listTypeGet returns a robj with incremented refcount */
-        // 取出 ziplist 中的所有元素
-        // 并将它们添加到双端列表中
-        // O(N)
-        li = listTypeInitIterator(subject,0,REDIS_TAIL);
-        while (listTypeNext(li,&entry)) listAddNodeTail(l,listTypeGet(&entry));
-        listTypeReleaseIterator(li);
-
-        // 更新编码
-        subject->encoding = REDIS_ENCODING_LINKEDLIST;
-        // 释放 ziplist
-        zfree(subject->ptr);
-        // 指向双端链表
-        subject->ptr = l;
+    if (enc == REDIS_ENCODING_QUICKLIST) {
+        int fill = server.list_max_ziplist_size;
+        int depth = server.list_compress_depth;
+        subject->ptr = quicklistCreateFromZiplist(fill, depth, subject->ptr);
+        subject->encoding = REDIS_ENCODING_QUICKLIST;
     } else {
         redisPanic("Unsupported list conversion");
     }
@@ -444,7 +279,7 @@ void listTypeConvert(robj *subject, int enc) {
 /*
  * [LR]PUSH 命令的实现
  *
- * T = O(N^3)
+ * T = O(N)
  */
 void pushGenericCommand(redisClient *c, int where) {
     int j, waiting = 0, pushed = 0;
@@ -467,15 +302,15 @@ void pushGenericCommand(redisClient *c, int where) {
     if (may_have_waiting_clients) signalListAsReady(c,c->argv[1]);
 
     // 将所有输入元素推入列表
-    // O(N^3)
+    // O(N)
     for (j = 2; j < c->argc; j++) {
         c->argv[j] = tryObjectEncoding(c->argv[j]);
         // 如果列表不存在，那么创建新列表
         if (!lobj) {
-            lobj = createZiplistObject();   // 默认使用 ziplist 编码
+            lobj = createQuicklistObject();
             dbAdd(c->db,c->argv[1],lobj);
         }
-        // 将元素推入列表，O(N^2)
+        // 将元素推入列表，O(1)
         listTypePush(lobj,c->argv[j],where);
         pushed++;
     }
@@ -522,24 +357,15 @@ void pushxGenericCommand(redisClient *c, robj *refval, robj *val, int where) {
     if (refval != NULL) {
         /* Note: we expect refval to be string-encoded because it is *not* the
          * last argument of the multi-bulk LINSERT. */
-        redisAssertWithInfo(c,refval,refval->encoding == REDIS_ENCODING_RAW);
-
-        /* We're not sure if this value can be inserted yet, but we cannot
-         * convert the list inside the iterator. We don't want to loop over
-         * the list twice (once to see if the value can be inserted and once
-         * to do the actual insert), so we assume this value can be inserted
-         * and convert the ziplist to a regular list if necessary. */
-        // 检查添加 value 是否需要对 subject 进行编码转换
-        // O(N)
-        listTypeTryConversion(subject,val);
+        redisAssertWithInfo(c,refval,sdsEncodedObject(refval));
 
         /* Seek refval from head to tail */
         // 从表头开始，向表尾查找包含 refval 的节点
-        // O(N^2)
+        // O(N)
         iter = listTypeInitIterator(subject,0,REDIS_TAIL);
         while (listTypeNext(iter,&entry)) {
             if (listTypeEqual(&entry,refval)) {
-                // 找到，插入 val, O(N^2)
+                // 找到，插入 val
                 listTypeInsert(&entry,val,where);
                 inserted = 1;
                 break;
@@ -549,11 +375,6 @@ void pushxGenericCommand(redisClient *c, robj *refval, robj *val, int where) {
 
         // value 已经插入成功？
         if (inserted) {
-            /* Check if the length exceeds the ziplist length threshold. */
-            // 检查是否需要对列表进行编码转换, O(N)
-            if (subject->encoding == REDIS_ENCODING_ZIPLIST &&
-                ziplistLen(subject->ptr) > server.list_max_ziplist_entries)
-                    listTypeConvert(subject,REDIS_ENCODING_LINKEDLIST);
             signalModifiedKey(c->db,c->argv[1]);
             server.dirty++;
         } else {
@@ -563,7 +384,7 @@ void pushxGenericCommand(redisClient *c, robj *refval, robj *val, int where) {
         }
     } else {
         // 简单地将 value 推入到列表的之前或之后
-        // O(N^2)
+        // O(1)
         listTypePush(subject,val,where);
 
         signalModifiedKey(c->db,c->argv[1]);
@@ -645,36 +466,21 @@ void lindexCommand(redisClient *c) {
     if ((getLongFromObjectOrReply(c, c->argv[2], &index, NULL) != REDIS_OK))
         return;
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        // 从 ziplist 中获取
-        unsigned char *p;
-        unsigned char *vstr;
-        unsigned int vlen;
-        long long vlong;
-        // O(1)
-        p = ziplistIndex(o->ptr,index);
-        if (ziplistGet(p,&vstr,&vlen,&vlong)) {
-            // 取出值
-            if (vstr) {
-                value = createStringObject((char*)vstr,vlen);
+    if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklistEntry entry;
+        // 根据索引从 quicklist 中取出值
+        // O(N/节点大小)
+        if (quicklistIndex(o->ptr, index, &entry)) {
+            if (entry.value) {
+                value = createStringObject((char*)entry.value,entry.sz);
             } else {
-                value = createStringObjectFromLongLong(vlong);
+                value = createStringObjectFromLongLong(entry.longval);
             }
             addReplyBulk(c,value);
             decrRefCount(value);
         } else {
             addReply(c,shared.nullbulk);
         }
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // 从双端列表中取出值
-        // O(N)
-        listNode *ln = listIndex(o->ptr,index);
-        if (ln != NULL) {
-            value = listNodeValue(ln);
-            addReplyBulk(c,value);
-        } else {
-            addReply(c,shared.nullbulk);
-        }
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -700,46 +506,20 @@ void lsetCommand(redisClient *c) {
     if ((getLongFromObjectOrReply(c, c->argv[2], &index, NULL) != REDIS_OK))
         return;
 
-    // 如果有需要，转换列表的编码,O(N)
-    listTypeTryConversion(o,value);
+    if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklist *ql = o->ptr;
+        int replaced;
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        // 更新到 ziplist
-        unsigned char *p, *zl = o->ptr;
-        p = ziplistIndex(zl,index);
-        if (p == NULL) {
+        // 用新值替换 index 上的元素
+        // O(N/节点大小)
+        value = getDecodedObject(value);
+        replaced = quicklistReplaceAtIndex(ql, index, value->ptr,
+                                           sdslen(value->ptr));
+        decrRefCount(value);
+        if (!replaced) {
             // index 越界
             addReply(c,shared.outofrangeerr);
         } else {
-            // 先删除 ziplist 里指定 index 的值
-            // O(N^2)
-            o->ptr = ziplistDelete(o->ptr,&p);
-            // 再将新值添加到 ziplist 的末尾
-            value = getDecodedObject(value);
-            // O(N^2)
-            o->ptr = ziplistInsert(o->ptr,p,value->ptr,sdslen(value->ptr));
-
-            decrRefCount(value);
-
-            addReply(c,shared.ok);
-            signalModifiedKey(c->db,c->argv[1]);
-            server.dirty++;
-        }
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // 添加到双端链表
-        // O(N)
-        listNode *ln = listIndex(o->ptr,index);
-        if (ln == NULL) {
-            addReply(c,shared.outofrangeerr);
-        } else {
-            // 删除 ln 原有的值
-            // O(1)
-            decrRefCount((robj*)listNodeValue(ln));
-            // 在用新值替换它
-            listNodeValue(ln) = value;
-
-            incrRefCount(value);
-
             addReply(c,shared.ok);
             signalModifiedKey(c->db,c->argv[1]);
             server.dirty++;
@@ -829,50 +609,33 @@ void lrangeCommand(redisClient *c) {
 
     /* Return the result in form of a multi-bulk reply */
     addReplyMultiBulkLen(c,rangelen);
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        // 处理 ziplist
-        unsigned char *p = ziplistIndex(o->ptr,start);
-        unsigned char *vstr;
-        unsigned int vlen;
-        long long vlong;
+    if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        // 从 start 开始向表尾迭代
+        listTypeIterator *iter = listTypeInitIterator(o, start, REDIS_TAIL);
+        listTypeEntry entry;
 
         // O(N)
         while(rangelen--) {
-            ziplistGet(p,&vstr,&vlen,&vlong);
-            if (vstr) {
-                addReplyBulkCBuffer(c,vstr,vlen);
+            listTypeNext(iter, &entry);
+            quicklistEntry *qe = &entry.entry;
+            if (qe->value) {
+                addReplyBulkCBuffer(c,qe->value,qe->sz);
             } else {
-                addReplyBulkLongLong(c,vlong);
+                addReplyBulkLongLong(c,qe->longval);
             }
-            p = ziplistNext(o->ptr,p);
-        }
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        // 处理双端链表
-        listNode *ln;
-
-        /* If we are nearest to the end of the list, reach the element
-         * starting from tail and going backward, as it is faster. */
-        if (start > llen/2) start -= llen;
-        ln = listIndex(o->ptr,start);
-
-        // O(N)
-        while(rangelen--) {
-            addReplyBulk(c,ln->value);
-            ln = ln->next;
         }
+        listTypeReleaseIterator(iter);
     } else {
-        redisPanic("List encoding is not LINKEDLIST nor ZIPLIST!");
+        redisPanic("List encoding is not QUICKLIST!");
     }
 }
 
 /*
- * T = O(N^2)
+ * T = O(N)
  */
 void ltrimCommand(redisClient *c) {
     robj *o;
-    long start, end, llen, j, ltrim, rtrim;
-    list *list;
-    listNode *ln;
+    long start, end, llen, ltrim, rtrim;
 
     if ((getLongFromObjectOrReply(c, c->argv[2], &start, NULL) != REDIS_OK) ||
         (getLongFromObjectOrReply(c, c->argv[3], &end, NULL) != REDIS_OK)) return;
@@ -900,23 +663,11 @@ void ltrimCommand(redisClient *c) {
 
     /* Remove list elements to perform the trim */
     // 删除
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        // O(N^2)
-        o->ptr = ziplistDeleteRange(o->ptr,0,ltrim);
-        // O(N^2)
-        o->ptr = ziplistDeleteRange(o->ptr,-rtrim,rtrim);
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        list = o->ptr;
-        // 从表头向表尾删除, O(N)
-        for (j = 0; j < ltrim; j++) {
-            ln = listFirst(list);
-            listDelNode(list,ln);
-        }
-        // 从表尾向表头删除, O(N)
-        for (j = 0; j < rtrim; j++) {
-            ln = listLast(list);
-            listDelNode(list,ln);
-        }
+    if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        // 从表头向表尾删除
+        quicklistDelRange(o->ptr,0,ltrim);
+        // 从表尾向表头删除
+        quicklistDelRange(o->ptr,-rtrim,rtrim);
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -930,7 +681,7 @@ void ltrimCommand(redisClient *c) {
 }
 
 /*
- * T = O(N^3)
+ * T = O(N)
  */
 void lremCommand(redisClient *c) {
     robj *subject, *obj;
@@ -951,9 +702,8 @@ void lremCommand(redisClient *c) {
     // 类型检查
     if (subject == NULL || checkType(c,subject,REDIS_LIST)) return;
 
-    /* Make sure obj is raw when we're dealing with a ziplist */
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST)
-        obj = getDecodedObject(obj);
+    /* Make sure obj is raw, ziplist entries are compared as strings */
+    obj = getDecodedObject(obj);
 
     // 根据 toremove ，决定是迭代器遍历的方式（从头到尾或者从尾到头）
     listTypeIterator *li;
@@ -968,7 +718,7 @@ void lremCommand(redisClient *c) {
     // 遍历, O(N)
     while (listTypeNext(li,&entry)) {
         if (listTypeEqual(&entry,obj)) {
-            // 删除, O(N^2)
+            // 删除
             listTypeDelete(&entry);
             server.dirty++;
             removed++;
@@ -978,8 +728,7 @@ void lremCommand(redisClient *c) {
     listTypeReleaseIterator(li);
 
     /* Clean up raw encoded object */
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST)
-        decrRefCount(obj);
+    decrRefCount(obj);
 
     // 列表为空？删除它
     if (listTypeLength(subject) == 0) dbDelete(c->db,c->argv[1]);
@@ -1014,8 +763,8 @@ void rpoplpushHandlePush(redisClient *c, robj *dstkey, robj *dstobj, robj *value
     /* Create the list if the key does not exist */
     // 列表不存在，创建列表
     if (!dstobj) {
-        // 创建 ziplist
-        dstobj = createZiplistObject();
+        // 创建 quicklist
+        dstobj = createQuicklistObject();
         // 添加到 db
         dbAdd(c->db,dstkey,dstobj);
         // 将 dstkey 添加到 server.ready_keys 列表里
@@ -1371,6 +1120,10 @@ int serveClientBlockedOnList(redisClient *receiver, robj *key, robj *dstkey, red
             return REDIS_ERR;
         }
     }
+
+    /* The reply must not reach the client before the pop is on disk. */
+    // 在弹出操作写入 AOF 之前，不向客户端发送回复
+    aofHoldClientReply(receiver);
     return REDIS_OK;
 }
 
@@ -134,6 +134,51 @@ tags {"aof"} {
         }
     }
 
+    ## Test threaded AOF writes with many clients writing at the same time
+    foreach fsync {always everysec} {
+        create_aof {
+            append_to_aof [formatCommand set foo hello]
+        }
+
+        start_server_aof [list dir $server_path aof-write-thread yes appendfsync $fsync] {
+            test "AOF write thread (appendfsync $fsync): concurrent writes" {
+                set clients {}
+                for {set j 0} {$j < 10} {incr j} {
+                    lappend clients [redis [dict get $srv host] [dict get $srv port] 1]
+                }
+                foreach rd $clients {
+                    for {set i 0} {$i < 1000} {incr i} {
+                        $rd incr counter
+                        $rd rpush list $i
+                    }
+                }
+                foreach rd $clients {
+                    for {set i 0} {$i < 2000} {incr i} {$rd read}
+                    $rd close
+                }
+
+                set client [redis [dict get $srv host] [dict get $srv port]]
+                assert_equal 10000 [$client get counter]
+                set d1 [$client debug digest]
+                $client debug loadaof
+                assert_equal $d1 [$client debug digest]
+                assert_equal hello [$client get foo]
+                assert_equal 10000 [$client llen list]
+            }
+
+            if {$fsync eq {always}} {
+                test "AOF write thread (appendfsync always): reply after write" {
+                    set client [redis [dict get $srv host] [dict get $srv port]]
+                    $client set durable value
+                    set fp [open $aof_path r]
+                    set content [read $fp]
+                    close $fp
+                    assert_match {*durable*} $content
+                }
+            }
+        }
+    }
+
     start_server {overrides {appendonly {yes} appendfilename {appendonly.aof}}} {
         test {Redis should not try to convert DEL into EXPIREAT for EXPIRE -1} {
             r set x 10
@@ -3,8 +3,9 @@ set server_path [tmpdir "server.rdb-encoding-test"]
 # Copy RDB with different encodings in server path
 exec cp tests/assets/encodings.rdb $server_path
 
-start_server [list overrides [list "dir" $server_path "dbfilename" "encodings.rdb"]] {
-  test "RDB encoding loading test" {
+foreach threads {1 4} {
+start_server [list overrides [list "dir" $server_path "dbfilename" "encodings.rdb" "rdb-load-threads" $threads]] {
+  test "RDB encoding loading test (rdb-load-threads $threads)" {
     r select 0
     csvdump r
   } {"compressible","string","aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
@@ -22,4 +23,81 @@ start_server [list overrides [list "dir" $server_path "dbfilename" "encodings.rd
 "zset_zipped","zset","a","1","b","2","c","3",
 }
 }
+}
+
+start_server {tags {"rdb"} overrides {rdb-load-threads 4}} {
+    test {Threaded RDB loading preserves the dataset} {
+        r select 9
+        createComplexDataset r 10000
+        r set bigstring [string repeat "abcd" 10000]
+        for {set j 0} {$j < 100} {incr j} {
+            r setex volatile:$j 1000 $j
+        }
+        r debug populate 20000
+        set digest [r debug digest]
+        set size [r dbsize]
+        r debug reload
+        assert_equal $digest [r debug digest]
+        assert_equal $size [r dbsize]
+    }
+
+    test {Threaded RDB loading matches serial loading} {
+        set digest [r debug digest]
+        r config set rdb-load-threads 1
+        r debug reload
+        assert_equal $digest [r debug digest]
+        r config set rdb-load-threads 4
+        r debug reload
+        assert_equal $digest [r debug digest]
+    }
+
+    test {Threaded RDB loading shares small integer values} {
+        r set smallint 123
+        r set bigint 1234567
+        r debug reload
+        list [expr {[r object refcount smallint] > 1}] \
+             [r object refcount bigint] [r object encoding bigint]
+    } {1 1 int}
+}
+
+start_server {tags {"rdb"} overrides {rdb-compression-codec lz4}} {
+    test {RDB strings compressed with LZ4 are loaded back} {
+        r select 9
+        createComplexDataset r 5000
+        r set bigstring [string repeat "abcd" 10000]
+        for {set j 0} {$j < 100} {incr j} {
+            r set compressible:$j [string repeat "value:$j " 20]
+        }
+        set digest [r debug digest]
+        r debug reload
+        assert_equal $digest [r debug digest]
+    }
 
+    test {RDB files saved with LZ4 strings load with any codec configured} {
+        set digest [r debug digest]
+        r save
+        r config set rdb-compression-codec lzf
+        r debug reload
+        assert_equal $digest [r debug digest]
+        r config set rdb-compression-codec lz4
+        r debug reload
+        assert_equal $digest [r debug digest]
+    }
+
+    test {RDB stream compression preserves the dataset} {
+        set digest [r debug digest]
+        r config set rdb-stream-compression yes
+        foreach codec {lz4 lzf} {
+            r config set rdb-compression-codec $codec
+            r debug reload
+            assert_equal $digest [r debug digest]
+        }
+        r config set rdb-load-threads 4
+        r debug reload
+        r config set rdb-load-threads 1
+        assert_equal $digest [r debug digest]
+        r config set rdb-stream-compression no
+        r debug reload
+        assert_equal $digest [r debug digest]
+    }
+}
@@ -0,0 +1,106 @@
+proc start_bg_complex_data {host port db ops} {
+    exec tclsh8.5 tests/helpers/bg_complex_data.tcl $host $port $db $ops &
+}
+
+proc stop_bg_complex_data {handle} {
+    catch {exec /bin/kill -9 $handle}
+}
+
+proc wait_for_link_up {slave} {
+    wait_for_condition 100 100 {
+        [status $slave master_link_status] eq {up}
+    } else {
+        fail "Replication link not established"
+    }
+}
+
+proc wait_for_same_digest {master slave} {
+    wait_for_condition 100 100 {
+        [$master debug digest] eq [$slave debug digest]
+    } else {
+        fail "Master and slave have different datasets"
+    }
+}
+
+proc count_log_lines {stdout pattern} {
+    set fp [open $stdout r]
+    set count 0
+    while {[gets $fp line] >= 0} {
+        if {[string match $pattern $line]} {incr count}
+    }
+    close $fp
+    return $count
+}
+
+start_server {tags {"repl"}} {
+    set master [srv 0 client]
+    set master_host [srv 0 host]
+    set master_port [srv 0 port]
+    set master_stdout [srv 0 stdout]
+    $master config set repl-diskless-sync yes
+    $master config set repl-diskless-sync-delay 3
+    $master debug populate 10000
+
+    start_server {} {
+        set slave_disk [srv 0 client]
+
+        start_server {} {
+            set slave_socket [srv 0 client]
+            $slave_socket config set repl-diskless-load yes
+
+            test {Diskless sync: CONFIG GET reports the new options} {
+                list [lindex [$master config get repl-diskless-sync] 1] \
+                     [lindex [$master config get repl-diskless-sync-delay] 1] \
+                     [lindex [$slave_socket config get repl-diskless-load] 1]
+            } {yes 3 yes}
+
+            test {Diskless sync: one transfer streams the RDB to both slaves} {
+                set load_handle [start_bg_complex_data \
+                    $master_host $master_port 9 100000]
+                $slave_disk slaveof $master_host $master_port
+                $slave_socket slaveof $master_host $master_port
+                wait_for_link_up $slave_disk
+                wait_for_link_up $slave_socket
+                after 1000
+                stop_bg_complex_data $load_handle
+                wait_for_same_digest $master $slave_disk
+                wait_for_same_digest $master $slave_socket
+                list [count_log_lines $master_stdout \
+                        {*Starting BGSAVE for SYNC with target: slaves sockets*}] \
+                     [count_log_lines $master_stdout \
+                        {*Starting BGSAVE for SYNC with target: disk*}] \
+                     [count_log_lines $master_stdout \
+                        {*Streamed RDB transfer with slave succeeded*}]
+            } {1 0 2}
+
+            test {Diskless sync: slaves keep following the master} {
+                $master set diskless-key 12345
+                $master lpush diskless-list a b c
+                wait_for_same_digest $master $slave_disk
+                wait_for_same_digest $master $slave_socket
+                $slave_socket lrange diskless-list 0 -1
+            } {c b a}
+
+            test {Diskless sync: slave loading from the socket resyncs again} {
+                $slave_socket slaveof no one
+                for {set j 0} {$j < 1000} {incr j} {$master set extra:$j $j}
+                $slave_socket slaveof $master_host $master_port
+                wait_for_link_up $slave_socket
+                wait_for_same_digest $master $slave_socket
+                count_log_lines $master_stdout \
+                    {*Starting BGSAVE for SYNC with target: slaves sockets*}
+            } {2}
+
+            test {Diskless sync: slaves without EOF capability get a disk payload} {
+                set fd [socket $master_host $master_port]
+                fconfigure $fd -translation binary
+                puts -nonewline $fd "SYNC\r\n"
+                flush $fd
+                while {[set line [string trim [gets $fd]]] eq {}} {}
+                close $fd
+                list [string range $line 0 0] \
+                     [string is integer -strict [string range $line 1 end]]
+            } {{$} 1}
+        }
+    }
+}
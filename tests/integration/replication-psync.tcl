@@ -0,0 +1,199 @@
+proc start_bg_complex_data {host port db ops} {
+    exec tclsh8.5 tests/helpers/bg_complex_data.tcl $host $port $db $ops &
+}
+
+proc stop_bg_complex_data {handle} {
+    catch {exec /bin/kill -9 $handle}
+}
+
+# Kill the link with the master from the slave side, so that the slave
+# caches the master and tries a partial resynchronization.
+proc kill_master_link {slave} {
+    foreach line [split [$slave client list] "\n"] {
+        if {[string match {*flags=M*} $line]} {
+            regexp {addr=([^ ]+)} $line - addr
+            catch {$slave client kill $addr}
+        }
+    }
+}
+
+proc wait_for_link_up {slave} {
+    wait_for_condition 100 100 {
+        [status $slave master_link_status] eq {up}
+    } else {
+        fail "Replication link not established"
+    }
+}
+
+proc wait_for_same_digest {master slave} {
+    wait_for_condition 100 100 {
+        [$master debug digest] eq [$slave debug digest]
+    } else {
+        fail "Master and slave have different datasets"
+    }
+}
+
+start_server {tags {"repl"}} {
+    set master [srv 0 client]
+    set master_host [srv 0 host]
+    set master_port [srv 0 port]
+
+    start_server {} {
+        set slave [srv 0 client]
+
+        test {PSYNC: slave attaches with a full resync} {
+            $slave slaveof $master_host $master_port
+            wait_for_link_up $slave
+            list [status $master sync_full] [status $master repl_backlog_active]
+        } {1 1}
+
+        test {PSYNC: partial resync after the link drops under write load} {
+            set load_handle0 [start_bg_complex_data $master_host $master_port 9 100000]
+            set load_handle1 [start_bg_complex_data $master_host $master_port 11 100000]
+            after 500
+
+            for {set j 0} {$j < 3} {incr j} {
+                kill_master_link $slave
+                after 200
+                wait_for_link_up $slave
+                after 300
+            }
+
+            stop_bg_complex_data $load_handle0
+            stop_bg_complex_data $load_handle1
+            wait_for_same_digest $master $slave
+            assert {[$master dbsize] > 0}
+            list [status $master sync_full] [status $master sync_partial_ok]
+        } {1 3}
+
+        test {PSYNC: master and slave agree on the replication offset} {
+            $master set foo bar
+            wait_for_condition 50 100 {
+                [status $master master_repl_offset] ==
+                [status $slave slave_repl_offset]
+            } else {
+                fail "Slave offset doesn't match the master offset"
+            }
+        }
+
+        test {PSYNC: full resync when the offset is outside the backlog} {
+            $master config set repl-backlog-size 16384
+            set rd [redis_deferring_client]
+            kill_master_link $slave
+            # Keep the slave busy so that it can't reconnect while the
+            # backlog is overwritten.
+            $rd debug sleep 1
+            for {set j 0} {$j < 100} {incr j} {
+                $master set key:$j [string repeat x 1000]
+            }
+            $rd read
+            $rd close
+            wait_for_link_up $slave
+            wait_for_same_digest $master $slave
+            list [status $master sync_full] [status $master sync_partial_err]
+        } {2 1}
+
+        test {PSYNC: SLAVEOF to the same master after SLAVEOF NO ONE does a full resync} {
+            $slave slaveof no one
+            $slave slaveof $master_host $master_port
+            wait_for_link_up $slave
+            wait_for_same_digest $master $slave
+            status $master sync_full
+        } {3}
+
+        test {PSYNC: backlog is freed after repl-backlog-ttl without slaves} {
+            $master config set repl-backlog-ttl 1
+            $slave slaveof no one
+            wait_for_condition 50 100 {
+                [status $master repl_backlog_active] == 0
+            } else {
+                fail "Backlog not freed"
+            }
+        }
+    }
+}
+
+# A master implemented in Tcl, so that the replication stream can be cut
+# in the middle of a command.
+proc fake_master_accept {fd addr port} {
+    fconfigure $fd -translation binary -blocking 1
+    set ::fake_master_link $fd
+}
+
+proc fake_master_wait_link {} {
+    set ::fake_master_link {}
+    set timer [after 10000 {set ::fake_master_link timeout}]
+    vwait ::fake_master_link
+    after cancel $timer
+    if {$::fake_master_link eq {timeout}} {
+        fail "The slave did not connect to the fake master"
+    }
+    return $::fake_master_link
+}
+
+# Reply to the slave handshake, and return its PSYNC command.
+proc fake_master_handshake {fd} {
+    while 1 {
+        set line [string trim [gets $fd]]
+        if {[string match PSYNC* $line]} {return $line}
+        if {[string match PING* $line]} {
+            puts -nonewline $fd "+PONG\r\n"
+        } else {
+            puts -nonewline $fd "+OK\r\n"
+        }
+        flush $fd
+    }
+}
+
+start_server {tags {"repl"}} {
+    set slave [srv 0 client]
+
+    test {PSYNC: master link lost in the middle of a big argument} {
+        # Take the RDB payload of the full resync from the empty slave.
+        $slave save
+        set rdbfile [file join [lindex [$slave config get dir] 1] dump.rdb]
+        set f [open $rdbfile r]
+        fconfigure $f -translation binary
+        set rdb [read $f]
+        close $f
+
+        set listener [socket -server fake_master_accept -myaddr 127.0.0.1 0]
+        set port [lindex [fconfigure $listener -sockname] 2]
+        set runid [string repeat a 40]
+        set val [string repeat x 4096]
+        set cmd "*3\r\n\$3\r\nSET\r\n\$3\r\nfoo\r\n\$4096\r\n$val\r\n"
+
+        $slave slaveof 127.0.0.1 $port
+        set fd [fake_master_wait_link]
+        assert_equal {PSYNC ? -1} [fake_master_handshake $fd]
+        puts -nonewline $fd "+FULLRESYNC $runid 0\r\n"
+        puts -nonewline $fd "\$[string length $rdb]\r\n$rdb"
+        flush $fd
+        wait_for_link_up $slave
+
+        # Stop in the middle of the value, so that the slave is reading
+        # it in place when the link is closed.
+        set select "*2\r\n\$6\r\nSELECT\r\n\$1\r\n9\r\n"
+        puts -nonewline $fd $select[string range $cmd 0 2000]
+        flush $fd
+        after 200
+        close $fd
+
+        # The half received command is not part of the offset, and is
+        # sent again as a whole after the partial resynchronization.
+        set fd [fake_master_wait_link]
+        set offset [expr {[string length $select]+1}]
+        assert_equal "PSYNC $runid $offset" [fake_master_handshake $fd]
+        puts -nonewline $fd "+CONTINUE\r\n$cmd"
+        flush $fd
+        wait_for_condition 50 100 {
+            [$slave strlen foo] == 4096
+        } else {
+            fail "The command was not replicated after the partial resync"
+        }
+        $slave slaveof no one
+        close $fd
+        close $listener
+        $slave get foo
+    } [string repeat x 4096]
+}
@@ -77,14 +77,6 @@ start_server {tags {"repl"}} {
     }
 }
 
-proc start_write_load {host port seconds} {
-    exec tclsh8.5 tests/helpers/gen_write_load.tcl $host $port $seconds &
-}
-
-proc stop_write_load {handle} {
-    catch {exec /bin/kill -9 $handle}
-}
-
 start_server {tags {"repl"}} {
     set master [srv 0 client]
     set master_host [srv 0 host]
@@ -310,3 +310,11 @@ proc csvstring s {
 proc roundFloat f {
     format "%.10g" $f
 }
+
+proc start_write_load {host port seconds} {
+    exec tclsh8.5 tests/helpers/gen_write_load.tcl $host $port $seconds &
+}
+
+proc stop_write_load {handle} {
+    catch {exec /bin/kill -9 $handle}
+}
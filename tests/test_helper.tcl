@@ -15,6 +15,7 @@ set ::all_tests {
     unit/auth
     unit/protocol
     unit/basic
+    unit/scan
     unit/type/list
     unit/type/list-2
     unit/type/list-3
@@ -31,17 +32,22 @@ set ::all_tests {
     integration/replication-2
     integration/replication-3
     integration/replication-4
+    integration/replication-psync
+    integration/replication-diskless
     integration/aof
     integration/rdb
     integration/convert-zipmap-hash-on-load
     unit/pubsub
     unit/slowlog
+    unit/latency-monitor
     unit/scripting
     unit/maxmemory
     unit/introspection
     unit/limits
     unit/obuf-limits
     unit/bitops
+    unit/io-threads
+    unit/lazyfree
 }
 # Index to the next test to run in the ::all_tests list.
 set ::next_test 0
@@ -1,3 +1,40 @@
+start_server {tags {"aofrw"}} {
+    # Enable the AOF and wait for the initial rewrite to finish
+    r config set appendonly yes
+    waitForBgrewriteaof r
+
+    foreach rdbpre {no yes} {
+        test "AOF rewrite during write load (RDB preamble: $rdbpre)" {
+            r config set aof-use-rdb-preamble $rdbpre
+            r flushall
+            r debug populate 200000
+
+            # Keep writing while the child rewrites, so that the parent
+            # has to stream its diff to the child.
+            set load_handle [start_write_load [srv 0 host] [srv 0 port] 10]
+            set dbsize [r dbsize]
+            wait_for_condition 50 100 {
+                [r dbsize] > $dbsize
+            } else {
+                fail "No write load detected."
+            }
+            r bgrewriteaof
+            waitForBgrewriteaof r
+            stop_write_load $load_handle
+            after 100
+
+            # The rewritten AOF must contain everything written meanwhile.
+            set d1 [r debug digest]
+            r debug loadaof
+            set d2 [r debug digest]
+            r config set aof-use-rdb-preamble no
+            assert_equal $d1 $d2
+            assert {[status r aof_last_rewrite_diff_bytes] >= 0}
+            assert {[status r aof_last_rewrite_diff_write_usec] >= 0}
+        }
+    }
+}
+
 start_server {tags {"aofrw"}} {
 
     test {Turning off AOF kills the background writing child if any} {
@@ -15,10 +52,10 @@ start_server {tags {"aofrw"}} {
     }
 
     foreach d {string int} {
-        foreach e {ziplist linkedlist} {
+        foreach e {quicklist} {
             test "AOF rewrite of list with $e encoding, $d data" {
                 r flushall
-                if {$e eq {ziplist}} {set len 10} else {set len 1000}
+                set len 1000
                 for {set j 0} {$j < $len} {incr j} {
                     if {$d eq {string}} {
                         set data [randstring 0 16 alpha]
@@ -120,6 +157,44 @@ start_server {tags {"aofrw"}} {
         }
     }
 
+    test {AOF rewrite with RDB preamble, then load the AOF tail} {
+        r config set aof-use-rdb-preamble yes
+        r config set appendonly yes
+        waitForBgrewriteaof r
+        r flushall
+        r debug populate 1000
+        r rpush mylist a b c 1 2 3
+        r sadd myset a b c
+        r zadd myzset 1 a 2 b
+        r hset myhash field value
+        r setex volatile 1000 value
+        r bgrewriteaof
+        waitForBgrewriteaof r
+
+        # The snapshot part of the rewritten AOF is an RDB payload.
+        set aof [file join [lindex [r config get dir] 1] appendonly.aof]
+        set fp [open $aof r]
+        fconfigure $fp -translation binary
+        set sig [read $fp 5]
+        close $fp
+        assert_equal REDIS $sig
+
+        # Commands received after the rewrite are appended as the tail.
+        r rpush mylist 4
+        r del key:10
+        r select 10
+        r set otherdb value
+        r select 9
+        set d1 [r debug digest]
+        r debug loadaof
+        set d2 [r debug digest]
+        r config set appendonly no
+        r config set aof-use-rdb-preamble no
+        assert_equal $d1 $d2
+        assert_equal 1004 [r dbsize]
+        assert_equal {a b c 1 2 3 4} [r lrange mylist 0 -1]
+    }
+
     test {BGREWRITEAOF is delayed if BGSAVE is in progress} {
         r multi
         r bgsave
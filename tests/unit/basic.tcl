@@ -14,6 +14,43 @@ start_server {tags {"basic"}} {
         r get x
     } {}
 
+    test {Short strings are embstr encoded, long strings are raw} {
+        r set x foobar
+        assert_encoding embstr x
+        r set x [string repeat a 39]
+        assert_encoding embstr x
+        r set x [string repeat a 40]
+        assert_encoding raw x
+        r get x
+    } [string repeat a 40]
+
+    test {Modifying an embstr value converts it to raw} {
+        r set x foo
+        assert_encoding embstr x
+        r append x bar
+        assert_encoding raw x
+        assert_equal foobar [r get x]
+        r set x foo
+        r setrange x 1 xx
+        assert_encoding raw x
+        assert_equal fxx [r get x]
+        r set x foo
+        r setbit x 7 1
+        assert_encoding raw x
+        assert_equal [r getbit x 7] 1
+        r get x
+    } {goo}
+
+    test {Embstr values survive DEBUG RELOAD} {
+        r set x foobar
+        r sadd myset foobar
+        r debug reload
+        assert_encoding embstr x
+        set res [list [r get x] [r smembers myset] [r strlen x] [r getrange x 1 2]]
+        r del myset
+        set res
+    } {foobar foobar 6 oo}
+
     test {DEL against a single item} {
         r del x
         r get x
@@ -46,6 +83,16 @@ start_server {tags {"basic"}} {
         r dbsize
     } {0}
 
+    test {Replies larger than the reply buffer, with a deferred length} {
+        # KEYS sends the length of the reply after the keys: the reply
+        # spans many reply blocks, and the length is glued in front of them
+        r debug populate 20000
+        set keys [r keys *]
+        assert_equal 20000 [llength $keys]
+        assert_equal 20000 [llength [lsort -unique $keys]]
+        r flushdb
+    } {OK}
+
     test {Very big payload in GET/SET} {
         set buf [string repeat "abcd" 1000000]
         r set foo $buf
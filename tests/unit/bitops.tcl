@@ -60,6 +60,17 @@ start_server {tags {"bitops"}} {
         }
     }
 
+    test {BITCOUNT fuzzing with start, end} {
+        for {set j 0} {$j < 100} {incr j} {
+            set str [randstring 0 3000]
+            set start [randomInt 3000]
+            set end [randomInt 3000]
+            r set str $str
+            assert {[r bitcount str $start $end] ==
+                    [count_bits [string range $str $start $end]]}
+        }
+    }
+
     test {BITCOUNT with start, end} {
         r set s "foobar"
         assert_equal [r bitcount s 0 -1] [count_bits "foobar"]
@@ -146,6 +157,23 @@ start_server {tags {"bitops"}} {
         }
     }
 
+    test {BITOP fuzzing with many keys} {
+        foreach op {and or xor} {
+            r flushall
+            set vec {}
+            set veckeys {}
+            set len [randomInt 600]
+            for {set j 0} {$j < 20} {incr j} {
+                set str [randstring $len $len]
+                lappend vec $str
+                lappend veckeys vector_$j
+                r set vector_$j $str
+            }
+            r bitop $op target {*}$veckeys
+            assert_equal [r get target] [simulate_bit_op $op {*}$vec]
+        }
+    }
+
     test {BITOP NOT fuzzing} {
         for {set i 0} {$i < 10} {incr i} {
             r flushall
@@ -177,4 +205,131 @@ start_server {tags {"bitops"}} {
         r set a "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
         r bitop or x a b
     } {32}
+
+    test {BITPOS bit=0 with empty key returns 0} {
+        r del str
+        r bitpos str 0
+    } {0}
+
+    test {BITPOS bit=1 with empty key returns -1} {
+        r del str
+        r bitpos str 1
+    } {-1}
+
+    test {BITPOS bit argument must be 1 or 0} {
+        r set str "\x00"
+        catch {r bitpos str 2} e
+        set e
+    } {*ERR*}
+
+    test {BITPOS bit=0 with string less than 1 word works} {
+        r set str "\xff\xf0\x00"
+        r bitpos str 0
+    } {12}
+
+    test {BITPOS bit=1 with string less than 1 word works} {
+        r set str "\x00\x0f\x00"
+        r bitpos str 1
+    } {12}
+
+    test {BITPOS bit=0 starting at unaligned address} {
+        r set str "\xff\xf0\x00"
+        r bitpos str 0 1
+    } {12}
+
+    test {BITPOS bit=1 starting at unaligned address} {
+        r set str "\x00\x0f\xff"
+        r bitpos str 1 1
+    } {12}
+
+    test {BITPOS bit=0 unaligned+full vectors+reminder} {
+        r set str "\xff\xff\xff" ; # Prefix
+        # Followed by more than two 32 bytes vectors
+        r append str [string repeat "\xff" 72]
+        # First zero bit.
+        r append str "\x0f"
+        assert {[r bitpos str 0] == 600}
+        assert {[r bitpos str 0 1] == 600}
+        assert {[r bitpos str 0 2] == 600}
+        assert {[r bitpos str 0 3] == 600}
+        assert {[r bitpos str 0 70] == 600}
+        assert {[r bitpos str 0 75] == 600}
+    }
+
+    test {BITPOS bit=1 unaligned+full vectors+reminder} {
+        r set str "\x00\x00\x00" ; # Prefix
+        # Followed by more than two 32 bytes vectors
+        r append str [string repeat "\x00" 72]
+        # First one bit.
+        r append str "\xf0"
+        assert {[r bitpos str 1] == 600}
+        assert {[r bitpos str 1 1] == 600}
+        assert {[r bitpos str 1 2] == 600}
+        assert {[r bitpos str 1 3] == 600}
+        assert {[r bitpos str 1 70] == 600}
+        assert {[r bitpos str 1 75] == 600}
+    }
+
+    test {BITPOS bit=1 returns -1 if string is all 0 bits} {
+        r set str ""
+        for {set j 0} {$j < 70} {incr j} {
+            assert {[r bitpos str 1] == -1}
+            r append str "\x00"
+        }
+    }
+
+    test {BITPOS bit=0 works with intervals} {
+        r set str "\x00\xff\x00"
+        assert {[r bitpos str 0 0 -1] == 0}
+        assert {[r bitpos str 0 1 -1] == 16}
+        assert {[r bitpos str 0 2 -1] == 16}
+        assert {[r bitpos str 0 2 200] == 16}
+        assert {[r bitpos str 0 1 1] == -1}
+    }
+
+    test {BITPOS bit=1 works with intervals} {
+        r set str "\x00\xff\x00"
+        assert {[r bitpos str 1 0 -1] == 8}
+        assert {[r bitpos str 1 1 -1] == 8}
+        assert {[r bitpos str 1 2 -1] == -1}
+        assert {[r bitpos str 1 2 200] == -1}
+        assert {[r bitpos str 1 1 1] == 8}
+    }
+
+    test {BITPOS bit=0 changes behavior if end is given} {
+        r set str "\xff\xff\xff"
+        assert {[r bitpos str 0] == 24}
+        assert {[r bitpos str 0 0] == 24}
+        assert {[r bitpos str 0 0 -1] == -1}
+    }
+
+    test {BITPOS bit=1 fuzzy testing using SETBIT} {
+        r del str
+        set max 524288; # 64k
+        set first_one_pos -1
+        for {set j 0} {$j < 1000} {incr j} {
+            assert {[r bitpos str 1] == $first_one_pos}
+            set pos [randomInt $max]
+            r setbit str $pos 1
+            if {$first_one_pos == -1 || $first_one_pos > $pos} {
+                # Update the position of the first 1 bit in the array
+                # if the bit we set is on the left of the previous one.
+                set first_one_pos $pos
+            }
+        }
+    }
+
+    test {BITPOS bit=0 fuzzy testing using SETBIT} {
+        set max 524288; # 64k
+        set first_zero_pos $max
+        r set str [string repeat "\xff" [expr $max/8]]
+        for {set j 0} {$j < 1000} {incr j} {
+            assert {[r bitpos str 0] == $first_zero_pos}
+            set pos [randomInt $max]
+            r setbit str $pos 0
+            if {$first_zero_pos > $pos} {
+                set first_zero_pos $pos
+            }
+        }
+    }
 }
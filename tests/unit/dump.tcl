@@ -16,6 +16,17 @@ start_server {tags {"dump"}} {
         r get foo
     } {bar}
 
+    test {DUMP compresses strings with LZF whatever the RDB codec} {
+        r config set rdb-compression-codec lz4
+        r set foo [string repeat "abcd" 100]
+        set encoded [r dump foo]
+        r config set rdb-compression-codec lzf
+        # Type byte, then a string encoded as REDIS_RDB_ENC_LZF (0xC3).
+        binary scan [string index $encoded 1] cu enc
+        r del foo
+        list $enc [r restore foo 0 $encoded] [string length [r get foo]]
+    } {195 OK 400}
+
     test {RESTORE returns an error of the key already exists} {
         r set foo bar
         set e {}
@@ -147,7 +158,7 @@ start_server {tags {"dump"}} {
     test {MIGRATE can correctly transfer large values} {
         set first [srv 0 client]
         r del key
-        for {set j 0} {$j < 5000} {incr j} {
+        for {set j 0} {$j < 40000} {incr j} {
             r rpush key 1 2 3 4 5 6 7 8 9 10
             r rpush key "item 1" "item 2" "item 3" "item 4" "item 5" \
                         "item 6" "item 7" "item 8" "item 9" "item 10"
@@ -165,7 +176,7 @@ start_server {tags {"dump"}} {
             assert {[$first exists key] == 0}
             assert {[$second exists key] == 1}
             assert {[$second ttl key] == -1}
-            assert {[$second llen key] == 5000*20}
+            assert {[$second llen key] == 40000*20}
         }
     }
 
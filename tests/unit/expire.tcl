@@ -170,4 +170,32 @@ start_server {tags {"expire"}} {
         r set foo b
         lsort [r keys *]
     } {a e foo s t}
+
+    test {Redis should actively expire many keys expiring at once} {
+        r flushdb
+        # Keys that all expire at the same time, and a few non volatile
+        # keys: the active cycle should reclaim the volatile ones without
+        # them being accessed.
+        for {set j 0} {$j < 20000} {incr j} {
+            r psetex volatile:$j 500 x
+        }
+        for {set j 0} {$j < 100} {incr j} {
+            r set persistent:$j x
+        }
+        after 600
+        wait_for_condition 50 100 {
+            [r dbsize] == 100
+        } else {
+            fail "Keys were not actively expired"
+        }
+        assert {[s expired_keys] >= 20000}
+        r dbsize
+    } {100}
+
+    test {INFO reports the active expire cycle stats} {
+        set info [r info stats]
+        list [regexp {expired_stale_perc:[0-9.]+} $info] \
+             [regexp {expired_time_cap_reached_count:[0-9]+} $info] \
+             [regexp {expire_cycle_cpu_milliseconds:[0-9]+} $info]
+    } {1 1 1}
 }
@@ -19,4 +19,27 @@ start_server {tags {"introspection"}} {
         assert_match {*eval*} [$rd read]
         assert_match {*lua*"set"*"foo"*"bar"*} [$rd read]
     }
+
+    test {INFO commandstats reports latency percentiles} {
+        r config resetstat
+        for {set j 0} {$j < 100} {incr j} {
+            r set foo $j
+        }
+        r debug sleep 0.05
+        set line [string trim [lsearch -inline [split [r info commandstats] "\n"] cmdstat_set:*]]
+        assert_match {cmdstat_set:calls=100,*,p50=*,p99=*,p999=*} $line
+        regexp {p50=(\d+),p99=(\d+),p999=(\d+)} $line -> p50 p99 p999
+        assert {$p50 <= $p99 && $p99 <= $p999}
+        set line [string trim [lsearch -inline [split [r info commandstats] "\n"] cmdstat_debug:*]]
+        regexp {p50=(\d+),p99=(\d+),p999=(\d+)} $line -> p50 p99 p999
+        assert {$p50 >= 50000 && $p999 >= 50000}
+    }
+
+    test {CONFIG RESETSTAT resets the latency histograms} {
+        r config resetstat
+        r debug sleep 0
+        set line [string trim [lsearch -inline [split [r info commandstats] "\n"] cmdstat_debug:*]]
+        regexp {p999=(\d+)} $line -> p999
+        assert {$p999 < 50000}
+    }
 }
@@ -0,0 +1,61 @@
+start_server {tags {"io-threads"} overrides {io-threads 4}} {
+    test {CONFIG GET io-threads} {
+        lindex [r config get io-threads] 1
+    } {4}
+
+    test {Many clients served by the I/O threads} {
+        set clients {}
+        for {set j 0} {$j < 20} {incr j} {
+            lappend clients [redis_deferring_client]
+        }
+        for {set j 0} {$j < 100} {incr j} {
+            set i 0
+            foreach rd $clients {
+                $rd set key:$i:$j $j
+                incr i
+            }
+        }
+        foreach rd $clients {
+            for {set j 0} {$j < 100} {incr j} {
+                assert_equal OK [$rd read]
+            }
+        }
+        set i 0
+        foreach rd $clients {
+            $rd mget key:$i:0 key:$i:99
+            assert_equal {0 99} [$rd read]
+            $rd close
+            incr i
+        }
+        r dbsize
+    } {2000}
+
+    test {Big pipelined replies are written by the I/O threads} {
+        r del biglist
+        for {set j 0} {$j < 1000} {incr j} {
+            r rpush biglist [string repeat x 100]
+        }
+        set rd [redis_deferring_client]
+        for {set j 0} {$j < 50} {incr j} {
+            $rd lrange biglist 0 -1
+        }
+        for {set j 0} {$j < 50} {incr j} {
+            assert_equal 1000 [llength [$rd read]]
+        }
+        $rd close
+    }
+
+    test {QUIT is honored with pending replies} {
+        set rd [redis_deferring_client]
+        $rd ping
+        $rd quit
+        assert_equal PONG [$rd read]
+        assert_equal OK [$rd read]
+        $rd close
+        r ping
+    } {PONG}
+
+    test {io_threaded_reads_processed is reported in INFO} {
+        expr {[status r io_threaded_reads_processed] > 0}
+    } {1}
+}
@@ -0,0 +1,107 @@
+start_server {tags {"lazyfree"}} {
+    test "UNLINK can reclaim memory in background" {
+        set orig_mem [s used_memory]
+        set args {}
+        for {set i 0} {$i < 100000} {incr i} {
+            lappend args $i
+        }
+        r sadd myset {*}$args
+        assert {[r scard myset] == 100000}
+        set peak_mem [s used_memory]
+        assert {[r unlink myset] == 1}
+        assert {$peak_mem > $orig_mem+1000000}
+        wait_for_condition 50 100 {
+            [s used_memory] < $peak_mem &&
+            [s used_memory] < $orig_mem*2
+        } else {
+            fail "Memory is not reclaimed by UNLINK"
+        }
+    }
+
+    test "UNLINK returns the number of removed keys" {
+        r set foo 1
+        r rpush biglist {*}[lrepeat 1000 x]
+        r set bar 2
+        list [r unlink foo biglist bar nokey] [r exists foo] \
+             [r exists biglist] [r exists bar]
+    } {3 0 0 0}
+
+    test "UNLINK removes the expire of the key" {
+        r sadd volatile a b c
+        r expire volatile 100
+        r unlink volatile
+        r sadd volatile a
+        r ttl volatile
+    } {-1}
+
+    test "UNLINK of a set sharing its elements with another key" {
+        r del myset copy
+        for {set i 0} {$i < 1000} {incr i} {r sadd myset "element:$i"}
+        r sunionstore copy myset
+        r unlink myset
+        list [r exists myset] [r scard copy] [r sismember copy element:999]
+    } {0 1000 1}
+
+    test "FLUSHALL ASYNC inside MULTI/EXEC" {
+        r multi
+        r set foo [string repeat x 2000]
+        r flushall async
+        r set bar baz
+        r exec
+        list [r exists foo] [r get bar]
+    } {0 baz}
+
+    test "FLUSHDB ASYNC can reclaim memory in background" {
+        set orig_mem [s used_memory]
+        set args {}
+        for {set i 0} {$i < 100000} {incr i} {
+            lappend args $i
+        }
+        r sadd myset {*}$args
+        assert {[r scard myset] == 100000}
+        set peak_mem [s used_memory]
+        r flushdb async
+        assert {[r dbsize] == 0}
+        assert {$peak_mem > $orig_mem+1000000}
+        wait_for_condition 50 100 {
+            [s used_memory] < $peak_mem &&
+            [s used_memory] < $orig_mem*2
+        } else {
+            fail "Memory is not reclaimed by FLUSHDB ASYNC"
+        }
+    }
+
+    test "FLUSHALL ASYNC empties every database" {
+        r select 10
+        r set foo bar
+        r select 9
+        r set foo bar
+        r flushall async
+        set res [r dbsize]
+        r select 10
+        lappend res [r dbsize]
+        r select 9
+        set res
+    } {0 0}
+
+    test "Lazyfree pending objects eventually drop to zero" {
+        for {set i 0} {$i < 10} {incr i} {
+            for {set j 0} {$j < 1000} {incr j} {r sadd set:$i $j}
+            r rpush list:$i {*}[lrepeat 1000 x]
+            r unlink list:$i
+        }
+        r flushall async
+        wait_for_condition 50 100 {
+            [s lazyfree_pending_objects] == 0
+        } else {
+            fail "Lazyfree pending objects never reached zero"
+        }
+    }
+
+    test "FLUSHDB and FLUSHALL reject unknown arguments" {
+        set e1 [catch {r flushdb foo} err1]
+        set e2 [catch {r flushall async foo} err2]
+        list $e1 $e2 [string match {*syntax*} $err1] \
+             [string match {*syntax*} $err2]
+    } {1 1 1 1}
+}
@@ -1,6 +1,7 @@
 start_server {tags {"maxmemory"}} {
     foreach policy {
-        allkeys-random allkeys-lru volatile-lru volatile-random volatile-ttl
+        allkeys-random allkeys-lru allkeys-lfu volatile-lru volatile-lfu
+        volatile-random volatile-ttl
     } {
         test "maxmemory - is the memory limit honoured? (policy $policy)" {
             # make sure to start with a blank instance
@@ -32,7 +33,8 @@ start_server {tags {"maxmemory"}} {
     }
 
     foreach policy {
-        allkeys-random allkeys-lru volatile-lru volatile-random volatile-ttl
+        allkeys-random allkeys-lru allkeys-lfu volatile-lru volatile-lfu
+        volatile-random volatile-ttl
     } {
         test "maxmemory - only allkeys-* should remove non-volatile keys ($policy)" {
             # make sure to start with a blank instance
@@ -74,7 +76,7 @@ start_server {tags {"maxmemory"}} {
     }
 
     foreach policy {
-        volatile-lru volatile-random volatile-ttl
+        volatile-lru volatile-lfu volatile-random volatile-ttl
     } {
         test "maxmemory - policy $policy should only remove volatile keys." {
             # make sure to start with a blank instance
@@ -117,4 +119,110 @@ start_server {tags {"maxmemory"}} {
             }
         }
     }
+
+    test "maxmemory - allkeys-lru evicts the least recently used keys" {
+        r flushall
+        set used [s used_memory]
+        set limit [expr {$used+100*1024}]
+        r config set maxmemory $limit
+        r config set maxmemory-policy allkeys-lru
+        # Fill the instance, then wait for the keys to become idle.
+        set numkeys 0
+        while 1 {
+            r set "key:$numkeys" x
+            incr numkeys
+            if {[s used_memory]+4096 > $limit} {
+                assert {$numkeys > 10}
+                break
+            }
+        }
+        after 2000
+        # Access the first half of the keys, and make space for new keys:
+        # only keys of the untouched half should be evicted. We add fewer
+        # new keys than the untouched ones as a resize of the main dict may
+        # require evicting more keys than the ones added. For the same
+        # reason a few keys may already be gone, so only the keys we were
+        # able to access are checked.
+        set hot {}
+        for {set j 0} {$j < $numkeys/2} {incr j} {
+            if {[r get "key:$j"] ne {}} {lappend hot "key:$j"}
+        }
+        for {set j 0} {$j < $numkeys/4} {incr j} {
+            r set "new:$j" x
+        }
+        assert {[s used_memory] < ($limit+4096)}
+        set survived 0
+        foreach key $hot {
+            incr survived [r exists $key]
+        }
+        assert {$survived > [llength $hot]*0.95}
+    }
+
+    test "OBJECT FREQ requires an LFU policy" {
+        r config set maxmemory 0
+        r config set maxmemory-policy allkeys-lru
+        r set foo bar
+        catch {r object freq foo} e
+        set e
+    } {*LFU maxmemory policy is not selected*}
+
+    test "OBJECT FREQ grows logarithmically with accesses" {
+        r config set maxmemory-policy allkeys-lfu
+        r config set lfu-log-factor 10
+        r flushall
+        r set foo bar
+        set initial [r object freq foo]
+        for {set j 0} {$j < 100} {incr j} {r get foo}
+        set after100 [r object freq foo]
+        for {set j 0} {$j < 1000} {incr j} {r get foo}
+        set after1100 [r object freq foo]
+        assert {$initial == 5}
+        assert {$after100 > $initial}
+        assert {$after1100 > $after100}
+        # The counter is logarithmic: 1100 accesses are far from
+        # saturating it with the default factor.
+        assert {$after1100 < 50}
+        catch {r object idletime foo} e
+        set e
+    } {*LFU maxmemory policy is selected*}
+
+    test "CONFIG SET/GET of the LFU parameters" {
+        r config set lfu-log-factor 0
+        r config set lfu-decay-time 5
+        r set foo bar
+        for {set j 0} {$j < 20} {incr j} {r get foo}
+        set res [list [lindex [r config get lfu-log-factor] 1] \
+                      [lindex [r config get lfu-decay-time] 1] \
+                      [r object freq foo]]
+        r config set lfu-log-factor 10
+        r config set lfu-decay-time 1
+        set res
+    } {0 5 25}
+
+    test "maxmemory - allkeys-lfu keeps frequently used keys on scans" {
+        r flushall
+        r config set lfu-log-factor 0
+        set used [s used_memory]
+        set limit [expr {$used+100*1024}]
+        r config set maxmemory $limit
+        r config set maxmemory-policy allkeys-lfu
+        # Create a few hot keys, accessed many times.
+        for {set j 0} {$j < 50} {incr j} {
+            r set "hot:$j" x
+            for {set i 0} {$i < 20} {incr i} {r get "hot:$j"}
+        }
+        # A scan-like burst of keys written once: LRU would evict the hot
+        # keys as they are not the most recently used ones.
+        for {set j 0} {$j < 5000} {incr j} {
+            r set "scan:$j" x
+        }
+        assert {[s used_memory] < ($limit+4096)}
+        assert {[s evicted_keys] > 0}
+        set survived 0
+        for {set j 0} {$j < 50} {incr j} {
+            incr survived [r exists "hot:$j"]
+        }
+        r config set lfu-log-factor 10
+        set survived
+    } {50}
 }
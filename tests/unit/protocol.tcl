@@ -60,6 +60,25 @@ start_server {tags {"protocol"}} {
         assert_error "*wrong*arguments*ping*" {r ping x y z}
     }
 
+    test "Big bulk arguments split across reads" {
+        reconnect
+        set val [string repeat x 5000]
+        set cmd "*3\r\n\$3\r\nSET\r\n\$3\r\nfoo\r\n\$5000\r\n$val\r\n"
+        # Stop in the middle of the value, then in the middle of its CRLF,
+        # and pipeline a second command after the end of the first one.
+        r write [string range $cmd 0 1000]
+        r flush
+        after 100
+        r write [string range $cmd 1001 end-1]
+        r flush
+        after 100
+        r write "\n*2\r\n\$3\r\nGET\r\n\$3\r\nfoo\r\n"
+        r flush
+        assert_equal OK [r read]
+        assert_equal $val [r read]
+        r strlen foo
+    } {5000}
+
     set c 0
     foreach seq [list "\x00" "*\x00" "$\x00"] {
         incr c
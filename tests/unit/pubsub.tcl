@@ -172,6 +172,20 @@ start_server {tags {"pubsub"}} {
         $rd1 close
     }
 
+    test "PSUBSCRIBE to one pattern more than once" {
+        set rd1 [redis_deferring_client]
+        assert_equal {1 1 2} [psubscribe $rd1 {chan.* chan.* 123}]
+        assert_equal 1 [r publish chan.1 hello]
+        assert_equal {pmessage chan.* chan.1 hello} [$rd1 read]
+        assert_equal {1} [punsubscribe $rd1 {123}]
+        assert_equal 0 [r publish 123 hello]
+        assert_equal 1 [r publish chan.2 hello]
+        assert_equal {pmessage chan.* chan.2 hello} [$rd1 read]
+
+        # clean up clients
+        $rd1 close
+    }
+
     test "PUNSUBSCRIBE from non-subscribed channels" {
         set rd1 [redis_deferring_client]
         assert_equal {0 0 0} [punsubscribe $rd1 {foo.* bar.* quux.*}]
@@ -180,6 +194,63 @@ start_server {tags {"pubsub"}} {
         $rd1 close
     }
 
+    test "PUBLISH/PSUBSCRIBE with patterns sharing a prefix" {
+        set rd1 [redis_deferring_client]
+        set patterns [list news.* news.sport.* n?ws.* * {news.sport.[ab]*} {lit\*}]
+        assert_equal {1 2 3 4 5 6} [psubscribe $rd1 $patterns]
+
+        assert_equal 5 [r publish news.sport.a1 hello]
+        set got {}
+        for {set j 0} {$j < 5} {incr j} {lappend got [lindex [$rd1 read] 1]}
+        assert_equal [lsort {news.* news.sport.* n?ws.* * news.sport.[ab]*}] \
+                     [lsort $got]
+        assert_equal 2 [r publish lit* hello]
+        assert_equal 1 [r publish litx hello]
+        assert_equal 1 [r publish news hello]
+        for {set j 0} {$j < 4} {incr j} {$rd1 read}
+
+        # unsubscribe from patterns that share their prefix with others
+        assert_equal {5 4} [punsubscribe $rd1 {news.sport.* news.*}]
+        assert_equal 3 [r publish news.sport.a1 hello]
+        for {set j 0} {$j < 3} {incr j} {$rd1 read}
+        assert_equal {5} [psubscribe $rd1 {news.sport.*}]
+        assert_equal 4 [r publish news.sport.b1 hello]
+        for {set j 0} {$j < 4} {incr j} {$rd1 read}
+
+        punsubscribe $rd1
+        assert_equal 0 [r publish news.sport.a1 hello]
+        assert_equal 0 [r publish lit* hello]
+
+        # clean up clients
+        $rd1 close
+    }
+
+    test "PUBLISH of a large message to many subscribers" {
+        set rd1 [redis_deferring_client]
+        set rd2 [redis_deferring_client]
+        set rd3 [redis_deferring_client]
+        assert_equal {1} [subscribe $rd1 {big}]
+        assert_equal {1} [subscribe $rd2 {big}]
+        assert_equal {1} [psubscribe $rd3 {b*}]
+
+        # the payload is shared by the subscribers, every one of them must
+        # still receive it in full and followed by the next messages
+        set payload [string repeat "x" 100000]
+        assert_equal 3 [r publish big $payload]
+        assert_equal 3 [r publish big small]
+        foreach rd [list $rd1 $rd2] {
+            assert_equal [list message big $payload] [$rd read]
+            assert_equal {message big small} [$rd read]
+        }
+        assert_equal [list pmessage b* big $payload] [$rd3 read]
+        assert_equal {pmessage b* big small} [$rd3 read]
+
+        # clean up clients
+        $rd1 close
+        $rd2 close
+        $rd3 close
+    }
+
     test "Mix SUBSCRIBE and PSUBSCRIBE" {
         set rd1 [redis_deferring_client]
         assert_equal {1} [subscribe $rd1 {foo.bar}]
@@ -0,0 +1,248 @@
+start_server {tags {"scan"}} {
+    test "SCAN basic" {
+        r flushdb
+        r debug populate 1000
+
+        set cur 0
+        set keys {}
+        while 1 {
+            set res [r scan $cur]
+            set cur [lindex $res 0]
+            set k [lindex $res 1]
+            lappend keys {*}$k
+            if {$cur == 0} break
+        }
+
+        set keys [lsort -unique $keys]
+        assert_equal 1000 [llength $keys]
+    }
+
+    foreach count {1 5 10 50 100} {
+        test "SCAN COUNT $count" {
+            r flushdb
+            r debug populate 1000
+
+            set cur 0
+            set keys {}
+            while 1 {
+                set res [r scan $cur count $count]
+                set cur [lindex $res 0]
+                set k [lindex $res 1]
+                lappend keys {*}$k
+                if {$cur == 0} break
+            }
+
+            set keys [lsort -unique $keys]
+            assert_equal 1000 [llength $keys]
+        }
+    }
+
+    test "SCAN MATCH" {
+        r flushdb
+        r debug populate 1000
+
+        set cur 0
+        set keys {}
+        while 1 {
+            set res [r scan $cur match "key:1??"]
+            set cur [lindex $res 0]
+            set k [lindex $res 1]
+            lappend keys {*}$k
+            if {$cur == 0} break
+        }
+
+        set keys [lsort -unique $keys]
+        assert_equal 100 [llength $keys]
+    }
+
+    test "SCAN does not return expired keys" {
+        r flushdb
+        r debug populate 100
+        for {set j 0} {$j < 50} {incr j} {
+            r pexpire key:$j 1
+        }
+        after 10
+
+        set cur 0
+        set keys {}
+        while 1 {
+            set res [r scan $cur]
+            set cur [lindex $res 0]
+            lappend keys {*}[lindex $res 1]
+            if {$cur == 0} break
+        }
+
+        assert_equal 50 [llength [lsort -unique $keys]]
+    }
+
+    test "SCAN guarantees check under write load" {
+        r flushdb
+        r debug populate 100
+
+        # We start scanning here, so keys from 0 to 99 should all be
+        # reported at the end of the iteration. Keys added in the meantime
+        # force the hash table to grow and rehash while we scan.
+        set keys {}
+        set cur 0
+        while 1 {
+            set res [r scan $cur]
+            set cur [lindex $res 0]
+            set k [lindex $res 1]
+            lappend keys {*}$k
+            if {$cur == 0} break
+            for {set j 0} {$j < 10} {incr j} {
+                r set "new:[randomInt 1000000000]" x
+            }
+        }
+
+        set keys2 {}
+        foreach k $keys {
+            if {[string length $k] > 6} continue
+            lappend keys2 $k
+        }
+
+        set keys2 [lsort -unique $keys2]
+        assert_equal 100 [llength $keys2]
+    }
+
+    test "SCAN with invalid cursor or options" {
+        assert_error "*invalid cursor*" {r scan foo}
+        assert_error "*invalid cursor*" {r scan -1}
+        assert_error "*syntax*" {r scan 0 count 0}
+        assert_error "*syntax*" {r scan 0 foo bar}
+    }
+
+    foreach enc {intset hashtable} {
+        test "SSCAN with encoding $enc" {
+            r del set
+            if {$enc eq {intset}} {
+                set prefix ""
+            } else {
+                set prefix "ele:"
+            }
+            set elements {}
+            for {set j 0} {$j < 100} {incr j} {
+                lappend elements ${prefix}${j}
+            }
+            r sadd set {*}$elements
+
+            # Verify that the encoding matches.
+            assert {[r object encoding set] eq $enc}
+
+            # Test SSCAN
+            set cur 0
+            set keys {}
+            while 1 {
+                set res [r sscan set $cur]
+                set cur [lindex $res 0]
+                set k [lindex $res 1]
+                lappend keys {*}$k
+                if {$cur == 0} break
+            }
+
+            set keys [lsort -unique $keys]
+            assert_equal 100 [llength $keys]
+        }
+    }
+
+    foreach enc {ziplist hashtable} {
+        test "HSCAN with encoding $enc" {
+            r del hash
+            if {$enc eq {ziplist}} {
+                set count 30
+            } else {
+                set count 1000
+            }
+            set elements {}
+            for {set j 0} {$j < $count} {incr j} {
+                lappend elements key:$j $j
+            }
+            r hmset hash {*}$elements
+
+            # Verify that the encoding matches.
+            assert {[r object encoding hash] eq $enc}
+
+            # Test HSCAN
+            set cur 0
+            set keys {}
+            set vals {}
+            while 1 {
+                set res [r hscan hash $cur]
+                set cur [lindex $res 0]
+                set k [lindex $res 1]
+                foreach {field val} $k {
+                    lappend keys $field
+                    lappend vals $val
+                    assert_equal "key:$val" $field
+                }
+                if {$cur == 0} break
+            }
+
+            set keys [lsort -unique $keys]
+            assert_equal $count [llength $keys]
+        }
+    }
+
+    foreach enc {ziplist skiplist} {
+        test "ZSCAN with encoding $enc" {
+            r del zset
+            if {$enc eq {ziplist}} {
+                set count 30
+            } else {
+                set count 1000
+            }
+            set elements {}
+            for {set j 0} {$j < $count} {incr j} {
+                lappend elements $j key:$j
+            }
+            r zadd zset {*}$elements
+
+            # Verify that the encoding matches.
+            assert {[r object encoding zset] eq $enc}
+
+            # Test ZSCAN
+            set cur 0
+            set keys {}
+            while 1 {
+                set res [r zscan zset $cur]
+                set cur [lindex $res 0]
+                set k [lindex $res 1]
+                foreach {member score} $k {
+                    lappend keys $member
+                    assert_equal "key:$score" $member
+                }
+                if {$cur == 0} break
+            }
+
+            set keys [lsort -unique $keys]
+            assert_equal $count [llength $keys]
+        }
+    }
+
+    test "SSCAN with integer encoded object and MATCH" {
+        r del set
+        r sadd set 1 a 2 b 10 20 100
+        set res [r sscan set 0 match 1* count 100]
+        lsort [lindex $res 1]
+    } {1 10 100}
+
+    test "HSCAN and ZSCAN with MATCH filter fields, not values" {
+        r del hash zset
+        r hmset hash foo1 a bar b foo2 c
+        r zadd zset 1 foo1 2 bar 3 foo2
+        set h [lindex [r hscan hash 0 match foo*] 1]
+        set z [lindex [r zscan zset 0 match foo*] 1]
+        list [lsort $h] [lsort $z]
+    } {{a c foo1 foo2} {1 3 foo1 foo2}}
+
+    test "SCAN family against missing keys and wrong types" {
+        r del nokey
+        r set str foo
+        assert_equal {0 {}} [r sscan nokey 0]
+        assert_equal {0 {}} [r hscan nokey 0]
+        assert_equal {0 {}} [r zscan nokey 0]
+        assert_error "*WRONGTYPE*" {r sscan str 0}
+        assert_error "*WRONGTYPE*" {r hscan str 0}
+        assert_error "*WRONGTYPE*" {r zscan str 0}
+    }
+}
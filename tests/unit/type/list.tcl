@@ -1,8 +1,7 @@
 start_server {
     tags {"list"}
     overrides {
-        "list-max-ziplist-value" 16
-        "list-max-ziplist-entries" 256
+        "list-max-ziplist-size" 5
     }
 } {
     source "tests/unit/type/list-common.tcl"
@@ -19,7 +18,7 @@ start_server {
         assert_equal {} [r lindex myziplist2 3]
         assert_equal c [r rpop myziplist1]
         assert_equal a [r lpop myziplist1]
-        assert_encoding ziplist myziplist1
+        assert_encoding quicklist myziplist1
 
         # first rpush then lpush
         assert_equal 1 [r rpush myziplist2 a]
@@ -32,13 +31,13 @@ start_server {
         assert_equal {} [r lindex myziplist2 3]
         assert_equal a [r rpop myziplist2]
         assert_equal c [r lpop myziplist2]
-        assert_encoding ziplist myziplist2
+        assert_encoding quicklist myziplist2
     }
 
     test {LPUSH, RPUSH, LLENGTH, LINDEX, LPOP - regular list} {
         # first lpush then rpush
         assert_equal 1 [r lpush mylist1 $largevalue(linkedlist)]
-        assert_encoding linkedlist mylist1
+        assert_encoding quicklist mylist1
         assert_equal 2 [r rpush mylist1 b]
         assert_equal 3 [r rpush mylist1 c]
         assert_equal 3 [r llen mylist1]
@@ -51,7 +50,7 @@ start_server {
 
         # first rpush then lpush
         assert_equal 1 [r rpush mylist2 $largevalue(linkedlist)]
-        assert_encoding linkedlist mylist2
+        assert_encoding quicklist mylist2
         assert_equal 2 [r lpush mylist2 b]
         assert_equal 3 [r lpush mylist2 c]
         assert_equal 3 [r llen mylist2]
@@ -89,13 +88,13 @@ start_server {
     proc create_ziplist {key entries} {
         r del $key
         foreach entry $entries { r rpush $key $entry }
-        assert_encoding ziplist $key
+        assert_encoding quicklist $key
     }
 
     proc create_linkedlist {key entries} {
         r del $key
         foreach entry $entries { r rpush $key $entry }
-        assert_encoding linkedlist $key
+        assert_encoding quicklist $key
     }
 
     foreach {type large} [array get largevalue] {
@@ -524,52 +523,46 @@ start_server {
         set e
     } {*ERR*syntax*error*}
 
-    test {LPUSHX, RPUSHX convert from ziplist to list} {
+    test {LPUSHX, RPUSHX across quicklist nodes} {
         set large $largevalue(linkedlist)
 
-        # convert when a large value is pushed
+        # push large values on a single node list
         create_ziplist xlist a
         assert_equal 2 [r rpushx xlist $large]
-        assert_encoding linkedlist xlist
-        create_ziplist xlist a
-        assert_equal 2 [r lpushx xlist $large]
-        assert_encoding linkedlist xlist
+        assert_equal 3 [r lpushx xlist $large]
+        assert_equal "$large a $large" [r lrange xlist 0 -1]
 
-        # convert when the length threshold is exceeded
+        # push past the node fill limit on both sides
         create_ziplist xlist [lrepeat 256 a]
         assert_equal 257 [r rpushx xlist b]
-        assert_encoding linkedlist xlist
-        create_ziplist xlist [lrepeat 256 a]
-        assert_equal 257 [r lpushx xlist b]
-        assert_encoding linkedlist xlist
+        assert_equal 258 [r lpushx xlist c]
+        assert_equal c [r lindex xlist 0]
+        assert_equal b [r lindex xlist -1]
+        assert_encoding quicklist xlist
     }
 
-    test {LINSERT convert from ziplist to list} {
+    test {LINSERT across quicklist nodes} {
         set large $largevalue(linkedlist)
 
-        # convert when a large value is inserted
+        # insert large values in a single node list
         create_ziplist xlist a
         assert_equal 2 [r linsert xlist before a $large]
-        assert_encoding linkedlist xlist
-        create_ziplist xlist a
-        assert_equal 2 [r linsert xlist after a $large]
-        assert_encoding linkedlist xlist
-
-        # convert when the length threshold is exceeded
-        create_ziplist xlist [lrepeat 256 a]
-        assert_equal 257 [r linsert xlist before a a]
-        assert_encoding linkedlist xlist
-        create_ziplist xlist [lrepeat 256 a]
-        assert_equal 257 [r linsert xlist after a a]
-        assert_encoding linkedlist xlist
-
-        # don't convert when the value could not be inserted
+        assert_equal 3 [r linsert xlist after a $large]
+        assert_equal "$large a $large" [r lrange xlist 0 -1]
+
+        # insert in the middle of a multi node list, splitting nodes
+        create_ziplist xlist [lrepeat 20 a]
+        r lset xlist 12 b
+        assert_equal 21 [r linsert xlist before b x]
+        assert_equal 22 [r linsert xlist after b y]
+        assert_equal {a x b y a} [r lrange xlist 11 15]
+        assert_equal 22 [r llen xlist]
+
+        # nothing changes when the pivot is not found
         create_ziplist xlist [lrepeat 256 a]
         assert_equal -1 [r linsert xlist before foo a]
-        assert_encoding ziplist xlist
-        create_ziplist xlist [lrepeat 256 a]
         assert_equal -1 [r linsert xlist after foo a]
-        assert_encoding ziplist xlist
+        assert_equal 256 [r llen xlist]
     }
 
     foreach {type num} {ziplist 250 linkedlist 500} {
@@ -595,18 +588,18 @@ start_server {
             for {set i 0} {$i < $num} {incr i} {
                 r rpush mylist $i
             }
-            assert_encoding $type mylist
+            assert_encoding quicklist mylist
             check_numbered_list_consistency mylist
         }
 
         test "LINDEX random access - $type" {
-            assert_encoding $type mylist
+            assert_encoding quicklist mylist
             check_random_access_consistency mylist
         }
 
         test "Check if list is still ok after a DEBUG RELOAD - $type" {
             r debug reload
-            assert_encoding $type mylist
+            assert_encoding quicklist mylist
             check_numbered_list_consistency mylist
             check_random_access_consistency mylist
         }
@@ -646,7 +639,7 @@ start_server {
             assert_equal c [r rpoplpush mylist1 mylist2]
             assert_equal "a $large" [r lrange mylist1 0 -1]
             assert_equal "c d" [r lrange mylist2 0 -1]
-            assert_encoding ziplist mylist2
+            assert_encoding quicklist mylist2
         }
 
         test "RPOPLPUSH with the same list as src and dst - $type" {
@@ -664,12 +657,7 @@ start_server {
                 assert_equal c [r rpoplpush srclist dstlist]
                 assert_equal "a b" [r lrange srclist 0 -1]
                 assert_equal "c $large $otherlarge" [r lrange dstlist 0 -1]
-
-                # When we rpoplpush'ed a large value, dstlist should be
-                # converted to the same encoding as srclist.
-                if {$type eq "linkedlist"} {
-                    assert_encoding linkedlist dstlist
-                }
+                assert_encoding quicklist dstlist
             }
         }
     }
@@ -730,7 +718,7 @@ start_server {
                 r lpush mylist $i
                 incr sum1 $i
             }
-            assert_encoding $type mylist
+            assert_encoding quicklist mylist
             set sum2 0
             for {set i 0} {$i < [expr $num/2]} {incr i} {
                 incr sum2 [r lpop mylist]
@@ -857,6 +845,42 @@ start_server {
         }
     }
 
+    test {Lists are split in multiple quicklist nodes} {
+        r del biglist
+        for {set i 0} {$i < 100} {incr i} { r rpush biglist $i }
+        assert_match {*ql_nodes:20 *} [r debug object biglist]
+        assert_equal {0 1 2 3 4 5} [r lrange biglist 0 5]
+        assert_equal {97 98 99} [r lrange biglist -3 -1]
+    }
+
+    test {Compressed list survives LSET, LREM, LTRIM and DEBUG RELOAD} {
+        r config set list-compress-depth 1
+        r del biglist
+        for {set i 0} {$i < 500} {incr i} {
+            r rpush biglist [string repeat "v$i-" 10]
+        }
+        assert_match {*ql_compressed:1*} [r debug object biglist]
+        assert_equal [string repeat "v250-" 10] [r lindex biglist 250]
+        r lset biglist 300 foo
+        assert_equal 1 [r lrem biglist 0 [string repeat "v200-" 10]]
+        r ltrim biglist 10 -10
+        set before [r lrange biglist 0 -1]
+        assert_equal 480 [llength $before]
+        r debug reload
+        assert_equal $before [r lrange biglist 0 -1]
+        assert_match {*ql_compressed:1*} [r debug object biglist]
+        r config set list-compress-depth 0
+    } {OK}
+
+    test {CONFIG SET list-max-ziplist-size and list-compress-depth} {
+        assert_error {*Invalid argument*} {r config set list-max-ziplist-size 0}
+        assert_error {*Invalid argument*} {r config set list-max-ziplist-size -6}
+        assert_error {*Invalid argument*} {r config set list-compress-depth -1}
+        r config set list-max-ziplist-size -2
+        assert_equal {list-max-ziplist-size -2} [r config get list-max-ziplist-size]
+        r config set list-max-ziplist-size 5
+    } {OK}
+
     test "Regression for bug 593 - chaining BRPOPLPUSH with other blocking cmds" {
         set rd1 [redis_deferring_client]
         set rd2 [redis_deferring_client]
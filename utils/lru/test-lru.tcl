@@ -0,0 +1,183 @@
+#!/usr/bin/env tclsh8.5
+# Compare the hit ratio of the Redis approximated LRU eviction with the one
+# of a true LRU cache (and of random eviction) on a Zipf distributed
+# workload.
+#
+# The script uses Redis as a cache: for every request a key is picked with
+# a Zipf distribution and fetched with GET, on a miss the key is SET.
+# After a warm-up the hit ratio of the server is measured, then the same
+# sequence of requests is replayed against a simulated true LRU cache and a
+# random eviction cache holding the same number of keys Redis was able to
+# hold within maxmemory.
+#
+# Usage: tclsh8.5 test-lru.tcl [host] [port] [maxmemory] [keyspace] \
+#                              [requests] [zipf-exponent] [policy]
+#
+# WARNING: the target server is flushed and reconfigured.
+
+source [file join [file dirname [info script]] ../../tests/support/redis.tcl]
+
+set host [expr {[llength $argv] > 0 ? [lindex $argv 0] : "127.0.0.1"}]
+set port [expr {[llength $argv] > 1 ? [lindex $argv 1] : 6379}]
+set maxmemory [expr {[llength $argv] > 2 ? [lindex $argv 2] : 4194304}]
+set keyspace [expr {[llength $argv] > 3 ? [lindex $argv 3] : 100000}]
+set requests [expr {[llength $argv] > 4 ? [lindex $argv 4] : 1000000}]
+set zipf_s [expr {[llength $argv] > 5 ? [lindex $argv 5] : 1.0}]
+set policy [expr {[llength $argv] > 6 ? [lindex $argv 6] : "allkeys-lru"}]
+set warmup [expr {$requests/5}]
+set batch 100
+set seed 1234
+set value [string repeat x 64]
+
+# Cumulative distribution of a Zipf law over $keyspace keys.
+proc zipf_init {n s} {
+    set sum 0.0
+    for {set i 1} {$i <= $n} {incr i} {
+        set sum [expr {$sum + 1.0/pow($i,$s)}]
+    }
+    set ::cdf {}
+    set acc 0.0
+    for {set i 1} {$i <= $n} {incr i} {
+        set acc [expr {$acc + (1.0/pow($i,$s))/$sum}]
+        lappend ::cdf $acc
+    }
+}
+
+# Return a key index in [0, keyspace) with Zipf distribution.
+proc zipf_next {} {
+    set r [expr {rand()}]
+    set lo 0
+    set hi [expr {[llength $::cdf]-1}]
+    while {$lo < $hi} {
+        set mid [expr {($lo+$hi)/2}]
+        if {[lindex $::cdf $mid] < $r} {
+            set lo [expr {$mid+1}]
+        } else {
+            set hi $mid
+        }
+    }
+    return $lo
+}
+
+# Run the workload against Redis, returning the hit ratio after warm-up.
+proc run_redis {r} {
+    set hits 0
+    set total 0
+    expr {srand($::seed)}
+    for {set done 0} {$done < $::requests} {incr done $::batch} {
+        set keys {}
+        for {set j 0} {$j < $::batch} {incr j} {
+            set k [zipf_next]
+            lappend keys $k
+            $r get key:$k
+        }
+        set misses {}
+        foreach k $keys {
+            set reply [$r read]
+            if {$done >= $::warmup} {
+                incr total
+                if {$reply ne {}} {incr hits}
+            }
+            if {$reply eq {}} {lappend misses $k}
+        }
+        foreach k $misses {$r set key:$k $::value}
+        foreach k $misses {$r read}
+    }
+    expr {double($hits)/$total}
+}
+
+# Replay the workload against a true LRU cache holding 'size' keys.
+# Keys are kept in a doubly linked list ordered by access time.
+proc run_true_lru {size} {
+    array set prev {}
+    array set next {}
+    set head -1; set tail -1; set used 0
+    set hits 0; set total 0
+    expr {srand($::seed)}
+    for {set i 0} {$i < $::requests} {incr i} {
+        set k [zipf_next]
+        set hit [info exists next($k)]
+        if {$i >= $::warmup} {
+            incr total
+            if {$hit} {incr hits}
+        }
+        if {$hit} {
+            if {$head == $k} continue
+            # Unlink.
+            set p $prev($k); set n $next($k)
+            set next($p) $n
+            if {$n != -1} {set prev($n) $p} else {set tail $p}
+        } elseif {$used == $size} {
+            # Evict the least recently used key.
+            set victim $tail
+            set tail $prev($victim)
+            set next($tail) -1
+            unset prev($victim) next($victim)
+        } else {
+            incr used
+        }
+        # Link as head.
+        set prev($k) -1
+        set next($k) $head
+        if {$head != -1} {set prev($head) $k}
+        set head $k
+        if {$tail == -1} {set tail $k}
+    }
+    expr {double($hits)/$total}
+}
+
+# Replay the workload against a cache with random eviction holding 'size'
+# keys.
+proc run_random {size} {
+    array set pos {}
+    set slots {}
+    set hits 0; set total 0
+    expr {srand($::seed)}
+    for {set i 0} {$i < $::requests} {incr i} {
+        set k [zipf_next]
+        set hit [info exists pos($k)]
+        if {$i >= $::warmup} {
+            incr total
+            if {$hit} {incr hits}
+        }
+        if {$hit} continue
+        if {[llength $slots] == $size} {
+            set j [expr {int(rand()*$size)}]
+            unset pos([lindex $slots $j])
+            lset slots $j $k
+            set pos($k) $j
+        } else {
+            set pos($k) [llength $slots]
+            lappend slots $k
+        }
+    }
+    expr {double($hits)/$total}
+}
+
+zipf_init $keyspace $zipf_s
+
+set r [redis $host $port]
+$r flushall
+$r config set maxmemory $maxmemory
+$r config set maxmemory-policy $policy
+$r close
+
+puts "Requests: $requests ($warmup warm-up), keyspace: $keyspace,\
+      zipf exponent: $zipf_s, maxmemory: $maxmemory bytes ($policy)"
+
+set r [redis $host $port 1]
+set start [clock milliseconds]
+set redis_ratio [run_redis $r]
+set elapsed [expr {[clock milliseconds]-$start}]
+$r close
+
+set r [redis $host $port]
+set size [$r dbsize]
+set info [$r info stats]
+$r close
+regexp {evicted_keys:(\d+)} $info -> evicted
+
+puts "Redis held $size keys, $evicted evictions ($elapsed ms)"
+puts [format "Redis %-14s hit ratio: %.4f" $policy $redis_ratio]
+puts [format "True LRU             hit ratio: %.4f" [run_true_lru $size]]
+puts [format "Random eviction      hit ratio: %.4f" [run_random $size]]